@@ -241,14 +241,7 @@
     {
         if (self.environment->getActiveObject())
         {
-            
-            if (MPMeshGetRefCount(self.environment->getActiveObject()->getMesh()) <= 1)
-            {
-                // free allocated vertex and index data if we're about to free the mesh
-                free((void *)_environment->getActiveObject()->getMesh()->vertexData);
-                free((void *)_environment->getActiveObject()->getMesh()->indexData);
-            }
-            
+            // meshes release their own vertex and index data when freed
             delete self.environment->getActiveObject();
         }
         
@@ -257,13 +250,6 @@
         {
             MP::Model *otherModel = *it;
             
-            if (MPMeshGetRefCount((*it)->getMesh()) <= 1)
-            {
-                // free allocated vertex and index data if we're about to free the mesh
-                free((void *)(*it)->getMesh()->vertexData);
-                free((void *)(*it)->getMesh()->indexData);
-            }
-            
             delete otherModel;
         }
         
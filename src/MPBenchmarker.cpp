@@ -152,50 +152,113 @@ namespace MP
         }
     }
     
+    void Benchmarker::benchmarkLoading(int N, const std::vector<std::string> &files)
+    {
+        std::cout << "\t *** BEGIN LOAD BENCHMARKING ***" << std::endl;
+        
+        Timer timer;
+        
+        for(auto &file : files)
+        {
+            bool isMesh = file.size() > 5 && file.compare(file.size() - 5, 5, ".mesh") == 0;
+            
+            double loadTime = 0.0;
+            int failures = 0;
+            
+            for(int i = 0; i < N; ++i)
+            {
+                Reader reader(file);
+                
+                timer.start();
+                
+                if(isMesh)
+                {
+                    MPMesh *mesh = reader.generateMesh();
+                    loadTime += GET_ELAPSED_MICRO(timer) / 1000.0;
+                    
+                    if(mesh)
+                        MPMeshFree(mesh);
+                    else
+                        failures++;
+                }
+                else
+                {
+                    Environment3D *environment = reader.generateEnvironment3D();
+                    loadTime += GET_ELAPSED_MICRO(timer) / 1000.0;
+                    
+                    if(environment)
+                        delete environment;
+                    else
+                        failures++;
+                }
+            }
+            
+            std::cout << file << ": (average) " << loadTime / N << " ms";
+            if(failures > 0)
+                std::cout << " (" << failures << " failed loads)";
+            std::cout << std::endl;
+        }
+    }
+    
     void Benchmarker::generateRandomStartGoalPairs3D(int N, const MPAABox &region)
     {
         assert(environment_ != nullptr);
         
         startGoalPairs_.clear();
         
+        std::vector<Transform3D> transforms;
+        randomValidTransforms3D(2 * N, region, transforms);
+        
         for(int s = 0; s < N; ++s)
         {
-            Transform3D start = randomTransform3D(region);
-            Transform3D goal = randomTransform3D(region);
-            
-            startGoalPairs_.push_back(std::make_pair(start, goal));
+            startGoalPairs_.push_back(std::make_pair(transforms.at(2 * s), transforms.at(2 * s + 1)));
         }
         
         std::cout << "Done adding " << N << " randomly generated start/goal pairs" << std::endl;
     }
     
-    Transform3D Benchmarker::randomTransform3D(const MPAABox &region)
+    void Benchmarker::randomValidTransforms3D(int N, const MPAABox &region, std::vector<Transform3D> &transforms)
     {
-        float x, y, z;
-        bool valid = false;
-        Transform3D transform;
-        while(!valid)
+        std::vector<Transform3D> candidates;
+        PoseBatch batch;
+        PoseBatch::Mask valid;
+        
+        int attempts = 0;
+        
+        while((int)transforms.size() < N)
         {
-            x = region.min.x + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.x - region.min.x)));
-            y = region.min.y + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.y - region.min.y)));
-            z = region.min.z + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.z - region.min.z)));
-            transform = Transform3D(MPVec3Make(x, y, z), MPVec3Make(1.0f, 1.0f, 1.0f), MPQuaternionIdentity);
-            
-            Transform3D plannerTransform(transform);
-            environment_->worldToPlanner(plannerTransform);
+            candidates.clear();
+            batch.clear();
             
-            if(environment_->stateValid(plannerTransform))
+            for(int i = 0; i < SAMPLE_BATCH_SIZE; ++i)
             {
-                valid = true;
-                std::cout << "found one!" << std::endl;
+                float x = region.min.x + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.x - region.min.x)));
+                float y = region.min.y + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.y - region.min.y)));
+                float z = region.min.z + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (region.max.z - region.min.z)));
+                candidates.push_back(Transform3D(MPVec3Make(x, y, z), MPVec3Make(1.0f, 1.0f, 1.0f), MPQuaternionIdentity));
+                
+                // check the state the planner will actually use
+                Transform3D plannerTransform(candidates.back());
+                environment_->worldToPlanner(plannerTransform);
+                environment_->plannerToWorld(plannerTransform);
+                
+                batch.push_back(plannerTransform);
             }
-            else
+            
+            environment_->isValidBatch(batch, valid);
+            
+            for(size_t i = 0; i < candidates.size() && (int)transforms.size() < N; ++i)
             {
-                std::cout << "bad :(" << std::endl;
+                if(PoseBatch::maskGet(valid, i))
+                {
+                    transforms.push_back(candidates[i]);
+                }
             }
+            
+            attempts += SAMPLE_BATCH_SIZE;
         }
         
-        return transform;
+        std::cout << "Sampled " << N << " valid transforms from " << attempts << " candidates" << std::endl;
     }
     
     void Benchmarker::stopPlanning(int plan)
@@ -24,6 +24,9 @@
 
 #define PLANNER_TIMEOUT 30.0f
 
+// number of candidate poses checked together when sampling start/goal pairs
+#define SAMPLE_BATCH_SIZE 256
+
 namespace MP
 {
     // Taken from http://stackoverflow.com/questions/14650885/how-to-create-timer-events-using-c-11
@@ -62,6 +65,11 @@ namespace MP
         
         void benchmark(int N, const Action6D::ActionSet &actionSet);
         
+        /* loads each file (a mesh if it ends in .mesh, otherwise an environment) N times and
+           reports the average time a load takes. meshes imported by environments are cached,
+           so only their first load parses them. */
+        void benchmarkLoading(int N, const std::vector<std::string> &files);
+        
         float getEnvStepSize() const { return environment_->getStepSize(); }
         
         float getEnvRotationStepSize() const { return environment_->getRotationStepSize(); }
@@ -69,7 +77,8 @@ namespace MP
     private:
         void generateRandomStartGoalPairs3D(int N, const MPAABox &region);
         
-        Transform3D randomTransform3D(const MPAABox &region);
+        /* samples random valid transforms (snapped to the planner lattice) until there are N of them */
+        void randomValidTransforms3D(int N, const MPAABox &region, std::vector<Transform3D> &transforms);
         
         void stopPlanning(int plan);
         
@@ -0,0 +1,117 @@
+//
+//  MPBitGrid.h
+//
+//  A dense 3D grid of bits packed 64 to a word. Cells are stored with k varying fastest,
+//  so a thread that owns a range of whole words can fill its cells without locking.
+
+#ifndef _MPBitGrid_h
+#define _MPBitGrid_h
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _MPBitGrid
+{
+    int dims[3];
+    size_t numWords;
+    uint64_t *words;
+} MPBitGrid;
+
+/* allocates a grid with all bits cleared. */
+static inline MPBitGrid MPBitGridMake(int ni, int nj, int nk)
+{
+    MPBitGrid g;
+    g.dims[0] = ni; g.dims[1] = nj; g.dims[2] = nk;
+
+    size_t numCells = (size_t)ni * (size_t)nj * (size_t)nk;
+    g.numWords = (numCells + 63) / 64;
+    g.words = (uint64_t *)calloc(g.numWords > 0 ? g.numWords : 1, sizeof(uint64_t));
+
+    return g;
+}
+
+static inline void MPBitGridFree(MPBitGrid *g)
+{
+    free(g->words);
+    g->words = NULL;
+    g->numWords = 0;
+}
+
+static inline size_t MPBitGridNumCells(const MPBitGrid *g)
+{
+    return (size_t)g->dims[0] * (size_t)g->dims[1] * (size_t)g->dims[2];
+}
+
+static inline size_t MPBitGridByteSize(const MPBitGrid *g)
+{
+    return g->numWords * sizeof(uint64_t);
+}
+
+static inline int MPBitGridContains(const MPBitGrid *g, int i, int j, int k)
+{
+    return (i >= 0 && i < g->dims[0] && j >= 0 && j < g->dims[1] && k >= 0 && k < g->dims[2]);
+}
+
+static inline size_t MPBitGridIndex(const MPBitGrid *g, int i, int j, int k)
+{
+    return ((size_t)i * g->dims[1] + j) * g->dims[2] + k;
+}
+
+/* inverse of MPBitGridIndex */
+static inline void MPBitGridCell(const MPBitGrid *g, size_t index, int *i, int *j, int *k)
+{
+    *k = (int)(index % g->dims[2]);
+    index /= g->dims[2];
+    *j = (int)(index % g->dims[1]);
+    *i = (int)(index / g->dims[1]);
+}
+
+static inline int MPBitGridGetIndex(const MPBitGrid *g, size_t index)
+{
+    return (int)((g->words[index >> 6] >> (index & 63)) & 1);
+}
+
+static inline void MPBitGridSetIndex(MPBitGrid *g, size_t index)
+{
+    g->words[index >> 6] |= ((uint64_t)1 << (index & 63));
+}
+
+/* sets the bit with an atomic or, for threads whose cells may share a word */
+static inline void MPBitGridSetIndexAtomic(MPBitGrid *g, size_t index)
+{
+    __atomic_fetch_or(&g->words[index >> 6], ((uint64_t)1 << (index & 63)), __ATOMIC_RELAXED);
+}
+
+/* results undefined if (i, j, k) is not contained in the grid. */
+static inline int MPBitGridGet(const MPBitGrid *g, int i, int j, int k)
+{
+    return MPBitGridGetIndex(g, MPBitGridIndex(g, i, j, k));
+}
+
+static inline void MPBitGridSet(MPBitGrid *g, int i, int j, int k)
+{
+    MPBitGridSetIndex(g, MPBitGridIndex(g, i, j, k));
+}
+
+static inline size_t MPBitGridCount(const MPBitGrid *g)
+{
+    size_t count = 0;
+
+    size_t w;
+    for (w = 0; w < g->numWords; ++w)
+    {
+        count += __builtin_popcountll(g->words[w]);
+    }
+
+    return count;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
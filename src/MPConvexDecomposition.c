@@ -0,0 +1,851 @@
+//
+//  MPConvexDecomposition.c
+//
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MPConvexDecomposition.h"
+#include "MPVoxelizer.h"
+
+#pragma mark - private definitions
+
+// voxels along the longest side of the mesh
+#define MP_CONVEX_RESOLUTION 24
+
+// a cluster is accepted once its voxels fill this fraction of its hull
+#define MP_CONVEX_MIN_FILL 0.75
+
+#define MP_GJK_MAX_ITERATIONS 64
+
+/* a corner of the voxel grid. hulls are built from these in integer coordinates, so the
+   orientation tests are exact even though voxel corners are very often coplanar. */
+typedef struct _MPLatticePoint
+{
+    int v[3];
+} MPLatticePoint;
+
+typedef struct _MPHullFace
+{
+    int v[3];  // indices into the hull's points, counterclockwise seen from outside
+} MPHullFace;
+
+typedef struct _MPConvexCluster
+{
+    int *cells;  // grid indices of the cluster's voxels
+    int count;
+
+    MPLatticePoint *hull;
+    int hullCount;
+
+    double fill;  // voxel volume over hull volume
+} MPConvexCluster;
+
+void _MPConvexClusterComputeHull(MPConvexCluster *cluster, const MPBitGrid *grid);
+
+int _MPConvexClusterSplit(const MPConvexCluster *cluster, const MPBitGrid *grid, MPConvexCluster *left, MPConvexCluster *right);
+
+long long _MPLatticeOrient(MPLatticePoint a, MPLatticePoint b, MPLatticePoint c, MPLatticePoint d);
+
+int _MPLatticeHull(const MPLatticePoint *points, int n, MPLatticePoint **hull, int *hullCount, long long *volume6);
+
+MPVec3 _MPConvexSupport(const MPVec3 *vertices, int count, MPMat4 transform, MPVec3 direction);
+
+int _MPGJKLine(MPVec3 *simplex, int *n, MPVec3 *direction);
+
+int _MPGJKTriangle(MPVec3 *simplex, int *n, MPVec3 *direction);
+
+int _MPGJKTetrahedron(MPVec3 *simplex, int *n, MPVec3 *direction);
+
+#pragma mark - public functions
+
+MPConvexDecomposition MPConvexDecompositionMake(const MPMesh *mesh, int maxPieces)
+{
+    MPConvexDecomposition decomposition;
+    memset(&decomposition, 0, sizeof(decomposition));
+
+    if (maxPieces < 1 || MPMeshGetTriangleCount(mesh) == 0) return decomposition;
+
+    const MPVec3 *extremes = MPMeshGetExtremePoints(mesh);
+    MPAABox bounds = MPAABoxMake(MPVec3Make(extremes[0].x, extremes[1].y, extremes[2].z), MPVec3Make(extremes[3].x, extremes[4].y, extremes[5].z));
+
+    float longest = fmaxf(fmaxf(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y), bounds.max.z - bounds.min.z);
+    if (!(longest > 0.0f)) return decomposition;
+
+    float voxelSize = longest / MP_CONVEX_RESOLUTION;
+
+    MPBitGrid grid = MPVoxelizeMesh(mesh, MPMat4Identity, bounds, voxelSize, 1);
+
+    MPConvexCluster *clusters = calloc(maxPieces, sizeof(MPConvexCluster));
+    int numClusters = 1;
+
+    size_t numCells = MPBitGridNumCells(&grid);
+    clusters[0].cells = malloc(MPBitGridCount(&grid) * sizeof(int) + sizeof(int));
+
+    size_t n;
+    for (n = 0; n < numCells; ++n)
+    {
+        if (MPBitGridGetIndex(&grid, n))
+        {
+            clusters[0].cells[clusters[0].count++] = (int)n;
+        }
+    }
+
+    _MPConvexClusterComputeHull(&clusters[0], &grid);
+
+    // split the cluster that fills its hull the least until all are nearly convex
+    while (numClusters < maxPieces)
+    {
+        int worst = -1;
+
+        int c;
+        for (c = 0; c < numClusters; ++c)
+        {
+            if (clusters[c].fill < MP_CONVEX_MIN_FILL && clusters[c].count > 1 && (worst < 0 || clusters[c].fill < clusters[worst].fill))
+            {
+                worst = c;
+            }
+        }
+
+        if (worst < 0) break;
+
+        MPConvexCluster left, right;
+
+        if (!_MPConvexClusterSplit(&clusters[worst], &grid, &left, &right))
+        {
+            // leave it whole
+            clusters[worst].fill = 1.0;
+            continue;
+        }
+
+        _MPConvexClusterComputeHull(&left, &grid);
+        _MPConvexClusterComputeHull(&right, &grid);
+
+        free(clusters[worst].cells);
+        free(clusters[worst].hull);
+
+        clusters[worst] = left;
+        clusters[numClusters++] = right;
+    }
+
+    // turn the hulls into pieces in the mesh's coordinates
+    int numVertices = 0;
+
+    int c;
+    for (c = 0; c < numClusters; ++c)
+    {
+        numVertices += clusters[c].hullCount;
+    }
+
+    decomposition.pieces = malloc(numClusters * sizeof(MPConvexPiece));
+    decomposition.vertices = malloc((numVertices > 0 ? numVertices : 1) * sizeof(MPVec3));
+
+    for (c = 0; c < numClusters; ++c)
+    {
+        MPConvexPiece *piece = &decomposition.pieces[decomposition.numPieces++];
+        piece->first = decomposition.numVertices;
+        piece->count = clusters[c].hullCount;
+
+        MPAABox box = MPAABoxMake(MPVec3Make(INFINITY, INFINITY, INFINITY), MPVec3Make(-INFINITY, -INFINITY, -INFINITY));
+
+        int i, a;
+        for (i = 0; i < clusters[c].hullCount; ++i)
+        {
+            MPVec3 v;
+
+            for (a = 0; a < 3; ++a)
+            {
+                v.v[a] = bounds.min.v[a] + clusters[c].hull[i].v[a] * voxelSize;
+
+                box.min.v[a] = fminf(box.min.v[a], v.v[a]);
+                box.max.v[a] = fmaxf(box.max.v[a], v.v[a]);
+            }
+
+            decomposition.vertices[decomposition.numVertices++] = v;
+        }
+
+        MPVec3 center = MPVec3MultiplyScalar(MPVec3Add(box.min, box.max), 0.5f);
+        float radius = 0.0f;
+
+        for (i = piece->first; i < piece->first + piece->count; ++i)
+        {
+            radius = fmaxf(radius, MPVec3EuclideanDistance(center, decomposition.vertices[i]));
+        }
+
+        piece->sphere = MPSphereMake(center, radius);
+
+        free(clusters[c].cells);
+        free(clusters[c].hull);
+    }
+
+    free(clusters);
+    MPBitGridFree(&grid);
+
+    return decomposition;
+}
+
+void MPConvexDecompositionFree(MPConvexDecomposition *decomposition)
+{
+    free(decomposition->pieces);
+    free(decomposition->vertices);
+
+    memset(decomposition, 0, sizeof(MPConvexDecomposition));
+}
+
+int MPConvexHullsIntersect(const MPVec3 *vertices1, int count1, MPMat4 transform1, const MPVec3 *vertices2, int count2, MPMat4 transform2)
+{
+    if (count1 == 0 || count2 == 0) return 0;
+
+    // search the minkowski difference of the hulls for the origin
+    MPVec3 direction = MPVec3Make(transform1.m30 - transform2.m30, transform1.m31 - transform2.m31, transform1.m32 - transform2.m32);
+
+    if (MPVec3DotProduct(direction, direction) == 0.0f)
+    {
+        direction = MPVec3Make(1.0f, 0.0f, 0.0f);
+    }
+
+    MPVec3 simplex[4];
+    int n = 0;
+
+    simplex[n++] = MPVec3Subtract(_MPConvexSupport(vertices1, count1, transform1, direction),
+                                  _MPConvexSupport(vertices2, count2, transform2, MPVec3MultiplyScalar(direction, -1.0f)));
+
+    direction = MPVec3MultiplyScalar(simplex[0], -1.0f);
+
+    int iteration;
+    for (iteration = 0; iteration < MP_GJK_MAX_ITERATIONS; ++iteration)
+    {
+        // the origin is on the boundary of the simplex
+        if (MPVec3DotProduct(direction, direction) == 0.0f) return 1;
+
+        MPVec3 a = MPVec3Subtract(_MPConvexSupport(vertices1, count1, transform1, direction),
+                                  _MPConvexSupport(vertices2, count2, transform2, MPVec3MultiplyScalar(direction, -1.0f)));
+
+        // nothing in the difference gets past the origin along direction, so it is a separating axis
+        if (MPVec3DotProduct(a, direction) < 0.0f) return 0;
+
+        simplex[n++] = a;
+
+        int contains;
+
+        switch (n)
+        {
+            case 2:  contains = _MPGJKLine(simplex, &n, &direction); break;
+            case 3:  contains = _MPGJKTriangle(simplex, &n, &direction); break;
+            default: contains = _MPGJKTetrahedron(simplex, &n, &direction); break;
+        }
+
+        if (contains) return 1;
+    }
+
+    // didn't converge, so err on the side of overlap
+    return 1;
+}
+
+#pragma mark - private functions
+
+void _MPConvexClusterComputeHull(MPConvexCluster *cluster, const MPBitGrid *grid)
+{
+    const int *dims = grid->dims;
+    int lattice[3] = {dims[0] + 1, dims[1] + 1, dims[2] + 1};
+
+    size_t numRows = (size_t)dims[1] * dims[2];
+    size_t numPoints = (size_t)lattice[0] * lattice[1] * lattice[2];
+
+    // the voxels of each row along i lie within the box spanned by the row's ends,
+    // so only the corners at either end of a row can be on the hull
+    int *rowMin = malloc(numRows * sizeof(int));
+    int *rowMax = malloc(numRows * sizeof(int));
+
+    size_t r;
+    for (r = 0; r < numRows; ++r)
+    {
+        rowMin[r] = INT_MAX;
+        rowMax[r] = INT_MIN;
+    }
+
+    int c;
+    for (c = 0; c < cluster->count; ++c)
+    {
+        int i, j, k;
+        MPBitGridCell(grid, cluster->cells[c], &i, &j, &k);
+
+        r = (size_t)j * dims[2] + k;
+
+        if (i < rowMin[r]) rowMin[r] = i;
+        if (i > rowMax[r]) rowMax[r] = i;
+    }
+
+    unsigned char *present = calloc(numPoints, 1);
+
+    int j, k;
+    for (j = 0; j < dims[1]; ++j)
+    {
+        for (k = 0; k < dims[2]; ++k)
+        {
+            r = (size_t)j * dims[2] + k;
+
+            if (rowMin[r] > rowMax[r]) continue;
+
+            int ends[2] = {rowMin[r], rowMax[r] + 1};
+
+            int e, dj, dk;
+            for (e = 0; e < 2; ++e)
+            {
+                for (dj = 0; dj < 2; ++dj)
+                {
+                    for (dk = 0; dk < 2; ++dk)
+                    {
+                        present[((size_t)ends[e] * lattice[1] + (j + dj)) * lattice[2] + (k + dk)] = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    free(rowMin);
+    free(rowMax);
+
+    // a hull vertex can't lie strictly between two other points, so keep only the points that
+    // are at an end of their line of points along every axis
+    unsigned char *extreme = calloc(numPoints, 1);
+
+    int a;
+    for (a = 0; a < 3; ++a)
+    {
+        int b = (a + 1) % 3, d = (a + 2) % 3;
+
+        int p[3];
+        for (p[b] = 0; p[b] < lattice[b]; ++p[b])
+        {
+            for (p[d] = 0; p[d] < lattice[d]; ++p[d])
+            {
+                size_t first = SIZE_MAX, last = SIZE_MAX;
+
+                for (p[a] = 0; p[a] < lattice[a]; ++p[a])
+                {
+                    size_t index = ((size_t)p[0] * lattice[1] + p[1]) * lattice[2] + p[2];
+
+                    if (!present[index]) continue;
+
+                    if (first == SIZE_MAX) first = index;
+                    last = index;
+                }
+
+                if (first == SIZE_MAX) continue;
+
+                extreme[first]++;
+                if (last != first) extreme[last]++;
+            }
+        }
+    }
+
+    int numCandidates = 0;
+
+    size_t index;
+    for (index = 0; index < numPoints; ++index)
+    {
+        if (present[index] && extreme[index] == 3) numCandidates++;
+    }
+
+    MPLatticePoint *candidates = malloc(numCandidates * sizeof(MPLatticePoint) + sizeof(MPLatticePoint));
+    numCandidates = 0;
+
+    for (index = 0; index < numPoints; ++index)
+    {
+        if (!present[index] || extreme[index] != 3) continue;
+
+        MPLatticePoint *point = &candidates[numCandidates++];
+        point->v[2] = (int)(index % lattice[2]);
+        point->v[1] = (int)((index / lattice[2]) % lattice[1]);
+        point->v[0] = (int)(index / ((size_t)lattice[2] * lattice[1]));
+    }
+
+    free(present);
+    free(extreme);
+
+    long long volume6;
+
+    if (_MPLatticeHull(candidates, numCandidates, &cluster->hull, &cluster->hullCount, &volume6) && volume6 > 0)
+    {
+        cluster->fill = (6.0 * cluster->count) / (double)volume6;
+
+        free(candidates);
+    }
+    else
+    {
+        // the candidates still cover the cluster, they just aren't reduced to the hull
+        cluster->hull = candidates;
+        cluster->hullCount = numCandidates;
+        cluster->fill = 1.0;
+    }
+}
+
+// the cut (an axis-aligned plane between voxels) leaving the smallest total bounding box volume
+int _MPConvexClusterSplit(const MPConvexCluster *cluster, const MPBitGrid *grid, MPConvexCluster *left, MPConvexCluster *right)
+{
+    long long bestCost = LLONG_MAX;
+    int bestAxis = -1, bestCut = 0;
+
+    int maxDim = grid->dims[0] > grid->dims[1] ? grid->dims[0] : grid->dims[1];
+    if (grid->dims[2] > maxDim) maxDim = grid->dims[2];
+
+    // per slice: count, and range along the other two axes
+    int *count = malloc(maxDim * sizeof(int));
+    int (*lo)[2] = malloc(maxDim * sizeof(*lo));
+    int (*hi)[2] = malloc(maxDim * sizeof(*hi));
+
+    // extents of everything before each cut
+    int (*prefixLo)[2] = malloc(maxDim * sizeof(*prefixLo));
+    int (*prefixHi)[2] = malloc(maxDim * sizeof(*prefixHi));
+    int *prefixFirst = malloc(maxDim * sizeof(int));
+
+    int a;
+    for (a = 0; a < 3; ++a)
+    {
+        int n = grid->dims[a];
+        int axes[2] = {(a + 1) % 3, (a + 2) % 3};
+
+        int s, x;
+        for (s = 0; s < n; ++s)
+        {
+            count[s] = 0;
+            lo[s][0] = lo[s][1] = INT_MAX;
+            hi[s][0] = hi[s][1] = INT_MIN;
+        }
+
+        int c;
+        for (c = 0; c < cluster->count; ++c)
+        {
+            int ijk[3];
+            MPBitGridCell(grid, cluster->cells[c], &ijk[0], &ijk[1], &ijk[2]);
+
+            s = ijk[a];
+            count[s]++;
+
+            for (x = 0; x < 2; ++x)
+            {
+                if (ijk[axes[x]] < lo[s][x]) lo[s][x] = ijk[axes[x]];
+                if (ijk[axes[x]] > hi[s][x]) hi[s][x] = ijk[axes[x]];
+            }
+        }
+
+        int first = -1;
+        int runLo[2] = {INT_MAX, INT_MAX}, runHi[2] = {INT_MIN, INT_MIN};
+
+        for (s = 0; s < n; ++s)
+        {
+            if (count[s] > 0)
+            {
+                if (first < 0) first = s;
+
+                for (x = 0; x < 2; ++x)
+                {
+                    if (lo[s][x] < runLo[x]) runLo[x] = lo[s][x];
+                    if (hi[s][x] > runHi[x]) runHi[x] = hi[s][x];
+                }
+            }
+
+            prefixFirst[s] = first;
+            prefixLo[s][0] = runLo[0]; prefixLo[s][1] = runLo[1];
+            prefixHi[s][0] = runHi[0]; prefixHi[s][1] = runHi[1];
+        }
+
+        // walk back from the end, cutting before slice s
+        int last = -1;
+        runLo[0] = runLo[1] = INT_MAX;
+        runHi[0] = runHi[1] = INT_MIN;
+
+        for (s = n - 1; s > 0; --s)
+        {
+            if (count[s] > 0)
+            {
+                if (last < 0) last = s;
+
+                for (x = 0; x < 2; ++x)
+                {
+                    if (lo[s][x] < runLo[x]) runLo[x] = lo[s][x];
+                    if (hi[s][x] > runHi[x]) runHi[x] = hi[s][x];
+                }
+            }
+
+            // both sides need voxels
+            if (last < 0 || prefixFirst[s - 1] < 0) continue;
+
+            int leftLast = s - 1;
+            while (count[leftLast] == 0) --leftLast;
+
+            int rightFirst = s;
+            while (count[rightFirst] == 0) ++rightFirst;
+
+            long long leftVolume = (long long)(leftLast - prefixFirst[s - 1] + 1) *
+                                   (prefixHi[s - 1][0] - prefixLo[s - 1][0] + 1) * (prefixHi[s - 1][1] - prefixLo[s - 1][1] + 1);
+
+            long long rightVolume = (long long)(last - rightFirst + 1) *
+                                    (runHi[0] - runLo[0] + 1) * (runHi[1] - runLo[1] + 1);
+
+            if (leftVolume + rightVolume < bestCost)
+            {
+                bestCost = leftVolume + rightVolume;
+                bestAxis = a;
+                bestCut = s;
+            }
+        }
+    }
+
+    free(count);
+    free(lo);
+    free(hi);
+    free(prefixLo);
+    free(prefixHi);
+    free(prefixFirst);
+
+    if (bestAxis < 0) return 0;
+
+    memset(left, 0, sizeof(MPConvexCluster));
+    memset(right, 0, sizeof(MPConvexCluster));
+
+    left->cells = malloc(cluster->count * sizeof(int));
+    right->cells = malloc(cluster->count * sizeof(int));
+
+    int c;
+    for (c = 0; c < cluster->count; ++c)
+    {
+        int ijk[3];
+        MPBitGridCell(grid, cluster->cells[c], &ijk[0], &ijk[1], &ijk[2]);
+
+        if (ijk[bestAxis] < bestCut)
+        {
+            left->cells[left->count++] = cluster->cells[c];
+        }
+        else
+        {
+            right->cells[right->count++] = cluster->cells[c];
+        }
+    }
+
+    return 1;
+}
+
+long long _MPLatticeOrient(MPLatticePoint a, MPLatticePoint b, MPLatticePoint c, MPLatticePoint d)
+{
+    long long bx = b.v[0] - a.v[0], by = b.v[1] - a.v[1], bz = b.v[2] - a.v[2];
+    long long cx = c.v[0] - a.v[0], cy = c.v[1] - a.v[1], cz = c.v[2] - a.v[2];
+    long long dx = d.v[0] - a.v[0], dy = d.v[1] - a.v[1], dz = d.v[2] - a.v[2];
+
+    return bx * (cy * dz - cz * dy) - by * (cx * dz - cz * dx) + bz * (cx * dy - cy * dx);
+}
+
+// incremental convex hull. returns 0 if the points are all coplanar.
+int _MPLatticeHull(const MPLatticePoint *points, int n, MPLatticePoint **hull, int *hullCount, long long *volume6)
+{
+    // find a starting tetrahedron
+    int tet[4] = {0, -1, -1, -1};
+
+    int i;
+    for (i = 1; i < n && tet[1] < 0; ++i)
+    {
+        if (memcmp(&points[i], &points[0], sizeof(MPLatticePoint)) != 0) tet[1] = i;
+    }
+
+    for (i = 1; i < n && tet[1] >= 0 && tet[2] < 0; ++i)
+    {
+        long long ux = points[tet[1]].v[0] - points[0].v[0], uy = points[tet[1]].v[1] - points[0].v[1], uz = points[tet[1]].v[2] - points[0].v[2];
+        long long vx = points[i].v[0] - points[0].v[0], vy = points[i].v[1] - points[0].v[1], vz = points[i].v[2] - points[0].v[2];
+
+        if (uy * vz - uz * vy != 0 || uz * vx - ux * vz != 0 || ux * vy - uy * vx != 0) tet[2] = i;
+    }
+
+    for (i = 1; i < n && tet[2] >= 0 && tet[3] < 0; ++i)
+    {
+        if (_MPLatticeOrient(points[tet[0]], points[tet[1]], points[tet[2]], points[i]) != 0) tet[3] = i;
+    }
+
+    if (tet[3] < 0) return 0;
+
+    int faceCapacity = 64;
+    int numFaces = 0;
+    MPHullFace *faces = malloc(faceCapacity * sizeof(MPHullFace));
+
+    const int tetFaces[4][4] = {{0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 3, 1}, {1, 2, 3, 0}};  // face, then opposite vertex
+
+    int f;
+    for (f = 0; f < 4; ++f)
+    {
+        MPHullFace face = {{tet[tetFaces[f][0]], tet[tetFaces[f][1]], tet[tetFaces[f][2]]}};
+
+        // the opposite vertex must be behind the face
+        if (_MPLatticeOrient(points[face.v[0]], points[face.v[1]], points[face.v[2]], points[tet[tetFaces[f][3]]]) > 0)
+        {
+            int swap = face.v[1]; face.v[1] = face.v[2]; face.v[2] = swap;
+        }
+
+        faces[numFaces++] = face;
+    }
+
+    int visibleCapacity = 64, horizonCapacity = 64;
+    int *visible = malloc(visibleCapacity * sizeof(int));
+    int (*horizon)[2] = malloc(horizonCapacity * sizeof(*horizon));
+
+    int p;
+    for (p = 0; p < n; ++p)
+    {
+        if (p == tet[0] || p == tet[1] || p == tet[2] || p == tet[3]) continue;
+
+        int numVisible = 0;
+
+        for (f = 0; f < numFaces; ++f)
+        {
+            if (_MPLatticeOrient(points[faces[f].v[0]], points[faces[f].v[1]], points[faces[f].v[2]], points[p]) > 0)
+            {
+                if (numVisible >= visibleCapacity)
+                {
+                    // double buffer if necessary
+                    visible = realloc(visible, 2 * visibleCapacity * sizeof(int));
+                    visibleCapacity *= 2;
+                }
+
+                visible[numVisible++] = f;
+            }
+        }
+
+        // inside (or on) the hull
+        if (numVisible == 0) continue;
+
+        // the horizon is the edges of visible faces that aren't shared with another visible face
+        int numHorizon = 0;
+
+        int v, e;
+        for (v = 0; v < numVisible; ++v)
+        {
+            const MPHullFace *face = &faces[visible[v]];
+
+            for (e = 0; e < 3; ++e)
+            {
+                int from = face->v[e], to = face->v[(e + 1) % 3];
+                int shared = 0;
+
+                int w, g;
+                for (w = 0; w < numVisible && !shared; ++w)
+                {
+                    const MPHullFace *other = &faces[visible[w]];
+
+                    for (g = 0; g < 3 && !shared; ++g)
+                    {
+                        shared = (other->v[g] == to && other->v[(g + 1) % 3] == from);
+                    }
+                }
+
+                if (shared) continue;
+
+                if (numHorizon >= horizonCapacity)
+                {
+                    horizon = realloc(horizon, 2 * horizonCapacity * sizeof(*horizon));
+                    horizonCapacity *= 2;
+                }
+
+                horizon[numHorizon][0] = from;
+                horizon[numHorizon][1] = to;
+                numHorizon++;
+            }
+        }
+
+        // replace the visible faces with a fan from the horizon to p
+        for (v = 0; v < numVisible; ++v)
+        {
+            faces[visible[v]].v[0] = -1;
+        }
+
+        int kept = 0;
+        for (f = 0; f < numFaces; ++f)
+        {
+            if (faces[f].v[0] >= 0) faces[kept++] = faces[f];
+        }
+
+        numFaces = kept;
+
+        if (numFaces + numHorizon > faceCapacity)
+        {
+            while (numFaces + numHorizon > faceCapacity) faceCapacity *= 2;
+
+            faces = realloc(faces, faceCapacity * sizeof(MPHullFace));
+        }
+
+        for (e = 0; e < numHorizon; ++e)
+        {
+            MPHullFace face = {{horizon[e][0], horizon[e][1], p}};
+            faces[numFaces++] = face;
+        }
+    }
+
+    free(visible);
+    free(horizon);
+
+    // collect the points used by the faces, and the volume of the hull
+    unsigned char *used = calloc(n, 1);
+
+    *volume6 = 0;
+    *hullCount = 0;
+
+    MPLatticePoint origin = {{0, 0, 0}};
+
+    for (f = 0; f < numFaces; ++f)
+    {
+        *volume6 += _MPLatticeOrient(origin, points[faces[f].v[0]], points[faces[f].v[1]], points[faces[f].v[2]]);
+
+        int v;
+        for (v = 0; v < 3; ++v)
+        {
+            if (!used[faces[f].v[v]])
+            {
+                used[faces[f].v[v]] = 1;
+                (*hullCount)++;
+            }
+        }
+    }
+
+    *hull = malloc(*hullCount * sizeof(MPLatticePoint));
+    *hullCount = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (used[i]) (*hull)[(*hullCount)++] = points[i];
+    }
+
+    free(used);
+    free(faces);
+
+    return 1;
+}
+
+MPVec3 _MPConvexSupport(const MPVec3 *vertices, int count, MPMat4 transform, MPVec3 direction)
+{
+    // the vertex farthest along direction after the transform is the one farthest along the
+    // direction moved by the transpose of the transform
+    MPVec3 local = MPVec3Make(transform.m00 * direction.x + transform.m01 * direction.y + transform.m02 * direction.z,
+                              transform.m10 * direction.x + transform.m11 * direction.y + transform.m12 * direction.z,
+                              transform.m20 * direction.x + transform.m21 * direction.y + transform.m22 * direction.z);
+
+    int best = 0;
+    float bestDistance = MPVec3DotProduct(local, vertices[0]);
+
+    int i;
+    for (i = 1; i < count; ++i)
+    {
+        float distance = MPVec3DotProduct(local, vertices[i]);
+
+        if (distance > bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+
+    return MPMat4TransformVec3(transform, vertices[best]);
+}
+
+// simplices are stored oldest point first. each case keeps the feature nearest the origin and
+// points direction from it toward the origin. (see Muratori, Implementing GJK)
+
+int _MPGJKLine(MPVec3 *simplex, int *n, MPVec3 *direction)
+{
+    MPVec3 a = simplex[1], b = simplex[0];
+    MPVec3 ab = MPVec3Subtract(b, a), ao = MPVec3MultiplyScalar(a, -1.0f);
+
+    if (MPVec3DotProduct(ab, ao) > 0.0f)
+    {
+        *direction = MPVec3CrossProduct(MPVec3CrossProduct(ab, ao), ab);
+        *n = 2;
+    }
+    else
+    {
+        simplex[0] = a;
+        *direction = ao;
+        *n = 1;
+    }
+
+    return 0;
+}
+
+int _MPGJKTriangle(MPVec3 *simplex, int *n, MPVec3 *direction)
+{
+    MPVec3 a = simplex[2], b = simplex[1], c = simplex[0];
+    MPVec3 ab = MPVec3Subtract(b, a), ac = MPVec3Subtract(c, a), ao = MPVec3MultiplyScalar(a, -1.0f);
+    MPVec3 abc = MPVec3CrossProduct(ab, ac);
+
+    if (MPVec3DotProduct(MPVec3CrossProduct(abc, ac), ao) > 0.0f)
+    {
+        if (MPVec3DotProduct(ac, ao) > 0.0f)
+        {
+            simplex[0] = c; simplex[1] = a;
+            *direction = MPVec3CrossProduct(MPVec3CrossProduct(ac, ao), ac);
+            *n = 2;
+
+            return 0;
+        }
+
+        simplex[0] = b; simplex[1] = a;
+
+        return _MPGJKLine(simplex, n, direction);
+    }
+
+    if (MPVec3DotProduct(MPVec3CrossProduct(ab, abc), ao) > 0.0f)
+    {
+        simplex[0] = b; simplex[1] = a;
+
+        return _MPGJKLine(simplex, n, direction);
+    }
+
+    float side = MPVec3DotProduct(abc, ao);
+
+    // the origin is in the triangle
+    if (side == 0.0f) return 1;
+
+    if (side > 0.0f)
+    {
+        *direction = abc;
+    }
+    else
+    {
+        // wind the triangle so that the origin is in front of it
+        simplex[0] = b; simplex[1] = c;
+        *direction = MPVec3MultiplyScalar(abc, -1.0f);
+    }
+
+    *n = 3;
+
+    return 0;
+}
+
+int _MPGJKTetrahedron(MPVec3 *simplex, int *n, MPVec3 *direction)
+{
+    MPVec3 a = simplex[3], b = simplex[2], c = simplex[1], d = simplex[0];
+    MPVec3 ab = MPVec3Subtract(b, a), ac = MPVec3Subtract(c, a), ad = MPVec3Subtract(d, a), ao = MPVec3MultiplyScalar(a, -1.0f);
+
+    // a was found in front of the triangle bcd, so these face normals point outward
+    if (MPVec3DotProduct(MPVec3CrossProduct(ab, ac), ao) > 0.0f)
+    {
+        simplex[0] = c; simplex[1] = b; simplex[2] = a;
+        *n = 3;
+
+        return _MPGJKTriangle(simplex, n, direction);
+    }
+
+    if (MPVec3DotProduct(MPVec3CrossProduct(ac, ad), ao) > 0.0f)
+    {
+        simplex[0] = d; simplex[1] = c; simplex[2] = a;
+        *n = 3;
+
+        return _MPGJKTriangle(simplex, n, direction);
+    }
+
+    if (MPVec3DotProduct(MPVec3CrossProduct(ad, ab), ao) > 0.0f)
+    {
+        simplex[0] = b; simplex[1] = d; simplex[2] = a;
+        *n = 3;
+
+        return _MPGJKTriangle(simplex, n, direction);
+    }
+
+    return 1;
+}
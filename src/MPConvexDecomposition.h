@@ -0,0 +1,32 @@
+//
+//  MPConvexDecomposition.h
+//
+//  Approximate convex decomposition of a mesh. The solid voxelization of the mesh is split
+//  along axis-aligned planes until each cluster of voxels fills most of its convex hull, and
+//  the hulls of the clusters become the pieces. Since the voxels cover the mesh, so do the
+//  pieces, which makes them safe for rejecting collisions.
+
+#ifndef _MPConvexDecomposition_h
+#define _MPConvexDecomposition_h
+
+#include "MPMesh.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* decomposes the mesh into at most maxPieces convex pieces.
+    @note the decomposition must be freed with MPConvexDecompositionFree. */
+MPConvexDecomposition MPConvexDecompositionMake(const MPMesh *mesh, int maxPieces);
+
+void MPConvexDecompositionFree(MPConvexDecomposition *decomposition);
+
+/* returns 1 if the convex hulls of the two vertex sets, under the given transforms, may
+   intersect (GJK). when the test can't decide, e.g. the hulls only touch, it returns 1. */
+int MPConvexHullsIntersect(const MPVec3 *vertices1, int count1, MPMat4 transform1, const MPVec3 *vertices2, int count2, MPMat4 transform2);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,302 @@
+//
+//  MPDistanceField.cpp
+//
+
+#include "MPDistanceField.h"
+#include <algorithm>
+#include <thread>
+
+namespace MP
+{
+
+namespace
+{
+    // world space triangles and bounds of a single model
+    struct FieldSource
+    {
+        std::vector<MPTriangle> triangles;
+        MPAABox box;
+        MPSphere sphere;
+    };
+
+    float signedDistance(const std::vector<FieldSource> &sources, const MPVec3 &p)
+    {
+        float best = Inf;
+        bool inside = false;
+
+        for(const FieldSource &source : sources)
+        {
+            // no triangle of this source can be closer than its bounding sphere
+            if(MPVec3EuclideanDistance(p, source.sphere.center) - source.sphere.radius < best)
+            {
+                for(const MPTriangle &t : source.triangles)
+                {
+                    best = fminf(best, MPVec3EuclideanDistance(p, MPTriangleClosestPoint(t, p)));
+                }
+            }
+
+            if(!inside && MPAABoxContainsPoint(source.box, p))
+            {
+                // winding number of the (closed) triangulation around p
+                float solidAngle = 0.0f;
+
+                for(const MPTriangle &t : source.triangles)
+                {
+                    solidAngle += MPTriangleSolidAngle(t, p);
+                }
+
+                inside = fabsf(solidAngle) > 2.0f * M_PI;
+            }
+        }
+
+        return inside ? -best : best;
+    }
+}
+
+DistanceField::DistanceField()
+: bounds_(MPAABoxMake(MPVec3Zero, MPVec3Zero)), resolution_(0.0f)
+{
+    dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+void DistanceField::build(const std::vector<Model *> &models, const MPAABox &bounds, float resolution)
+{
+    clear();
+
+    if(resolution <= 0.0f) return;
+
+    std::vector<FieldSource> sources;
+
+    for(auto model : models)
+    {
+        MPMesh *mesh = model->getMesh();
+        if(mesh == nullptr) continue;
+
+        MPMat4 matrix = model->getModelMatrix();
+
+        FieldSource source;
+        source.box = MPAABoxMake(MPVec3Make(Inf, Inf, Inf), MPVec3Make(-Inf, -Inf, -Inf));
+
+        size_t numTriangles = MPMeshGetTriangleCount(mesh);
+        source.triangles.resize(numTriangles);
+
+        MPMeshGetTransformedTriangles(mesh, matrix, source.triangles.data());
+
+        for(size_t i = 0; i < numTriangles; ++i)
+        {
+            const MPTriangle &t = source.triangles[i];
+
+            for(int v = 0; v < 3; ++v)
+            {
+                for(int a = 0; a < 3; ++a)
+                {
+                    source.box.min.v[a] = fminf(source.box.min.v[a], t.p[v].v[a]);
+                    source.box.max.v[a] = fmaxf(source.box.max.v[a], t.p[v].v[a]);
+                }
+            }
+        }
+
+        MPVec3 center = MPVec3MultiplyScalar(MPVec3Add(source.box.min, source.box.max), 0.5f);
+        source.sphere = MPSphereMake(center, MPVec3EuclideanDistance(center, source.box.max));
+
+        sources.push_back(source);
+    }
+
+    bounds_ = bounds;
+    resolution_ = resolution;
+
+    for(int a = 0; a < 3; ++a)
+    {
+        dims_[a] = std::max(2, (int)std::ceil((bounds.max.v[a] - bounds.min.v[a]) / resolution) + 1);
+        bounds_.max.v[a] = bounds.min.v[a] + (dims_[a] - 1) * resolution;
+    }
+
+    samples_.resize((size_t)dims_[0] * dims_[1] * dims_[2]);
+
+    // each thread samples a set of whole i-slabs
+    auto fill = [&](int firstSlab, int lastSlab)
+    {
+        for(int i = firstSlab; i < lastSlab; ++i)
+        {
+            for(int j = 0; j < dims_[1]; ++j)
+            {
+                for(int k = 0; k < dims_[2]; ++k)
+                {
+                    MPVec3 p = MPVec3Make(bounds_.min.x + i * resolution,
+                                          bounds_.min.y + j * resolution,
+                                          bounds_.min.z + k * resolution);
+
+                    samples_[(i * dims_[1] + j) * dims_[2] + k] = signedDistance(sources, p);
+                }
+            }
+        }
+    };
+
+    int numThreads = std::min(dims_[0], std::max(1, (int)std::thread::hardware_concurrency()));
+    int slabsPerThread = (dims_[0] + numThreads - 1) / numThreads;
+
+    std::vector<std::thread> workers;
+
+    for(int t = 1; t < numThreads; ++t)
+    {
+        int first = t * slabsPerThread;
+        int last = std::min(dims_[0], first + slabsPerThread);
+
+        if(first < last)
+            workers.push_back(std::thread(fill, first, last));
+    }
+
+    fill(0, std::min(dims_[0], slabsPerThread));
+
+    for(auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void DistanceField::assign(const MPAABox &bounds, float resolution, const int dims[3], const float *samples)
+{
+    bounds_ = bounds;
+    resolution_ = resolution;
+
+    dims_[0] = dims[0];
+    dims_[1] = dims[1];
+    dims_[2] = dims[2];
+
+    samples_.assign(samples, samples + (size_t)dims_[0] * dims_[1] * dims_[2]);
+}
+
+void DistanceField::clear()
+{
+    samples_.clear();
+    dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+float DistanceField::distance(const MPVec3 &p) const
+{
+    MPVec3 q = MPAABoxClosestPoint(bounds_, p);
+
+    int c[3];
+    float t[3];
+    locate(q, c, t);
+
+    float d00 = sample(c[0], c[1], c[2]) * (1.0f - t[2]) + sample(c[0], c[1], c[2] + 1) * t[2];
+    float d01 = sample(c[0], c[1] + 1, c[2]) * (1.0f - t[2]) + sample(c[0], c[1] + 1, c[2] + 1) * t[2];
+    float d10 = sample(c[0] + 1, c[1], c[2]) * (1.0f - t[2]) + sample(c[0] + 1, c[1], c[2] + 1) * t[2];
+    float d11 = sample(c[0] + 1, c[1] + 1, c[2]) * (1.0f - t[2]) + sample(c[0] + 1, c[1] + 1, c[2] + 1) * t[2];
+
+    float d0 = d00 * (1.0f - t[1]) + d01 * t[1];
+    float d1 = d10 * (1.0f - t[1]) + d11 * t[1];
+
+    return d0 * (1.0f - t[0]) + d1 * t[0] + MPVec3EuclideanDistance(p, q);
+}
+
+MPVec3 DistanceField::gradient(const MPVec3 &p) const
+{
+    int c[3];
+    float t[3];
+    locate(MPAABoxClosestPoint(bounds_, p), c, t);
+
+    float s[2][2][2];
+    for(int a = 0; a < 2; ++a)
+        for(int b = 0; b < 2; ++b)
+            for(int d = 0; d < 2; ++d)
+                s[a][b][d] = sample(c[0] + a, c[1] + b, c[2] + d);
+
+    // partial derivatives of the trilinear interpolant
+    MPVec3 grad = MPVec3Zero;
+
+    for(int b = 0; b < 2; ++b)
+    {
+        for(int d = 0; d < 2; ++d)
+        {
+            float wb = b ? t[1] : 1.0f - t[1];
+            float wd = d ? t[2] : 1.0f - t[2];
+            grad.x += (s[1][b][d] - s[0][b][d]) * wb * wd;
+        }
+    }
+
+    for(int a = 0; a < 2; ++a)
+    {
+        for(int d = 0; d < 2; ++d)
+        {
+            float wa = a ? t[0] : 1.0f - t[0];
+            float wd = d ? t[2] : 1.0f - t[2];
+            grad.y += (s[a][1][d] - s[a][0][d]) * wa * wd;
+        }
+    }
+
+    for(int a = 0; a < 2; ++a)
+    {
+        for(int b = 0; b < 2; ++b)
+        {
+            float wa = a ? t[0] : 1.0f - t[0];
+            float wb = b ? t[1] : 1.0f - t[1];
+            grad.z += (s[a][b][1] - s[a][b][0]) * wa * wb;
+        }
+    }
+
+    return MPVec3MultiplyScalar(grad, 1.0f / resolution_);
+}
+
+float DistanceField::distanceLowerBound(const MPVec3 &p) const
+{
+    MPVec3 q = MPAABoxClosestPoint(bounds_, p);
+
+    int c[3];
+    float t[3];
+    locate(q, c, t);
+
+    // each sample s_i satisfies d(q) >= s_i - |q - c_i|, so the interpolant over-estimates d(q)
+    // by at most the weighted distance to the cell corners, which is bounded by h * sqrt(sum t(1 - t))
+    float slack = resolution_ * sqrtf(t[0] * (1.0f - t[0]) + t[1] * (1.0f - t[1]) + t[2] * (1.0f - t[2]));
+
+    // the distance function is 1-Lipschitz, so moving from q to p can't decrease it by more than |p - q|
+    return this->distance(q) - slack - MPVec3EuclideanDistance(p, q);
+}
+
+bool DistanceField::spheresClear(const std::vector<MPSphere> &spheres, const MPMat4 &transform, float radiusScale) const
+{
+    if(!isBuilt()) return false;
+
+    for(const MPSphere &sphere : spheres)
+    {
+        MPVec3 center = MPMat4TransformVec3(transform, sphere.center);
+
+        if(distanceLowerBound(center) <= sphere.radius * radiusScale)
+            return false;
+    }
+
+    return true;
+}
+
+float DistanceField::spheresClearance(const std::vector<MPSphere> &spheres, const MPMat4 &transform, float radiusScale) const
+{
+    if(!isBuilt()) return -Inf;
+    
+    float clearance = Inf;
+    
+    for(const MPSphere &sphere : spheres)
+    {
+        MPVec3 center = MPMat4TransformVec3(transform, sphere.center);
+        
+        clearance = std::min(clearance, distanceLowerBound(center) - sphere.radius * radiusScale);
+    }
+    
+    return clearance;
+}
+
+#pragma mark - private methods
+
+void DistanceField::locate(const MPVec3 &p, int cell[3], float t[3]) const
+{
+    for(int a = 0; a < 3; ++a)
+    {
+        float u = (p.v[a] - bounds_.min.v[a]) / resolution_;
+
+        cell[a] = std::min(std::max((int)std::floor(u), 0), dims_[a] - 2);
+        t[a] = std::min(std::max(u - cell[a], 0.0f), 1.0f);
+    }
+}
+
+}
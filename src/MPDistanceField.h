@@ -0,0 +1,75 @@
+//
+//  MPDistanceField.h
+//
+//  A signed distance field of a set of models, sampled on a regular grid (negative inside).
+//  Since the true signed distance is 1-Lipschitz, the sampled field gives conservative lower
+//  bounds on the distance anywhere in space, which is enough to prove a pose collision-free.
+
+#ifndef __MPDistanceField__
+#define __MPDistanceField__
+
+#include <vector>
+#include "MPModel.h"
+
+namespace MP
+{
+
+class DistanceField
+{
+public:
+    DistanceField();
+
+    /* samples the signed distance to the given models over bounds, with the given spacing between samples */
+    void build(const std::vector<Model *> &models, const MPAABox &bounds, float resolution);
+
+    void clear();
+
+    bool isBuilt() const { return !samples_.empty(); }
+
+    float getResolution() const { return resolution_; }
+
+    MPAABox getBounds() const { return bounds_; }
+
+    /* the number of samples along each axis */
+    void getDimensions(int dims[3]) const { dims[0] = dims_[0]; dims[1] = dims_[1]; dims[2] = dims_[2]; }
+
+    /* the samples, with sample (i, j, k) at (i * dims[1] + j) * dims[2] + k */
+    const std::vector<float>& getSamples() const { return samples_; }
+
+    /* uses samples taken earlier (e.g. loaded from a file) rather than building the field. every
+     * dimension must be at least 2. */
+    void assign(const MPAABox &bounds, float resolution, const int dims[3], const float *samples);
+
+    /* trilinearly interpolated signed distance at p. points outside the field are clamped to it,
+     * and the distance to the field is added on. */
+    float distance(const MPVec3 &p) const;
+
+    /* gradient of the interpolated distance at p */
+    MPVec3 gradient(const MPVec3 &p) const;
+
+    /* a lower bound on the true signed distance at p */
+    float distanceLowerBound(const MPVec3 &p) const;
+
+    /* returns true if every sphere, after being transformed, is guaranteed to lie outside the
+     * models. radiusScale should be the largest scale factor of the transform. */
+    bool spheresClear(const std::vector<MPSphere> &spheres, const MPMat4 &transform, float radiusScale) const;
+    
+    /* a lower bound on the distance between the transformed spheres and the models (negative if they may overlap) */
+    float spheresClearance(const std::vector<MPSphere> &spheres, const MPMat4 &transform, float radiusScale) const;
+
+private:
+    float sample(int i, int j, int k) const { return samples_[(i * dims_[1] + j) * dims_[2] + k]; }
+
+    /* finds the cell containing p and the offsets in [0, 1] of p within the cell */
+    void locate(const MPVec3 &p, int cell[3], float t[3]) const;
+
+    MPAABox bounds_;
+    float resolution_;
+
+    int dims_[3];
+    std::vector<float> samples_;
+};
+
+}
+
+#endif
@@ -9,6 +9,10 @@
 #include "MPTimer.h"
 #include "MPUtils.h"
 
+// the smallest step along an edge, as a fraction of the edge tolerance. advancing by the clearance
+// alone would take ever smaller steps past a nearby obstacle.
+#define MP_MIN_EDGE_CLEARANCE 0.01f
+
 namespace MP
 {
 
@@ -75,18 +79,30 @@ int transform3DHash(const Transform3D &t)
 }
 
 Environment3D::Environment3D()
-: Environment<Transform3D>(transform3DHash), origin_(MPVec3Zero), size_(MPVec3Make(1.0f, 1.0f, 1.0f)), activeObject_(nullptr), dynamic_(false)
+: Environment<Transform3D>(transform3DHash), origin_(MPVec3Zero), size_(MPVec3Make(1.0f, 1.0f, 1.0f)), activeObject_(nullptr), dynamic_(false), stepSize_(1.0), rotationStepSize_(2.0 * M_PI), numRotations_(1),
+  useOccupancySlices_(true), occupancySlicesValid_(false), distanceFieldResolution_(0.0), distanceFieldValid_(false), sphereMesh_(nullptr),
+  checkEdges_(false), edgeTolerance_(0.0)
 {
+    this->updateBoundingBox();
+    this->updateOrientationTable();
 }
 
 Environment3D::Environment3D(const MPVec3 &size)
-: Environment<Transform3D>(transform3DHash), origin_(MPVec3Zero), size_(size), activeObject_(nullptr), dynamic_(false)
+: Environment<Transform3D>(transform3DHash), origin_(MPVec3Zero), size_(size), activeObject_(nullptr), dynamic_(false), stepSize_(1.0), rotationStepSize_(2.0 * M_PI), numRotations_(1),
+  useOccupancySlices_(true), occupancySlicesValid_(false), distanceFieldResolution_(0.0), distanceFieldValid_(false), sphereMesh_(nullptr),
+  checkEdges_(false), edgeTolerance_(0.0)
 {
+    this->updateBoundingBox();
+    this->updateOrientationTable();
 }
 
 Environment3D::Environment3D(const MPVec3 &origin, const MPVec3 &size)
-: Environment<Transform3D>(transform3DHash), origin_(origin), size_(size), activeObject_(nullptr), dynamic_(false)
+: Environment<Transform3D>(transform3DHash), origin_(origin), size_(size), activeObject_(nullptr), dynamic_(false), stepSize_(1.0), rotationStepSize_(2.0 * M_PI), numRotations_(1),
+  useOccupancySlices_(true), occupancySlicesValid_(false), distanceFieldResolution_(0.0), distanceFieldValid_(false), sphereMesh_(nullptr),
+  checkEdges_(false), edgeTolerance_(0.0)
 {
+    this->updateBoundingBox();
+    this->updateOrientationTable();
 }
 
 Environment3D::~Environment3D()
@@ -105,10 +121,18 @@ void Environment3D::setSize(const MPVec3 &size)
     this->updateBoundingBox();
 }
     
+void Environment3D::setStepSize(double s)
+{
+    this->stepSize_ = s;
+    this->invalidateOccupancySlices();
+}
+    
 void Environment3D::setRotationStepSize(double s)
 {
     this->rotationStepSize_ = s;
     this->numRotations_ = 2.0f * M_PI / s;
+    this->updateOrientationTable();
+    this->invalidateOccupancySlices();
 }
     
 void Environment3D::setActiveObject(MP::Model *activeObject)
@@ -116,6 +140,83 @@ void Environment3D::setActiveObject(MP::Model *activeObject)
     activeObject_ = activeObject;
 
     actionSet_.clear();
+    
+    if(activeObject_ != nullptr)
+    {
+        orientations_.setMesh(activeObject_->getMesh(), activeObject_->getScale());
+    }
+    
+    this->invalidateOccupancySlices();
+    this->invalidateDistanceField();
+}
+    
+void Environment3D::addObstacle(Model *obstacle)
+{
+    obstacles_.push_back(obstacle);
+    
+    this->invalidateOccupancySlices();
+    this->invalidateDistanceField();
+}
+
+void Environment3D::setDistanceFieldResolution(double resolution)
+{
+    distanceFieldResolution_ = resolution;
+    
+    this->invalidateDistanceField();
+}
+    
+void Environment3D::updateDistanceField()
+{
+    if(distanceFieldValid_ || distanceFieldResolution_ <= 0.0 || dynamic_) return;
+    
+    // pad the field so that spheres of an object touching the bounds are still inside it
+    MPVec3 pad = MPVec3Make(2.0f * distanceFieldResolution_, 2.0f * distanceFieldResolution_, 2.0f * distanceFieldResolution_);
+    MPAABox bounds = MPAABoxMake(MPVec3Subtract(boundingBox_.min, pad), MPVec3Add(boundingBox_.max, pad));
+    
+    distanceField_.build(obstacles_, bounds, distanceFieldResolution_);
+    
+    activeSpheres_.clear();
+    sphereMesh_ = nullptr;
+    
+    if(activeObject_ != nullptr && activeObject_->getMesh() != nullptr)
+    {
+        // spheres are in mesh coordinates, so size them for the object's current scale. spheres a
+        // little larger than the field spacing are a good balance between count and tightness
+        MPVec3 scale = activeObject_->getScale();
+        float maxScale = fmaxf(fmaxf(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+        
+        int n;
+        MPSphere *spheres = MPMeshGetSurfaceSpheres(activeObject_->getMesh(), 2.0 * distanceFieldResolution_ / maxScale, &n);
+        
+        activeSpheres_.assign(spheres, spheres + n);
+        sphereMesh_ = activeObject_->getMesh();
+        
+        // enclose the sphere set in one sphere about the mesh's center
+        MPVec3 center = MPMeshGetBoundingSphere(sphereMesh_, NULL).center;
+        float radius = 0.0f;
+        
+        for(int i = 0; i < n; ++i)
+        {
+            radius = fmaxf(radius, MPVec3EuclideanDistance(center, spheres[i].center) + spheres[i].radius);
+        }
+        
+        activeBound_ = MPSphereMake(center, radius);
+        
+        free(spheres);
+    }
+    
+    distanceFieldValid_ = true;
+}
+
+void Environment3D::setDistanceField(DistanceField field, std::vector<MPSphere> activeSpheres, const MPSphere &activeBound)
+{
+    distanceField_ = std::move(field);
+    
+    activeSpheres_ = std::move(activeSpheres);
+    activeBound_ = activeBound;
+    sphereMesh_ = (activeObject_ != nullptr) ? activeObject_->getMesh() : nullptr;
+    
+    distanceFieldValid_ = true;
 }
 
 void Environment3D::getSuccessors(SearchState3D *s,
@@ -139,6 +240,9 @@ void Environment3D::getSuccessors(SearchState3D *s,
         Transform3D T = sT;
         applyAction(action, T);
         
+        if(checkEdges_ && !this->edgeValid(sT, T))
+            continue;
+        
         SearchState3D *neighbor = states_.get(T);
         if(neighbor == nullptr)
         {
@@ -174,11 +278,42 @@ bool Environment3D::getCost(SearchState3D *s, SearchState3D *t, double &cost)
 
 bool Environment3D::stateValid(const Transform3D &T)
 {
+    this->updateDistanceField();
+    
+    if(useOccupancySlices_ && !dynamic_ && activeObject_ != nullptr)
+    {
+        if(!occupancySlicesValid_)
+        {
+            int min[3], max[3];
+            
+            for(int a = 0; a < 3; ++a)
+            {
+                min[a] = (int)std::ceil(boundingBox_.min.v[a] / stepSize_);
+                max[a] = (int)std::floor(boundingBox_.max.v[a] / stepSize_);
+            }
+            
+            occupancySlices_.setGrid(min, max, numRotations_);
+            
+            occupancySlicesValid_ = true;
+        }
+        
+        int occupied = occupancySlices_.lookup(T, [this](const Transform3D &state)
+        {
+            if(!this->orientationInBounds(state)) return true;
+            
+            Transform3D worldT = this->plannerToWorld(state);
+            return !this->isValid(worldT);
+        });
+        
+        // states outside of the slice grid fall through to the exact check
+        if(occupied >= 0) return !occupied;
+    }
+    
     if(!Environment<Transform3D>::stateValid(T)) return false;
     
     Transform3D worldT = this->plannerToWorld(T);
     
-    if(!this->isValid(worldT))
+    if(!this->orientationInBounds(T) || !this->isValid(worldT))
     {
         SearchState3D *s = new SearchState3D();
         s->setValue(T);
@@ -189,6 +324,18 @@ bool Environment3D::stateValid(const Transform3D &T)
     return true;
 }
 
+double Environment3D::getEdgeTolerance() const
+{
+    return edgeTolerance_ > 0.0 ? edgeTolerance_ : 0.25 * stepSize_;
+}
+    
+bool Environment3D::edgeValid(const Transform3D &from, const Transform3D &to)
+{
+    this->updateDistanceField();
+    
+    return this->isMotionValid(this->plannerToWorld(from), this->plannerToWorld(to));
+}
+
 bool Environment3D::isValid(Transform3D &T) const
 {
     return this->isValidForModel(T, this->activeObject_);
@@ -201,6 +348,11 @@ bool Environment3D::isValidForModel(Transform3D &T, Model *model) const
     
     bool valid = this->inBoundsForModel(T, model);
     
+    if(valid && this->clearOfObstacles(T, model))
+    {
+        return true;
+    }
+    
     for(auto it = obstacles_.begin(); valid && it != obstacles_.end(); ++it)
     {
         if(model->wouldCollideWithModel(T, **it))
@@ -215,6 +367,199 @@ bool Environment3D::isValidForModel(Transform3D &T, Model *model) const
     return valid;
 }
     
+void Environment3D::isValidBatch(const PoseBatch &poses, PoseBatch::Mask &valid) const
+{
+    this->isValidBatchForModel(poses, this->activeObject_, valid);
+}
+    
+void Environment3D::isValidBatchForModel(const PoseBatch &poses, Model *model, PoseBatch::Mask &valid) const
+{
+    size_t n = poses.size();
+    valid.assign((n + 63) / 64, 0);
+    
+    if(n == 0) return;
+    
+    // upper 3x3 of each pose's matrix, built exactly as Transform3D builds it
+    std::vector<float> m[9];
+    for(auto &c : m) c.resize(n);
+    
+    for(size_t i = 0; i < n; ++i)
+    {
+        MPMat4 r = MPMat4MakeRotation(MPQuaternionMake(poses.qx[i], poses.qy[i], poses.qz[i], poses.qw[i]));
+        
+        m[0][i] = r.m00 * poses.sx[i]; m[1][i] = r.m01 * poses.sx[i]; m[2][i] = r.m02 * poses.sx[i];
+        m[3][i] = r.m10 * poses.sy[i]; m[4][i] = r.m11 * poses.sy[i]; m[5][i] = r.m12 * poses.sy[i];
+        m[6][i] = r.m20 * poses.sz[i]; m[7][i] = r.m21 * poses.sz[i]; m[8][i] = r.m22 * poses.sz[i];
+    }
+    
+    // the extreme points of the mesh must all lie in the environment
+    std::vector<uint8_t> pass(n, 1);
+    const MPVec3 *extremePoints = MPMeshGetExtremePoints(model->getMesh());
+    
+    for(int e = 0; e < 6; ++e)
+    {
+        MPVec3 v = extremePoints[e];
+        
+        for(size_t i = 0; i < n; ++i)
+        {
+            float wx = m[0][i] * v.x + m[3][i] * v.y + m[6][i] * v.z + poses.x[i];
+            float wy = m[1][i] * v.x + m[4][i] * v.y + m[7][i] * v.z + poses.y[i];
+            float wz = m[2][i] * v.x + m[5][i] * v.y + m[8][i] * v.z + poses.z[i];
+            
+            pass[i] &= (wx >= boundingBox_.min.x) & (wx <= boundingBox_.max.x) &
+                       (wy >= boundingBox_.min.y) & (wy <= boundingBox_.max.y) &
+                       (wz >= boundingBox_.min.z) & (wz <= boundingBox_.max.z);
+        }
+    }
+    
+    // the root sphere of the model at each pose
+    const MPSphereTree *tree = MPMeshGetSphereTree(model->getMesh());
+    MPSphere root = tree->numNodes > 0 ? tree->nodes[0].sphere : MPSphereMake(MPVec3Zero, 0.0f);
+    
+    std::vector<float> cx(n), cy(n), cz(n), radius(n);
+    
+    for(size_t i = 0; i < n; ++i)
+    {
+        cx[i] = m[0][i] * root.center.x + m[3][i] * root.center.y + m[6][i] * root.center.z + poses.x[i];
+        cy[i] = m[1][i] * root.center.x + m[4][i] * root.center.y + m[7][i] * root.center.z + poses.y[i];
+        cz[i] = m[2][i] * root.center.x + m[5][i] * root.center.y + m[8][i] * root.center.z + poses.z[i];
+        
+        float s2 = fmaxf(fmaxf(m[0][i] * m[0][i] + m[1][i] * m[1][i] + m[2][i] * m[2][i],
+                               m[3][i] * m[3][i] + m[4][i] * m[4][i] + m[5][i] * m[5][i]),
+                               m[6][i] * m[6][i] + m[7][i] * m[7][i] + m[8][i] * m[8][i]);
+        
+        radius[i] = root.radius * sqrtf(s2);
+    }
+    
+    // mark the obstacles each pose might touch. obstacle spheres are only computed once.
+    size_t numObstacles = obstacles_.size();
+    std::vector<uint8_t> near(n * numObstacles, 0);
+    std::vector<MPMat4> obstacleMatrices(numObstacles);
+    
+    for(size_t o = 0; o < numObstacles; ++o)
+    {
+        obstacleMatrices[o] = obstacles_[o]->getModelMatrix();
+        
+        const MPSphereTree *obstacleTree = MPMeshGetSphereTree(obstacles_[o]->getMesh());
+        if(obstacleTree->numNodes == 0) continue;
+        
+        MPSphere sphere = obstacleTree->nodes[0].sphere;
+        sphere.center = MPMat4TransformVec3(obstacleMatrices[o], sphere.center);
+        sphere.radius *= MPMat4MaxScale(obstacleMatrices[o]);
+        
+        uint8_t *nearObstacle = &near[o * n];
+        
+        for(size_t i = 0; i < n; ++i)
+        {
+            float dx = cx[i] - sphere.center.x;
+            float dy = cy[i] - sphere.center.y;
+            float dz = cz[i] - sphere.center.z;
+            float r = radius[i] + sphere.radius;
+            
+            nearObstacle[i] = (dx * dx + dy * dy + dz * dz <= r * r);
+        }
+    }
+    
+    // only poses near an obstacle need an exact test
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(!pass[i]) continue;
+        
+        bool anyNear = false;
+        for(size_t o = 0; o < numObstacles && !anyNear; ++o)
+        {
+            anyNear = near[o * n + i];
+        }
+        
+        if(anyNear)
+        {
+            Transform3D T = poses.get(i);
+            
+            if(!this->clearOfObstacles(T, model))
+            {
+                MPMat4 matrix = T.getMatrix();
+                
+                for(size_t o = 0; o < numObstacles && pass[i]; ++o)
+                {
+                    if(near[o * n + i] && MPMeshesIntersect(model->getMesh(), matrix, obstacles_[o]->getMesh(), obstacleMatrices[o]))
+                    {
+                        pass[i] = 0;
+                    }
+                }
+            }
+        }
+        
+        if(pass[i]) PoseBatch::maskSet(valid, i);
+    }
+}
+    
+bool Environment3D::isMotionValid(const Transform3D &from, const Transform3D &to) const
+{
+    return this->isMotionValidForModel(from, to, this->activeObject_);
+}
+    
+bool Environment3D::isMotionValidForModel(const Transform3D &from, const Transform3D &to, Model *model) const
+{
+    MPVec3 p0 = from.getPosition();
+    MPVec3 p1 = to.getPosition();
+    
+    MPQuaternion q0 = from.getRotation();
+    MPQuaternion q1 = to.getRotation();
+    
+    MPVec3 scale = from.getScale();
+    float maxScale = fmaxf(fmaxf(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+    
+    // the furthest any point of the model lies from its origin, which bounds how far it can move
+    // for a given rotation
+    float reach = 0.0f;
+    const MPSphereTree *tree = MPMeshGetSphereTree(model->getMesh());
+    
+    if(tree->numNodes > 0)
+    {
+        MPSphere root = tree->nodes[0].sphere;
+        reach = (MPVec3Length(root.center) + root.radius) * maxScale;
+    }
+    
+    // the most any point of the model moves over the whole edge
+    float sweep = MPVec3EuclideanDistance(p0, p1) + MPQuaternionAngle(q0, q1) * reach;
+    
+    float tolerance = this->getEdgeTolerance();
+    
+    Transform3D T = from;
+    double t = 0.0;
+    
+    while(true)
+    {
+        T.setPosition(MPVec3Add(p0, MPVec3MultiplyScalar(MPVec3Subtract(p1, p0), t)));
+        T.setRotation(MPQuaternionSlerp(q0, q1, t));
+        
+        float clearance = this->obstacleClearance(T, model);
+        
+        if(clearance < tolerance)
+        {
+            // the field can't prove enough, so check exactly and measure the distance to the
+            // obstacles themselves. no more than the rest of the edge's sweep is needed.
+            if(!this->isValidForModel(T, model)) return false;
+            
+            float remaining = (float)(1.0 - t) * sweep;
+            
+            clearance = std::max(clearance, this->surfaceClearance(T, model, std::max(remaining, tolerance)));
+            
+            // the sample is valid but too close to the obstacles to advance by its clearance, so
+            // the next one is taken a short step ahead and checked exactly as well
+            clearance = std::max(clearance, MP_MIN_EDGE_CLEARANCE * tolerance);
+        }
+        else if(!this->inBoundsForModel(T, model))
+        {
+            return false;
+        }
+        
+        if(t >= 1.0 || sweep <= 0.0f) return true;
+        
+        t = std::min(1.0, t + clearance / sweep);
+    }
+}
+    
 bool Environment3D::inBounds(Transform3D &T) const
 {
     return this->inBoundsForModel(T, this->activeObject_);
@@ -287,6 +632,14 @@ void Environment3D::plannerToWorld(MPVec3 &vec) const
 
 void Environment3D::plannerToWorld(MPQuaternion &q) const
 {
+    const OrientationTable::Orientation *o = orientations_.find(q);
+    
+    if(o != nullptr)
+    {
+        q = o->rotation;
+        return;
+    }
+    
     q = MPRPYToQuaternion(q.z * this->rotationStepSize_, q.x * this->rotationStepSize_, q.y * this->rotationStepSize_);
 }
     
@@ -309,6 +662,43 @@ void Environment3D::worldToPlanner(MPQuaternion &q) const
     
 #pragma mark - protected methods
     
+void Environment3D::updateOrientationTable()
+{
+    if(activeObject_ != nullptr)
+    {
+        orientations_.build(rotationStepSize_, numRotations_, activeObject_->getMesh(), activeObject_->getScale());
+    }
+    else
+    {
+        orientations_.build(rotationStepSize_, numRotations_, nullptr, MPVec3Make(1.0f, 1.0f, 1.0f));
+    }
+}
+    
+bool Environment3D::orientationInBounds(const Transform3D &plannerState) const
+{
+    if(!orientations_.hasExtremePoints() || !MPVec3EqualToVec3(plannerState.getScale(), orientations_.getScale()))
+    {
+        return true;
+    }
+    
+    const OrientationTable::Orientation *o = orientations_.find(plannerState.getRotation());
+    
+    if(o == nullptr) return true;
+    
+    MPVec3 position = plannerState.getPosition();
+    this->plannerToWorld(position);
+    
+    for(int i = 0; i < 6; ++i)
+    {
+        if(!MPAABoxContainsPoint(boundingBox_, MPVec3Add(position, o->extremePoints[i])))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+    
 void Environment3D::updateBoundingBox()
 {
     MPVec3 halfSize = MPVec3MultiplyScalar(this->size_, 0.5f);
@@ -316,7 +706,81 @@ void Environment3D::updateBoundingBox()
     MPVec3 min = MPVec3Subtract(this->origin_, halfSize);
     MPVec3 max = MPVec3Add(this->origin_, halfSize);
     
-    this->boundingBox_ = MPAABoxMake(min, max);    
+    this->boundingBox_ = MPAABoxMake(min, max);
+    
+    this->invalidateOccupancySlices();
+    this->invalidateDistanceField();
+}
+    
+void Environment3D::invalidateOccupancySlices()
+{
+    occupancySlicesValid_ = false;
+    occupancySlices_.clear();
+}
+    
+void Environment3D::invalidateDistanceField()
+{
+    distanceFieldValid_ = false;
+    distanceField_.clear();
+    
+    activeSpheres_.clear();
+    sphereMesh_ = nullptr;
+}
+    
+bool Environment3D::clearOfObstacles(Transform3D &T, Model *model) const
+{
+    if(!distanceFieldValid_ || dynamic_ || model->getMesh() != sphereMesh_) return false;
+    
+    MPMat4 matrix = T.getMatrix();
+    
+    MPVec3 scale = T.getScale();
+    float radiusScale = fmaxf(fmaxf(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+    
+    // a single lookup is enough when the whole object is far from the obstacles
+    MPVec3 center = MPMat4TransformVec3(matrix, activeBound_.center);
+    
+    if(distanceField_.distanceLowerBound(center) > activeBound_.radius * radiusScale)
+    {
+        return true;
+    }
+    
+    return distanceField_.spheresClear(activeSpheres_, matrix, radiusScale);
+}
+    
+float Environment3D::obstacleClearance(Transform3D &T, Model *model) const
+{
+    if(!distanceFieldValid_ || dynamic_ || model->getMesh() != sphereMesh_) return 0.0f;
+    
+    MPMat4 matrix = T.getMatrix();
+    
+    MPVec3 scale = T.getScale();
+    float radiusScale = fmaxf(fmaxf(std::abs(scale.x), std::abs(scale.y)), std::abs(scale.z));
+    
+    // both the whole-object sphere and the surface spheres give valid bounds, so take the better
+    MPVec3 center = MPMat4TransformVec3(matrix, activeBound_.center);
+    float clearance = distanceField_.distanceLowerBound(center) - activeBound_.radius * radiusScale;
+    
+    if(clearance < this->getEdgeTolerance())
+    {
+        clearance = std::max(clearance, distanceField_.spheresClearance(activeSpheres_, matrix, radiusScale));
+    }
+    
+    return std::max(clearance, 0.0f);
+}
+    
+float Environment3D::surfaceClearance(Transform3D &T, Model *model, float limit) const
+{
+    MPMat4 matrix = T.getMatrix();
+    float clearance = limit;
+    
+    for(auto obstacle : obstacles_)
+    {
+        if(obstacle == model) continue;
+        
+        clearance = MPMeshesDistance(model->getMesh(), matrix, obstacle->getMesh(), obstacle->getModelMatrix(), clearance);
+    }
+    
+    return clearance;
 }
     
 void Environment3D::generateActionSet()
@@ -345,12 +809,21 @@ void Environment3D::applyAction(const MP::Action6D &action, MP::Transform3D &sta
     MPVec3 p = stateTransform.getPosition();
     MPQuaternion q = stateTransform.getRotation();
     
-    MPQuaternion worldQ = q;
-    this->plannerToWorld(worldQ);
-    
     this->plannerToWorld(trans);
     
-    trans = MPQuaternionRotateVec3(worldQ, trans);
+    const OrientationTable::Orientation *o = orientations_.find(q);
+    
+    if(o != nullptr)
+    {
+        trans = MPMat4TransformVec3(o->matrix, trans);
+    }
+    else
+    {
+        MPQuaternion worldQ = q;
+        this->plannerToWorld(worldQ);
+        
+        trans = MPQuaternionRotateVec3(worldQ, trans);
+    }
     
     this->worldToPlanner(trans);
     
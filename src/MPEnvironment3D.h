@@ -15,6 +15,10 @@
 #include "MPEnvironment.h"
 #include "MPModel.h"
 #include "MPAction6D.h"
+#include "MPOccupancySlices.h"
+#include "MPOrientationTable.h"
+#include "MPDistanceField.h"
+#include "MPPoseBatch.h"
 #include <cmath>
 
 namespace MP
@@ -52,24 +56,75 @@ public:
     
     Model* getActiveObject() const { return activeObject_; }
     
-    void addObstacle(Model *obstacle) { obstacles_.push_back(obstacle); }
+    void addObstacle(Model *obstacle);
     
     const std::vector<Model *>& getObstacles() const { return obstacles_; }
     
     double getStepSize() const { return stepSize_; }
     
-    void setStepSize(double s) { stepSize_ = s; }
+    void setStepSize(double s);
     
     double getRotationStepSize() const { return rotationStepSize_; }
     
     void setRotationStepSize(double s);
     
+    /* the world rotation of every discrete orientation, built when the rotation step is set */
+    const OrientationTable& getOrientationTable() const { return orientations_; }
+    
     bool isDynamic() const { return dynamic_; }
     
     void setDynamic(bool d) { dynamic_ = d; }
     
     void resetActions() { actionSet_.clear(); }
     
+    /* when enabled (the default), validity of states in a static environment is answered from
+     * per-orientation occupancy slices, which are computed the first time an orientation is used */
+    void setUseOccupancySlices(bool use) { useOccupancySlices_ = use; }
+    
+    bool usesOccupancySlices() const { return useOccupancySlices_; }
+    
+    void setOccupancyMemoryLimit(size_t bytes) { occupancySlices_.setMemoryLimit(bytes); }
+    
+    const OccupancySlices& getOccupancySlices() const { return occupancySlices_; }
+    
+    /* a positive resolution enables a signed distance field of the obstacles, which lets most
+     * collision-free poses of the active object skip the exact triangle tests. pass 0 to disable. */
+    void setDistanceFieldResolution(double resolution);
+    
+    double getDistanceFieldResolution() const { return distanceFieldResolution_; }
+    
+    /* (re)builds the distance field and active object spheres if they are out of date */
+    void updateDistanceField();
+    
+    const DistanceField& getDistanceField() const { return distanceField_; }
+    
+    /* the spheres covering the active object that are checked against the distance field, and a
+     * sphere enclosing them (in mesh coordinates). empty until the field is built. */
+    const std::vector<MPSphere>& getActiveSpheres() const { return activeSpheres_; }
+    
+    MPSphere getActiveBound() const { return activeBound_; }
+    
+    /* uses a distance field and active object spheres that were built earlier (e.g. loaded from a
+     * snapshot) for the current obstacles, bounds, resolution and active object */
+    void setDistanceField(DistanceField field, std::vector<MPSphere> activeSpheres, const MPSphere &activeBound);
+    
+    /* when enabled, successors are only generated along actions that the active object can follow
+     * without collision, so coarse lattices can't tunnel through thin obstacles */
+    void setCheckEdges(bool check) { checkEdges_ = check; }
+    
+    bool checksEdges() const { return checkEdges_; }
+    
+    /* where the distance field can't prove this much clearance along an edge (or is disabled), the
+     * distance to the obstacles' surfaces is measured instead. where an edge passes within a
+     * hundredth of it, poses are only checked exactly at samples that far apart. pass 0 to use a
+     * quarter of the step size. */
+    void setEdgeTolerance(double tolerance) { edgeTolerance_ = tolerance; }
+    
+    double getEdgeTolerance() const;
+    
+    /* returns true if the active object can move between the given planner states */
+    bool edgeValid(const Transform3D &from, const Transform3D &to);
+    
     bool stateValid(const Transform3D &T);
     
     void plannerToWorld(Transform3D &state) const;
@@ -81,6 +136,19 @@ public:
     bool isValid(Transform3D &T) const;
     bool isValidForModel(Transform3D &T, Model *model) const;
     
+    /* checks every (world) pose in the batch, with the same result as isValidForModel. the bounds
+     * and bounding sphere tests are swept across all poses before any exact tests are made. */
+    void isValidBatch(const PoseBatch &poses, PoseBatch::Mask &valid) const;
+    void isValidBatchForModel(const PoseBatch &poses, Model *model, PoseBatch::Mask &valid) const;
+    
+    /* returns true if the model can move from one (world) pose to the other, interpolating
+     * position linearly and rotation along the shortest arc. uses conservative advancement:
+     * each step moves no point of the model further than a lower bound on its clearance, from
+     * the distance field or else the obstacle meshes, but at least a hundredth of the edge
+     * tolerance. every pose reached is valid, so so are both ends of a valid motion. */
+    bool isMotionValid(const Transform3D &from, const Transform3D &to) const;
+    bool isMotionValidForModel(const Transform3D &from, const Transform3D &to, Model *model) const;
+    
     bool inBounds(Transform3D &T) const;
     bool inBoundsForModel(Transform3D &T, Model *model) const;
     
@@ -88,6 +156,28 @@ protected:
     
     void updateBoundingBox();
     
+    /* must be called whenever the geometry, bounds or discretization change */
+    void invalidateOccupancySlices();
+    
+    void invalidateDistanceField();
+    
+    /* rebuilds the orientation table for the current rotation step and active object */
+    void updateOrientationTable();
+    
+    /* returns false if the active object is known to leave the bounds at the given planner state,
+     * using the extreme points in the orientation table. returns true when the table can't tell. */
+    bool orientationInBounds(const Transform3D &plannerState) const;
+    
+    /* returns true if the distance field proves that the model doesn't collide with any obstacle */
+    bool clearOfObstacles(Transform3D &T, Model *model) const;
+    
+    /* a lower bound on the distance between the model and the obstacles, or 0 if none is known */
+    float obstacleClearance(Transform3D &T, Model *model) const;
+    
+    /* the distance between the surfaces of the model and the nearest obstacle, or limit if that
+     * is further. the model must not collide at T. */
+    float surfaceClearance(Transform3D &T, Model *model, float limit) const;
+    
     void generateActionSet();
     
     void applyAction(const Action6D &action, Transform3D &stateTransform);
@@ -109,10 +199,28 @@ protected:
     double rotationStepSize_;
     int numRotations_;
     
+    OrientationTable orientations_;
+    
     Model *activeObject_;
     std::vector<Model *> obstacles_;
     
     Action6D::ActionSet actionSet_;
+    
+    bool useOccupancySlices_;
+    bool occupancySlicesValid_;
+    OccupancySlices occupancySlices_;
+    
+    double distanceFieldResolution_;
+    bool distanceFieldValid_;
+    DistanceField distanceField_;
+    
+    /* spheres covering the surface of the active object's mesh */
+    MPMesh *sphereMesh_;
+    std::vector<MPSphere> activeSpheres_;
+    MPSphere activeBound_;
+    
+    bool checkEdges_;
+    double edgeTolerance_;
 
 };
     
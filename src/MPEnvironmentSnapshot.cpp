@@ -0,0 +1,409 @@
+//
+//  MPEnvironmentSnapshot.cpp
+//
+
+#include "MPEnvironmentSnapshot.h"
+#include "MPMeshFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MP_ENVIRONMENT_SNAPSHOT_ALIGNMENT 16
+
+namespace MP
+{
+
+namespace
+{
+    uint64_t align(uint64_t offset)
+    {
+        return (offset + MP_ENVIRONMENT_SNAPSHOT_ALIGNMENT - 1) & ~(uint64_t)(MP_ENVIRONMENT_SNAPSHOT_ALIGNMENT - 1);
+    }
+
+    bool writeAt(FILE *file, uint64_t offset, const void *data, size_t size)
+    {
+        if(size == 0) return true;
+
+        // fseek past the end leaves a zero filled gap, which is the alignment padding
+        return fseek(file, (long)offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+    }
+
+    /* returns true if [offset, offset + size) lies in the file and offset is aligned. empty
+     * sections may lie past the end of the file, since nothing is written for them. */
+    bool sectionValid(uint64_t offset, uint64_t size, size_t fileSize)
+    {
+        if(size == 0) return true;
+
+        return offset % MP_ENVIRONMENT_SNAPSHOT_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+    }
+
+    bool validate(const char *base, size_t size)
+    {
+        const EnvironmentSnapshotHeader *header = (const EnvironmentSnapshotHeader *)base;
+
+        if(header->magic != MP_ENVIRONMENT_SNAPSHOT_MAGIC || header->version != MP_ENVIRONMENT_SNAPSHOT_VERSION) return false;
+
+        // guard the size computations below against overflow
+        if(header->numMeshes > size / sizeof(EnvironmentSnapshotMesh) || header->numModels > size / sizeof(EnvironmentSnapshotModel)) return false;
+
+        if(!sectionValid(header->meshesOffset, header->numMeshes * sizeof(EnvironmentSnapshotMesh), size)) return false;
+        if(!sectionValid(header->modelsOffset, header->numModels * sizeof(EnvironmentSnapshotModel), size)) return false;
+
+        if(header->activeObject < -1 || header->activeObject >= (int64_t)header->numModels) return false;
+
+        // the mesh images themselves are validated as the meshes are created
+        const EnvironmentSnapshotMesh *meshes = (const EnvironmentSnapshotMesh *)(base + header->meshesOffset);
+
+        for(uint32_t i = 0; i < header->numMeshes; ++i)
+        {
+            if(meshes[i].size == 0 || !sectionValid(meshes[i].offset, meshes[i].size, size)) return false;
+        }
+
+        const EnvironmentSnapshotModel *models = (const EnvironmentSnapshotModel *)(base + header->modelsOffset);
+
+        for(uint32_t i = 0; i < header->numModels; ++i)
+        {
+            const EnvironmentSnapshotModel &model = models[i];
+
+            if(model.mesh < -1 || model.mesh >= (int64_t)header->numMeshes) return false;
+
+            if(model.pathLength > size / sizeof(MPVec3) || !sectionValid(model.pathOffset, model.pathLength * sizeof(MPVec3), size)) return false;
+        }
+
+        if(header->fieldOffset)
+        {
+            if(!sectionValid(header->fieldOffset, sizeof(EnvironmentSnapshotField), size)) return false;
+
+            const EnvironmentSnapshotField *field = (const EnvironmentSnapshotField *)(base + header->fieldOffset);
+
+            uint64_t numSamples = 1;
+
+            for(int a = 0; a < 3; ++a)
+            {
+                if(field->dims[a] < 2) return false;
+
+                numSamples *= field->dims[a];
+
+                if(numSamples > size / sizeof(float)) return false;
+            }
+
+            if(!sectionValid(field->samplesOffset, numSamples * sizeof(float), size)) return false;
+
+            if(field->numActiveSpheres > size / sizeof(MPSphere) ||
+               !sectionValid(field->activeSpheresOffset, field->numActiveSpheres * sizeof(MPSphere), size)) return false;
+        }
+
+        return true;
+    }
+
+    // the mapping is shared by the snapshot's meshes, and released along with the last of them
+    struct SnapshotMapping
+    {
+        void *base;
+        size_t size;
+        std::atomic<int> references;
+    };
+
+    void releaseMapping(SnapshotMapping *mapping)
+    {
+        if(mapping->references.fetch_sub(1) == 1)
+        {
+            munmap(mapping->base, mapping->size);
+            delete mapping;
+        }
+    }
+
+    void releaseMeshMapping(MPMesh *mesh, void *context)
+    {
+        releaseMapping((SnapshotMapping *)context);
+    }
+}
+
+#pragma mark - public functions
+
+bool isEnvironmentSnapshot(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if(file == NULL) return false;
+
+    uint32_t magic = 0;
+    size_t read = fread(&magic, sizeof(magic), 1, file);
+
+    fclose(file);
+
+    return read == 1 && magic == MP_ENVIRONMENT_SNAPSHOT_MAGIC;
+}
+
+bool writeEnvironmentSnapshot(Environment3D &environment, const std::string &path)
+{
+    // saves rebuilding the field on load (this does nothing if the field is disabled)
+    environment.updateDistanceField();
+
+    std::vector<Model *> models(environment.getObstacles());
+
+    Model *activeObject = environment.getActiveObject();
+    if(activeObject != nullptr) models.push_back(activeObject);
+
+    EnvironmentSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = MP_ENVIRONMENT_SNAPSHOT_MAGIC;
+    header.version = MP_ENVIRONMENT_SNAPSHOT_VERSION;
+    header.numModels = (uint32_t)models.size();
+    header.origin = environment.getOrigin();
+    header.size = environment.getSize();
+    header.dynamic = environment.isDynamic() ? 1 : 0;
+    header.activeObject = activeObject != nullptr ? (int32_t)models.size() - 1 : -1;
+    header.stepSize = environment.getStepSize();
+    header.rotationStepSize = environment.getRotationStepSize();
+    header.distanceFieldResolution = environment.getDistanceFieldResolution();
+
+    // models may share meshes, which are only stored once
+    std::vector<MPMesh *> meshes;
+    std::vector<EnvironmentSnapshotModel> modelRecords(models.size());
+
+    for(size_t i = 0; i < models.size(); ++i)
+    {
+        Model *model = models[i];
+        EnvironmentSnapshotModel &record = modelRecords[i];
+
+        record.rotation = model->getRotation();
+        record.position = model->getPosition();
+        record.scale = model->getScale();
+        record.mesh = -1;
+
+        if(model->getMesh() != nullptr)
+        {
+            auto found = std::find(meshes.begin(), meshes.end(), model->getMesh());
+            record.mesh = (int32_t)(found - meshes.begin());
+
+            if(found == meshes.end()) meshes.push_back(model->getMesh());
+        }
+
+        Motion *motion = model->getMotion();
+
+        if(motion != nullptr)
+        {
+            record.hasMotion = 1;
+            record.repeats = motion->repeats() ? 1 : 0;
+            record.loops = motion->loops() ? 1 : 0;
+            record.duration = motion->duration();
+            record.pathLength = motion->path().size();
+        }
+    }
+
+    header.numMeshes = (uint32_t)meshes.size();
+
+    // lay out the sections. the mesh images go last, since their sizes are only known once they are written
+    header.meshesOffset = align(sizeof(header));
+    header.modelsOffset = align(header.meshesOffset + meshes.size() * sizeof(EnvironmentSnapshotMesh));
+    uint64_t end = header.modelsOffset + models.size() * sizeof(EnvironmentSnapshotModel);
+
+    for(EnvironmentSnapshotModel &record : modelRecords)
+    {
+        if(record.pathLength == 0) continue;
+
+        record.pathOffset = align(end);
+        end = record.pathOffset + record.pathLength * sizeof(MPVec3);
+    }
+
+    const DistanceField &distanceField = environment.getDistanceField();
+
+    EnvironmentSnapshotField field;
+    memset(&field, 0, sizeof(field));
+
+    if(distanceField.isBuilt())
+    {
+        field.bounds = distanceField.getBounds();
+        field.resolution = distanceField.getResolution();
+        distanceField.getDimensions(field.dims);
+        field.activeBound = environment.getActiveBound();
+        field.numActiveSpheres = environment.getActiveSpheres().size();
+
+        header.fieldOffset = align(end);
+        field.samplesOffset = align(header.fieldOffset + sizeof(field));
+        field.activeSpheresOffset = align(field.samplesOffset + distanceField.getSamples().size() * sizeof(float));
+        end = field.activeSpheresOffset + field.numActiveSpheres * sizeof(MPSphere);
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == NULL) return false;
+
+    std::vector<EnvironmentSnapshotMesh> meshRecords(meshes.size());
+    bool ok = true;
+
+    for(size_t i = 0; i < meshes.size() && ok; ++i)
+    {
+        meshRecords[i].offset = align(end);
+        ok = MPMeshWriteBinaryToFile(meshes[i], file, meshRecords[i].offset, &meshRecords[i].size) == 0;
+
+        end = meshRecords[i].offset + meshRecords[i].size;
+    }
+
+    ok = ok &&
+         writeAt(file, 0, &header, sizeof(header)) &&
+         writeAt(file, header.meshesOffset, meshRecords.data(), meshRecords.size() * sizeof(EnvironmentSnapshotMesh)) &&
+         writeAt(file, header.modelsOffset, modelRecords.data(), modelRecords.size() * sizeof(EnvironmentSnapshotModel));
+
+    for(size_t i = 0; i < models.size() && ok; ++i)
+    {
+        if(modelRecords[i].pathLength == 0) continue;
+
+        ok = writeAt(file, modelRecords[i].pathOffset, models[i]->getMotion()->path().data(), modelRecords[i].pathLength * sizeof(MPVec3));
+    }
+
+    if(ok && header.fieldOffset)
+    {
+        ok = writeAt(file, header.fieldOffset, &field, sizeof(field)) &&
+             writeAt(file, field.samplesOffset, distanceField.getSamples().data(), distanceField.getSamples().size() * sizeof(float)) &&
+             writeAt(file, field.activeSpheresOffset, environment.getActiveSpheres().data(), field.numActiveSpheres * sizeof(MPSphere));
+    }
+
+    if(fclose(file) != 0) ok = false;
+
+    return ok;
+}
+
+Environment3D* openEnvironmentSnapshot(const std::string &path, std::ostream &errors)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if(fd < 0)
+    {
+        errors << "error: could not read environment snapshot " << path << std::endl;
+        return nullptr;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(EnvironmentSnapshotHeader))
+    {
+        errors << "error: malformed environment snapshot " << path << std::endl;
+
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if(base == MAP_FAILED)
+    {
+        errors << "error: could not read environment snapshot " << path << std::endl;
+        return nullptr;
+    }
+
+    const char *bytes = (const char *)base;
+
+    if(!validate(bytes, size))
+    {
+        errors << "error: malformed environment snapshot " << path << std::endl;
+
+        munmap(base, size);
+        return nullptr;
+    }
+
+    const EnvironmentSnapshotHeader *header = (const EnvironmentSnapshotHeader *)bytes;
+
+    // one reference is held while loading, and one by each mesh
+    SnapshotMapping *mapping = new SnapshotMapping();
+    mapping->base = base;
+    mapping->size = size;
+    mapping->references = 1;
+
+    std::vector<MPMesh *> meshes;
+    const EnvironmentSnapshotMesh *meshRecords = (const EnvironmentSnapshotMesh *)(bytes + header->meshesOffset);
+
+    for(uint32_t i = 0; i < header->numMeshes; ++i)
+    {
+        MPMesh *mesh = MPMeshCreateWithBinaryData(bytes + meshRecords[i].offset, meshRecords[i].size);
+
+        if(mesh == nullptr)
+        {
+            errors << "error: malformed mesh " << i << " in environment snapshot " << path << std::endl;
+
+            for(auto created : meshes)
+            {
+                MPMeshFree(created);
+            }
+
+            releaseMapping(mapping);
+            return nullptr;
+        }
+
+        mapping->references++;
+        MPMeshSetDataDeallocator(mesh, releaseMeshMapping, mapping);
+
+        meshes.push_back(mesh);
+    }
+
+    Environment3D *environment = new Environment3D(header->origin, header->size);
+
+    environment->setDynamic(header->dynamic != 0);
+    environment->setStepSize(header->stepSize);
+    environment->setRotationStepSize(header->rotationStepSize);
+
+    const EnvironmentSnapshotModel *modelRecords = (const EnvironmentSnapshotModel *)(bytes + header->modelsOffset);
+
+    for(uint32_t i = 0; i < header->numModels; ++i)
+    {
+        const EnvironmentSnapshotModel &record = modelRecords[i];
+
+        Model *model = new Model(record.mesh >= 0 ? meshes[record.mesh] : nullptr);
+        model->setTransform(Transform3D(record.position, record.scale, record.rotation));
+
+        if(record.hasMotion)
+        {
+            const MPVec3 *points = (const MPVec3 *)(bytes + record.pathOffset);
+
+            Motion motion;
+            motion.setPath(std::vector<MPVec3>(points, points + record.pathLength));
+            motion.setRepeats(record.repeats != 0);
+            motion.setLoops(record.loops != 0);
+            motion.setDuration(record.duration);
+
+            model->setMotion(motion);
+        }
+
+        if((int32_t)i == header->activeObject)
+        {
+            environment->setActiveObject(model);
+        }
+        else
+        {
+            environment->addObstacle(model);
+        }
+    }
+
+    environment->setDistanceFieldResolution(header->distanceFieldResolution);
+
+    if(header->fieldOffset)
+    {
+        const EnvironmentSnapshotField *fieldRecord = (const EnvironmentSnapshotField *)(bytes + header->fieldOffset);
+        const MPSphere *spheres = (const MPSphere *)(bytes + fieldRecord->activeSpheresOffset);
+
+        DistanceField field;
+        field.assign(fieldRecord->bounds, fieldRecord->resolution, fieldRecord->dims, (const float *)(bytes + fieldRecord->samplesOffset));
+
+        environment->setDistanceField(std::move(field), std::vector<MPSphere>(spheres, spheres + fieldRecord->numActiveSpheres), fieldRecord->activeBound);
+    }
+
+    // meshes no model uses would otherwise never be freed
+    for(auto mesh : meshes)
+    {
+        if(MPMeshGetRefCount(mesh) == 0) MPMeshFree(mesh);
+    }
+
+    releaseMapping(mapping);
+
+    return environment;
+}
+
+}
@@ -0,0 +1,99 @@
+//
+//  MPEnvironmentSnapshot.h
+//
+//  A versioned binary snapshot of an environment that can be memory-mapped and used in place,
+//  so that a process can start planning without parsing any text or rebuilding meshes. The file is:
+//
+//      header | mesh table | model table | motion paths | distance field (optional) | meshes
+//
+//  with every section aligned to 16 bytes. Each mesh is a complete binary mesh image (see
+//  MPMeshFile.h), including its precomputed data, and is used straight from the mapping. The
+//  mapping is released once the last of those meshes is freed. Data is in native byte order.
+
+#ifndef __MPEnvironmentSnapshot__
+#define __MPEnvironmentSnapshot__
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "MPEnvironment3D.h"
+
+#define MP_ENVIRONMENT_SNAPSHOT_MAGIC 0x4245504D    // "MPEB"
+#define MP_ENVIRONMENT_SNAPSHOT_VERSION 2
+
+namespace MP
+{
+
+struct EnvironmentSnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numMeshes;
+    uint32_t numModels;
+
+    MPVec3 origin;
+    MPVec3 size;
+    uint32_t dynamic;
+    int32_t activeObject;               // index of the active object's model, or -1. every other model is an obstacle.
+
+    double stepSize;
+    double rotationStepSize;
+    double distanceFieldResolution;
+
+    // byte offsets from the start of the file. 0 if the section is absent.
+    uint64_t meshesOffset;              // EnvironmentSnapshotMesh[numMeshes]
+    uint64_t modelsOffset;              // EnvironmentSnapshotModel[numModels]
+    uint64_t fieldOffset;               // an EnvironmentSnapshotField
+};
+
+struct EnvironmentSnapshotMesh
+{
+    uint64_t offset;                    // a binary mesh image
+    uint64_t size;
+};
+
+struct EnvironmentSnapshotModel
+{
+    MPQuaternion rotation;
+    MPVec3 position;
+    MPVec3 scale;
+
+    int32_t mesh;                       // index into the mesh table, or -1
+    int32_t hasMotion;
+    int32_t repeats;
+    int32_t loops;
+    double duration;
+
+    uint64_t pathLength;
+    uint64_t pathOffset;                // MPVec3[pathLength]
+};
+
+struct EnvironmentSnapshotField
+{
+    MPAABox bounds;
+    float resolution;
+    int32_t dims[3];
+
+    MPSphere activeBound;
+
+    uint64_t samplesOffset;             // float[dims[0] * dims[1] * dims[2]]
+
+    uint64_t numActiveSpheres;
+    uint64_t activeSpheresOffset;       // MPSphere[numActiveSpheres]
+};
+
+/* returns true if the file starts with the snapshot header */
+bool isEnvironmentSnapshot(const std::string &path);
+
+/* writes the environment, its meshes and their precomputed data in the snapshot format. if the
+ * environment has a distance field resolution set, the field is built first and saved too. */
+bool writeEnvironmentSnapshot(Environment3D &environment, const std::string &path);
+
+/* maps a snapshot into memory and creates the environment it holds, with meshes that use the
+ * mapping in place. returns nullptr, after writing the reason to errors, if the file can't be
+ * read or is malformed. */
+Environment3D* openEnvironmentSnapshot(const std::string &path, std::ostream &errors = std::cout);
+
+}
+
+#endif
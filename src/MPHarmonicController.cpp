@@ -0,0 +1,100 @@
+//
+//  MPHarmonicController.cpp
+//
+
+#include "MPHarmonicController.h"
+
+namespace MP
+{
+
+HarmonicController::HarmonicController(const std::vector<Model *> &obstacles, Model *activeObject, const MPAABox &bounds, float resolution)
+: activeObject_(activeObject), resolution_(resolution), gradStep_(0.1f * resolution), sweepsPerStep_(16), tolerance_(1e-6), lastSweeps_(0)
+{
+    MPSphere activeSphere = MPSphereTransformTRS(MPMeshGetBoundingSphere(activeObject->getMesh(), NULL),
+                                                 activeObject->getPosition(), activeObject->getRotation(), activeObject->getScale());
+
+    // the same radius PotentialFieldController gives the object, plus half a voxel
+    clearance_ = 0.5f * activeSphere.radius + 0.5f * resolution;
+
+    field_.setGrid(bounds, resolution);
+
+    for(auto model : obstacles)
+    {
+        Obstacle obstacle;
+        obstacle.model = model;
+        obstacle.index = field_.addObstacle();
+        obstacle.scale = MPVec3Zero;
+        obstacle.epoch = 0;
+
+        obstacles_.push_back(obstacle);
+    }
+
+    this->updateObstacles();
+}
+
+void HarmonicController::setGoal(const Transform3D &goal)
+{
+    field_.setGoal(goal.getPosition());
+}
+
+int HarmonicController::solve(int maxSweeps)
+{
+    this->updateObstacles();
+
+    return field_.relax(maxSweeps, tolerance_);
+}
+
+void HarmonicController::move()
+{
+    this->updateObstacles();
+
+    lastSweeps_ = field_.relax(sweepsPerStep_, tolerance_);
+
+    // the potential is only meaningful up to its shape, so take a fixed step up its steepest
+    // slope (a flat potential, where the goal can't be reached, leaves the object in place)
+    MPVec3 currentPosition = activeObject_->getPosition();
+    MPVec3 direction = field_.direction(currentPosition);
+
+    activeObject_->setPosition(MPVec3Add(currentPosition, MPVec3MultiplyScalar(direction, gradStep_)));
+}
+
+void HarmonicController::updateObstacles()
+{
+    std::vector<MPVec3> points;
+
+    for(Obstacle &obstacle : obstacles_)
+    {
+        unsigned long epoch = obstacle.model->getTransformEpoch();
+
+        if(epoch == obstacle.epoch) continue;
+
+        obstacle.epoch = epoch;
+
+        MPVec3 scale = obstacle.model->getScale();
+
+        if(!MPVec3EqualToVec3(scale, obstacle.scale))
+        {
+            int n;
+            MPVec3 *voxArray = MPMeshGetVoxels(obstacle.model->getMesh(), scale, resolution_, &n);
+
+            obstacle.voxels.assign(voxArray, voxArray + n);
+            obstacle.scale = scale;
+
+            free(voxArray);
+        }
+
+        // the voxels are already scaled, so only rotation and translation take them to the world
+        MPMat4 toWorld = MPMat4MakeRotation(obstacle.model->getRotation());
+        MPVec3 position = obstacle.model->getPosition();
+        toWorld.m[12] = position.x;
+        toWorld.m[13] = position.y;
+        toWorld.m[14] = position.z;
+
+        points.resize(obstacle.voxels.size());
+        MPMat4TransformVec3Array(toWorld, obstacle.voxels.data(), points.data(), points.size());
+
+        field_.setObstacle(obstacle.index, points, clearance_);
+    }
+}
+
+}
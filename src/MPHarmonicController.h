@@ -0,0 +1,85 @@
+//
+//  MPHarmonicController.h
+//
+//  Moves an object toward a goal down a harmonic potential (see MPHarmonicField.h) rather than
+//  the sum of attractive and repulsive potentials PotentialFieldController uses, so it can't get
+//  stuck in a local minimum. The potential is relaxed a bounded number of sweeps per step,
+//  starting from the last solution, and obstacles are only re-rasterized once they move.
+
+#ifndef __MPHarmonicController__
+#define __MPHarmonicController__
+
+#include <vector>
+#include "MPModel.h"
+#include "MPHarmonicField.h"
+
+namespace MP
+{
+
+class HarmonicController
+{
+public:
+    /* the potential covers bounds with nodes spaced resolution apart. obstacles are voxelized
+     * with the same spacing. */
+    HarmonicController(const std::vector<Model *> &obstacles, Model *activeObject, const MPAABox &bounds, float resolution);
+
+    void setGoal(const Transform3D &goal);
+
+    /* the distance the object moves per step. defaults to a tenth of the resolution. */
+    void setGradStep(float gradStep) { gradStep_ = gradStep; }
+
+    /* the most relaxation sweeps a single move() performs. defaults to 16. */
+    void setSweepsPerStep(int sweeps) { sweepsPerStep_ = sweeps; }
+
+    /* the potential is converged once no sweep changes any value by more than this fraction of
+     * itself. defaults to 1e-6. */
+    void setTolerance(double tolerance) { tolerance_ = tolerance; }
+
+    /* relaxes the potential until it converges or maxSweeps is reached, returning the sweeps performed */
+    int solve(int maxSweeps);
+
+    void move();
+
+    bool isConverged() const { return field_.isConverged(); }
+
+    /* the number of relaxation sweeps performed by the last move() */
+    int getLastSweeps() const { return lastSweeps_; }
+
+    const HarmonicField& getField() const { return field_; }
+
+private:
+    /* an obstacle's voxels in its own frame, and the transform epoch they were last placed at */
+    struct Obstacle
+    {
+        Model *model;
+        int index;
+
+        MPVec3 scale;
+        std::vector<MPVec3> voxels;
+
+        unsigned long epoch;
+    };
+
+    /* re-rasterizes the obstacles that moved since the last step */
+    void updateObstacles();
+
+    Model *activeObject_;
+
+    float resolution_;
+
+    /* how close the object's center may come to an obstacle voxel's center */
+    float clearance_;
+
+    float gradStep_;
+    int sweepsPerStep_;
+    double tolerance_;
+
+    int lastSweeps_;
+
+    std::vector<Obstacle> obstacles_;
+    HarmonicField field_;
+};
+
+}
+
+#endif
@@ -0,0 +1,543 @@
+//
+//  MPHarmonicField.cpp
+//
+
+#include "MPHarmonicField.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// fewer i-slabs than this per thread aren't worth starting a thread for
+#define MP_MIN_SLABS_PER_THREAD 8
+
+namespace MP
+{
+
+namespace
+{
+    // lets a fixed number of threads wait for each other between half-sweeps
+    class Barrier
+    {
+    public:
+        explicit Barrier(int count) : count_(count), waiting_(0), generation_(0) {}
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            int generation = generation_;
+
+            if(++waiting_ == count_)
+            {
+                waiting_ = 0;
+                ++generation_;
+                condition_.notify_all();
+            }
+            else
+            {
+                condition_.wait(lock, [&] { return generation != generation_; });
+            }
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable condition_;
+
+        int count_;
+        int waiting_;
+        int generation_;
+    };
+}
+
+HarmonicField::HarmonicField()
+: bounds_(MPAABoxMake(MPVec3Zero, MPVec3Zero)), resolution_(0.0f), rowLength_(0), hasGoal_(false), smoothing_(false), converged_(false)
+{
+    dims_[0] = dims_[1] = dims_[2] = 0;
+    goal_[0] = goal_[1] = goal_[2] = 0;
+}
+
+void HarmonicField::setGrid(const MPAABox &bounds, float resolution)
+{
+    clear();
+
+    if(resolution <= 0.0f) return;
+
+    bounds_ = bounds;
+    resolution_ = resolution;
+
+    // at least one interior node along each axis
+    for(int a = 0; a < 3; ++a)
+    {
+        dims_[a] = std::max(3, (int)std::ceil((bounds.max.v[a] - bounds.min.v[a]) / resolution) + 1);
+        bounds_.max.v[a] = bounds.min.v[a] + (dims_[a] - 1) * resolution;
+    }
+
+    // one pad in front of each row, and enough behind it for a sweep to run a pair past the end
+    rowLength_ = (dims_[2] + 1) / 2 + 4;
+
+    size_t size = (size_t)dims_[0] * dims_[1] * rowLength_;
+
+    for(int c = 0; c < 2; ++c)
+    {
+        values_[c].assign(size, 0.0);
+        free_[c].assign(size, 0.0);
+    }
+
+    blocked_.assign((size_t)dims_[0] * dims_[1] * dims_[2], 0);
+
+    for(int i = 1; i < dims_[0] - 1; ++i)
+    {
+        for(int j = 1; j < dims_[1] - 1; ++j)
+        {
+            for(int k = 1; k < dims_[2] - 1; ++k)
+            {
+                free_[color(i, j, k)][index(i, j, k)] = 1.0;
+            }
+        }
+    }
+}
+
+void HarmonicField::clear()
+{
+    for(int c = 0; c < 2; ++c)
+    {
+        values_[c].clear();
+        free_[c].clear();
+    }
+
+    blocked_.clear();
+    footprints_.clear();
+
+    dims_[0] = dims_[1] = dims_[2] = 0;
+    rowLength_ = 0;
+
+    hasGoal_ = false;
+    smoothing_ = false;
+    converged_ = false;
+}
+
+void HarmonicField::setGoal(const MPVec3 &goal)
+{
+    if(!isBuilt()) return;
+
+    if(hasGoal_)
+    {
+        hasGoal_ = false;
+        updateNode(goal_[0], goal_[1], goal_[2]);
+    }
+
+    // the nearest interior node, since the boundary is always fixed at 0
+    for(int a = 0; a < 3; ++a)
+    {
+        int n = (int)std::floor((goal.v[a] - bounds_.min.v[a]) / resolution_ + 0.5f);
+        goal_[a] = std::min(std::max(n, 1), dims_[a] - 2);
+    }
+
+    hasGoal_ = true;
+    updateNode(goal_[0], goal_[1], goal_[2]);
+}
+
+int HarmonicField::addObstacle()
+{
+    footprints_.push_back(std::vector<int>());
+
+    return (int)footprints_.size() - 1;
+}
+
+void HarmonicField::setObstacle(int obstacle, const std::vector<MPVec3> &points, float clearance)
+{
+    if(!isBuilt()) return;
+
+    std::vector<int> previous;
+    previous.swap(footprints_[obstacle]);
+
+    std::vector<int> &footprint = footprints_[obstacle];
+
+    int reach = (int)std::ceil(clearance / resolution_);
+    float clearance2 = clearance * clearance;
+
+    for(const MPVec3 &p : points)
+    {
+        int center[3], min[3], max[3];
+
+        for(int a = 0; a < 3; ++a)
+        {
+            center[a] = (int)std::floor((p.v[a] - bounds_.min.v[a]) / resolution_ + 0.5f);
+            min[a] = std::max(center[a] - reach, 0);
+            max[a] = std::min(center[a] + reach, dims_[a] - 1);
+        }
+
+        for(int i = min[0]; i <= max[0]; ++i)
+        {
+            for(int j = min[1]; j <= max[1]; ++j)
+            {
+                for(int k = min[2]; k <= max[2]; ++k)
+                {
+                    MPVec3 q = MPVec3Make(bounds_.min.x + i * resolution_,
+                                          bounds_.min.y + j * resolution_,
+                                          bounds_.min.z + k * resolution_);
+
+                    MPVec3 d = MPVec3Subtract(q, p);
+
+                    if(MPVec3DotProduct(d, d) <= clearance2)
+                    {
+                        footprint.push_back((i * dims_[1] + j) * dims_[2] + k);
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(footprint.begin(), footprint.end());
+    footprint.erase(std::unique(footprint.begin(), footprint.end()), footprint.end());
+
+    // count the new footprint in before the old one out, so nodes in both never look unblocked
+    std::vector<int> changed;
+
+    for(int n : footprint)
+    {
+        if(blocked_[n]++ == 0) changed.push_back(n);
+    }
+
+    for(int n : previous)
+    {
+        if(--blocked_[n] == 0) changed.push_back(n);
+    }
+
+    for(int n : changed)
+    {
+        int k = n % dims_[2];
+        int j = (n / dims_[2]) % dims_[1];
+        int i = n / (dims_[2] * dims_[1]);
+
+        updateNode(i, j, k);
+    }
+}
+
+int HarmonicField::relax(int maxSweeps, double tolerance)
+{
+    if(!isBuilt() || converged_ || maxSweeps <= 0) return 0;
+
+    // the optimal over-relaxation factor for Laplace's equation on a grid this size
+    int n = std::max(std::max(dims_[0], dims_[1]), dims_[2]);
+    double optimal = 2.0 / (1.0 + sin(M_PI / n));
+
+    int numSlabs = dims_[0] - 2;
+
+    int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    numThreads = std::max(1, std::min(numThreads, numSlabs / MP_MIN_SLABS_PER_THREAD));
+
+    // over-relaxation quickly settles the potential to within rounding of its largest values, but
+    // leaves the smallest (far from the goal, where the direction matters just as much) at a floor
+    // of rounding noise. plain Gauss-Seidel sweeps then settle every value relative to itself.
+    auto done = [tolerance](const double change[2], bool &smoothing)
+    {
+        if(!smoothing)
+        {
+            smoothing = change[0] <= tolerance;
+            return false;
+        }
+
+        return change[1] <= tolerance;
+    };
+
+    if(numThreads == 1)
+    {
+        for(int s = 0; s < maxSweeps; ++s)
+        {
+            double omega = smoothing_ ? 1.0 : optimal;
+            double change[2] = { 0.0, 0.0 };
+
+            sweep(0, 1, numSlabs + 1, omega, change);
+            sweep(1, 1, numSlabs + 1, omega, change);
+
+            if(done(change, smoothing_))
+            {
+                converged_ = true;
+                return s + 1;
+            }
+        }
+
+        return maxSweeps;
+    }
+
+    // each thread relaxes a set of whole i-slabs. the nodes of one color only depend on the
+    // other color, so threads just have to wait for each other between half-sweeps. the largest
+    // changes are double buffered so a thread can't overwrite one another is still reading.
+    Barrier barrier(numThreads);
+    std::vector<double> changes[2] = { std::vector<double>(2 * numThreads), std::vector<double>(2 * numThreads) };
+
+    int slabsPerThread = (numSlabs + numThreads - 1) / numThreads;
+    int sweeps = maxSweeps;
+    bool smoothing = smoothing_;
+    bool finished = false;
+
+    auto work = [&](int t)
+    {
+        int first = 1 + t * slabsPerThread;
+        int last = std::min(numSlabs + 1, first + slabsPerThread);
+
+        // every thread comes to the same decisions from the same changes
+        bool threadSmoothing = smoothing;
+
+        for(int s = 0; s < maxSweeps; ++s)
+        {
+            double omega = threadSmoothing ? 1.0 : optimal;
+            double *change = &changes[s & 1][2 * t];
+            change[0] = change[1] = 0.0;
+
+            sweep(0, first, last, omega, change);
+            barrier.wait();
+
+            sweep(1, first, last, omega, change);
+            barrier.wait();
+
+            double largest[2] = { 0.0, 0.0 };
+
+            for(int u = 0; u < numThreads; ++u)
+            {
+                largest[0] = std::max(largest[0], changes[s & 1][2 * u]);
+                largest[1] = std::max(largest[1], changes[s & 1][2 * u + 1]);
+            }
+
+            if(done(largest, threadSmoothing))
+            {
+                if(t == 0)
+                {
+                    sweeps = s + 1;
+                    finished = true;
+                }
+
+                break;
+            }
+        }
+
+        if(t == 0) smoothing = threadSmoothing;
+    };
+
+    std::vector<std::thread> workers;
+
+    for(int t = 1; t < numThreads; ++t)
+    {
+        workers.push_back(std::thread(work, t));
+    }
+
+    work(0);
+
+    for(auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    smoothing_ = smoothing;
+    converged_ = finished;
+
+    return sweeps;
+}
+
+double HarmonicField::value(const MPVec3 &p) const
+{
+    if(!isBuilt()) return 1.0;
+
+    int c[3];
+    double t[3];
+    locate(p, c, t);
+
+    double v[2][2];
+
+    for(int a = 0; a < 2; ++a)
+    {
+        for(int b = 0; b < 2; ++b)
+        {
+            v[a][b] = node(c[0] + a, c[1] + b, c[2]) * (1.0 - t[2]) + node(c[0] + a, c[1] + b, c[2] + 1) * t[2];
+        }
+    }
+
+    double v0 = v[0][0] * (1.0 - t[1]) + v[0][1] * t[1];
+    double v1 = v[1][0] * (1.0 - t[1]) + v[1][1] * t[1];
+
+    return v0 * (1.0 - t[0]) + v1 * t[0];
+}
+
+MPVec3 HarmonicField::direction(const MPVec3 &p) const
+{
+    if(!isBuilt()) return MPVec3Zero;
+
+    int c[3];
+    double t[3];
+    locate(p, c, t);
+
+    double s[2][2][2];
+    for(int a = 0; a < 2; ++a)
+        for(int b = 0; b < 2; ++b)
+            for(int d = 0; d < 2; ++d)
+                s[a][b][d] = node(c[0] + a, c[1] + b, c[2] + d);
+
+    // partial derivatives of the trilinear interpolant, kept in double precision since far from
+    // the goal the potential only differs from 1 in the last few digits
+    double grad[3] = { 0.0, 0.0, 0.0 };
+
+    for(int b = 0; b < 2; ++b)
+    {
+        for(int d = 0; d < 2; ++d)
+        {
+            double wb = b ? t[1] : 1.0 - t[1];
+            double wd = d ? t[2] : 1.0 - t[2];
+            grad[0] += (s[1][b][d] - s[0][b][d]) * wb * wd;
+        }
+    }
+
+    for(int a = 0; a < 2; ++a)
+    {
+        for(int d = 0; d < 2; ++d)
+        {
+            double wa = a ? t[0] : 1.0 - t[0];
+            double wd = d ? t[2] : 1.0 - t[2];
+            grad[1] += (s[a][1][d] - s[a][0][d]) * wa * wd;
+        }
+    }
+
+    for(int a = 0; a < 2; ++a)
+    {
+        for(int b = 0; b < 2; ++b)
+        {
+            double wa = a ? t[0] : 1.0 - t[0];
+            double wb = b ? t[1] : 1.0 - t[1];
+            grad[2] += (s[a][b][1] - s[a][b][0]) * wa * wb;
+        }
+    }
+
+    double length = sqrt(grad[0] * grad[0] + grad[1] * grad[1] + grad[2] * grad[2]);
+
+    if(length == 0.0) return MPVec3Zero;
+
+    return MPVec3Make(grad[0] / length, grad[1] / length, grad[2] / length);
+}
+
+void HarmonicField::updateNode(int i, int j, int k)
+{
+    int c = color(i, j, k);
+    size_t n = index(i, j, k);
+
+    bool boundary = i == 0 || j == 0 || k == 0 || i == dims_[0] - 1 || j == dims_[1] - 1 || k == dims_[2] - 1;
+    bool goal = hasGoal_ && i == goal_[0] && j == goal_[1] && k == goal_[2];
+
+    if(goal)
+    {
+        values_[c][n] = 1.0;
+        free_[c][n] = 0.0;
+    }
+    else if(boundary || blocked_[(i * dims_[1] + j) * dims_[2] + k] > 0)
+    {
+        values_[c][n] = 0.0;
+        free_[c][n] = 0.0;
+    }
+    else
+    {
+        // a node that was fixed keeps its value as the starting point for relaxing it
+        free_[c][n] = 1.0;
+    }
+
+    smoothing_ = false;
+    converged_ = false;
+}
+
+void HarmonicField::sweep(int c, int firstSlab, int lastSlab, double omega, double change[2])
+{
+    const double *other = values_[1 - c].data();
+    const double *mask = free_[c].data();
+    double *u = values_[c].data();
+
+    const double sixth = 1.0 / 6.0;
+
+#if MP_SIMD_SSE
+    __m128d omega2 = _mm_set1_pd(omega);
+    __m128d sixth2 = _mm_set1_pd(sixth);
+    __m128d signMask = _mm_set1_pd(-0.0);
+    __m128d absolute2 = _mm_setzero_pd();
+    __m128d relative2 = _mm_setzero_pd();
+#endif
+
+    for(int i = firstSlab; i < lastSlab; ++i)
+    {
+        for(int j = 1; j < dims_[1] - 1; ++j)
+        {
+            // nodes of this color sit at k = 2m + q in this row, so their neighbors along k are the
+            // other color's m - 1 + q and m + q, and their neighbors in adjacent rows are at m
+            int q = c ^ ((i + j) & 1);
+            int count = (dims_[2] - q + 1) / 2;
+
+            size_t base = index(i, j, 0);
+
+            const double *left = other + base - 1 + q;
+            const double *right = other + base + q;
+            const double *down = other + index(i, j - 1, 0);
+            const double *up = other + index(i, j + 1, 0);
+            const double *back = other + index(i - 1, j, 0);
+            const double *front = other + index(i + 1, j, 0);
+
+            const double *f = mask + base;
+            double *row = u + base;
+
+            int m = 0;
+
+#if MP_SIMD_SSE
+            // fixed nodes and the padding have a mask of 0, so running a pair past the end is harmless
+            for(; m < count; m += 2)
+            {
+                __m128d sum = _mm_add_pd(_mm_add_pd(_mm_loadu_pd(left + m), _mm_loadu_pd(right + m)),
+                                         _mm_add_pd(_mm_loadu_pd(down + m), _mm_loadu_pd(up + m)));
+                sum = _mm_add_pd(sum, _mm_add_pd(_mm_loadu_pd(back + m), _mm_loadu_pd(front + m)));
+
+                __m128d value = _mm_loadu_pd(row + m);
+                __m128d delta = _mm_mul_pd(_mm_mul_pd(omega2, _mm_loadu_pd(f + m)), _mm_sub_pd(_mm_mul_pd(sum, sixth2), value));
+
+                value = _mm_add_pd(value, delta);
+                _mm_storeu_pd(row + m, value);
+
+                // fixed nodes of 0 give 0 / 0, and max returns its second operand when either is NaN
+                delta = _mm_andnot_pd(signMask, delta);
+                absolute2 = _mm_max_pd(absolute2, delta);
+                relative2 = _mm_max_pd(_mm_div_pd(delta, _mm_andnot_pd(signMask, value)), relative2);
+            }
+#endif
+
+            for(; m < count; ++m)
+            {
+                double sum = ((left[m] + right[m]) + (down[m] + up[m])) + (back[m] + front[m]);
+                double delta = omega * f[m] * (sum * sixth - row[m]);
+
+                row[m] += delta;
+
+                if(delta != 0.0)
+                {
+                    change[0] = std::max(change[0], std::abs(delta));
+                    change[1] = std::max(change[1], std::abs(delta / row[m]));
+                }
+            }
+        }
+    }
+
+#if MP_SIMD_SSE
+    double lanes[2];
+
+    _mm_storeu_pd(lanes, absolute2);
+    change[0] = std::max(change[0], std::max(lanes[0], lanes[1]));
+
+    _mm_storeu_pd(lanes, relative2);
+    change[1] = std::max(change[1], std::max(lanes[0], lanes[1]));
+#endif
+}
+
+void HarmonicField::locate(const MPVec3 &p, int cell[3], double t[3]) const
+{
+    for(int a = 0; a < 3; ++a)
+    {
+        double u = (p.v[a] - bounds_.min.v[a]) / resolution_;
+
+        cell[a] = std::min(std::max((int)std::floor(u), 0), dims_[a] - 2);
+        t[a] = std::min(std::max(u - cell[a], 0.0), 1.0);
+    }
+}
+
+}
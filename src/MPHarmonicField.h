@@ -0,0 +1,108 @@
+//
+//  MPHarmonicField.h
+//
+//  A harmonic potential on a regular grid: 0 on the boundary and at nodes blocked by obstacles,
+//  1 at the goal, and the solution of Laplace's equation everywhere else. A harmonic function
+//  has no local extrema away from its boundary, so climbing it reaches the goal from any free
+//  node connected to it (Connolly, Burns and Weiss, Path Planning Using Laplace's Equation).
+//  The potential decays exponentially along corridors, so it is kept this way up (rather than
+//  0 at the goal and 1 elsewhere) where doubles resolve it to its smallest values.
+
+#ifndef __MPHarmonicField__
+#define __MPHarmonicField__
+
+#include <vector>
+#include "MPMath.h"
+
+namespace MP
+{
+
+class HarmonicField
+{
+public:
+    HarmonicField();
+
+    /* covers bounds with nodes spaced resolution apart, with no obstacles and no goal */
+    void setGrid(const MPAABox &bounds, float resolution);
+
+    void clear();
+
+    bool isBuilt() const { return !values_[0].empty(); }
+
+    MPAABox getBounds() const { return bounds_; }
+
+    float getResolution() const { return resolution_; }
+
+    /* fixes the node nearest the goal at 1 */
+    void setGoal(const MPVec3 &goal);
+
+    /* returns the index of a new obstacle, which blocks nothing until it is given points */
+    int addObstacle();
+
+    /* the obstacle now blocks every node within clearance of one of the points, and only those.
+     * only the nodes it blocked before and blocks now are touched. */
+    void setObstacle(int obstacle, const std::vector<MPVec3> &points, float clearance);
+
+    /* performs red-black successive over-relaxation sweeps, starting from the current values,
+     * until no value changes by more than tolerance times its own size in a sweep or maxSweeps
+     * is reached. returns the number of sweeps performed. successive calls pick up where the
+     * last left off. */
+    int relax(int maxSweeps, double tolerance);
+
+    /* true once a sweep changed no value by more than the tolerance, and nothing changed since */
+    bool isConverged() const { return converged_; }
+
+    /* trilinearly interpolated potential at p, clamped to the grid */
+    double value(const MPVec3 &p) const;
+
+    /* the unit direction of steepest ascent of the interpolated potential at p, or zero where
+     * the potential is flat (e.g. where no free path leads to the goal) */
+    MPVec3 direction(const MPVec3 &p) const;
+
+private:
+    /* nodes are stored by color ((i + j + k) % 2), and rows of each color are compressed to
+     * every other k, so that a sweep over one color reads neighbors from contiguous runs of the
+     * other. rows are padded on both ends. */
+    size_t index(int i, int j, int k) const { return (size_t)(i * dims_[1] + j) * rowLength_ + (k >> 1) + 1; }
+
+    int color(int i, int j, int k) const { return (i + j + k) & 1; }
+
+    double node(int i, int j, int k) const { return values_[color(i, j, k)][index(i, j, k)]; }
+
+    /* recomputes whether a node is fixed, and its value if it is */
+    void updateNode(int i, int j, int k);
+
+    /* relaxes the nodes of one color in i-slabs [firstSlab, lastSlab), raising change[0] to the
+     * largest change and change[1] to the largest change relative to the new value */
+    void sweep(int color, int firstSlab, int lastSlab, double omega, double change[2]);
+
+    /* finds the cell containing p (clamped to the grid) and the offsets in [0, 1] of p within the cell */
+    void locate(const MPVec3 &p, int cell[3], double t[3]) const;
+
+    MPAABox bounds_;
+    float resolution_;
+
+    int dims_[3];
+    int rowLength_;
+
+    /* per color: node values, and 1 for free nodes or 0 for fixed ones */
+    std::vector<double> values_[2];
+    std::vector<double> free_[2];
+
+    /* per node (i * dims_[1] + j) * dims_[2] + k: the number of obstacles blocking it */
+    std::vector<unsigned short> blocked_;
+
+    /* per obstacle: the nodes it blocks */
+    std::vector<std::vector<int> > footprints_;
+
+    int goal_[3];
+    bool hasGoal_;
+
+    /* true once over-relaxation has settled the potential, and only plain sweeps are needed */
+    bool smoothing_;
+    bool converged_;
+};
+
+}
+
+#endif
@@ -9,8 +9,16 @@
 #define _MPMath_h
 
 #include <math.h>
+#include <stddef.h>
 #include "MPFloat.h"
 
+// SSE2 is part of every x86-64 target, so it needs no build flags. define MP_NO_SIMD to use the
+// scalar versions everywhere. wider paths are taken when the compiler is told it may use AVX.
+#if defined(__SSE2__) && !defined(MP_NO_SIMD)
+#include <immintrin.h>
+#define MP_SIMD_SSE 1
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -46,6 +54,15 @@ typedef struct _MPAABox
     MPVec3 max;
 } MPAABox;
     
+/* a box with its own orientation, given by its center and three half-axes (from the center to
+   the middle of a face). the half-axes are orthogonal when the box is built, but a transform
+   with non-uniform scale can skew them, so they are not assumed to be. */
+typedef struct _MPOBox
+{
+    MPVec3 center;
+    MPVec3 halfAxes[3];
+} MPOBox;
+    
 typedef union _MPTriangle
 {
     struct {MPVec3 v1, v2, v3;};
@@ -160,6 +177,11 @@ static inline MPQuaternion MPQuaternionMake(float x, float y, float z, float w)
     return q;
 }
 
+static inline int MPQuaternionEqualToQuaternion(MPQuaternion q1, MPQuaternion q2)
+{
+    return (q1.q[0] == q2.q[0] && q1.q[1] == q2.q[1] && q1.q[2] == q2.q[2] && q1.q[3] == q2.q[3]);
+}
+
 static inline MPQuaternion MPQuaternionMakeWithAngleAndAxis(float angle, float x, float y, float z)
 {
     float half = 0.5f * angle;
@@ -189,18 +211,86 @@ static inline MPQuaternion MPQuaternionInvert(MPQuaternion q)
 
 static inline MPQuaternion MPQuaternionMultiply(MPQuaternion q1, MPQuaternion q2)
 {
+#if MP_SIMD_SSE
+    // q1.w * q2 + q1.x * (w, -z, y, -x) + q1.y * (z, w, -x, -y) + q1.z * (-y, x, w, -z)
+    __m128 a = _mm_loadu_ps(q1.q), b = _mm_loadu_ps(q2.q);
+    
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+    
+    __m128 t = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)), _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), t));
+    
+    t = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)), _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), t));
+    
+    t = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), t));
+    
+    MPQuaternion q;
+    _mm_store_ps(q.q, r);
+    
+    return q;
+#else
     return MPQuaternionMake(q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
                             q1.w * q2.y + q1.y * q2.w + q1.z * q2.x - q1.x * q2.z,
                             q1.w * q2.z + q1.z * q2.w + q1.x * q2.y - q1.y * q2.x,
                             q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z);
+#endif
 }
 
 static inline MPVec3 MPQuaternionRotateVec3(MPQuaternion q, MPVec3 v)
 {
-    MPQuaternion rq = MPQuaternionMake(v.x, v.y, v.z, 0.0f);
-    rq = MPQuaternionMultiply(MPQuaternionMultiply(q, rq), MPQuaternionInvert(q));
+    // q v q^-1 expanded: v + 2 (w (u x v) + u x (u x v)) / |q|^2, where u is the vector part
+    MPVec3 u = MPVec3Make(q.x, q.y, q.z);
+    float s = 2.0f / (q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    
+    MPVec3 uv = MPVec3Make(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x);
+    MPVec3 uuv = MPVec3Make(u.y * uv.z - u.z * uv.y, u.z * uv.x - u.x * uv.z, u.x * uv.y - u.y * uv.x);
+    
+    return MPVec3Make(v.x + s * (q.w * uv.x + uuv.x),
+                      v.y + s * (q.w * uv.y + uuv.y),
+                      v.z + s * (q.w * uv.z + uuv.z));
+}
+
+static inline float MPQuaternionDotProduct(MPQuaternion q1, MPQuaternion q2)
+{
+    return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+}
+    
+/* returns the angle of the (shortest) rotation taking unit quaternion q1 to q2 */
+static inline float MPQuaternionAngle(MPQuaternion q1, MPQuaternion q2)
+{
+    float d = fminf(fabsf(MPQuaternionDotProduct(q1, q2)), 1.0f);
+    
+    return 2.0f * acosf(d);
+}
+    
+/* spherical linear interpolation between unit quaternions, along the shortest arc */
+static inline MPQuaternion MPQuaternionSlerp(MPQuaternion q1, MPQuaternion q2, float t)
+{
+    float d = MPQuaternionDotProduct(q1, q2);
+    
+    if (d < 0.0f)
+    {
+        q2 = MPQuaternionMake(-q2.x, -q2.y, -q2.z, -q2.w);
+        d = -d;
+    }
+    
+    float s1 = 1.0f - t;
+    float s2 = t;
+    
+    // fall back to a normalized lerp when the quaternions are nearly equal
+    if (d < 0.9995f)
+    {
+        float angle = acosf(d);
+        float invSin = 1.0f / sinf(angle);
+        
+        s1 = sinf(s1 * angle) * invSin;
+        s2 = sinf(s2 * angle) * invSin;
+    }
     
-    return MPVec3Make(rq.x, rq.y, rq.z);
+    return MPQuaternionNormalize(MPQuaternionMake(s1 * q1.x + s2 * q2.x, s1 * q1.y + s2 * q2.y,
+                                                  s1 * q1.z + s2 * q2.z, s1 * q1.w + s2 * q2.w));
 }
     
 static inline void MPQuaternionToRPY(MPQuaternion q, float *r, float *p, float *y)
@@ -301,13 +391,33 @@ static inline MPMat4 MPMat4Multiply(MPMat4 left, MPMat4 right)
 {
     MPMat4 m;
     
+#if MP_SIMD_SSE
+    // each column of the product is the left columns weighted by a column of right
+    __m128 c0 = _mm_loadu_ps(&left.m[0]);
+    __m128 c1 = _mm_loadu_ps(&left.m[4]);
+    __m128 c2 = _mm_loadu_ps(&left.m[8]);
+    __m128 c3 = _mm_loadu_ps(&left.m[12]);
+    
+    int j;
+    for (j = 0; j < 4; ++j)
+    {
+        const float *r = &right.m[4 * j];
+        
+        __m128 col = _mm_mul_ps(c0, _mm_set1_ps(r[0]));
+        col = _mm_add_ps(col, _mm_mul_ps(c1, _mm_set1_ps(r[1])));
+        col = _mm_add_ps(col, _mm_mul_ps(c2, _mm_set1_ps(r[2])));
+        col = _mm_add_ps(col, _mm_mul_ps(c3, _mm_set1_ps(r[3])));
+        
+        _mm_storeu_ps(&m.m[4 * j], col);
+    }
+#else
     m.m[0]  = left.m00 * right.m00 + left.m10 * right.m01 + left.m20 * right.m02 + left.m30 * right.m03;
 	m.m[4]  = left.m00 * right.m10 + left.m10 * right.m11 + left.m20 * right.m12 + left.m30 * right.m13;
-	m.m[8]  = left.m00 * right.m20 + left.m10 * right.m12 + left.m20 * right.m22 + left.m30 * right.m23;
-	m.m[12] = left.m00 * right.m30 + left.m10 * right.m13 + left.m20 * right.m32 + left.m30 * right.m33;
+	m.m[8]  = left.m00 * right.m20 + left.m10 * right.m21 + left.m20 * right.m22 + left.m30 * right.m23;
+	m.m[12] = left.m00 * right.m30 + left.m10 * right.m31 + left.m20 * right.m32 + left.m30 * right.m33;
     
 	m.m[1]  = left.m01 * right.m00 + left.m11 * right.m01 + left.m21 * right.m02 + left.m31 * right.m03;
-	m.m[5]  = left.m01 * right.m10 + left.m11 * right.m11 + left.m21 * right.m12 + left.m31 * right.m12;
+	m.m[5]  = left.m01 * right.m10 + left.m11 * right.m11 + left.m21 * right.m12 + left.m31 * right.m13;
 	m.m[9]  = left.m01 * right.m20 + left.m11 * right.m21 + left.m21 * right.m22 + left.m31 * right.m23;
 	m.m[13] = left.m01 * right.m30 + left.m11 * right.m31 + left.m21 * right.m32 + left.m31 * right.m33;
     
@@ -320,6 +430,7 @@ static inline MPMat4 MPMat4Multiply(MPMat4 left, MPMat4 right)
 	m.m[7]  = left.m03 * right.m10 + left.m13 * right.m11 + left.m23 * right.m12 + left.m33 * right.m13;
 	m.m[11] = left.m03 * right.m20 + left.m13 * right.m21 + left.m23 * right.m22 + left.m33 * right.m23;
 	m.m[15] = left.m03 * right.m30 + left.m13 * right.m31 + left.m23 * right.m32 + left.m33 * right.m33;
+#endif
     
     return m;
 }
@@ -328,18 +439,144 @@ static inline MPVec3 MPMat4TransformVec3(MPMat4 m, MPVec3 v)
 {
     MPVec3 mv;
     
+#if MP_SIMD_SSE
+    __m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m.m[0]), _mm_set1_ps(v.v[0])), _mm_loadu_ps(&m.m[12]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m.m[4]), _mm_set1_ps(v.v[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m.m[8]), _mm_set1_ps(v.v[2])));
+    
+    float out[4] __attribute__((aligned(16)));
+    _mm_store_ps(out, r);
+    
+    mv.v[0] = out[0]; mv.v[1] = out[1]; mv.v[2] = out[2];
+#else
     mv.v[0] = m.m00 * v.v[0] + m.m10 * v.v[1] + m.m20 * v.v[2] + m.m30;
     mv.v[1] = m.m01 * v.v[0] + m.m11 * v.v[1] + m.m21 * v.v[2] + m.m31;
     mv.v[2] = m.m02 * v.v[0] + m.m12 * v.v[1] + m.m22 * v.v[2] + m.m32;
+#endif
     
     return mv;
 }
     
+/* transforms count points. in and out may be the same array. */
+static inline void MPMat4TransformVec3Array(MPMat4 m, const MPVec3 *in, MPVec3 *out, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; ++i)
+    {
+        out[i] = MPMat4TransformVec3(m, in[i]);
+    }
+}
+    
+/* transforms count points stored as separate coordinate arrays. the inputs and outputs may be
+   the same arrays. this layout lets several points be transformed at once. */
+static inline void MPMat4TransformPoints(MPMat4 m, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count)
+{
+    size_t i = 0;
+    
+#if MP_SIMD_SSE && defined(__AVX__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        
+        __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m00), px), _mm256_mul_ps(_mm256_set1_ps(m.m10), py)),
+                                  _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m20), pz), _mm256_set1_ps(m.m30)));
+        __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m01), px), _mm256_mul_ps(_mm256_set1_ps(m.m11), py)),
+                                  _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m21), pz), _mm256_set1_ps(m.m31)));
+        __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m02), px), _mm256_mul_ps(_mm256_set1_ps(m.m12), py)),
+                                  _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m22), pz), _mm256_set1_ps(m.m32)));
+        
+        _mm256_storeu_ps(outX + i, rx);
+        _mm256_storeu_ps(outY + i, ry);
+        _mm256_storeu_ps(outZ + i, rz);
+    }
+#endif
+    
+#if MP_SIMD_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m00), px), _mm_mul_ps(_mm_set1_ps(m.m10), py)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m20), pz), _mm_set1_ps(m.m30)));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m01), px), _mm_mul_ps(_mm_set1_ps(m.m11), py)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m21), pz), _mm_set1_ps(m.m31)));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m02), px), _mm_mul_ps(_mm_set1_ps(m.m12), py)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m22), pz), _mm_set1_ps(m.m32)));
+        
+        _mm_storeu_ps(outX + i, rx);
+        _mm_storeu_ps(outY + i, ry);
+        _mm_storeu_ps(outZ + i, rz);
+    }
+#endif
+    
+    for (; i < count; ++i)
+    {
+        float px = x[i], py = y[i], pz = z[i];
+        
+        outX[i] = m.m00 * px + m.m10 * py + m.m20 * pz + m.m30;
+        outY[i] = m.m01 * px + m.m11 * py + m.m21 * pz + m.m31;
+        outZ[i] = m.m02 * px + m.m12 * py + m.m22 * pz + m.m32;
+    }
+}
+    
 static inline void MPVec3ApplyTransform(MPVec3 *v, MPMat4 t)
 {
     *v = MPMat4TransformVec3(t, *v);
 }
 
+/* returns the largest factor by which the transform stretches any vector */
+static inline float MPMat4MaxScale(MPMat4 m)
+{
+    float sx = m.m00 * m.m00 + m.m01 * m.m01 + m.m02 * m.m02;
+    float sy = m.m10 * m.m10 + m.m11 * m.m11 + m.m12 * m.m12;
+    float sz = m.m20 * m.m20 + m.m21 * m.m21 + m.m22 * m.m22;
+    
+    return sqrtf(fmaxf(fmaxf(sx, sy), sz));
+}
+    
+/* returns the smallest factor by which the transform shrinks any vector. assumes no shear. */
+static inline float MPMat4MinScale(MPMat4 m)
+{
+    float sx = m.m00 * m.m00 + m.m01 * m.m01 + m.m02 * m.m02;
+    float sy = m.m10 * m.m10 + m.m11 * m.m11 + m.m12 * m.m12;
+    float sz = m.m20 * m.m20 + m.m21 * m.m21 + m.m22 * m.m22;
+    
+    return sqrtf(fminf(fminf(sx, sy), sz));
+}
+    
+/* returns the inverse of a transform made of rotation, scale and translation (no projection). */
+static inline MPMat4 MPMat4InvertAffine(MPMat4 m)
+{
+    // inverse of the upper 3x3 is its adjugate over its determinant
+    float c00 = m.m11 * m.m22 - m.m21 * m.m12;
+    float c01 = m.m21 * m.m02 - m.m01 * m.m22;
+    float c02 = m.m01 * m.m12 - m.m11 * m.m02;
+    
+    float det = m.m00 * c00 + m.m10 * c01 + m.m20 * c02;
+    float invDet = 1.0f / det;
+    
+    MPMat4 inv = MPMat4Identity;
+    
+    inv.m00 = c00 * invDet;
+    inv.m01 = c01 * invDet;
+    inv.m02 = c02 * invDet;
+    
+    inv.m10 = (m.m20 * m.m12 - m.m10 * m.m22) * invDet;
+    inv.m11 = (m.m00 * m.m22 - m.m20 * m.m02) * invDet;
+    inv.m12 = (m.m10 * m.m02 - m.m00 * m.m12) * invDet;
+    
+    inv.m20 = (m.m10 * m.m21 - m.m20 * m.m11) * invDet;
+    inv.m21 = (m.m20 * m.m01 - m.m00 * m.m21) * invDet;
+    inv.m22 = (m.m00 * m.m11 - m.m10 * m.m01) * invDet;
+    
+    // then undo the translation
+    inv.m30 = -(inv.m00 * m.m30 + inv.m10 * m.m31 + inv.m20 * m.m32);
+    inv.m31 = -(inv.m01 * m.m30 + inv.m11 * m.m31 + inv.m21 * m.m32);
+    inv.m32 = -(inv.m02 * m.m30 + inv.m12 * m.m31 + inv.m22 * m.m32);
+    
+    return inv;
+}
+
 #pragma mark - sphere functions
 
 static inline MPSphere MPSphereMake(MPVec3 center, float radius)
@@ -355,6 +592,24 @@ static inline int MPSphereIntersectsSphere(MPSphere s1, MPSphere s2)
     return MPVec3EuclideanDistance(s1.center, s2.center) <= s1.radius + s2.radius;
 }
     
+/* returns the sphere under the transform. the radius grows with the largest scale, so the
+   result still encloses whatever the sphere did. */
+static inline MPSphere MPSphereTransform(MPSphere s, MPMat4 m)
+{
+    return MPSphereMake(MPMat4TransformVec3(m, s.center), s.radius * MPMat4MaxScale(m));
+}
+    
+/* the same as MPSphereTransform for the matrix translate * rotate * scale, without building it. */
+static inline MPSphere MPSphereTransformTRS(MPSphere s, MPVec3 position, MPQuaternion rotation, MPVec3 scale)
+{
+    MPVec3 center = MPVec3Make(s.center.x * scale.x, s.center.y * scale.y, s.center.z * scale.z);
+    center = MPVec3Add(MPQuaternionRotateVec3(rotation, center), position);
+    
+    float maxScale = fmaxf(fmaxf(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+    
+    return MPSphereMake(center, s.radius * maxScale);
+}
+    
 #pragma mark - axis aligned box functions
     
 static inline MPAABox MPAABoxMake(MPVec3 min, MPVec3 max)
@@ -381,6 +636,110 @@ static inline int MPAABoxIntersectsBox(MPAABox b1, MPAABox b2)
            b1.min.z < b2.max.z);
 }
     
+static inline MPVec3 MPAABoxClosestPoint(MPAABox b, MPVec3 p)
+{
+    return MPVec3Make(fminf(fmaxf(p.x, b.min.x), b.max.x),
+                      fminf(fmaxf(p.y, b.min.y), b.max.y),
+                      fminf(fmaxf(p.z, b.min.z), b.max.z));
+}
+    
+#pragma mark - oriented box functions
+    
+static inline MPOBox MPOBoxMakeWithAABox(MPAABox b)
+{
+    MPOBox o;
+    o.center = MPVec3MultiplyScalar(MPVec3Add(b.min, b.max), 0.5f);
+    o.halfAxes[0] = MPVec3Make(0.5f * (b.max.x - b.min.x), 0.0f, 0.0f);
+    o.halfAxes[1] = MPVec3Make(0.0f, 0.5f * (b.max.y - b.min.y), 0.0f);
+    o.halfAxes[2] = MPVec3Make(0.0f, 0.0f, 0.5f * (b.max.z - b.min.z));
+    
+    return o;
+}
+    
+/* returns the box under the transform. since the half-axes may skew, the result is exact. */
+static inline MPOBox MPOBoxTransform(MPOBox b, MPMat4 m)
+{
+    MPOBox o;
+    o.center = MPMat4TransformVec3(m, b.center);
+    
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        MPVec3 a = b.halfAxes[i];
+        
+        o.halfAxes[i] = MPVec3Make(m.m00 * a.x + m.m10 * a.y + m.m20 * a.z,
+                                   m.m01 * a.x + m.m11 * a.y + m.m21 * a.z,
+                                   m.m02 * a.x + m.m12 * a.y + m.m22 * a.z);
+    }
+    
+    return o;
+}
+    
+/* the same as MPOBoxTransform for the matrix translate * rotate * scale, without building it. */
+static inline MPOBox MPOBoxTransformTRS(MPOBox b, MPVec3 position, MPQuaternion rotation, MPVec3 scale)
+{
+    MPOBox o;
+    o.center = MPVec3Make(b.center.x * scale.x, b.center.y * scale.y, b.center.z * scale.z);
+    o.center = MPVec3Add(MPQuaternionRotateVec3(rotation, o.center), position);
+    
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        MPVec3 a = b.halfAxes[i];
+        
+        o.halfAxes[i] = MPQuaternionRotateVec3(rotation, MPVec3Make(a.x * scale.x, a.y * scale.y, a.z * scale.z));
+    }
+    
+    return o;
+}
+    
+/* returns half the length of the box's shadow on the axis, scaled by the axis' length. */
+static inline float MPOBoxProjectedRadius(MPOBox b, MPVec3 axis)
+{
+    return (fabsf(MPVec3DotProduct(b.halfAxes[0], axis)) +
+            fabsf(MPVec3DotProduct(b.halfAxes[1], axis)) +
+            fabsf(MPVec3DotProduct(b.halfAxes[2], axis)));
+}
+    
+/* separating axis test. the candidate axes are the face normals of both boxes and the cross
+   products of their edges. */
+static inline int MPOBoxIntersectsOBox(MPOBox b1, MPOBox b2)
+{
+    MPVec3 d = MPVec3Subtract(b2.center, b1.center);
+    
+    MPVec3 axes[6] = {
+        MPVec3CrossProduct(b1.halfAxes[1], b1.halfAxes[2]),
+        MPVec3CrossProduct(b1.halfAxes[2], b1.halfAxes[0]),
+        MPVec3CrossProduct(b1.halfAxes[0], b1.halfAxes[1]),
+        MPVec3CrossProduct(b2.halfAxes[1], b2.halfAxes[2]),
+        MPVec3CrossProduct(b2.halfAxes[2], b2.halfAxes[0]),
+        MPVec3CrossProduct(b2.halfAxes[0], b2.halfAxes[1])
+    };
+    
+    int i, j;
+    for (i = 0; i < 6; ++i)
+    {
+        if (fabsf(MPVec3DotProduct(d, axes[i])) > MPOBoxProjectedRadius(b1, axes[i]) + MPOBoxProjectedRadius(b2, axes[i])) return 0;
+    }
+    
+    for (i = 0; i < 3; ++i)
+    {
+        for (j = 0; j < 3; ++j)
+        {
+            MPVec3 axis = MPVec3CrossProduct(b1.halfAxes[i], b2.halfAxes[j]);
+            
+            // nearly parallel edges give an axis that is mostly rounding error. the face normals
+            // already cover that case.
+            float length2 = MPVec3DotProduct(axis, axis);
+            if (length2 <= 1e-6f * MPVec3DotProduct(b1.halfAxes[i], b1.halfAxes[i]) * MPVec3DotProduct(b2.halfAxes[j], b2.halfAxes[j])) continue;
+            
+            if (fabsf(MPVec3DotProduct(d, axis)) > MPOBoxProjectedRadius(b1, axis) + MPOBoxProjectedRadius(b2, axis)) return 0;
+        }
+    }
+    
+    return 1;
+}
+    
 #pragma mark - line functions
     
 static inline MPLineSegment MPLineSegmentMake(MPVec3 p1, MPVec3 p2)
@@ -477,9 +836,7 @@ static inline MPVec3 MPLineGetIntersection(MPLine l1, MPLine l2, float *t, float
     
 static inline void MPTriangleApplyTransform(MPTriangle *t, MPMat4 m)
 {
-    t->p[0] = MPMat4TransformVec3(m, t->p[0]);
-    t->p[1] = MPMat4TransformVec3(m, t->p[1]);
-    t->p[2] = MPMat4TransformVec3(m, t->p[2]);
+    MPMat4TransformVec3Array(m, t->p, t->p, 3);
 }
     
 /* assumes vertices specified in CCW order. */
@@ -488,6 +845,71 @@ static inline MPVec3 MPTriangleNormal(MPTriangle t)
     return MPVec3CrossProduct(MPVec3Subtract(t.v2, t.v1), MPVec3Subtract(t.v3, t.v1));
 }
     
+/* returns the point on t closest to p. (see Ericson, Real-Time Collision Detection, 5.1.5) */
+static inline MPVec3 MPTriangleClosestPoint(MPTriangle t, MPVec3 p)
+{
+    MPVec3 ab = MPVec3Subtract(t.v2, t.v1);
+    MPVec3 ac = MPVec3Subtract(t.v3, t.v1);
+    MPVec3 ap = MPVec3Subtract(p, t.v1);
+    
+    float d1 = MPVec3DotProduct(ab, ap);
+    float d2 = MPVec3DotProduct(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return t.v1;
+    
+    MPVec3 bp = MPVec3Subtract(p, t.v2);
+    float d3 = MPVec3DotProduct(ab, bp);
+    float d4 = MPVec3DotProduct(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return t.v2;
+    
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        return MPVec3Add(t.v1, MPVec3MultiplyScalar(ab, d1 / (d1 - d3)));
+    }
+    
+    MPVec3 cp = MPVec3Subtract(p, t.v3);
+    float d5 = MPVec3DotProduct(ab, cp);
+    float d6 = MPVec3DotProduct(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return t.v3;
+    
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        return MPVec3Add(t.v1, MPVec3MultiplyScalar(ac, d2 / (d2 - d6)));
+    }
+    
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        MPVec3 bc = MPVec3Subtract(t.v3, t.v2);
+        return MPVec3Add(t.v2, MPVec3MultiplyScalar(bc, (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+    
+    float denom = 1.0f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    
+    return MPVec3Add(t.v1, MPVec3Add(MPVec3MultiplyScalar(ab, v), MPVec3MultiplyScalar(ac, w)));
+}
+    
+/* returns the signed solid angle subtended by t at p (Van Oosterom and Strackee). summed over
+   a closed CCW triangulation, this is 4pi for points inside and 0 for points outside. */
+static inline float MPTriangleSolidAngle(MPTriangle t, MPVec3 p)
+{
+    MPVec3 a = MPVec3Subtract(t.v1, p);
+    MPVec3 b = MPVec3Subtract(t.v2, p);
+    MPVec3 c = MPVec3Subtract(t.v3, p);
+    
+    float la = MPVec3Length(a);
+    float lb = MPVec3Length(b);
+    float lc = MPVec3Length(c);
+    
+    float numer = MPVec3DotProduct(a, MPVec3CrossProduct(b, c));
+    float denom = la * lb * lc + MPVec3DotProduct(a, b) * lc + MPVec3DotProduct(a, c) * lb + MPVec3DotProduct(b, c) * la;
+    
+    return 2.0f * atan2f(numer, denom);
+}
+    
 /* returns the line segment resulting from projecting the vertices of t onto v. */
 static inline MPLineSegment MPTriangleProject(MPTriangle t, MPVec3 v)
 {
@@ -516,148 +938,59 @@ static inline MPLineSegment MPTriangleProject(MPTriangle t, MPVec3 v)
     return line;
 }
     
-/* results undefined if t1, t2 are not coplanar. used method of separating axis */
-static inline int MPCoplanarTrianglesIntersect(MPTriangle t1, MPTriangle t2)
+/* returns 1 if the triangle overlaps the box with the given center and half extents.
+   (separating axis test, see Akenine-Moller, Fast 3D Triangle-Box Overlap Testing) */
+static inline int MPTriangleIntersectsAABox(MPTriangle t, MPVec3 center, MPVec3 halfSize)
 {
-    int intersection = 1;
-    
-    MPLineSegment t1s, t2s;
+    // move the box to the origin
+    MPVec3 v[3];
+    v[0] = MPVec3Subtract(t.v1, center);
+    v[1] = MPVec3Subtract(t.v2, center);
+    v[2] = MPVec3Subtract(t.v3, center);
     
-    MPVec3 edges[6];
-    edges[0] = MPVec3Subtract(t1.v1, t1.v2);
-    edges[1] = MPVec3Subtract(t1.v1, t1.v3);
-    edges[2] = MPVec3Subtract(t1.v2, t1.v3);
-    
-    edges[3] = MPVec3Subtract(t2.v1, t2.v2);
-    edges[4] = MPVec3Subtract(t2.v1, t2.v3);
-    edges[5] = MPVec3Subtract(t2.v2, t2.v3);
-    
-    // project each triangle to every possible edge. if it exists,
-    // axis of separation will be perpendicular to one of the edges of the triangles
-    int i;
-    for (i = 0; i < 6; ++i)
+    // box normals, i.e. overlap of the triangle's bounding box
+    int a;
+    for (a = 0; a < 3; ++a)
     {
-        t1s = MPTriangleProject(t1, edges[i]);
-        t2s = MPTriangleProject(t2, edges[i]);
-        
-        intersection = MPCollinearLineSegmentsIntersect(t1s, t2s);
+        float min = fminf(fminf(v[0].v[a], v[1].v[a]), v[2].v[a]);
+        float max = fmaxf(fmaxf(v[0].v[a], v[1].v[a]), v[2].v[a]);
         
-        // if we found an axis of separation, we're done
-        if (!intersection) break;
+        if (min > halfSize.v[a] || max < -halfSize.v[a]) return 0;
     }
     
-    return intersection;
-}
-    
-/* if intersection exists, returns 1 and intersection is the segment of intersection.
-   if no intersection exists, returns 0 and intersection is unchanged. */
-static inline int MPTriangleIntersectsLine(MPTriangle tri, MPLine l, MPLineSegment *intersection)
-{
-    MPVec3 edges[3];
-    edges[0] = MPVec3Subtract(tri.v2, tri.v1);
-    edges[1] = MPVec3Subtract(tri.v3, tri.v2);
-    edges[2] = MPVec3Subtract(tri.v1, tri.v3);
-    
-    MPVec3 intersections[3];
-    
-    float t[3];
-    float s;
+    MPVec3 e[3];
+    e[0] = MPVec3Subtract(v[1], v[0]);
+    e[1] = MPVec3Subtract(v[2], v[1]);
+    e[2] = MPVec3Subtract(v[0], v[2]);
     
+    // cross products of the triangle edges with the box normals
     int i;
     for (i = 0; i < 3; ++i)
     {
-        intersections[i] = MPLineGetIntersection(MPLineMake(tri.p[i], edges[i]), l, &t[i], &s);
-    }
-    
-    // not all 3 edges can intersect, so at least one must not
-    int noInt;
-    
-    if (t[0] < 0.0 || t[0] > 1.0)       noInt = 0;
-    else if (t[1] < 0.0 || t[1] > 1.0)  noInt = 1;
-    else                                noInt = 2;
-    
-    int t1 = (noInt + 3 - 1) % 3;
-    int t2 = (noInt + 1) % 3;
-    
-    if (t[t1] >= 0.0f && t[t1] <= 1.0f && t[t2] >= 0.0f && t[t2] <= 1.0f)
-    {
-        if (MPVec3DotProduct(l.v, MPVec3Subtract(intersections[t2], intersections[t1])) > 0)
+        for (a = 0; a < 3; ++a)
         {
-            intersection->p1 = intersections[t1];
-            intersection->p2 = intersections[t2];
+            MPVec3 unit = MPVec3Zero;
+            unit.v[a] = 1.0f;
+            
+            MPVec3 axis = MPVec3CrossProduct(unit, e[i]);
+            
+            float p0 = MPVec3DotProduct(v[0], axis);
+            float p1 = MPVec3DotProduct(v[1], axis);
+            float p2 = MPVec3DotProduct(v[2], axis);
+            
+            float r = halfSize.x * fabsf(axis.x) + halfSize.y * fabsf(axis.y) + halfSize.z * fabsf(axis.z);
+            
+            if (fminf(fminf(p0, p1), p2) > r || fmaxf(fmaxf(p0, p1), p2) < -r) return 0;
         }
-        else
-        {
-            intersection->p1 = intersections[t2];
-            intersection->p2 = intersections[t1];
-        }
-
-        return 1;
     }
-
-    return 0;
-}
     
-static inline int MPTrianglesIntersect(MPTriangle t1, MPTriangle t2)
-{
-    // find plane normals
-    MPVec3 n1 = MPVec3CrossProduct(MPVec3Subtract(t1.v2, t1.v1), MPVec3Subtract(t1.v3, t1.v1));
-    MPVec3 n2 = MPVec3CrossProduct(MPVec3Subtract(t2.v2, t2.v1), MPVec3Subtract(t2.v3, t2.v1));
+    // the triangle's plane
+    MPVec3 normal = MPVec3CrossProduct(e[0], e[1]);
     
-    float n1dott1 = MPVec3DotProduct(n1, t1.v1);
-    float n2dott2 = MPVec3DotProduct(n2, t2.v1);
-    
-    // intersection line of the two planes
-    MPLine pInt;
-    
-    // parallel to line of intersection of planes
-    pInt.v = MPVec3CrossProduct(n1, n2);
-    
-    // check if planes are parallel
-    if (MPVec3EqualToVec3(pInt.v, MPVec3Zero))
-    {
-        float diff = MPVec3DotProduct(n1, t2.v1) - n1dott1;
-        
-        if (diff == 0.0f)
-        {
-            // triangles are coplanar, so use 2D intersection test
-            return MPCoplanarTrianglesIntersect(t1, t2);
-        }
-
-        // triangles are in parallel planes and not coplanar, so no intersection
-        return 0;
-    }
-    
-    if (!MPCollinearLineSegmentsIntersect(MPTriangleProject(t1, pInt.v), MPTriangleProject(t2, pInt.v)))
-    {
-        // projections of triangles onto intersection line don't even intersect, so no intersection
-        return 0;
-    }
-    
-    // find an axis for which v is non-zero
-    int a0 = 0;
-    
-    if (pInt.v.y != 0.0f)      a0 = 1;
-    else if (pInt.v.z != 0.0f) a0 = 2;
-    
-    // let one coordinate of p0 be 0
-    pInt.p0.v[a0] = 0.0f;
-    
-    // solve for the other two coordinates
-    int a1 = (a0 + 3 - 1) % 3;
-    int a2 = (a0 + 1) % 3;
-    
-    pInt.p0.v[a1] = (n1.v[a2] * n2dott2 - n2.v[a2] * n1dott1) / (n1.v[a2] * n2.v[a1] - n1.v[a1] * n2.v[a2]);
-    pInt.p0.v[a2] = (n1.v[a1] * n2dott2 - n2.v[a1] * n1dott1) / (n1.v[a1] * n2.v[a2] - n1.v[a2] * n2.v[a1]);
-    
-    MPLineSegment t1s, t2s;
-    
-    if (MPTriangleIntersectsLine(t1, pInt, &t1s) && MPTriangleIntersectsLine(t2, pInt, &t2s))
-    {
-        return MPCollinearLineSegmentsIntersect(t1s, t2s);
-    }
+    float d = MPVec3DotProduct(normal, v[0]);
+    float r = halfSize.x * fabsf(normal.x) + halfSize.y * fabsf(normal.y) + halfSize.z * fabsf(normal.z);
     
-    return 0;
+    return fabsf(d) <= r;
 }
     
 #if defined(__cplusplus)
@@ -7,7 +7,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "MPMesh.h"
+#include "MPVoxelizer.h"
+#include "MPConvexDecomposition.h"
+#include "MPPredicates.h"
 
 #pragma mark - private definitions
 
@@ -16,11 +20,81 @@ typedef struct _MPMeshPrivate
     int refCount;
     MPVec3 extremePoints[6]; // left, bottom, far, right, top, near
     MPSphere boundingSphere;
+    MPOBox orientedBox;
+    MPSphereTree sphereTree;
+    MPConvexDecomposition decomposition;
+    int ownsPrecomputed;
+    MPCollisionMesh collision;
+    
+    MPMeshDataDeallocator deallocator;
+    void *deallocatorContext;
 } MPMeshPrivate;
 
+MPMesh* _MPMeshAlloc(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices);
+
 void _MPMeshComputePrivate(MPMesh *mesh);
 
-int _MPMeshVoxelCollision(const MPTriangle *faces, size_t n, const MPMesh *voxMesh, MPMat4 voxTransform);
+MPSphere _MPMinimalSphere(MPVec3 *points, int n);
+
+MPOBox _MPMeshComputeOrientedBox(const MPMesh *mesh, const MPVec3 *points, int n, MPAABox bounds);
+
+void _MPSymmetricEigenvectors(double a[3][3], double vectors[3][3]);
+
+size_t _MPMeshGetIndex(const MPMesh *mesh, size_t i);
+
+uint32_t _MPVec3Hash(MPVec3 v);
+
+void _MPMeshBuildCollisionMesh(MPMesh *mesh);
+
+void _MPCollisionMeshFree(MPCollisionMesh *mesh);
+
+// trees are split at the median, so their depth (and the traversal stack) stays logarithmic.
+// trees read from a binary mesh file may be deeper, and the stack moves to the heap for those.
+#define MP_SPHERE_TREE_LEAF_SIZE 4
+#define MP_SPHERE_TREE_STACK_SIZE 128
+
+// inner spheres are chosen from a grid of samples in the mesh's bounding box
+#define MP_SPHERE_TREE_INNER_SAMPLES 8
+#define MP_SPHERE_TREE_MAX_INNER 16
+
+void _MPMeshBuildSphereTree(MPMesh *mesh);
+
+int _MPSphereTreeBuildNode(MPSphereTree *tree, const MPTriangle *triangles, const MPVec3 *centroids, int first, int count);
+
+void _MPSphereTreeSelect(int *order, const MPVec3 *centroids, int axis, int n, int k);
+
+int _MPSphereCompareRadiusDescending(const void *a, const void *b);
+
+void _MPSphereTreeComputeInnerSpheres(MPSphereTree *tree, const MPMesh *mesh, const MPTriangle *triangles, int numTriangles);
+
+float _MPSphereTreeDistance(const MPSphereTree *tree, const MPTriangle *triangles, MPVec3 p);
+
+int _MPSphereTreeContainsPoint(const MPSphereTree *tree, const MPMesh *mesh, MPVec3 p);
+
+int _MPSphereTreeCountCrossings(const MPSphereTree *tree, const MPMesh *mesh, MPVec3 p, MPVec3 direction);
+
+int _MPRayCrossesTriangle(MPTriangle tri, MPVec3 p, MPVec3 direction);
+
+void _MPStackReserve(int **stack, int *capacity, int *buffer, int needed);
+
+float _MPTrianglesDistance(MPTriangle t1, MPTriangle t2, float limit);
+float _MPTrianglePlaneGap(MPTriangle t, MPTriangle other);
+
+float _MPSegmentsDistance(MPVec3 p1, MPVec3 q1, MPVec3 p2, MPVec3 q2);
+
+MPSphere _MPSphereTransform(MPSphere sphere, MPMat4 transform, float scale);
+
+// the decomposition is only a filter in front of the trees, so a handful of pieces is enough
+#define MP_MESH_MAX_CONVEX_PIECES 8
+
+int _MPMeshPiecesIntersect(const MPConvexDecomposition *decomposition1, MPMat4 transform1, float scale1, const MPConvexDecomposition *decomposition2, MPMat4 transform2, float scale2);
+
+int _MPSphereTouchesLeaf(MPSphere sphere, const MPMesh *mesh, const MPSphereTree *tree, const MPSphereTreeNode *leaf, MPMat4 transform);
+
+int _MPMeshLeavesIntersect(const MPCollisionMesh *mesh1, const MPSphereTree *tree1, const MPSphereTreeNode *leaf1, MPMat4 transform1,
+                           const MPCollisionMesh *mesh2, const MPSphereTree *tree2, const MPSphereTreeNode *leaf2, MPMat4 transform2);
+
+void _MPMeshAddSurfaceSpheres(MPTriangle t, float maxRadius, int depth, MPSphere **spheres, int *count, int *arraySize);
 
 const float CubeVertices[24][6] = {
     // Front
@@ -80,24 +154,33 @@ const unsigned int CubeIndices[] = {
 
 MPMesh* MPMeshCreate(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices)
 {
-    MPMesh *mesh = malloc(sizeof(MPMesh));
+    MPMesh *mesh = _MPMeshAlloc(vertexData, stride, numVertices, indexData, indexSize, numIndices);
     
-    mesh->vertexData = vertexData;
-    mesh->stride = stride;
-    mesh->numVertices = numVertices;
+    _MPMeshBuildCollisionMesh(mesh);
+    _MPMeshComputePrivate(mesh);
+    _MPMeshBuildSphereTree(mesh);
     
-    mesh->indexData = indexData;
-    mesh->indexSize = indexSize;
-    mesh->numIndices = numIndices;
+    MPMeshPrivate *priv = (MPMeshPrivate *)mesh->_reserved;
     
-    mesh->texName = NULL;
+    priv->decomposition = MPConvexDecompositionMake(mesh, MP_MESH_MAX_CONVEX_PIECES);
+    priv->ownsPrecomputed = 1;
     
-    MPMeshPrivate *priv = malloc(sizeof(MPMeshPrivate));
-    priv->refCount = 0;
+    return mesh;
+}
+
+MPMesh* MPMeshCreateWithPrecomputed(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices, const MPMeshPrecomputed *precomputed)
+{
+    MPMesh *mesh = _MPMeshAlloc(vertexData, stride, numVertices, indexData, indexSize, numIndices);
     
-    mesh->_reserved = priv;
+    MPMeshPrivate *priv = (MPMeshPrivate *)mesh->_reserved;
     
-    _MPMeshComputePrivate(mesh);
+    memcpy(priv->extremePoints, precomputed->extremePoints, sizeof(priv->extremePoints));
+    priv->boundingSphere = precomputed->boundingSphere;
+    priv->orientedBox = precomputed->orientedBox;
+    priv->sphereTree = precomputed->sphereTree;
+    priv->decomposition = precomputed->decomposition;
+    priv->collision = precomputed->collision;
+    priv->ownsPrecomputed = 0;
     
     return mesh;
 }
@@ -111,24 +194,56 @@ void MPMeshFree(MPMesh *mesh)
 {
     if (mesh)
     {
+        MPMeshPrivate *priv = (MPMeshPrivate *)mesh->_reserved;
+        
+        if (priv->ownsPrecomputed)
+        {
+            free(priv->sphereTree.nodes);
+            free(priv->sphereTree.triangles);
+            free(priv->sphereTree.innerSpheres);
+            
+            MPConvexDecompositionFree(&priv->decomposition);
+            _MPCollisionMeshFree(&priv->collision);
+        }
+        
+        if (priv->deallocator)
+        {
+            priv->deallocator(mesh, priv->deallocatorContext);
+        }
+        
         free((void *)mesh->texName);
         free(mesh->_reserved);
         free(mesh);
     }
 }
 
+void MPMeshSetDataDeallocator(MPMesh *mesh, MPMeshDataDeallocator deallocator, void *context)
+{
+    MPMeshPrivate *priv = (MPMeshPrivate *)mesh->_reserved;
+    
+    priv->deallocator = deallocator;
+    priv->deallocatorContext = context;
+}
+
+void MPMeshFreeData(MPMesh *mesh, void *context)
+{
+    free((void *)mesh->vertexData);
+    free((void *)mesh->indexData);
+}
+
 void MPMeshRetain(MPMesh *mesh)
 {
     if (mesh == NULL) return;
     
-    ++(((MPMeshPrivate *)mesh->_reserved)->refCount);
+    __atomic_fetch_add(&((MPMeshPrivate *)mesh->_reserved)->refCount, 1, __ATOMIC_RELAXED);
 }
 
 void MPMeshRelease(MPMesh *mesh)
 {
     if (mesh == NULL) return;
     
-    int refCount = ((MPMeshPrivate *)mesh->_reserved)->refCount;
+    // the decrement is the only read, so exactly one of any racing releases sees the last reference
+    int refCount = __atomic_fetch_sub(&((MPMeshPrivate *)mesh->_reserved)->refCount, 1, __ATOMIC_ACQ_REL);
     
     if (!refCount)
     {
@@ -139,15 +254,11 @@ void MPMeshRelease(MPMesh *mesh)
     {
         MPMeshFree(mesh);
     }
-    else
-    {
-        --(((MPMeshPrivate *)mesh->_reserved)->refCount);
-    }
 }
 
 int MPMeshGetRefCount(const MPMesh *mesh)
 {
-    return ((MPMeshPrivate *)mesh->_reserved)->refCount;
+    return __atomic_load_n(&((MPMeshPrivate *)mesh->_reserved)->refCount, __ATOMIC_RELAXED);
 }
 
 size_t MPMeshGetTriangleCount(const MPMesh *mesh)
@@ -159,31 +270,32 @@ void MPMeshGetTriangle(const MPMesh *mesh, size_t n, MPVec3 *triangle)
 {
     if (triangle == NULL) return;
     
-    const void *index = (char *)mesh->indexData + (3 * n * mesh->indexSize);
+    MPCollisionMeshGetTriangle(&((MPMeshPrivate *)mesh->_reserved)->collision, n, triangle);
+}
+
+void MPMeshGetTransformedTriangles(const MPMesh *mesh, MPMat4 transform, MPTriangle *triangles)
+{
+    const MPCollisionMesh *collision = &((MPMeshPrivate *)mesh->_reserved)->collision;
+    
+    size_t numVertices = collision->numVertices;
     
-    switch (mesh->indexSize)
+    // transform each welded vertex once, rather than once for every triangle that uses it
+    float *points = malloc(3 * (numVertices > 0 ? numVertices : 1) * sizeof(float));
+    float *x = points, *y = points + numVertices, *z = points + 2 * numVertices;
+    
+    MPMat4TransformPoints(transform, collision->x, collision->y, collision->z, x, y, z, numVertices);
+    
+    size_t t;
+    for (t = 0; t < collision->numTriangles; ++t)
     {
-        case sizeof(char):
-            triangle[0] = *(MPVec3 *)((char *)mesh->vertexData + ((char *)index)[0] * mesh->stride);
-            triangle[1] = *(MPVec3 *)((char *)mesh->vertexData + ((char *)index)[1] * mesh->stride);
-            triangle[2] = *(MPVec3 *)((char *)mesh->vertexData + ((char *)index)[2] * mesh->stride);
-            break;
-            
-        case sizeof(short):
-            triangle[0] = *(MPVec3 *)((char *)mesh->vertexData + ((short *)index)[0] * mesh->stride);
-            triangle[1] = *(MPVec3 *)((char *)mesh->vertexData + ((short *)index)[1] * mesh->stride);
-            triangle[2] = *(MPVec3 *)((char *)mesh->vertexData + ((short *)index)[2] * mesh->stride);
-            break;
-            
-        case sizeof(int):
-            triangle[0] = *(MPVec3 *)((char *)mesh->vertexData + ((int *)index)[0] * mesh->stride);
-            triangle[1] = *(MPVec3 *)((char *)mesh->vertexData + ((int *)index)[1] * mesh->stride);
-            triangle[2] = *(MPVec3 *)((char *)mesh->vertexData + ((int *)index)[2] * mesh->stride);
-            break;
-            
-        default:
-            break;
+        const uint32_t *index = collision->indices + 3 * t;
+        
+        triangles[t].p[0] = MPVec3Make(x[index[0]], y[index[0]], z[index[0]]);
+        triangles[t].p[1] = MPVec3Make(x[index[1]], y[index[1]], z[index[1]]);
+        triangles[t].p[2] = MPVec3Make(x[index[2]], y[index[2]], z[index[2]]);
     }
+    
+    free(points);
 }
 
 const MPVec3* MPMeshGetExtremePoints(const MPMesh *mesh)
@@ -192,114 +304,339 @@ const MPVec3* MPMeshGetExtremePoints(const MPMesh *mesh)
 }
 
 MPSphere MPMeshGetBoundingSphere(const MPMesh *mesh, const MPMat4 *transform)
-{    
+{
     MPSphere boundingSphere = ((MPMeshPrivate *)mesh->_reserved)->boundingSphere;
     
-    if (transform != NULL)
-    {
-        // apply translation to center point (scale and rotation don't matter)
-        boundingSphere.center.x -= transform->m[12];
-        boundingSphere.center.y -= transform->m[13];
-        boundingSphere.center.z -= transform->m[14];
-        
-        // scale the radius on the x-axis
-        MPVec3 xRad = MPVec3Make(boundingSphere.radius, 0.0f, 0.0f);
-        xRad = MPMat4TransformVec3(*transform, xRad);
-        xRad.x -= transform->m[12]; xRad.y -= transform->m[13]; xRad.z -= transform->m[14];
-        
-        // scale the radius on the y-axis
-        MPVec3 yRad = MPVec3Make(0.0f, boundingSphere.radius, 0.0f);
-        yRad = MPMat4TransformVec3(*transform, yRad);
-        yRad.x -= transform->m[12]; yRad.y -= transform->m[13]; yRad.z -= transform->m[14];
+    return transform != NULL ? MPSphereTransform(boundingSphere, *transform) : boundingSphere;
+}
 
-        // scale the radius on the z-axis
-        MPVec3 zRad = MPVec3Make(0.0f, 0.0f, boundingSphere.radius);
-        zRad = MPMat4TransformVec3(*transform, zRad);
-        zRad.x -= transform->m[12]; zRad.y -= transform->m[13]; zRad.z -= transform->m[14];
-        
-        // take the new radius to be the max of the radius scaled on each axis
-        boundingSphere.radius = fmaxf(MPVec3Length(xRad), MPVec3Length(yRad));
-        boundingSphere.radius = fmaxf(boundingSphere.radius, MPVec3Length(zRad));
-    }
+MPOBox MPMeshGetOrientedBox(const MPMesh *mesh, const MPMat4 *transform)
+{
+    MPOBox orientedBox = ((MPMeshPrivate *)mesh->_reserved)->orientedBox;
     
-    return  boundingSphere;
+    return transform != NULL ? MPOBoxTransform(orientedBox, *transform) : orientedBox;
 }
 
-MPVec3* MPMeshGetVoxels(const MPMesh *mesh, MPVec3 scale, float voxelSize, int *n)
+const MPSphereTree* MPMeshGetSphereTree(const MPMesh *mesh)
 {
-    MPVec3 *extremes = ((MPMeshPrivate *)mesh->_reserved)->extremePoints;
+    return &((MPMeshPrivate *)mesh->_reserved)->sphereTree;
+}
+
+const MPConvexDecomposition* MPMeshGetConvexDecomposition(const MPMesh *mesh)
+{
+    return &((MPMeshPrivate *)mesh->_reserved)->decomposition;
+}
+
+const MPCollisionMesh* MPMeshGetCollisionMesh(const MPMesh *mesh)
+{
+    return &((MPMeshPrivate *)mesh->_reserved)->collision;
+}
+
+void MPMeshGetPrecomputed(const MPMesh *mesh, MPMeshPrecomputed *precomputed)
+{
+    MPMeshPrivate *priv = (MPMeshPrivate *)mesh->_reserved;
     
-    // some arbitrary start size
-    int arraySize = 10;
-    int count = 0;
+    memcpy(precomputed->extremePoints, priv->extremePoints, sizeof(priv->extremePoints));
+    precomputed->boundingSphere = priv->boundingSphere;
+    precomputed->orientedBox = priv->orientedBox;
+    precomputed->sphereTree = priv->sphereTree;
+    precomputed->decomposition = priv->decomposition;
+    precomputed->collision = priv->collision;
+}
+
+int MPMeshesIntersect(const MPMesh *mesh1, MPMat4 transform1, const MPMesh *mesh2, MPMat4 transform2)
+{
+    const MPSphereTree *tree1 = MPMeshGetSphereTree(mesh1);
+    const MPSphereTree *tree2 = MPMeshGetSphereTree(mesh2);
     
-    MPVec3 *voxels = malloc(arraySize * sizeof(MPVec3));
+    if (tree1->numNodes == 0 || tree2->numNodes == 0) return 0;
     
-    // temporary cube mesh to represent a voxel
-    MPMesh *cubeMesh = MPMeshCreateCube();
-    MPMat4 transform = MPMat4MakeScale(MPVec3Make(voxelSize, voxelSize, voxelSize));
+    // outer spheres must grow with the largest scale to stay enclosing
+    float maxScale1 = MPMat4MaxScale(transform1);
+    float maxScale2 = MPMat4MaxScale(transform2);
     
-    float startX = scale.x * extremes[0].x + 0.5f * voxelSize;
-    float endX = scale.x * extremes[3].x;
+    MPSphere root1 = _MPSphereTransform(tree1->nodes[0].sphere, transform1, maxScale1);
+    MPSphere root2 = _MPSphereTransform(tree2->nodes[0].sphere, transform2, maxScale2);
     
-    float startY = scale.y * extremes[1].y + 0.5f * voxelSize;
-    float endY = scale.y * extremes[4].y;
+    if (!MPSphereIntersectsSphere(root1, root2)) return 0;
     
-    float startZ = scale.z * extremes[2].z + 0.5f * voxelSize;
-    float endZ = scale.z * extremes[5].z;
+    if (!MPOBoxIntersectsOBox(MPMeshGetOrientedBox(mesh1, &transform1), MPMeshGetOrientedBox(mesh2, &transform2))) return 0;
     
-    // compute triangles of the mesh
-    size_t numTriangles = MPMeshGetTriangleCount(mesh);
-    MPTriangle triangles[numTriangles];
+    // inner spheres lie inside the volumes, so if any two overlap then so do the models.
+    // they must shrink with the smallest scale to stay inside.
+    float minScale1 = MPMat4MinScale(transform1);
+    float minScale2 = MPMat4MinScale(transform2);
     
-    MPMat4 scaleT = MPMat4MakeScale(scale);
+    int i, j;
+    for (i = 0; i < tree1->numInnerSpheres; ++i)
+    {
+        MPSphere inner1 = _MPSphereTransform(tree1->innerSpheres[i], transform1, minScale1);
+        
+        for (j = 0; j < tree2->numInnerSpheres; ++j)
+        {
+            if (MPSphereIntersectsSphere(inner1, _MPSphereTransform(tree2->innerSpheres[j], transform2, minScale2)))
+            {
+                return 1;
+            }
+        }
+    }
     
-    int i;
-    for (i = 0; i < numTriangles; ++i)
+    // the pieces cover the meshes, so if none of them meet neither do the meshes
+    if (!_MPMeshPiecesIntersect(MPMeshGetConvexDecomposition(mesh1), transform1, maxScale1, MPMeshGetConvexDecomposition(mesh2), transform2, maxScale2))
     {
-        MPMeshGetTriangle(mesh, i, triangles[i].p);
-        MPTriangleApplyTransform(&triangles[i], scaleT);
+        return 0;
+    }
+    
+    const MPCollisionMesh *collision1 = MPMeshGetCollisionMesh(mesh1);
+    const MPCollisionMesh *collision2 = MPMeshGetCollisionMesh(mesh2);
+    
+    // descend both trees together, only visiting pairs of nodes whose spheres overlap
+    int stackBuffer[2 * MP_SPHERE_TREE_STACK_SIZE];
+    int *stack = stackBuffer;
+    int capacity = 2 * MP_SPHERE_TREE_STACK_SIZE;
+    int top = 0;
+    int intersect = 0;
+    
+    stack[top++] = 0;
+    stack[top++] = 0;
+    
+    while (top > 0 && !intersect)
+    {
+        int b = stack[--top];
+        int a = stack[--top];
+        
+        const MPSphereTreeNode *node1 = &tree1->nodes[a];
+        const MPSphereTreeNode *node2 = &tree2->nodes[b];
+        
+        MPSphere sphere1 = _MPSphereTransform(node1->sphere, transform1, maxScale1);
+        MPSphere sphere2 = _MPSphereTransform(node2->sphere, transform2, maxScale2);
+        
+        if (!MPSphereIntersectsSphere(sphere1, sphere2)) continue;
+        
+        int leaf1 = (node1->children[0] < 0);
+        int leaf2 = (node2->children[0] < 0);
+        
+        // a leaf's sphere can be much larger than its triangles (e.g. the faces of a long box),
+        // so check the other sphere against the triangles themselves
+        if (leaf1 && !_MPSphereTouchesLeaf(sphere2, mesh1, tree1, node1, transform1)) continue;
+        if (leaf2 && !_MPSphereTouchesLeaf(sphere1, mesh2, tree2, node2, transform2)) continue;
+        
+        if (leaf1 && leaf2)
+        {
+            intersect = _MPMeshLeavesIntersect(collision1, tree1, node1, transform1, collision2, tree2, node2, transform2);
+            continue;
+        }
+        
+        _MPStackReserve(&stack, &capacity, stackBuffer, top + 4);
+        
+        if (leaf2 || (!leaf1 && sphere1.radius >= sphere2.radius))
+        {
+            // split the larger sphere
+            stack[top++] = node1->children[0]; stack[top++] = b;
+            stack[top++] = node1->children[1]; stack[top++] = b;
+        }
+        else
+        {
+            stack[top++] = a; stack[top++] = node2->children[0];
+            stack[top++] = a; stack[top++] = node2->children[1];
+        }
     }
     
-    float x, y, z;
-    for (x = startX; x < endX; x += voxelSize)
+    if (stack != stackBuffer) free(stack);
+    
+    if (intersect) return 1;
+    
+    // the surfaces don't meet, but one mesh may still lie entirely inside the other. then all of its
+    // points are, so testing one of them is enough.
+    MPTriangle first;
+    
+    MPMeshGetTriangle(mesh1, 0, first.p);
+    MPVec3 point1 = MPMat4TransformVec3(MPMat4Multiply(MPMat4InvertAffine(transform2), transform1), first.v1);
+    
+    if (_MPSphereTreeContainsPoint(tree2, mesh2, point1)) return 1;
+    
+    MPMeshGetTriangle(mesh2, 0, first.p);
+    MPVec3 point2 = MPMat4TransformVec3(MPMat4Multiply(MPMat4InvertAffine(transform1), transform2), first.v1);
+    
+    return _MPSphereTreeContainsPoint(tree1, mesh1, point2);
+}
+
+float MPMeshesDistance(const MPMesh *mesh1, MPMat4 transform1, const MPMesh *mesh2, MPMat4 transform2, float limit)
+{
+    const MPSphereTree *tree1 = MPMeshGetSphereTree(mesh1);
+    const MPSphereTree *tree2 = MPMeshGetSphereTree(mesh2);
+    
+    if (tree1->numNodes == 0 || tree2->numNodes == 0) return limit;
+    
+    float maxScale1 = MPMat4MaxScale(transform1);
+    float maxScale2 = MPMat4MaxScale(transform2);
+    
+    const MPCollisionMesh *collision1 = MPMeshGetCollisionMesh(mesh1);
+    const MPCollisionMesh *collision2 = MPMeshGetCollisionMesh(mesh2);
+    
+    int stackBuffer[2 * MP_SPHERE_TREE_STACK_SIZE];
+    int *stack = stackBuffer;
+    int capacity = 2 * MP_SPHERE_TREE_STACK_SIZE;
+    int top = 0;
+    
+    float distance = limit;
+    
+    stack[top++] = 0;
+    stack[top++] = 0;
+    
+    while (top > 0 && distance > 0.0f)
     {
-        transform.m[12] = x;
+        int b = stack[--top];
+        int a = stack[--top];
+        
+        const MPSphereTreeNode *node1 = &tree1->nodes[a];
+        const MPSphereTreeNode *node2 = &tree2->nodes[b];
         
-        for (y = startY; y < endY; y += voxelSize)
+        MPSphere sphere1 = _MPSphereTransform(node1->sphere, transform1, maxScale1);
+        MPSphere sphere2 = _MPSphereTransform(node2->sphere, transform2, maxScale2);
+        
+        // no triangles in the spheres can be nearer than the spheres are
+        if (MPVec3EuclideanDistance(sphere1.center, sphere2.center) - sphere1.radius - sphere2.radius >= distance) continue;
+        
+        int leaf1 = (node1->children[0] < 0);
+        int leaf2 = (node2->children[0] < 0);
+        
+        if (leaf1 && leaf2)
         {
-            transform.m[13] = y;
+            MPTriangle others[MP_SPHERE_TREE_LEAF_SIZE];
+            MPTriangle tri;
+            
+            int i, j;
+            for (j = 0; j < node2->count; ++j)
+            {
+                MPCollisionMeshGetTriangle(collision2, tree2->triangles[node2->first + j], others[j].p);
+                MPTriangleApplyTransform(&others[j], transform2);
+            }
             
-            for (z = startZ; z < endZ; z += voxelSize)
+            for (i = 0; i < node1->count; ++i)
             {
-                transform.m[14] = z;
+                MPCollisionMeshGetTriangle(collision1, tree1->triangles[node1->first + i], tri.p);
+                MPTriangleApplyTransform(&tri, transform1);
                 
-                if (_MPMeshVoxelCollision(triangles, numTriangles, cubeMesh, transform))
+                for (j = 0; j < node2->count; ++j)
                 {
-                    if (count >= arraySize)
-                    {
-                        // double array if necessary
-                        voxels = realloc(voxels, 2 * arraySize * sizeof(MPVec3));
-                        arraySize *= 2;
-                    }
-                    
-                    voxels[count] = MPVec3Make(x, y, z);
-                    ++count;
+                    distance = _MPTrianglesDistance(tri, others[j], distance);
                 }
             }
+            
+            continue;
+        }
+        
+        _MPStackReserve(&stack, &capacity, stackBuffer, top + 4);
+        
+        // split the larger sphere, and visit the nearer child first so the distance shrinks early
+        if (leaf2 || (!leaf1 && sphere1.radius >= sphere2.radius))
+        {
+            int near = node1->children[0], far = node1->children[1];
+            
+            if (MPVec3EuclideanDistance(_MPSphereTransform(tree1->nodes[far].sphere, transform1, maxScale1).center, sphere2.center) <
+                MPVec3EuclideanDistance(_MPSphereTransform(tree1->nodes[near].sphere, transform1, maxScale1).center, sphere2.center))
+            {
+                near = node1->children[1];
+                far = node1->children[0];
+            }
+            
+            stack[top++] = far; stack[top++] = b;
+            stack[top++] = near; stack[top++] = b;
+        }
+        else
+        {
+            int near = node2->children[0], far = node2->children[1];
+            
+            if (MPVec3EuclideanDistance(_MPSphereTransform(tree2->nodes[far].sphere, transform2, maxScale2).center, sphere1.center) <
+                MPVec3EuclideanDistance(_MPSphereTransform(tree2->nodes[near].sphere, transform2, maxScale2).center, sphere1.center))
+            {
+                near = node2->children[1];
+                far = node2->children[0];
+            }
+            
+            stack[top++] = a; stack[top++] = far;
+            stack[top++] = a; stack[top++] = near;
+        }
+    }
+    
+    if (stack != stackBuffer) free(stack);
+    
+    return fmaxf(distance, 0.0f);
+}
+
+MPVec3* MPMeshGetVoxels(const MPMesh *mesh, MPVec3 scale, float voxelSize, int *n)
+{
+    MPVec3 *extremes = ((MPMeshPrivate *)mesh->_reserved)->extremePoints;
+    
+    // bounds of the scaled mesh
+    MPAABox bounds;
+    
+    int a;
+    for (a = 0; a < 3; ++a)
+    {
+        float lo = scale.v[a] * extremes[a].v[a];
+        float hi = scale.v[a] * extremes[a + 3].v[a];
+        
+        bounds.min.v[a] = fminf(lo, hi);
+        bounds.max.v[a] = fmaxf(lo, hi);
+    }
+    
+    MPBitGrid grid = MPVoxelizeMesh(mesh, MPMat4MakeScale(scale), bounds, voxelSize, 0);
+    
+    int count = (int)MPBitGridCount(&grid);
+    MPVec3 *voxels = count > 0 ? malloc(count * sizeof(MPVec3)) : NULL;
+    
+    int v = 0;
+    
+    size_t index, numCells = MPBitGridNumCells(&grid);
+    for (index = 0; index < numCells; ++index)
+    {
+        if (MPBitGridGetIndex(&grid, index))
+        {
+            int i, j, k;
+            MPBitGridCell(&grid, index, &i, &j, &k);
+            
+            voxels[v++] = MPVoxelCenter(bounds.min, voxelSize, i, j, k);
         }
     }
     
-    MPMeshFree(cubeMesh);
+    MPBitGridFree(&grid);
+    
+    if (n != NULL)
+    {
+        *n = count;
+    }
+    
+    return voxels;
+}
+
+MPSphere* MPMeshGetSurfaceSpheres(const MPMesh *mesh, float maxRadius, int *n)
+{
+    size_t numTriangles = MPMeshGetTriangleCount(mesh);
+    
+    int arraySize = (int)numTriangles > 0 ? (int)numTriangles : 1;
+    int count = 0;
+    
+    MPSphere *spheres = malloc(arraySize * sizeof(MPSphere));
+    
+    MPTriangle t;
+    
+    size_t i;
+    for (i = 0; i < numTriangles; ++i)
+    {
+        MPMeshGetTriangle(mesh, i, t.p);
+        _MPMeshAddSurfaceSpheres(t, maxRadius, 0, &spheres, &count, &arraySize);
+    }
     
-    // resize array to fit
     if (count > 0)
     {
-        voxels = realloc(voxels, count * sizeof(MPVec3));
+        spheres = realloc(spheres, count * sizeof(MPSphere));
     }
     else
     {
-        voxels = NULL;
+        free(spheres);
+        spheres = NULL;
     }
     
     if (n != NULL)
@@ -307,11 +644,32 @@ MPVec3* MPMeshGetVoxels(const MPMesh *mesh, MPVec3 scale, float voxelSize, int *
         *n = count;
     }
     
-    return voxels;
+    return spheres;
 }
 
 #pragma mark - private functions
 
+MPMesh* _MPMeshAlloc(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices)
+{
+    MPMesh *mesh = malloc(sizeof(MPMesh));
+    
+    mesh->vertexData = vertexData;
+    mesh->stride = stride;
+    mesh->numVertices = numVertices;
+    
+    mesh->indexData = indexData;
+    mesh->indexSize = indexSize;
+    mesh->numIndices = numIndices;
+    
+    mesh->texName = NULL;
+    
+    MPMeshPrivate *priv = calloc(1, sizeof(MPMeshPrivate));
+    
+    mesh->_reserved = priv;
+    
+    return mesh;
+}
+
 void _MPMeshComputePrivate(MPMesh *mesh)
 {
     MPVec3 *left, *right, *bottom, *top, *back, *front;
@@ -332,20 +690,6 @@ void _MPMeshComputePrivate(MPMesh *mesh)
         if (current->z > front->z)  front = current;
     }
     
-    float midX = left->x + 0.5f * (right->x - left->x);
-    float midY = bottom->y + 0.5f * (top->y - bottom->y);
-    float midZ = back->z + 0.5f * (front->z - back->z);
-    
-    MPVec3 center = MPVec3Make(midX, midY, midZ);
-    
-    float maxDist = fmaxf(MPVec3EuclideanDistance(center, *left), MPVec3EuclideanDistance(center, *right));
-    
-    maxDist = fmaxf(maxDist, MPVec3EuclideanDistance(center, *bottom));
-    
-    maxDist = fmaxf(maxDist, MPVec3EuclideanDistance(center, *top));
-    maxDist = fmaxf(maxDist, MPVec3EuclideanDistance(center, *back));
-    maxDist = fmaxf(maxDist, MPVec3EuclideanDistance(center, *front));
-    
     MPMeshPrivate *private = (MPMeshPrivate *)mesh->_reserved;
     
     private->extremePoints[0] = *left;
@@ -354,48 +698,1062 @@ void _MPMeshComputePrivate(MPMesh *mesh)
     private->extremePoints[3] = *right;
     private->extremePoints[4] = *top;
     private->extremePoints[5] = *front;
-                              
-    private->boundingSphere = MPSphereMake(center, maxDist);
+    
+    // the bounds are computed over a packed copy of the positions, which the sphere shuffles
+    MPVec3 *points = malloc((mesh->numVertices > 0 ? mesh->numVertices : 1) * sizeof(MPVec3));
+    
+    for (i = 0; i < mesh->numVertices; ++i)
+    {
+        points[i] = *(MPVec3 *)((char *)mesh->vertexData + (i * mesh->stride));
+    }
+    
+    MPAABox bounds = MPAABoxMake(MPVec3Make(left->x, bottom->y, back->z), MPVec3Make(right->x, top->y, front->z));
+    
+    private->boundingSphere = _MPMinimalSphere(points, (int)mesh->numVertices);
+    private->orientedBox = _MPMeshComputeOrientedBox(mesh, points, (int)mesh->numVertices, bounds);
+    
+    free(points);
+}
+
+// the smallest sphere with the given points on its surface, in double precision
+typedef struct _MPSphereD
+{
+    double c[3];
+    double r2;
+} MPSphereD;
+
+int _MPSphereDContains(const MPSphereD *s, MPVec3 p)
+{
+    double dx = p.x - s->c[0], dy = p.y - s->c[1], dz = p.z - s->c[2];
+    
+    return dx * dx + dy * dy + dz * dz <= s->r2 * (1.0 + 1e-9) + 1e-18;
+}
+
+MPSphereD _MPSphereDMake2(MPVec3 a, MPVec3 b)
+{
+    MPSphereD s;
+    s.c[0] = 0.5 * ((double)a.x + b.x);
+    s.c[1] = 0.5 * ((double)a.y + b.y);
+    s.c[2] = 0.5 * ((double)a.z + b.z);
+    
+    double dx = a.x - s.c[0], dy = a.y - s.c[1], dz = a.z - s.c[2];
+    s.r2 = dx * dx + dy * dy + dz * dz;
+    
+    return s;
 }
 
-// NOTE: this method is faster than full collision detection, but is not guaranteed to catch all cases
-int _MPMeshVoxelCollision(const MPTriangle *faces, size_t n, const MPMesh *voxMesh, MPMat4 voxTransform)
+// circumscribed circle of a triangle. falls back to the longest side when the points are collinear.
+MPSphereD _MPSphereDMake3(MPVec3 a, MPVec3 b, MPVec3 c)
 {
-    int numInside = 0;
-    int numOutside = 0;
+    double u[3] = {(double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z};
+    double v[3] = {(double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z};
+    double w[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
     
-    size_t v, t;
-    for (v = 0; v < voxMesh->numVertices && !(numOutside && numInside); ++v)
+    double uu = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+    double vv = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    double ww = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    
+    if (ww <= 1e-12 * uu * vv)
     {
-        int inside = 1;
-        int on = 0;
+        MPSphereD ab = _MPSphereDMake2(a, b), ac = _MPSphereDMake2(a, c), bc = _MPSphereDMake2(b, c);
         
-        for (t = 0; t < n && inside; ++t)
-        {
-            MPVec3 vertex = *(MPVec3 *)((char *)voxMesh->vertexData + v * voxMesh->stride);
-            MPVec3ApplyTransform(&vertex, voxTransform);
-            
-            MPVec3 normal = MPTriangleNormal(faces[t]);
-            
-            float dot = MPVec3DotProduct(MPVec3Subtract(vertex, faces[t].v1), normal);
+        if (ab.r2 >= ac.r2 && ab.r2 >= bc.r2) return ab;
+        
+        return ac.r2 >= bc.r2 ? ac : bc;
+    }
+    
+    // a + (|v|^2 (w x u) + |u|^2 (v x w)) / 2|w|^2
+    double wu[3] = {w[1] * u[2] - w[2] * u[1], w[2] * u[0] - w[0] * u[2], w[0] * u[1] - w[1] * u[0]};
+    double vw[3] = {v[1] * w[2] - v[2] * w[1], v[2] * w[0] - v[0] * w[2], v[0] * w[1] - v[1] * w[0]};
+    
+    MPSphereD s;
+    s.r2 = 0.0;
+    
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        double offset = (vv * wu[i] + uu * vw[i]) / (2.0 * ww);
+        
+        s.c[i] = (double)a.v[i] + offset;
+        s.r2 += offset * offset;
+    }
+    
+    return s;
+}
+
+// circumscribed sphere of a tetrahedron. returns 0 if the points are coplanar.
+int _MPSphereDMake4(MPVec3 a, MPVec3 b, MPVec3 c, MPVec3 d, MPSphereD *s)
+{
+    double u[3] = {(double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z};
+    double v[3] = {(double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z};
+    double t[3] = {(double)d.x - a.x, (double)d.y - a.y, (double)d.z - a.z};
+    
+    double vt[3] = {v[1] * t[2] - v[2] * t[1], v[2] * t[0] - v[0] * t[2], v[0] * t[1] - v[1] * t[0]};
+    double tu[3] = {t[1] * u[2] - t[2] * u[1], t[2] * u[0] - t[0] * u[2], t[0] * u[1] - t[1] * u[0]};
+    double uv[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+    
+    double det = u[0] * vt[0] + u[1] * vt[1] + u[2] * vt[2];
+    
+    double uu = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+    double vv = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    double tt = t[0] * t[0] + t[1] * t[1] + t[2] * t[2];
+    
+    if (fabs(det) <= 1e-9 * sqrt(uu * vv * tt)) return 0;
+    
+    s->r2 = 0.0;
+    
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        double offset = (uu * vt[i] + vv * tu[i] + tt * uv[i]) / (2.0 * det);
+        
+        s->c[i] = (double)a.v[i] + offset;
+        s->r2 += offset * offset;
+    }
+    
+    return 1;
+}
+
+// Welzl's algorithm, unrolled into loops over the points that must lie on the boundary
+MPSphere _MPMinimalSphere(MPVec3 *points, int n)
+{
+    if (n == 0) return MPSphereMake(MPVec3Zero, 0.0f);
+    
+    // a random order makes the expected running time linear. the seed is fixed so that the same
+    // mesh always gets the same sphere.
+    unsigned int seed = 0x9E3779B9u;
+    
+    int i, j, k, l;
+    for (i = n - 1; i > 0; --i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        j = (int)(seed % (unsigned int)(i + 1));
+        
+        MPVec3 swap = points[i]; points[i] = points[j]; points[j] = swap;
+    }
+    
+    MPSphereD s = _MPSphereDMake2(points[0], points[0]);
+    
+    for (i = 1; i < n; ++i)
+    {
+        if (_MPSphereDContains(&s, points[i])) continue;
+        
+        s = _MPSphereDMake2(points[i], points[i]);
+        
+        for (j = 0; j < i; ++j)
+        {
+            if (_MPSphereDContains(&s, points[j])) continue;
+            
+            s = _MPSphereDMake2(points[i], points[j]);
             
-            if (dot >= 0.0f)
+            for (k = 0; k < j; ++k)
             {
-                inside = 0;
-                on = (dot == 0.0f);
+                if (_MPSphereDContains(&s, points[k])) continue;
+                
+                s = _MPSphereDMake3(points[i], points[j], points[k]);
+                
+                for (l = 0; l < k; ++l)
+                {
+                    if (_MPSphereDContains(&s, points[l])) continue;
+                    
+                    MPSphereD four;
+                    if (_MPSphereDMake4(points[i], points[j], points[k], points[l], &four))
+                    {
+                        s = four;
+                    }
+                    else
+                    {
+                        // coplanar, so the circle through three of them already passes the fourth
+                        s = _MPSphereDMake3(points[i], points[j], points[l]);
+                    }
+                }
+            }
+        }
+    }
+    
+    // rounding can leave a point just outside, so take the radius from the rounded center
+    MPVec3 center = MPVec3Make((float)s.c[0], (float)s.c[1], (float)s.c[2]);
+    float radius = 0.0f;
+    
+    for (i = 0; i < n; ++i)
+    {
+        radius = fmaxf(radius, MPVec3EuclideanDistance(center, points[i]));
+    }
+    
+    return MPSphereMake(center, nextafterf(radius, INFINITY));
+}
+
+// boxes are aligned with the principal axes of the mesh's surface, unless the axis aligned box is smaller
+MPOBox _MPMeshComputeOrientedBox(const MPMesh *mesh, const MPVec3 *points, int n, MPAABox bounds)
+{
+    MPOBox aligned = MPOBoxMakeWithAABox(bounds);
+    
+    const MPCollisionMesh *collision = MPMeshGetCollisionMesh(mesh);
+    
+    // covariance of the surface, treating each triangle as uniformly dense (Gottschalk)
+    double area = 0.0, mean[3] = {0.0, 0.0, 0.0}, moments[3][3] = {{0.0}};
+    
+    int i, a, b;
+    for (i = 0; i < (int)collision->numTriangles; ++i)
+    {
+        MPTriangle tri;
+        MPCollisionMeshGetTriangle(collision, i, tri.p);
+        
+        double triangleArea = 0.5 * MPVec3Length(MPVec3CrossProduct(MPVec3Subtract(tri.v2, tri.v1), MPVec3Subtract(tri.v3, tri.v1)));
+        if (triangleArea <= 0.0) continue;
+        
+        double centroid[3];
+        for (a = 0; a < 3; ++a)
+        {
+            centroid[a] = ((double)tri.v1.v[a] + tri.v2.v[a] + tri.v3.v[a]) / 3.0;
+            mean[a] += triangleArea * centroid[a];
+        }
+        
+        for (a = 0; a < 3; ++a)
+        {
+            for (b = 0; b < 3; ++b)
+            {
+                moments[a][b] += triangleArea / 12.0 * (9.0 * centroid[a] * centroid[b] +
+                                                       (double)tri.v1.v[a] * tri.v1.v[b] +
+                                                       (double)tri.v2.v[a] * tri.v2.v[b] +
+                                                       (double)tri.v3.v[a] * tri.v3.v[b]);
+            }
+        }
+        
+        area += triangleArea;
+    }
+    
+    if (area <= 0.0 || n == 0) return aligned;
+    
+    double covariance[3][3], axes[3][3];
+    
+    for (a = 0; a < 3; ++a)
+    {
+        for (b = 0; b < 3; ++b)
+        {
+            covariance[a][b] = moments[a][b] / area - (mean[a] / area) * (mean[b] / area);
+        }
+    }
+    
+    _MPSymmetricEigenvectors(covariance, axes);
+    
+    MPVec3 axis[3];
+    float lo[3], hi[3];
+    
+    for (a = 0; a < 3; ++a)
+    {
+        axis[a] = MPVec3Normalize(MPVec3Make((float)axes[0][a], (float)axes[1][a], (float)axes[2][a]));
+        lo[a] = INFINITY;
+        hi[a] = -INFINITY;
+    }
+    
+    for (i = 0; i < n; ++i)
+    {
+        for (a = 0; a < 3; ++a)
+        {
+            float d = MPVec3DotProduct(axis[a], points[i]);
+            
+            lo[a] = fminf(lo[a], d);
+            hi[a] = fmaxf(hi[a], d);
+        }
+    }
+    
+    MPOBox box;
+    box.center = MPVec3Zero;
+    
+    float volume = 1.0f, alignedVolume = 1.0f;
+    
+    for (a = 0; a < 3; ++a)
+    {
+        box.center = MPVec3Add(box.center, MPVec3MultiplyScalar(axis[a], 0.5f * (lo[a] + hi[a])));
+        box.halfAxes[a] = MPVec3MultiplyScalar(axis[a], 0.5f * (hi[a] - lo[a]));
+        
+        volume *= hi[a] - lo[a];
+        alignedVolume *= bounds.max.v[a] - bounds.min.v[a];
+    }
+    
+    return volume < alignedVolume ? box : aligned;
+}
+
+// cyclic Jacobi rotations. the eigenvectors are the columns of vectors.
+void _MPSymmetricEigenvectors(double a[3][3], double vectors[3][3])
+{
+    int i, j, k, sweep;
+    
+    for (i = 0; i < 3; ++i)
+    {
+        for (j = 0; j < 3; ++j)
+        {
+            vectors[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+    
+    for (sweep = 0; sweep < 32; ++sweep)
+    {
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+        
+        if (off <= 1e-24 * diagonal) break;
+        
+        int p, q;
+        for (p = 0; p < 2; ++p)
+        {
+            for (q = p + 1; q < 3; ++q)
+            {
+                if (a[p][q] == 0.0) continue;
+                
+                // rotate in the pq plane to zero a[p][q]
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                
+                for (k = 0; k < 3; ++k)
+                {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                
+                for (k = 0; k < 3; ++k)
+                {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                
+                for (k = 0; k < 3; ++k)
+                {
+                    double vkp = vectors[k][p], vkq = vectors[k][q];
+                    vectors[k][p] = c * vkp - s * vkq;
+                    vectors[k][q] = s * vkp + c * vkq;
+                }
             }
         }
+    }
+}
+
+size_t _MPMeshGetIndex(const MPMesh *mesh, size_t i)
+{
+    switch (mesh->indexSize)
+    {
+        case sizeof(unsigned char):  return ((const unsigned char *)mesh->indexData)[i];
+        case sizeof(unsigned short): return ((const unsigned short *)mesh->indexData)[i];
+        default:                     return ((const unsigned int *)mesh->indexData)[i];
+    }
+}
+
+// open addressing on the bit patterns of the coordinates, so only exactly equal positions are welded
+uint32_t _MPVec3Hash(MPVec3 v)
+{
+    uint32_t bits[3];
+    memcpy(bits, v.v, sizeof(bits));
+    
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+}
+
+void _MPMeshBuildCollisionMesh(MPMesh *mesh)
+{
+    MPCollisionMesh *collision = &((MPMeshPrivate *)mesh->_reserved)->collision;
+    
+    size_t numVertices = mesh->numVertices;
+    size_t numTriangles = MPMeshGetTriangleCount(mesh);
+    
+    size_t vertexCapacity = numVertices > 0 ? numVertices : 1;
+    
+    collision->x = malloc(vertexCapacity * sizeof(float));
+    collision->y = malloc(vertexCapacity * sizeof(float));
+    collision->z = malloc(vertexCapacity * sizeof(float));
+    collision->numVertices = 0;
+    
+    // welded index of each original vertex
+    uint32_t *welded = malloc(vertexCapacity * sizeof(uint32_t));
+    
+    size_t tableSize = 1;
+    while (tableSize < 2 * numVertices) tableSize <<= 1;
+    
+    uint32_t *table = malloc(tableSize * sizeof(uint32_t));
+    memset(table, 0xff, tableSize * sizeof(uint32_t));
+    
+    size_t i;
+    for (i = 0; i < numVertices; ++i)
+    {
+        MPVec3 p = *(const MPVec3 *)((const char *)mesh->vertexData + i * mesh->stride);
+        
+        // -0 and 0 are the same position, but not the same bits
+        p.x += 0.0f; p.y += 0.0f; p.z += 0.0f;
+        
+        size_t slot = _MPVec3Hash(p) & (tableSize - 1);
+        
+        while (table[slot] != UINT32_MAX)
+        {
+            uint32_t w = table[slot];
+            
+            if (collision->x[w] == p.x && collision->y[w] == p.y && collision->z[w] == p.z) break;
+            
+            slot = (slot + 1) & (tableSize - 1);
+        }
         
-        if (on || inside)
+        if (table[slot] == UINT32_MAX)
         {
-            ++numInside;
+            uint32_t w = collision->numVertices++;
+            
+            collision->x[w] = p.x;
+            collision->y[w] = p.y;
+            collision->z[w] = p.z;
+            
+            table[slot] = w;
         }
         
-        if (on || !inside)
+        welded[i] = table[slot];
+    }
+    
+    free(table);
+    
+    if (collision->numVertices > 0 && collision->numVertices < numVertices)
+    {
+        collision->x = realloc(collision->x, collision->numVertices * sizeof(float));
+        collision->y = realloc(collision->y, collision->numVertices * sizeof(float));
+        collision->z = realloc(collision->z, collision->numVertices * sizeof(float));
+    }
+    
+    size_t triangleCapacity = numTriangles > 0 ? numTriangles : 1;
+    
+    collision->indices = malloc(3 * triangleCapacity * sizeof(uint32_t));
+    collision->numTriangles = (uint32_t)numTriangles;
+    
+    size_t t;
+    for (t = 0; t < numTriangles; ++t)
+    {
+        int v;
+        for (v = 0; v < 3; ++v)
         {
-            ++numOutside;
+            collision->indices[3 * t + v] = welded[_MPMeshGetIndex(mesh, 3 * t + v)];
         }
     }
     
-    return (numInside && numOutside);
-}
\ No newline at end of file
+    free(welded);
+}
+
+void _MPCollisionMeshFree(MPCollisionMesh *mesh)
+{
+    free(mesh->x);
+    free(mesh->y);
+    free(mesh->z);
+    free(mesh->indices);
+}
+
+void _MPMeshBuildSphereTree(MPMesh *mesh)
+{
+    MPSphereTree *tree = &((MPMeshPrivate *)mesh->_reserved)->sphereTree;
+    memset(tree, 0, sizeof(MPSphereTree));
+    
+    int numTriangles = (int)MPMeshGetTriangleCount(mesh);
+    if (numTriangles == 0) return;
+    
+    MPTriangle *triangles = malloc(numTriangles * sizeof(MPTriangle));
+    MPVec3 *centroids = malloc(numTriangles * sizeof(MPVec3));
+    
+    tree->triangles = malloc(numTriangles * sizeof(int));
+    
+    int i;
+    for (i = 0; i < numTriangles; ++i)
+    {
+        MPMeshGetTriangle(mesh, i, triangles[i].p);
+        centroids[i] = MPVec3MultiplyScalar(MPVec3Add(MPVec3Add(triangles[i].v1, triangles[i].v2), triangles[i].v3), 1.0f / 3.0f);
+        
+        tree->triangles[i] = i;
+    }
+    
+    // every split is into two non-empty halves, so this is an upper bound on the node count
+    tree->nodes = malloc((2 * numTriangles - 1) * sizeof(MPSphereTreeNode));
+    
+    _MPSphereTreeBuildNode(tree, triangles, centroids, 0, numTriangles);
+    
+    tree->nodes = realloc(tree->nodes, tree->numNodes * sizeof(MPSphereTreeNode));
+    
+    _MPSphereTreeComputeInnerSpheres(tree, mesh, triangles, numTriangles);
+    
+    free(triangles);
+    free(centroids);
+}
+
+int _MPSphereTreeBuildNode(MPSphereTree *tree, const MPTriangle *triangles, const MPVec3 *centroids, int first, int count)
+{
+    int index = tree->numNodes++;
+    MPSphereTreeNode *node = &tree->nodes[index];
+    
+    MPAABox box = MPAABoxMake(MPVec3Make(INFINITY, INFINITY, INFINITY), MPVec3Make(-INFINITY, -INFINITY, -INFINITY));
+    MPAABox centroidBox = box;
+    
+    int i, v, a;
+    for (i = first; i < first + count; ++i)
+    {
+        int t = tree->triangles[i];
+        
+        for (a = 0; a < 3; ++a)
+        {
+            for (v = 0; v < 3; ++v)
+            {
+                box.min.v[a] = fminf(box.min.v[a], triangles[t].p[v].v[a]);
+                box.max.v[a] = fmaxf(box.max.v[a], triangles[t].p[v].v[a]);
+            }
+            
+            centroidBox.min.v[a] = fminf(centroidBox.min.v[a], centroids[t].v[a]);
+            centroidBox.max.v[a] = fmaxf(centroidBox.max.v[a], centroids[t].v[a]);
+        }
+    }
+    
+    MPVec3 center = MPVec3MultiplyScalar(MPVec3Add(box.min, box.max), 0.5f);
+    float radius = 0.0f;
+    
+    for (i = first; i < first + count; ++i)
+    {
+        for (v = 0; v < 3; ++v)
+        {
+            radius = fmaxf(radius, MPVec3EuclideanDistance(center, triangles[tree->triangles[i]].p[v]));
+        }
+    }
+    
+    node->sphere = MPSphereMake(center, radius);
+    node->children[0] = node->children[1] = -1;
+    node->first = first;
+    node->count = count;
+    
+    if (count > MP_SPHERE_TREE_LEAF_SIZE)
+    {
+        // split at the median centroid along the axis of greatest spread
+        MPVec3 extent = MPVec3Subtract(centroidBox.max, centroidBox.min);
+        int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+        
+        int half = count / 2;
+        _MPSphereTreeSelect(tree->triangles + first, centroids, axis, count, half);
+        
+        int left = _MPSphereTreeBuildNode(tree, triangles, centroids, first, half);
+        int right = _MPSphereTreeBuildNode(tree, triangles, centroids, first + half, count - half);
+        
+        node->children[0] = left;
+        node->children[1] = right;
+    }
+    
+    return index;
+}
+
+// partially sorts order so that the kth element is in place, with no greater elements before it
+void _MPSphereTreeSelect(int *order, const MPVec3 *centroids, int axis, int n, int k)
+{
+    int lo = 0, hi = n - 1;
+    
+    while (lo < hi)
+    {
+        float pivot = centroids[order[(lo + hi) / 2]].v[axis];
+        int i = lo, j = hi;
+        
+        while (i <= j)
+        {
+            while (centroids[order[i]].v[axis] < pivot) ++i;
+            while (centroids[order[j]].v[axis] > pivot) --j;
+            
+            if (i <= j)
+            {
+                int tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+                
+                ++i; --j;
+            }
+        }
+        
+        if (k <= j)       hi = j;
+        else if (k >= i)  lo = i;
+        else              break;
+    }
+}
+
+int _MPSphereCompareRadiusDescending(const void *a, const void *b)
+{
+    float ra = ((const MPSphere *)a)->radius;
+    float rb = ((const MPSphere *)b)->radius;
+    
+    return (ra < rb) - (ra > rb);
+}
+
+void _MPSphereTreeComputeInnerSpheres(MPSphereTree *tree, const MPMesh *mesh, const MPTriangle *triangles, int numTriangles)
+{
+    const int samples = MP_SPHERE_TREE_INNER_SAMPLES;
+    
+    MPAABox box = MPAABoxMake(MPVec3Make(INFINITY, INFINITY, INFINITY), MPVec3Make(-INFINITY, -INFINITY, -INFINITY));
+    
+    int i, j, k, t;
+    for (t = 0; t < numTriangles; ++t)
+    {
+        for (i = 0; i < 3; ++i)
+        {
+            for (j = 0; j < 3; ++j)
+            {
+                box.min.v[j] = fminf(box.min.v[j], triangles[t].p[i].v[j]);
+                box.max.v[j] = fmaxf(box.max.v[j], triangles[t].p[i].v[j]);
+            }
+        }
+    }
+    
+    MPVec3 size = MPVec3Subtract(box.max, box.min);
+    
+    MPSphere candidates[MP_SPHERE_TREE_INNER_SAMPLES * MP_SPHERE_TREE_INNER_SAMPLES * MP_SPHERE_TREE_INNER_SAMPLES];
+    int numCandidates = 0;
+    
+    for (i = 0; i < samples; ++i)
+    {
+        for (j = 0; j < samples; ++j)
+        {
+            for (k = 0; k < samples; ++k)
+            {
+                MPVec3 p = MPVec3Make(box.min.x + (i + 0.5f) * size.x / samples,
+                                      box.min.y + (j + 0.5f) * size.y / samples,
+                                      box.min.z + (k + 0.5f) * size.z / samples);
+                
+                // the largest sphere about p that doesn't cross the surface
+                float radius = _MPSphereTreeDistance(tree, triangles, p);
+                
+                if (radius <= 0.0f) continue;
+                
+                if (_MPSphereTreeContainsPoint(tree, mesh, p))
+                {
+                    candidates[numCandidates++] = MPSphereMake(p, radius);
+                }
+            }
+        }
+    }
+    
+    if (numCandidates == 0) return;
+    
+    // greedily take the largest spheres, skipping those centered inside one already taken
+    qsort(candidates, numCandidates, sizeof(MPSphere), _MPSphereCompareRadiusDescending);
+    
+    tree->innerSpheres = malloc(MP_SPHERE_TREE_MAX_INNER * sizeof(MPSphere));
+    
+    for (i = 0; i < numCandidates && tree->numInnerSpheres < MP_SPHERE_TREE_MAX_INNER; ++i)
+    {
+        int covered = 0;
+        
+        for (j = 0; j < tree->numInnerSpheres && !covered; ++j)
+        {
+            covered = (MPVec3EuclideanDistance(candidates[i].center, tree->innerSpheres[j].center) < tree->innerSpheres[j].radius);
+        }
+        
+        if (!covered)
+        {
+            tree->innerSpheres[tree->numInnerSpheres++] = candidates[i];
+        }
+    }
+    
+    tree->innerSpheres = realloc(tree->innerSpheres, tree->numInnerSpheres * sizeof(MPSphere));
+}
+
+float _MPSphereTreeDistance(const MPSphereTree *tree, const MPTriangle *triangles, MPVec3 p)
+{
+    int stackBuffer[MP_SPHERE_TREE_STACK_SIZE];
+    int *stack = stackBuffer;
+    int capacity = MP_SPHERE_TREE_STACK_SIZE;
+    int top = 0;
+    
+    float distance = INFINITY;
+    
+    stack[top++] = 0;
+    
+    // nodes are visited nearest first, and skipped once they are farther than the nearest triangle so far
+    while (top > 0)
+    {
+        const MPSphereTreeNode *node = &tree->nodes[stack[--top]];
+        
+        if (MPVec3EuclideanDistance(p, node->sphere.center) - node->sphere.radius >= distance) continue;
+        
+        if (node->children[0] < 0)
+        {
+            int i;
+            for (i = 0; i < node->count; ++i)
+            {
+                MPTriangle tri = triangles[tree->triangles[node->first + i]];
+                
+                distance = fminf(distance, MPVec3EuclideanDistance(p, MPTriangleClosestPoint(tri, p)));
+            }
+            
+            continue;
+        }
+        
+        const MPSphereTreeNode *left = &tree->nodes[node->children[0]];
+        const MPSphereTreeNode *right = &tree->nodes[node->children[1]];
+        
+        int nearest = MPVec3EuclideanDistance(p, left->sphere.center) - left->sphere.radius <=
+                      MPVec3EuclideanDistance(p, right->sphere.center) - right->sphere.radius ? 0 : 1;
+        
+        _MPStackReserve(&stack, &capacity, stackBuffer, top + 2);
+        
+        stack[top++] = node->children[1 - nearest];
+        stack[top++] = node->children[nearest];
+    }
+    
+    if (stack != stackBuffer) free(stack);
+    
+    return distance;
+}
+
+// p is inside if rays in every direction cross the surface an odd number of times. through a hole
+// in an open mesh, or along the side of a surface, some won't.
+int _MPSphereTreeContainsPoint(const MPSphereTree *tree, const MPMesh *mesh, MPVec3 p)
+{
+    // off the axes and diagonals, so that rays rarely graze the edges of axis aligned faces
+    MPVec3 directions[3];
+    directions[0] = MPVec3Normalize(MPVec3Make(1.0f, 0.3183f, 0.1415f));
+    directions[1] = MPVec3Normalize(MPVec3Make(-0.2718f, 1.0f, 0.1732f));
+    directions[2] = MPVec3Normalize(MPVec3Make(0.1414f, -0.2236f, 1.0f));
+    
+    int d, sign;
+    for (d = 0; d < 3; ++d)
+    {
+        for (sign = -1; sign <= 1; sign += 2)
+        {
+            int crossings = _MPSphereTreeCountCrossings(tree, mesh, p, MPVec3MultiplyScalar(directions[d], (float)sign));
+            
+            if (crossings <= 0 || crossings % 2 == 0) return 0;
+        }
+    }
+    
+    return 1;
+}
+
+// returns the number of triangles crossed by the ray from p along direction (a unit vector), visiting
+// only the nodes whose spheres it passes through, or -1 if it comes too close to an edge to count them
+int _MPSphereTreeCountCrossings(const MPSphereTree *tree, const MPMesh *mesh, MPVec3 p, MPVec3 direction)
+{
+    int stackBuffer[MP_SPHERE_TREE_STACK_SIZE];
+    int *stack = stackBuffer;
+    int capacity = MP_SPHERE_TREE_STACK_SIZE;
+    int top = 0;
+    
+    int crossings = 0;
+    
+    stack[top++] = 0;
+    
+    while (top > 0 && crossings >= 0)
+    {
+        const MPSphereTreeNode *node = &tree->nodes[stack[--top]];
+        
+        // distance from the sphere's center to the ray, with some slack for the rounding of both
+        MPVec3 toCenter = MPVec3Subtract(node->sphere.center, p);
+        float along = fmaxf(MPVec3DotProduct(toCenter, direction), 0.0f);
+        
+        if (MPVec3Length(MPVec3Subtract(toCenter, MPVec3MultiplyScalar(direction, along))) > 1.0001f * node->sphere.radius + 1e-6f) continue;
+        
+        if (node->children[0] < 0)
+        {
+            int i;
+            for (i = 0; i < node->count && crossings >= 0; ++i)
+            {
+                MPTriangle triangle;
+                MPMeshGetTriangle(mesh, tree->triangles[node->first + i], triangle.p);
+                
+                int crossed = _MPRayCrossesTriangle(triangle, p, direction);
+                
+                crossings = crossed < 0 ? -1 : crossings + crossed;
+            }
+            
+            continue;
+        }
+        
+        _MPStackReserve(&stack, &capacity, stackBuffer, top + 2);
+        
+        stack[top++] = node->children[0];
+        stack[top++] = node->children[1];
+    }
+    
+    if (stack != stackBuffer) free(stack);
+    
+    return crossings;
+}
+
+// returns 1 if the ray crosses the triangle, 0 if it misses, or -1 if it passes too close to an edge to tell
+// (Moller and Trumbore, Fast, Minimum Storage Ray/Triangle Intersection, in double precision)
+int _MPRayCrossesTriangle(MPTriangle tri, MPVec3 p, MPVec3 direction)
+{
+    const double tolerance = 1e-6;
+    
+    double e1[3], e2[3], s[3], d[3];
+    
+    int a;
+    for (a = 0; a < 3; ++a)
+    {
+        e1[a] = (double)tri.v2.v[a] - tri.v1.v[a];
+        e2[a] = (double)tri.v3.v[a] - tri.v1.v[a];
+        s[a] = (double)p.v[a] - tri.v1.v[a];
+        d[a] = direction.v[a];
+    }
+    
+    double h[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+    double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    
+    double det = e1[0] * h[0] + e1[1] * h[1] + e1[2] * h[2];
+    
+    // a ray in the triangle's plane (or a degenerate triangle) crosses the neighbouring triangles instead
+    if (det == 0.0) return 0;
+    
+    double u = (s[0] * h[0] + s[1] * h[1] + s[2] * h[2]) / det;
+    double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+    double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+    
+    if (t <= 0.0 || u < -tolerance || v < -tolerance || u + v > 1.0 + tolerance) return 0;
+    
+    if (u < tolerance || v < tolerance || u + v > 1.0 - tolerance) return -1;
+    
+    return 1;
+}
+
+// returns the smaller of the distance between the triangles and limit. if the triangles don't
+// intersect, the nearest points are a vertex of one and a point of the other, or lie on an edge of each
+float _MPTrianglesDistance(MPTriangle t1, MPTriangle t2, float limit)
+{
+    // most pairs are ruled out by the gap between one triangle and the other's plane
+    if (fmaxf(_MPTrianglePlaneGap(t1, t2), _MPTrianglePlaneGap(t2, t1)) >= limit) return limit;
+    
+    if (MPTrianglesIntersect(t1, t2)) return 0.0f;
+    
+    float distance = limit;
+    
+    int i, j;
+    for (i = 0; i < 3; ++i)
+    {
+        distance = fminf(distance, MPVec3EuclideanDistance(t1.p[i], MPTriangleClosestPoint(t2, t1.p[i])));
+        distance = fminf(distance, MPVec3EuclideanDistance(t2.p[i], MPTriangleClosestPoint(t1, t2.p[i])));
+        
+        for (j = 0; j < 3; ++j)
+        {
+            distance = fminf(distance, _MPSegmentsDistance(t1.p[i], t1.p[(i + 1) % 3], t2.p[j], t2.p[(j + 1) % 3]));
+        }
+    }
+    
+    return distance;
+}
+
+// the distance from the plane of t to the nearest vertex of other, if all of other lies on one side
+// of it (a lower bound on the distance between the triangles), and 0 otherwise
+float _MPTrianglePlaneGap(MPTriangle t, MPTriangle other)
+{
+    MPVec3 normal = MPVec3CrossProduct(MPVec3Subtract(t.v2, t.v1), MPVec3Subtract(t.v3, t.v1));
+    float length = MPVec3Length(normal);
+    
+    if (length <= 0.0f) return 0.0f;
+    
+    float d1 = MPVec3DotProduct(normal, MPVec3Subtract(other.v1, t.v1)) / length;
+    float d2 = MPVec3DotProduct(normal, MPVec3Subtract(other.v2, t.v1)) / length;
+    float d3 = MPVec3DotProduct(normal, MPVec3Subtract(other.v3, t.v1)) / length;
+    
+    if (d1 > 0.0f && d2 > 0.0f && d3 > 0.0f) return fminf(fminf(d1, d2), d3);
+    if (d1 < 0.0f && d2 < 0.0f && d3 < 0.0f) return -fmaxf(fmaxf(d1, d2), d3);
+    
+    return 0.0f;
+}
+
+// (Ericson, Real-Time Collision Detection, 5.1.9)
+float _MPSegmentsDistance(MPVec3 p1, MPVec3 q1, MPVec3 p2, MPVec3 q2)
+{
+    MPVec3 d1 = MPVec3Subtract(q1, p1);
+    MPVec3 d2 = MPVec3Subtract(q2, p2);
+    MPVec3 r = MPVec3Subtract(p1, p2);
+    
+    float a = MPVec3DotProduct(d1, d1);
+    float e = MPVec3DotProduct(d2, d2);
+    float f = MPVec3DotProduct(d2, r);
+    
+    float s = 0.0f, t = 0.0f;
+    
+    if (a <= 0.0f && e <= 0.0f)
+    {
+        return MPVec3Length(r);
+    }
+    
+    if (a <= 0.0f)
+    {
+        t = fminf(fmaxf(f / e, 0.0f), 1.0f);
+    }
+    else
+    {
+        float c = MPVec3DotProduct(d1, r);
+        
+        if (e <= 0.0f)
+        {
+            s = fminf(fmaxf(-c / a, 0.0f), 1.0f);
+        }
+        else
+        {
+            float b = MPVec3DotProduct(d1, d2);
+            float denom = a * e - b * b;
+            
+            // parallel segments have no unique nearest pair, so start from either end
+            s = denom > 0.0f ? fminf(fmaxf((b * f - c * e) / denom, 0.0f), 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = fminf(fmaxf(-c / a, 0.0f), 1.0f);
+            }
+            else if (t > 1.0f)
+            {
+                t = 1.0f;
+                s = fminf(fmaxf((b - c) / a, 0.0f), 1.0f);
+            }
+        }
+    }
+    
+    MPVec3 c1 = MPVec3Add(p1, MPVec3MultiplyScalar(d1, s));
+    MPVec3 c2 = MPVec3Add(p2, MPVec3MultiplyScalar(d2, t));
+    
+    return MPVec3EuclideanDistance(c1, c2);
+}
+
+void _MPStackReserve(int **stack, int *capacity, int *buffer, int needed)
+{
+    if (needed <= *capacity) return;
+    
+    int grown = 2 * needed;
+    
+    if (*stack == buffer)
+    {
+        *stack = malloc(grown * sizeof(int));
+        memcpy(*stack, buffer, *capacity * sizeof(int));
+    }
+    else
+    {
+        *stack = realloc(*stack, grown * sizeof(int));
+    }
+    
+    *capacity = grown;
+}
+
+MPSphere _MPSphereTransform(MPSphere sphere, MPMat4 transform, float scale)
+{
+    return MPSphereMake(MPMat4TransformVec3(transform, sphere.center), sphere.radius * scale);
+}
+
+int _MPMeshPiecesIntersect(const MPConvexDecomposition *decomposition1, MPMat4 transform1, float scale1, const MPConvexDecomposition *decomposition2, MPMat4 transform2, float scale2)
+{
+    // without pieces there is nothing to reject with
+    if (decomposition1->numPieces == 0 || decomposition2->numPieces == 0) return 1;
+
+    int i, j;
+    for (i = 0; i < decomposition1->numPieces; ++i)
+    {
+        const MPConvexPiece *piece1 = &decomposition1->pieces[i];
+        MPSphere sphere1 = _MPSphereTransform(piece1->sphere, transform1, scale1);
+
+        for (j = 0; j < decomposition2->numPieces; ++j)
+        {
+            const MPConvexPiece *piece2 = &decomposition2->pieces[j];
+
+            if (!MPSphereIntersectsSphere(sphere1, _MPSphereTransform(piece2->sphere, transform2, scale2))) continue;
+
+            if (MPConvexHullsIntersect(&decomposition1->vertices[piece1->first], piece1->count, transform1,
+                                       &decomposition2->vertices[piece2->first], piece2->count, transform2))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int _MPSphereTouchesLeaf(MPSphere sphere, const MPMesh *mesh, const MPSphereTree *tree, const MPSphereTreeNode *leaf, MPMat4 transform)
+{
+    const MPCollisionMesh *collision = MPMeshGetCollisionMesh(mesh);
+    
+    MPTriangle tri;
+    
+    int i;
+    for (i = 0; i < leaf->count; ++i)
+    {
+        MPCollisionMeshGetTriangle(collision, tree->triangles[leaf->first + i], tri.p);
+        MPTriangleApplyTransform(&tri, transform);
+        
+        if (MPVec3EuclideanDistance(sphere.center, MPTriangleClosestPoint(tri, sphere.center)) <= sphere.radius)
+        {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+int _MPMeshLeavesIntersect(const MPCollisionMesh *mesh1, const MPSphereTree *tree1, const MPSphereTreeNode *leaf1, MPMat4 transform1,
+                           const MPCollisionMesh *mesh2, const MPSphereTree *tree2, const MPSphereTreeNode *leaf2, MPMat4 transform2)
+{
+    // triangles are compared in the frame of mesh1
+    MPMat4 relative = MPMat4Multiply(MPMat4InvertAffine(transform1), transform2);
+    
+    MPTriangle others[MP_SPHERE_TREE_LEAF_SIZE];
+    
+    int i, j;
+    for (j = 0; j < leaf2->count; ++j)
+    {
+        MPCollisionMeshGetTriangle(mesh2, tree2->triangles[leaf2->first + j], others[j].p);
+    }
+    
+    MPMat4TransformVec3Array(relative, others[0].p, others[0].p, 3 * leaf2->count);
+    
+    MPTriangle tri;
+    
+    for (i = 0; i < leaf1->count; ++i)
+    {
+        MPCollisionMeshGetTriangle(mesh1, tree1->triangles[leaf1->first + i], tri.p);
+        
+        MPTrianglePlane plane = MPTrianglePlaneMake(tri);
+        
+        for (j = 0; j < leaf2->count; ++j)
+        {
+            if (MPTrianglesIntersectWithPlane(&plane, others[j]))
+            {
+                return 1;
+            }
+        }
+    }
+    
+    return 0;
+}
+
+// depth limit keeps degenerate (very long, thin) triangles from exploding the sphere count
+#define MP_SURFACE_SPHERE_MAX_DEPTH 8
+
+void _MPMeshAddSurfaceSpheres(MPTriangle t, float maxRadius, int depth, MPSphere **spheres, int *count, int *arraySize)
+{
+    MPVec3 center = MPVec3MultiplyScalar(MPVec3Add(MPVec3Add(t.v1, t.v2), t.v3), 1.0f / 3.0f);
+    
+    float radius = fmaxf(MPVec3EuclideanDistance(center, t.v1), MPVec3EuclideanDistance(center, t.v2));
+    radius = fmaxf(radius, MPVec3EuclideanDistance(center, t.v3));
+    
+    if (radius > maxRadius && depth < MP_SURFACE_SPHERE_MAX_DEPTH)
+    {
+        // split into four triangles at the edge midpoints
+        MPVec3 m12 = MPVec3MultiplyScalar(MPVec3Add(t.v1, t.v2), 0.5f);
+        MPVec3 m23 = MPVec3MultiplyScalar(MPVec3Add(t.v2, t.v3), 0.5f);
+        MPVec3 m31 = MPVec3MultiplyScalar(MPVec3Add(t.v3, t.v1), 0.5f);
+        
+        MPTriangle sub[4] = {{{t.v1, m12, m31}}, {{m12, t.v2, m23}}, {{m31, m23, t.v3}}, {{m12, m23, m31}}};
+        
+        int i;
+        for (i = 0; i < 4; ++i)
+        {
+            _MPMeshAddSurfaceSpheres(sub[i], maxRadius, depth + 1, spheres, count, arraySize);
+        }
+        
+        return;
+    }
+    
+    if (*count >= *arraySize)
+    {
+        // double array if necessary
+        *spheres = realloc(*spheres, 2 * (*arraySize) * sizeof(MPSphere));
+        *arraySize *= 2;
+    }
+    
+    (*spheres)[*count] = MPSphereMake(center, radius);
+    ++(*count);
+}
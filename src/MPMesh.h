@@ -11,6 +11,7 @@
 #define _MPMesh_h
 
 #include <stddef.h>
+#include <stdint.h>
 #include "MPMath.h"
 
 #if defined(__cplusplus)
@@ -32,19 +33,111 @@ typedef struct _MPMesh
     void *_reserved;
 } MPMesh;
     
+/* the mesh geometry in the form used for collision checking, built when the mesh is created.
+   vertices with identical positions are welded together and their coordinates kept in separate
+   arrays. triangle n here is triangle n of the mesh. */
+typedef struct _MPCollisionMesh
+{
+    float *x, *y, *z;
+    uint32_t numVertices;
+    
+    uint32_t *indices;      // 3 per triangle
+    uint32_t numTriangles;
+} MPCollisionMesh;
+    
+/* copies the vertices of triangle n of the collision mesh into triangle. */
+static inline void MPCollisionMeshGetTriangle(const MPCollisionMesh *mesh, size_t n, MPVec3 *triangle)
+{
+    const uint32_t *index = mesh->indices + 3 * n;
+    
+    triangle[0] = MPVec3Make(mesh->x[index[0]], mesh->y[index[0]], mesh->z[index[0]]);
+    triangle[1] = MPVec3Make(mesh->x[index[1]], mesh->y[index[1]], mesh->z[index[1]]);
+    triangle[2] = MPVec3Make(mesh->x[index[2]], mesh->y[index[2]], mesh->z[index[2]]);
+}
+    
+/* a node of a mesh's sphere tree. leaves have children {-1, -1} and cover
+   triangles [first, first + count) of the tree's triangle list. */
+typedef struct _MPSphereTreeNode
+{
+    MPSphere sphere;
+    int children[2];
+    int first;
+    int count;
+} MPSphereTreeNode;
+    
+/* a hierarchy of spheres enclosing the mesh (the root is node 0), along with a
+   few spheres contained inside the volume of the mesh. */
+typedef struct _MPSphereTree
+{
+    MPSphereTreeNode *nodes;
+    int numNodes;
+    
+    int *triangles;  // mesh triangle indices, grouped by leaf
+    
+    MPSphere *innerSpheres;
+    int numInnerSpheres;
+} MPSphereTree;
+    
+/* a convex piece of a mesh's approximate convex decomposition: the convex hull of vertices
+   [first, first + count) of the decomposition's vertex list, and a sphere enclosing it. */
+typedef struct _MPConvexPiece
+{
+    MPSphere sphere;
+    int first;
+    int count;
+} MPConvexPiece;
+    
+/* a few convex pieces whose union covers the mesh (surface and interior). */
+typedef struct _MPConvexDecomposition
+{
+    MPConvexPiece *pieces;
+    int numPieces;
+    
+    MPVec3 *vertices;
+    int numVertices;
+} MPConvexDecomposition;
+    
+/* data derived from the mesh geometry when a mesh is created. it can be stored alongside the
+   mesh and handed back to MPMeshCreateWithPrecomputed to skip that work. */
+typedef struct _MPMeshPrecomputed
+{
+    MPVec3 extremePoints[6]; // left, bottom, far, right, top, near
+    MPSphere boundingSphere;
+    MPOBox orientedBox;
+    MPSphereTree sphereTree;
+    MPConvexDecomposition decomposition;
+    MPCollisionMesh collision;
+} MPMeshPrecomputed;
+    
+/* called when a mesh is freed, to release the vertex and index data it was created with. */
+typedef void (*MPMeshDataDeallocator)(MPMesh *mesh, void *context);
+    
 /* initialize a new mesh. mesh members shouldn't be changed after creation. */
 MPMesh* MPMeshCreate(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices);
     
+/* initialize a new mesh using precomputed data instead of deriving it from the geometry. the
+   sphere tree, decomposition and collision mesh arrays are referenced, not copied, so they must
+   outlive the mesh. */
+MPMesh* MPMeshCreateWithPrecomputed(const MPVec3 *vertexData, size_t stride, size_t numVertices, const void *indexData, size_t indexSize, size_t numIndices, const MPMeshPrecomputed *precomputed);
+    
 /* initialize a new mesh that is a 1x1x1 cube. Origin of mesh is the center. */
 MPMesh* MPMeshCreateCube();
 
 /* free all memory used by the mesh, including the mesh itself. */
 void MPMeshFree(MPMesh *mesh);
 
+/* sets the function called to release the mesh's vertex and index data when it is freed.
+   by default the mesh doesn't own its data. */
+void MPMeshSetDataDeallocator(MPMesh *mesh, MPMeshDataDeallocator deallocator, void *context);
+    
+/* deallocator for data that was allocated with malloc. */
+void MPMeshFreeData(MPMesh *mesh, void *context);
+    
 /* increment the retain counter of the given mesh, signaling that it is use and shouldn't be freed. */
 void MPMeshRetain(MPMesh *mesh);
 
-/* decrement the retain counter of the given mesh. the mesh will be freed if its retain count reaches 0. */
+/* decrement the retain counter of the given mesh. the mesh will be freed if its retain count reaches 0.
+   retain and release are atomic, so a mesh can be shared between threads. */
 void MPMeshRelease(MPMesh *mesh);
     
 int MPMeshGetRefCount(const MPMesh *mesh);
@@ -55,17 +148,54 @@ size_t MPMeshGetTriangleCount(const MPMesh *mesh);
 /* finds vertices of the nth triangle in the triangulation. 
    when the method returns, the array pointed to by triangle will contain the 3 vertices. */
 void MPMeshGetTriangle(const MPMesh *mesh, size_t n, MPVec3 *triangle);
+    
+/* fills triangles (MPMeshGetTriangleCount of them) with every triangle of the mesh under the transform. */
+void MPMeshGetTransformedTriangles(const MPMesh *mesh, MPMat4 transform, MPTriangle *triangles);
 
 /* returns the extreme points of the mesh. order is: left, bottom, far, right, top, near */
 const MPVec3* MPMeshGetExtremePoints(const MPMesh *mesh);
     
-/* returns the bounding sphere of the mesh using the given transform. pass NULL to use identity. */
+/* returns the smallest sphere enclosing the mesh using the given transform. pass NULL to use identity. */
 MPSphere MPMeshGetBoundingSphere(const MPMesh *mesh, const MPMat4 *transform);
     
+/* returns a box enclosing the mesh, aligned with its principal axes, using the given transform.
+   pass NULL to use identity. */
+MPOBox MPMeshGetOrientedBox(const MPMesh *mesh, const MPMat4 *transform);
+    
+/* returns the sphere tree of the mesh, which is built when the mesh is created. */
+const MPSphereTree* MPMeshGetSphereTree(const MPMesh *mesh);
+    
+/* returns the convex decomposition of the mesh, which is built when the mesh is created. */
+const MPConvexDecomposition* MPMeshGetConvexDecomposition(const MPMesh *mesh);
+    
+/* returns the collision representation of the mesh. */
+const MPCollisionMesh* MPMeshGetCollisionMesh(const MPMesh *mesh);
+    
+/* copies the data that was computed for the mesh when it was created. */
+void MPMeshGetPrecomputed(const MPMesh *mesh, MPMeshPrecomputed *precomputed);
+    
+/* returns 1 if the meshes, under the given transforms, intersect: their surfaces touch, or one
+   lies entirely inside the other (a closed) one. the meshes' convex pieces reject pairs that are
+   apart, the sphere trees cull pairs of triangles that can't touch and accept overlapping volumes
+   early; otherwise the triangles are tested exactly, and a vertex of each mesh is tested for
+   being inside the other. */
+int MPMeshesIntersect(const MPMesh *mesh1, MPMat4 transform1, const MPMesh *mesh2, MPMat4 transform2);
+    
+/* returns the distance between the surfaces of the meshes under the given transforms (0 if they
+   touch), or limit if they are at least that far apart. the sphere trees skip pairs of nodes
+   that can't be nearer than the closest triangles found so far. one mesh lying entirely inside
+   the other is not detected, but is by MPMeshesIntersect. */
+float MPMeshesDistance(const MPMesh *mesh1, MPMat4 transform1, const MPMesh *mesh2, MPMat4 transform2, float limit);
+    
 /* returns points relative to mesh origin that are active in the voxel grid. assumes mesh origin is at the center.
     @note return value must be freed. */
 MPVec3* MPMeshGetVoxels(const MPMesh *mesh, MPVec3 scale, float voxelSize, int *n);
     
+/* returns spheres relative to mesh origin whose union covers every triangle of the mesh.
+   triangles are subdivided until each sphere has radius at most maxRadius.
+    @note return value must be freed. */
+MPSphere* MPMeshGetSurfaceSpheres(const MPMesh *mesh, float maxRadius, int *n);
+    
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,209 @@
+//
+//  MPMeshCache.cpp
+//
+
+#include "MPMeshCache.h"
+#include "MPReader.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace MP
+{
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+#pragma mark - public methods
+
+MeshCache& MeshCache::shared()
+{
+    static MeshCache cache;
+
+    return cache;
+}
+
+MeshCache::~MeshCache()
+{
+    for (auto it = this->meshes_.begin(); it != this->meshes_.end(); ++it)
+    {
+        MPMeshRelease(it->second);
+    }
+}
+
+MPMesh* MeshCache::acquire(const std::string &path, std::ostream &errors)
+{
+    uint64_t size;
+    int64_t modified;
+
+    if (!this->fileStamp_(path, size, modified))
+    {
+        errors << "error: cannot open " << path << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+
+        auto it = this->files_.find(path);
+
+        if (it != this->files_.end() && it->second.size == size && it->second.modified == modified)
+        {
+            MPMesh *mesh = this->find_(it->second.key);
+
+            if (mesh != nullptr)
+            {
+                return mesh;
+            }
+        }
+    }
+
+    // the file is new or has changed, so hash its contents to find any copy of it
+    ContentKey key;
+    key.size = size;
+
+    if (!this->contentHash_(path, key.hash))
+    {
+        errors << "error: cannot open " << path << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+
+        FileRecord &record = this->files_[path];
+        record.size = size;
+        record.modified = modified;
+        record.key = key;
+
+        MPMesh *mesh = this->find_(key);
+
+        if (mesh != nullptr)
+        {
+            return mesh;
+        }
+    }
+
+    // load without holding the lock, so different meshes can load at the same time
+    MPMesh *mesh = Reader(path, errors).generateMesh();
+
+    if (mesh == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    auto inserted = this->meshes_.insert(std::make_pair(key, mesh));
+
+    if (!inserted.second)
+    {
+        // another thread loaded the same mesh first, so use that one
+        MPMeshFree(mesh);
+
+        mesh = inserted.first->second;
+    }
+    else
+    {
+        // the cache's reference
+        MPMeshRetain(mesh);
+    }
+
+    MPMeshRetain(mesh);
+
+    return mesh;
+}
+
+void MeshCache::purge()
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    for (auto it = this->meshes_.begin(); it != this->meshes_.end();)
+    {
+        // new references are only handed out under the lock, so a count of 1 means only the cache holds it
+        if (MPMeshGetRefCount(it->second) == 1)
+        {
+            MPMeshRelease(it->second);
+            it = this->meshes_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+size_t MeshCache::size()
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    return this->meshes_.size();
+}
+
+#pragma mark - private methods
+
+MPMesh* MeshCache::find_(const ContentKey &key)
+{
+    auto it = this->meshes_.find(key);
+
+    if (it == this->meshes_.end())
+    {
+        return nullptr;
+    }
+
+    MPMeshRetain(it->second);
+
+    return it->second;
+}
+
+bool MeshCache::fileStamp_(const std::string &path, uint64_t &size, int64_t &modified)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+    {
+        return false;
+    }
+
+    size = (uint64_t)info.st_size;
+
+#ifdef __APPLE__
+    modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+
+    return true;
+}
+
+// FNV-1a over the file's bytes
+bool MeshCache::contentHash_(const std::string &path, uint64_t &hash)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    hash = FNV_OFFSET_BASIS;
+
+    unsigned char buffer[64 * 1024];
+    size_t count;
+
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            hash = (hash ^ buffer[i]) * FNV_PRIME;
+        }
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+
+    return ok;
+}
+
+}
@@ -0,0 +1,84 @@
+//
+//  MPMeshCache.h
+//
+//  A process-wide registry of meshes loaded from files. Meshes are identified by the hash and
+//  size of their file's contents rather than the path alone, so an edited file is loaded again,
+//  while the same mesh imported by many environments (or under different paths) is parsed and
+//  preprocessed once and shared. A file is only hashed the first time its path is seen, or when
+//  its size or modification time has changed since. Meshes are treated as immutable once
+//  they are in the cache, which is what makes sharing them between threads safe.
+
+#ifndef __MPMeshCache__
+#define __MPMeshCache__
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "MPMesh.h"
+
+namespace MP
+{
+
+class MeshCache
+{
+public:
+    /* the cache shared by all readers. */
+    static MeshCache& shared();
+
+    MeshCache() {}
+    ~MeshCache();
+
+    /* returns the mesh in the file at path, loading it if no file with the same contents has
+       been loaded. the mesh is retained for the caller, who must release it. returns nullptr
+       if the file can't be read, and writes any errors in it to errors. safe to call from
+       multiple threads. */
+    MPMesh* acquire(const std::string &path, std::ostream &errors = std::cout);
+
+    /* releases the cache's hold on meshes that no one else is using. */
+    void purge();
+
+    size_t size();
+
+private:
+    /* identifies a file's contents */
+    struct ContentKey
+    {
+        uint64_t hash;
+        uint64_t size;
+
+        bool operator==(const ContentKey &other) const { return hash == other.hash && size == other.size; }
+    };
+
+    struct ContentKeyHash
+    {
+        size_t operator()(const ContentKey &key) const { return (size_t)(key.hash ^ key.size); }
+    };
+
+    /* what was last seen at a path */
+    struct FileRecord
+    {
+        uint64_t size;
+        int64_t modified;   // nanoseconds
+        ContentKey key;
+    };
+
+    std::mutex mutex_;
+
+    std::unordered_map<ContentKey, MPMesh *, ContentKeyHash> meshes_;  // mesh (retained)
+    std::unordered_map<std::string, FileRecord> files_;
+
+    MeshCache(const MeshCache &) = delete;
+    MeshCache& operator=(const MeshCache &) = delete;
+
+    /* returns the cached mesh for key, retained for the caller, or nullptr. the lock must be held. */
+    MPMesh* find_(const ContentKey &key);
+
+    bool fileStamp_(const std::string &path, uint64_t &size, int64_t &modified);
+    bool contentHash_(const std::string &path, uint64_t &hash);
+};
+
+}
+
+#endif
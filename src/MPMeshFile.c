@@ -0,0 +1,401 @@
+//
+//  MPMeshFile.c
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MPMeshFile.h"
+
+#pragma mark - private definitions
+
+#define MP_MESH_FILE_ALIGNMENT 16
+
+typedef struct _MPMeshFileMapping
+{
+    void *base;
+    size_t size;
+} MPMeshFileMapping;
+
+uint64_t _MPMeshFileAlign(uint64_t offset);
+
+int _MPMeshFileWriteAt(FILE *file, uint64_t offset, const void *data, size_t size);
+
+/* returns 1 if [offset, offset + size) lies in the file and offset is aligned for the data */
+int _MPMeshFileSectionValid(uint64_t offset, uint64_t size, size_t fileSize);
+
+int _MPMeshFileValidate(const char *base, size_t size);
+
+void _MPMeshFileUnmap(MPMesh *mesh, void *context);
+
+#pragma mark - public functions
+
+int MPMeshFileIsBinary(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return 0;
+
+    uint32_t magic = 0;
+    size_t read = fread(&magic, sizeof(magic), 1, file);
+
+    fclose(file);
+
+    return (read == 1 && magic == MP_MESH_FILE_MAGIC);
+}
+
+int MPMeshWriteBinary(const MPMesh *mesh, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return -1;
+
+    int status = MPMeshWriteBinaryToFile(mesh, file, 0, NULL);
+
+    if (fclose(file) != 0) status = -1;
+
+    return status;
+}
+
+int MPMeshWriteBinaryToFile(const MPMesh *mesh, FILE *file, uint64_t offset, uint64_t *size)
+{
+    if (mesh->stride < sizeof(MPVec3) || mesh->stride % sizeof(float) != 0 || offset % MP_MESH_FILE_ALIGNMENT != 0) return -1;
+
+    MPMeshPrecomputed precomputed;
+    MPMeshGetPrecomputed(mesh, &precomputed);
+
+    MPMeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = MP_MESH_FILE_MAGIC;
+    header.version = MP_MESH_FILE_VERSION;
+    header.vertexStride = (uint32_t)mesh->stride;
+    header.numVertices = mesh->numVertices;
+    header.numIndices = mesh->numIndices;
+
+    uint64_t vertexSize = mesh->numVertices * mesh->stride;
+    uint64_t indexSize = mesh->numIndices * sizeof(uint32_t);
+    uint64_t texNameSize = mesh->texName ? strlen(mesh->texName) + 1 : 0;
+
+    const MPSphereTree *tree = &precomputed.sphereTree;
+    const MPConvexDecomposition *decomposition = &precomputed.decomposition;
+    const MPCollisionMesh *collision = &precomputed.collision;
+
+    MPMeshFilePrecomputed filePrecomputed;
+    memset(&filePrecomputed, 0, sizeof(filePrecomputed));
+
+    memcpy(filePrecomputed.extremePoints, precomputed.extremePoints, sizeof(precomputed.extremePoints));
+    filePrecomputed.boundingSphere = precomputed.boundingSphere;
+    filePrecomputed.orientedBox = precomputed.orientedBox;
+    filePrecomputed.numNodes = tree->numNodes;
+    filePrecomputed.numTriangles = tree->numNodes > 0 ? (int32_t)MPMeshGetTriangleCount(mesh) : 0;
+    filePrecomputed.numInnerSpheres = tree->numInnerSpheres;
+    filePrecomputed.numPieces = decomposition->numPieces;
+    filePrecomputed.numPieceVertices = decomposition->numVertices;
+    filePrecomputed.numCollisionVertices = collision->numVertices;
+    filePrecomputed.numCollisionTriangles = collision->numTriangles;
+
+    // lay out the sections
+    header.vertexOffset = _MPMeshFileAlign(sizeof(header));
+    header.indexOffset = _MPMeshFileAlign(header.vertexOffset + vertexSize);
+    uint64_t end = header.indexOffset + indexSize;
+
+    if (texNameSize)
+    {
+        header.texNameOffset = _MPMeshFileAlign(end);
+        end = header.texNameOffset + texNameSize;
+    }
+
+    header.precomputedOffset = _MPMeshFileAlign(end);
+
+    filePrecomputed.nodesOffset = _MPMeshFileAlign(header.precomputedOffset + sizeof(filePrecomputed));
+    filePrecomputed.trianglesOffset = _MPMeshFileAlign(filePrecomputed.nodesOffset + tree->numNodes * sizeof(MPSphereTreeNode));
+    filePrecomputed.innerSpheresOffset = _MPMeshFileAlign(filePrecomputed.trianglesOffset + filePrecomputed.numTriangles * sizeof(int32_t));
+    filePrecomputed.piecesOffset = _MPMeshFileAlign(filePrecomputed.innerSpheresOffset + tree->numInnerSpheres * sizeof(MPSphere));
+    filePrecomputed.pieceVerticesOffset = _MPMeshFileAlign(filePrecomputed.piecesOffset + decomposition->numPieces * sizeof(MPConvexPiece));
+    filePrecomputed.collisionXOffset = _MPMeshFileAlign(filePrecomputed.pieceVerticesOffset + decomposition->numVertices * sizeof(MPVec3));
+    filePrecomputed.collisionYOffset = _MPMeshFileAlign(filePrecomputed.collisionXOffset + collision->numVertices * sizeof(float));
+    filePrecomputed.collisionZOffset = _MPMeshFileAlign(filePrecomputed.collisionYOffset + collision->numVertices * sizeof(float));
+    filePrecomputed.collisionIndicesOffset = _MPMeshFileAlign(filePrecomputed.collisionZOffset + collision->numVertices * sizeof(float));
+
+    // indices are always stored as uint32
+    uint32_t *indices = malloc((mesh->numIndices > 0 ? mesh->numIndices : 1) * sizeof(uint32_t));
+
+    size_t i;
+    for (i = 0; i < mesh->numIndices; ++i)
+    {
+        switch (mesh->indexSize)
+        {
+            case sizeof(unsigned char):  indices[i] = ((const unsigned char *)mesh->indexData)[i]; break;
+            case sizeof(unsigned short): indices[i] = ((const unsigned short *)mesh->indexData)[i]; break;
+            default:                     indices[i] = ((const unsigned int *)mesh->indexData)[i]; break;
+        }
+    }
+
+    uint64_t imageSize = filePrecomputed.collisionIndicesOffset + 3 * (uint64_t)collision->numTriangles * sizeof(uint32_t);
+
+    int ok = (_MPMeshFileWriteAt(file, offset, &header, sizeof(header)) &&
+              _MPMeshFileWriteAt(file, offset + header.vertexOffset, mesh->vertexData, vertexSize) &&
+              _MPMeshFileWriteAt(file, offset + header.indexOffset, indices, indexSize) &&
+              _MPMeshFileWriteAt(file, offset + header.texNameOffset, mesh->texName, texNameSize) &&
+              _MPMeshFileWriteAt(file, offset + header.precomputedOffset, &filePrecomputed, sizeof(filePrecomputed)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.nodesOffset, tree->nodes, tree->numNodes * sizeof(MPSphereTreeNode)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.trianglesOffset, tree->triangles, filePrecomputed.numTriangles * sizeof(int32_t)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.innerSpheresOffset, tree->innerSpheres, tree->numInnerSpheres * sizeof(MPSphere)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.piecesOffset, decomposition->pieces, decomposition->numPieces * sizeof(MPConvexPiece)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.pieceVerticesOffset, decomposition->vertices, decomposition->numVertices * sizeof(MPVec3)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.collisionXOffset, collision->x, collision->numVertices * sizeof(float)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.collisionYOffset, collision->y, collision->numVertices * sizeof(float)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.collisionZOffset, collision->z, collision->numVertices * sizeof(float)) &&
+              _MPMeshFileWriteAt(file, offset + filePrecomputed.collisionIndicesOffset, collision->indices, 3 * (size_t)collision->numTriangles * sizeof(uint32_t)));
+
+    // empty sections aren't written, so make sure the file covers every section's offset
+    if (ok && fseek(file, 0, SEEK_END) == 0 && (uint64_t)ftell(file) < offset + imageSize)
+    {
+        const char zero = 0;
+        ok = _MPMeshFileWriteAt(file, offset + imageSize - 1, &zero, 1);
+    }
+
+    free(indices);
+
+    if (ok && size != NULL)
+    {
+        *size = imageSize;
+    }
+
+    return ok ? 0 : -1;
+}
+
+MPMesh* MPMeshOpenBinary(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(MPMeshFileHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (base == MAP_FAILED) return NULL;
+
+    MPMesh *mesh = MPMeshCreateWithBinaryData(base, size);
+
+    if (mesh == NULL)
+    {
+        munmap(base, size);
+        return NULL;
+    }
+
+    MPMeshFileMapping *mapping = malloc(sizeof(MPMeshFileMapping));
+    mapping->base = base;
+    mapping->size = size;
+
+    MPMeshSetDataDeallocator(mesh, _MPMeshFileUnmap, mapping);
+
+    return mesh;
+}
+
+MPMesh* MPMeshCreateWithBinaryData(const void *data, size_t size)
+{
+    if (size < sizeof(MPMeshFileHeader) || (uintptr_t)data % MP_MESH_FILE_ALIGNMENT != 0) return NULL;
+
+    if (!_MPMeshFileValidate((const char *)data, size)) return NULL;
+
+    const char *bytes = (const char *)data;
+    const MPMeshFileHeader *header = (const MPMeshFileHeader *)bytes;
+
+    const MPVec3 *vertexData = (const MPVec3 *)(bytes + header->vertexOffset);
+    const void *indexData = bytes + header->indexOffset;
+
+    MPMesh *mesh;
+
+    if (header->precomputedOffset)
+    {
+        const MPMeshFilePrecomputed *filePrecomputed = (const MPMeshFilePrecomputed *)(bytes + header->precomputedOffset);
+
+        MPMeshPrecomputed precomputed;
+        memcpy(precomputed.extremePoints, filePrecomputed->extremePoints, sizeof(precomputed.extremePoints));
+        precomputed.boundingSphere = filePrecomputed->boundingSphere;
+        precomputed.orientedBox = filePrecomputed->orientedBox;
+
+        // the tree is only read, so it can point straight into the mapping
+        precomputed.sphereTree.nodes = (MPSphereTreeNode *)(bytes + filePrecomputed->nodesOffset);
+        precomputed.sphereTree.numNodes = filePrecomputed->numNodes;
+        precomputed.sphereTree.triangles = (int *)(bytes + filePrecomputed->trianglesOffset);
+        precomputed.sphereTree.innerSpheres = (MPSphere *)(bytes + filePrecomputed->innerSpheresOffset);
+        precomputed.sphereTree.numInnerSpheres = filePrecomputed->numInnerSpheres;
+
+        precomputed.decomposition.pieces = (MPConvexPiece *)(bytes + filePrecomputed->piecesOffset);
+        precomputed.decomposition.numPieces = filePrecomputed->numPieces;
+        precomputed.decomposition.vertices = (MPVec3 *)(bytes + filePrecomputed->pieceVerticesOffset);
+        precomputed.decomposition.numVertices = filePrecomputed->numPieceVertices;
+
+        precomputed.collision.x = (float *)(bytes + filePrecomputed->collisionXOffset);
+        precomputed.collision.y = (float *)(bytes + filePrecomputed->collisionYOffset);
+        precomputed.collision.z = (float *)(bytes + filePrecomputed->collisionZOffset);
+        precomputed.collision.numVertices = filePrecomputed->numCollisionVertices;
+        precomputed.collision.indices = (uint32_t *)(bytes + filePrecomputed->collisionIndicesOffset);
+        precomputed.collision.numTriangles = filePrecomputed->numCollisionTriangles;
+
+        mesh = MPMeshCreateWithPrecomputed(vertexData, header->vertexStride, header->numVertices, indexData, sizeof(uint32_t), header->numIndices, &precomputed);
+    }
+    else
+    {
+        mesh = MPMeshCreate(vertexData, header->vertexStride, header->numVertices, indexData, sizeof(uint32_t), header->numIndices);
+    }
+
+    if (header->texNameOffset)
+    {
+        mesh->texName = strdup(bytes + header->texNameOffset);
+    }
+
+    return mesh;
+}
+
+#pragma mark - private functions
+
+uint64_t _MPMeshFileAlign(uint64_t offset)
+{
+    return (offset + MP_MESH_FILE_ALIGNMENT - 1) & ~(uint64_t)(MP_MESH_FILE_ALIGNMENT - 1);
+}
+
+int _MPMeshFileWriteAt(FILE *file, uint64_t offset, const void *data, size_t size)
+{
+    if (size == 0) return 1;
+
+    // fseek past the end leaves a zero filled gap, which is the alignment padding
+    return (fseek(file, (long)offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size);
+}
+
+int _MPMeshFileSectionValid(uint64_t offset, uint64_t size, size_t fileSize)
+{
+    return (offset % 4 == 0 && offset <= fileSize && size <= fileSize - offset);
+}
+
+int _MPMeshFileValidate(const char *base, size_t size)
+{
+    const MPMeshFileHeader *header = (const MPMeshFileHeader *)base;
+
+    if (header->magic != MP_MESH_FILE_MAGIC || header->version != MP_MESH_FILE_VERSION) return 0;
+
+    if (header->vertexStride < sizeof(MPVec3) || header->vertexStride % sizeof(float) != 0) return 0;
+
+    if (header->numIndices % 3 != 0) return 0;
+
+    // guard the size computations below against overflow
+    if (header->numVertices > size / header->vertexStride || header->numIndices > size / sizeof(uint32_t)) return 0;
+
+    if (!_MPMeshFileSectionValid(header->vertexOffset, header->numVertices * header->vertexStride, size)) return 0;
+    if (!_MPMeshFileSectionValid(header->indexOffset, header->numIndices * sizeof(uint32_t), size)) return 0;
+
+    // every index must refer to a vertex, since the data is used in place
+    const uint32_t *indices = (const uint32_t *)(base + header->indexOffset);
+
+    uint64_t i;
+    for (i = 0; i < header->numIndices; ++i)
+    {
+        if (indices[i] >= header->numVertices) return 0;
+    }
+
+    if (header->texNameOffset)
+    {
+        if (header->texNameOffset >= size || memchr(base + header->texNameOffset, '\0', size - header->texNameOffset) == NULL) return 0;
+    }
+
+    if (header->precomputedOffset)
+    {
+        // the section has 64 bit offsets
+        if (header->precomputedOffset % sizeof(uint64_t) != 0 || !_MPMeshFileSectionValid(header->precomputedOffset, sizeof(MPMeshFilePrecomputed), size)) return 0;
+
+        const MPMeshFilePrecomputed *precomputed = (const MPMeshFilePrecomputed *)(base + header->precomputedOffset);
+
+        int32_t numTriangles = precomputed->numTriangles;
+
+        if (precomputed->numNodes < 0 || numTriangles < 0 || precomputed->numInnerSpheres < 0 ||
+            precomputed->numPieces < 0 || precomputed->numPieceVertices < 0) return 0;
+
+        if (precomputed->numNodes > 0 && (uint64_t)numTriangles != header->numIndices / 3) return 0;
+
+        if (!_MPMeshFileSectionValid(precomputed->nodesOffset, (uint64_t)precomputed->numNodes * sizeof(MPSphereTreeNode), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->trianglesOffset, (uint64_t)numTriangles * sizeof(int32_t), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->innerSpheresOffset, (uint64_t)precomputed->numInnerSpheres * sizeof(MPSphere), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->piecesOffset, (uint64_t)precomputed->numPieces * sizeof(MPConvexPiece), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->pieceVerticesOffset, (uint64_t)precomputed->numPieceVertices * sizeof(MPVec3), size)) return 0;
+
+        // the collision mesh has a triangle for each of the mesh's, over its (welded) vertices
+        if ((uint64_t)precomputed->numCollisionTriangles != header->numIndices / 3 || precomputed->numCollisionVertices > header->numVertices) return 0;
+
+        if (!_MPMeshFileSectionValid(precomputed->collisionXOffset, (uint64_t)precomputed->numCollisionVertices * sizeof(float), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->collisionYOffset, (uint64_t)precomputed->numCollisionVertices * sizeof(float), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->collisionZOffset, (uint64_t)precomputed->numCollisionVertices * sizeof(float), size)) return 0;
+        if (!_MPMeshFileSectionValid(precomputed->collisionIndicesOffset, 3 * (uint64_t)precomputed->numCollisionTriangles * sizeof(uint32_t), size)) return 0;
+
+        const uint32_t *collisionIndices = (const uint32_t *)(base + precomputed->collisionIndicesOffset);
+
+        for (i = 0; i < 3 * (uint64_t)precomputed->numCollisionTriangles; ++i)
+        {
+            if (collisionIndices[i] >= precomputed->numCollisionVertices) return 0;
+        }
+
+        // the tree is traversed without bounds checks, so its links must be sound
+        const MPSphereTreeNode *nodes = (const MPSphereTreeNode *)(base + precomputed->nodesOffset);
+        const int32_t *triangles = (const int32_t *)(base + precomputed->trianglesOffset);
+
+        int32_t n;
+        for (n = 0; n < precomputed->numNodes; ++n)
+        {
+            const MPSphereTreeNode *node = &nodes[n];
+
+            if (node->first < 0 || node->count < 0 || node->count > numTriangles - node->first) return 0;
+
+            int isLeaf = (node->children[0] < 0);
+
+            if (isLeaf) continue;
+
+            // children always come after their parent, so the tree can't loop
+            if (node->children[0] <= n || node->children[0] >= precomputed->numNodes ||
+                node->children[1] <= n || node->children[1] >= precomputed->numNodes) return 0;
+
+            // and split its triangles in half, which bounds the depth of the traversal stack
+            const MPSphereTreeNode *left = &nodes[node->children[0]];
+            const MPSphereTreeNode *right = &nodes[node->children[1]];
+
+            if (left->first != node->first || left->count != node->count / 2 ||
+                right->first != node->first + left->count || right->count != node->count - left->count) return 0;
+        }
+
+        if (precomputed->numNodes > 0 && (nodes[0].first != 0 || nodes[0].count != numTriangles)) return 0;
+
+        for (n = 0; n < numTriangles; ++n)
+        {
+            if (triangles[n] < 0 || triangles[n] >= numTriangles) return 0;
+        }
+
+        const MPConvexPiece *pieces = (const MPConvexPiece *)(base + precomputed->piecesOffset);
+
+        for (n = 0; n < precomputed->numPieces; ++n)
+        {
+            if (pieces[n].first < 0 || pieces[n].count < 1 || pieces[n].first > precomputed->numPieceVertices - pieces[n].count) return 0;
+        }
+    }
+
+    return 1;
+}
+
+void _MPMeshFileUnmap(MPMesh *mesh, void *context)
+{
+    MPMeshFileMapping *mapping = (MPMeshFileMapping *)context;
+
+    munmap(mapping->base, mapping->size);
+    free(mapping);
+}
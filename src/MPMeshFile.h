@@ -0,0 +1,98 @@
+//
+//  MPMeshFile.h
+//
+//  A versioned binary mesh format that can be memory-mapped and used in place. The file is:
+//
+//      header | vertex data | uint32 indices | texture name | precomputed data (optional)
+//
+//  with every section aligned to 16 bytes. Vertices are stored exactly as they are in memory
+//  (positions first, then any other attributes), and the precomputed section holds the mesh's
+//  bounds, sphere tree, convex decomposition and welded collision mesh so they don't need to be
+//  rebuilt on load. Data is in native byte order.
+
+#ifndef _MPMeshFile_h
+#define _MPMeshFile_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include "MPMesh.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define MP_MESH_FILE_MAGIC 0x424D504D   // "MPMB"
+#define MP_MESH_FILE_VERSION 4
+
+typedef struct _MPMeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;              // in bytes
+    uint32_t reserved;
+
+    uint64_t numVertices;
+    uint64_t numIndices;
+
+    // byte offsets from the start of the file. 0 if the section is absent.
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t texNameOffset;             // NUL terminated
+    uint64_t precomputedOffset;         // an MPMeshFilePrecomputed
+} MPMeshFileHeader;
+
+typedef struct _MPMeshFilePrecomputed
+{
+    MPVec3 extremePoints[6];
+    MPSphere boundingSphere;
+    MPOBox orientedBox;
+
+    int32_t numNodes;
+    int32_t numTriangles;
+    int32_t numInnerSpheres;
+    int32_t reserved;
+
+    uint64_t nodesOffset;               // MPSphereTreeNode[numNodes]
+    uint64_t trianglesOffset;           // int32_t[numTriangles]
+    uint64_t innerSpheresOffset;        // MPSphere[numInnerSpheres]
+
+    int32_t numPieces;
+    int32_t numPieceVertices;
+
+    uint64_t piecesOffset;              // MPConvexPiece[numPieces]
+    uint64_t pieceVerticesOffset;       // MPVec3[numPieceVertices]
+
+    uint32_t numCollisionVertices;
+    uint32_t numCollisionTriangles;
+
+    uint64_t collisionXOffset;          // float[numCollisionVertices], and likewise for y and z
+    uint64_t collisionYOffset;
+    uint64_t collisionZOffset;
+    uint64_t collisionIndicesOffset;    // uint32_t[3 * numCollisionTriangles]
+} MPMeshFilePrecomputed;
+
+/* returns 1 if the file starts with the binary mesh header. */
+int MPMeshFileIsBinary(const char *path);
+
+/* writes the mesh, along with its precomputed data, in the binary format. returns 0 on success. */
+int MPMeshWriteBinary(const MPMesh *mesh, const char *path);
+
+/* writes the mesh in the binary format into an open file, starting at offset (a multiple of 16).
+   offsets within the image are relative to its start, so it can be embedded in other files. if
+   size isn't NULL it is set to the size of the image. returns 0 on success. */
+int MPMeshWriteBinaryToFile(const MPMesh *mesh, FILE *file, uint64_t offset, uint64_t *size);
+
+/* maps a binary mesh file into memory and creates a mesh that uses it in place. the mapping is
+   released when the mesh is freed. returns NULL if the file can't be read or is malformed. */
+MPMesh* MPMeshOpenBinary(const char *path);
+
+/* creates a mesh that uses a binary mesh image (16 byte aligned) in place. the data isn't
+   released with the mesh, so it must outlive it, or be released by a data deallocator set on it.
+   returns NULL if the image is malformed. */
+MPMesh* MPMeshCreateWithBinaryData(const void *data, size_t size);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
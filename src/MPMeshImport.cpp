@@ -0,0 +1,1426 @@
+//
+//  MPMeshImport.cpp
+//
+
+#include "MPMeshImport.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// fewer bytes than this per thread aren't worth starting a thread for
+#define MP_MIN_IMPORT_BYTES_PER_THREAD (1 << 20)
+
+// longer numbers than this are malformed
+#define MP_MAX_IMPORT_NUMBER_LENGTH 64
+
+namespace MP
+{
+
+namespace
+{
+    // a read-only mapping of a whole file
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &path) : data_(nullptr), size_(0)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+
+            if(fd < 0) return;
+
+            struct stat info;
+
+            if(fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if(data != MAP_FAILED)
+                {
+                    data_ = (const char *)data;
+                    size_ = (size_t)info.st_size;
+                }
+            }
+
+            close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if(data_) munmap((void *)data_, size_);
+        }
+
+        bool isOpen() const { return data_ != nullptr; }
+        const char* data() const { return data_; }
+        const char* end() const { return data_ + size_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char *data_;
+        size_t size_;
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile& operator=(const MappedFile &) = delete;
+    };
+
+    int threadsFor(uint64_t bytes)
+    {
+        int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+        return (int)std::max<uint64_t>(1, std::min<uint64_t>(numThreads, bytes / MP_MIN_IMPORT_BYTES_PER_THREAD));
+    }
+
+    // threads busy with imports, including the threads that called them. imports made at the same
+    // time (e.g. by a Reader loading several files at once) share one thread per core between them.
+    std::atomic<int> importThreads(0);
+
+    /* runs work(t) for t in [0, numChunks), on the calling thread and as many more as there are
+     * cores not already busy with imports */
+    void runParallel(int numChunks, const std::function<void(int)> &work)
+    {
+        int numCores = std::max(1, (int)std::thread::hardware_concurrency());
+        int inUse = importThreads.load();
+        int numWorkers;
+
+        // count the calling thread, and take what's left of the cores for workers
+        do
+        {
+            numWorkers = std::max(0, std::min(numChunks - 1, numCores - inUse - 1));
+        }
+        while(!importThreads.compare_exchange_weak(inUse, inUse + 1 + numWorkers));
+
+        std::atomic<int> next(0);
+
+        auto run = [&]()
+        {
+            for(int t = next++; t < numChunks; t = next++)
+            {
+                work(t);
+            }
+        };
+
+        std::vector<std::thread> workers;
+
+        for(int i = 0; i < numWorkers; ++i)
+        {
+            workers.push_back(std::thread(run));
+        }
+
+        run();
+
+        for(auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        importThreads -= 1 + numWorkers;
+    }
+
+    /* the first of count items in thread t's share */
+    size_t shareBegin(size_t count, int t, int numThreads)
+    {
+        return (size_t)((uint64_t)count * t / numThreads);
+    }
+
+    /* splits text into numChunks chunks of whole lines, returning the numChunks + 1 boundaries */
+    std::vector<const char *> splitLines(const char *begin, const char *end, int numChunks)
+    {
+        std::vector<const char *> bounds(numChunks + 1, end);
+        bounds[0] = begin;
+
+        for(int t = 1; t < numChunks; ++t)
+        {
+            const char *c = std::max(bounds[t - 1], begin + shareBegin(end - begin, t, numChunks));
+
+            // a boundary at the start of a line belongs to this chunk, elsewhere the line goes to the previous chunk
+            if(c > begin && c < end && c[-1] != '\n')
+            {
+                const char *newline = (const char *)memchr(c, '\n', end - c);
+                c = newline ? newline + 1 : end;
+            }
+
+            bounds[t] = c;
+        }
+
+        return bounds;
+    }
+
+    const char* lineEnd(const char *c, const char *end)
+    {
+        const char *newline = (const char *)memchr(c, '\n', end - c);
+
+        return newline ? newline : end;
+    }
+
+    size_t countLines(const char *begin, const char *end)
+    {
+        size_t count = 0;
+
+        for(const char *c = begin; c < end; c = lineEnd(c, end) + 1)
+        {
+            ++count;
+        }
+
+        return count;
+    }
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    const char* skipSpaces(const char *c, const char *end)
+    {
+        while(c < end && isSpace(*c)) ++c;
+
+        return c;
+    }
+
+    const double ExactPowers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /* parses the number after any spaces at c, leaving c after it. returns false if there isn't
+     * one. a mantissa and power of ten that are both exact in a double give a correctly rounded
+     * value with one multiplication or division, which covers the numbers exporters write. the
+     * rest go to strtod. */
+    bool parseDouble(const char *&c, const char *end, double &value)
+    {
+        const char *start = c = skipSpaces(c, end);
+        bool negative = false;
+
+        if(c < end && (*c == '-' || *c == '+'))
+        {
+            negative = *c == '-';
+            ++c;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false, exact = true;
+
+        for(; c < end && isDigit(*c); ++c, any = true)
+        {
+            if(digits < 19)
+            {
+                mantissa = 10 * mantissa + (*c - '0');
+                if(mantissa > 0) ++digits;
+            }
+            else
+            {
+                ++exponent;
+                exact = false;
+            }
+        }
+
+        if(c < end && *c == '.')
+        {
+            for(++c; c < end && isDigit(*c); ++c, any = true)
+            {
+                if(digits < 19)
+                {
+                    mantissa = 10 * mantissa + (*c - '0');
+                    if(mantissa > 0) ++digits;
+                    --exponent;
+                }
+                else
+                {
+                    exact = false;
+                }
+            }
+        }
+
+        if(!any)
+        {
+            c = start;
+            return false;
+        }
+
+        if(c < end && (*c == 'e' || *c == 'E'))
+        {
+            const char *e = c + 1;
+            bool negativeExponent = false;
+
+            if(e < end && (*e == '-' || *e == '+'))
+            {
+                negativeExponent = *e == '-';
+                ++e;
+            }
+
+            if(e < end && isDigit(*e))
+            {
+                int power = 0;
+
+                for(; e < end && isDigit(*e); ++e)
+                {
+                    if(power < 100000) power = 10 * power + (*e - '0');
+                }
+
+                exponent += negativeExponent ? -power : power;
+                c = e;
+            }
+        }
+
+        if(exact && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double magnitude = exponent < 0 ? mantissa / ExactPowers[-exponent] : mantissa * ExactPowers[exponent];
+            value = negative ? -magnitude : magnitude;
+
+            return true;
+        }
+
+        char buffer[MP_MAX_IMPORT_NUMBER_LENGTH];
+        size_t length = c - start;
+
+        if(length >= sizeof(buffer)) return false;
+
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = strtod(buffer, nullptr);
+
+        return true;
+    }
+
+    /* parses the integer after any spaces at c, leaving c after it. returns false if there isn't one. */
+    bool parseInteger(const char *&c, const char *end, int64_t &value)
+    {
+        const char *start = c = skipSpaces(c, end);
+        bool negative = false;
+
+        if(c < end && (*c == '-' || *c == '+'))
+        {
+            negative = *c == '-';
+            ++c;
+        }
+
+        if(c == end || !isDigit(*c))
+        {
+            c = start;
+            return false;
+        }
+
+        int64_t magnitude = 0;
+
+        for(; c < end && isDigit(*c); ++c)
+        {
+            // anything this large is out of range as an index anyway
+            if(magnitude < (1LL << 40)) magnitude = 10 * magnitude + (*c - '0');
+        }
+
+        value = negative ? -magnitude : magnitude;
+
+        return true;
+    }
+
+    /* true if c is at the end of a field: the end of the line or a space */
+    bool atFieldEnd(const char *c, const char *end)
+    {
+        return c == end || isSpace(*c);
+    }
+
+    bool hostIsBigEndian()
+    {
+        const uint16_t one = 1;
+
+        return *(const uint8_t *)&one == 0;
+    }
+
+    /* copies size bytes from data, reversing them if swap is set */
+    void readBytes(void *value, const char *data, size_t size, bool swap)
+    {
+        if(!swap)
+        {
+            memcpy(value, data, size);
+            return;
+        }
+
+        for(size_t i = 0; i < size; ++i)
+        {
+            ((char *)value)[i] = data[size - 1 - i];
+        }
+    }
+
+    /* creates a mesh from positions and triangle indices, with the given per vertex normals or, if
+     * there are none, normals computed from the triangles */
+    MPMesh* createMesh(const std::vector<float> &positions, const std::vector<float> &normals, const std::vector<uint32_t> &indices, const std::string &path, std::ostream &errors)
+    {
+        size_t numVertices = positions.size() / 3;
+
+        if(numVertices == 0 || indices.empty())
+        {
+            errors << "error: mesh file " << path << " has no triangles" << std::endl;
+            return nullptr;
+        }
+
+        for(uint32_t index : indices)
+        {
+            if(index >= numVertices)
+            {
+                errors << "error: mesh file " << path << " refers to missing vertex " << index + 1 << std::endl;
+                return nullptr;
+            }
+        }
+
+        std::vector<float> computed;
+
+        if(normals.empty())
+        {
+            computed.assign(positions.size(), 0.0f);
+
+            // the cross product's length is twice the triangle's area, which weights it as it's summed
+            for(size_t i = 0; i < indices.size(); i += 3)
+            {
+                const float *a = &positions[3 * indices[i]];
+                const float *b = &positions[3 * indices[i + 1]];
+                const float *c = &positions[3 * indices[i + 2]];
+
+                float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+
+                for(int k = 0; k < 3; ++k)
+                {
+                    float *normal = &computed[3 * indices[i + k]];
+                    normal[0] += n[0];
+                    normal[1] += n[1];
+                    normal[2] += n[2];
+                }
+            }
+        }
+
+        const std::vector<float> &vertexNormals = normals.empty() ? computed : normals;
+
+        float *vertexData = (float *)malloc(6 * numVertices * sizeof(float));
+        unsigned int *indexData = (unsigned int *)malloc(indices.size() * sizeof(unsigned int));
+
+        if(vertexData == nullptr || indexData == nullptr)
+        {
+            free(vertexData);
+            free(indexData);
+
+            errors << "error: out of memory loading mesh file " << path << std::endl;
+            return nullptr;
+        }
+
+        int numThreads = threadsFor(6 * numVertices * sizeof(float));
+
+        runParallel(numThreads, [&](int t)
+        {
+            size_t last = shareBegin(numVertices, t + 1, numThreads);
+
+            for(size_t i = shareBegin(numVertices, t, numThreads); i < last; ++i)
+            {
+                const float *n = &vertexNormals[3 * i];
+                float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+                float *vertex = &vertexData[6 * i];
+                vertex[0] = positions[3 * i];
+                vertex[1] = positions[3 * i + 1];
+                vertex[2] = positions[3 * i + 2];
+                vertex[3] = n[0] * scale;
+                vertex[4] = n[1] * scale;
+                vertex[5] = n[2] * scale;
+            }
+        });
+
+        memcpy(indexData, indices.data(), indices.size() * sizeof(unsigned int));
+
+        MPMesh *mesh = MPMeshCreate((const MPVec3 *)vertexData, 6 * sizeof(float), numVertices, indexData, sizeof(unsigned int), indices.size());
+
+        MPMeshSetDataDeallocator(mesh, MPMeshFreeData, NULL);
+
+        return mesh;
+    }
+
+    /* converts corners given as vertex numbers into indices, checking that each is a vertex */
+    bool toIndices(const std::vector<int64_t> &corners, size_t numVertices, std::vector<uint32_t> &indices, size_t offset)
+    {
+        for(size_t i = 0; i < corners.size(); ++i)
+        {
+            if(corners[i] < 0 || (uint64_t)corners[i] >= numVertices) return false;
+
+            indices[offset + i] = (uint32_t)corners[i];
+        }
+
+        return true;
+    }
+
+    // what one thread parsed of an OBJ or ASCII PLY file, to be joined to the other chunks in order
+    struct TextChunk
+    {
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<int64_t> corners;               // three per triangle
+        std::vector<size_t> relativeCorners;        // corners counted back from the chunk's last vertex, which need the chunk's first vertex added
+
+        size_t numLines = 0;
+        size_t errorLine = 0;                       // within the chunk and 1 based, or 0 if there's no error
+        const char *error = nullptr;
+
+        bool fail(const char *what)
+        {
+            errorLine = numLines;
+            error = what;
+
+            return false;
+        }
+    };
+
+    /* reports the first chunk error, numbering the line within the file. returns false if there is one. */
+    bool reportChunkErrors(const std::vector<TextChunk> &chunks, size_t firstLine, const std::string &path, std::ostream &errors)
+    {
+        size_t line = firstLine;
+
+        for(const TextChunk &chunk : chunks)
+        {
+            if(chunk.error)
+            {
+                errors << "error: malformed " << chunk.error << " in line " << line + chunk.errorLine << " of " << path << std::endl;
+                return false;
+            }
+
+            line += chunk.numLines;
+        }
+
+        return true;
+    }
+
+    /* joins the chunks' vertices and triangles in order. returns false if a corner isn't a vertex. */
+    bool joinChunks(std::vector<TextChunk> &chunks, std::vector<float> &positions, std::vector<float> &normals, std::vector<uint32_t> &indices)
+    {
+        int numChunks = (int)chunks.size();
+        std::vector<size_t> firstPosition(numChunks + 1, 0), firstNormal(numChunks + 1, 0), firstCorner(numChunks + 1, 0);
+
+        for(int t = 0; t < numChunks; ++t)
+        {
+            firstPosition[t + 1] = firstPosition[t] + chunks[t].positions.size();
+            firstNormal[t + 1] = firstNormal[t] + chunks[t].normals.size();
+            firstCorner[t + 1] = firstCorner[t] + chunks[t].corners.size();
+        }
+
+        size_t numVertices = firstPosition[numChunks] / 3;
+
+        if(numVertices > UINT32_MAX) return false;
+
+        positions.resize(firstPosition[numChunks]);
+        normals.resize(firstNormal[numChunks]);
+        indices.resize(firstCorner[numChunks]);
+
+        std::vector<char> valid(numChunks, 1);
+
+        runParallel(numChunks, [&](int t)
+        {
+            TextChunk &chunk = chunks[t];
+
+            for(size_t corner : chunk.relativeCorners)
+            {
+                chunk.corners[corner] += firstPosition[t] / 3;
+            }
+
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + firstPosition[t]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + firstNormal[t]);
+
+            valid[t] = toIndices(chunk.corners, numVertices, indices, firstCorner[t]);
+        });
+
+        return std::find(valid.begin(), valid.end(), 0) == valid.end();
+    }
+
+    /* adds the triangles of a fan over a polygon's corners */
+    void addFan(TextChunk &chunk, const std::vector<int64_t> &polygon, const std::vector<char> &relative)
+    {
+        for(size_t k = 1; k + 1 < polygon.size(); ++k)
+        {
+            const size_t corners[3] = { 0, k, k + 1 };
+
+            for(size_t corner : corners)
+            {
+                if(relative[corner]) chunk.relativeCorners.push_back(chunk.corners.size());
+
+                chunk.corners.push_back(polygon[corner]);
+            }
+        }
+    }
+
+    /* parses the vertices and faces in a chunk of an OBJ file. everything else (normals, texture
+     * coordinates, groups, materials) is skipped. */
+    void parseOBJChunk(const char *c, const char *end, TextChunk &chunk)
+    {
+        std::vector<int64_t> polygon;
+        std::vector<char> relative;
+
+        for(; c < end; c = lineEnd(c, end) + 1)
+        {
+            const char *last = lineEnd(c, end);
+            ++chunk.numLines;
+
+            c = skipSpaces(c, last);
+
+            if(last - c < 2 || !isSpace(c[1])) continue;
+
+            if(c[0] == 'v')
+            {
+                double x, y, z;
+                c += 2;
+
+                if(!parseDouble(c, last, x) || !parseDouble(c, last, y) || !parseDouble(c, last, z))
+                {
+                    chunk.fail("vertex");
+                    return;
+                }
+
+                chunk.positions.push_back((float)x);
+                chunk.positions.push_back((float)y);
+                chunk.positions.push_back((float)z);
+            }
+            else if(c[0] == 'f')
+            {
+                polygon.clear();
+                relative.clear();
+                c += 2;
+
+                while((c = skipSpaces(c, last)) < last)
+                {
+                    int64_t index;
+
+                    // corners are v, v/vt, v/vt/vn or v//vn, and only v is used
+                    if(!parseInteger(c, last, index) || index == 0 || !(atFieldEnd(c, last) || *c == '/'))
+                    {
+                        chunk.fail("face");
+                        return;
+                    }
+
+                    while(!atFieldEnd(c, last)) ++c;
+
+                    // vertices are numbered from 1, or counted back from the last one read so far
+                    polygon.push_back(index > 0 ? index - 1 : (int64_t)(chunk.positions.size() / 3) + index);
+                    relative.push_back(index < 0);
+                }
+
+                if(polygon.size() < 3)
+                {
+                    chunk.fail("face");
+                    return;
+                }
+
+                addFan(chunk, polygon, relative);
+            }
+        }
+    }
+
+    enum PLYType { PLYInt8, PLYUInt8, PLYInt16, PLYUInt16, PLYInt32, PLYUInt32, PLYFloat32, PLYFloat64 };
+
+    struct PLYProperty
+    {
+        std::string name;
+        PLYType type = PLYFloat32;
+        bool isList = false;
+        PLYType countType = PLYUInt8;          // of the list's length
+    };
+
+    struct PLYElement
+    {
+        std::string name;
+        uint64_t count;
+        std::vector<PLYProperty> properties;
+
+        int find(const char *property) const
+        {
+            for(size_t i = 0; i < properties.size(); ++i)
+            {
+                if(properties[i].name == property) return (int)i;
+            }
+
+            return -1;
+        }
+
+        bool hasLists() const
+        {
+            for(const PLYProperty &property : properties)
+            {
+                if(property.isList) return true;
+            }
+
+            return false;
+        }
+    };
+
+    bool parsePLYType(const std::string &name, PLYType &type)
+    {
+        static const struct { const char *name; PLYType type; } Types[] =
+        {
+            { "char", PLYInt8 }, { "int8", PLYInt8 }, { "uchar", PLYUInt8 }, { "uint8", PLYUInt8 },
+            { "short", PLYInt16 }, { "int16", PLYInt16 }, { "ushort", PLYUInt16 }, { "uint16", PLYUInt16 },
+            { "int", PLYInt32 }, { "int32", PLYInt32 }, { "uint", PLYUInt32 }, { "uint32", PLYUInt32 },
+            { "float", PLYFloat32 }, { "float32", PLYFloat32 }, { "double", PLYFloat64 }, { "float64", PLYFloat64 }
+        };
+
+        for(const auto &entry : Types)
+        {
+            if(name == entry.name)
+            {
+                type = entry.type;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    size_t sizeOf(PLYType type)
+    {
+        static const size_t Sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+        return Sizes[type];
+    }
+
+    double readPLYValue(const char *data, PLYType type, bool swap)
+    {
+        switch(type)
+        {
+            case PLYInt8: return (int8_t)data[0];
+            case PLYUInt8: return (uint8_t)data[0];
+            case PLYInt16: { int16_t v; readBytes(&v, data, 2, swap); return v; }
+            case PLYUInt16: { uint16_t v; readBytes(&v, data, 2, swap); return v; }
+            case PLYInt32: { int32_t v; readBytes(&v, data, 4, swap); return v; }
+            case PLYUInt32: { uint32_t v; readBytes(&v, data, 4, swap); return v; }
+            case PLYFloat32: { float v; readBytes(&v, data, 4, swap); return v; }
+            case PLYFloat64: { double v; readBytes(&v, data, 8, swap); return v; }
+        }
+
+        return 0.0;
+    }
+
+    // a PLY header and where the vertex and face data is described in it
+    struct PLYHeader
+    {
+        enum Format { ASCII, BinaryLittleEndian, BinaryBigEndian } format;
+        std::vector<PLYElement> elements;
+        size_t numLines = 0;
+        const char *body = nullptr;
+
+        int vertexElement = -1;
+        int position[3] = { -1, -1, -1 };
+        int normal[3] = { -1, -1, -1 };
+
+        int faceElement = -1;
+        int faceIndices = -1;
+    };
+
+    /* parses the header, returning the reason it's malformed, or nullptr if it isn't */
+    const char* parsePLYHeader(const char *c, const char *end, PLYHeader &header)
+    {
+        bool hasFormat = false;
+
+        for(; c < end; c = lineEnd(c, end) + 1)
+        {
+            const char *last = lineEnd(c, end);
+            std::istringstream line(std::string(c, last));
+            std::string keyword;
+
+            ++header.numLines;
+            line >> keyword;
+
+            if(header.numLines == 1)
+            {
+                if(keyword != "ply") return "header";
+            }
+            else if(keyword == "format")
+            {
+                std::string format;
+                line >> format;
+
+                if(format == "ascii") header.format = PLYHeader::ASCII;
+                else if(format == "binary_little_endian") header.format = PLYHeader::BinaryLittleEndian;
+                else if(format == "binary_big_endian") header.format = PLYHeader::BinaryBigEndian;
+                else return "format";
+
+                hasFormat = true;
+            }
+            else if(keyword == "element")
+            {
+                PLYElement element;
+
+                if(!(line >> element.name >> element.count)) return "element";
+
+                header.elements.push_back(element);
+            }
+            else if(keyword == "property")
+            {
+                PLYProperty property;
+                std::string type;
+
+                if(header.elements.empty() || !(line >> type)) return "property";
+
+                property.isList = type == "list";
+
+                if(property.isList)
+                {
+                    std::string countType;
+
+                    if(!(line >> countType >> type) || !parsePLYType(countType, property.countType) || sizeOf(property.countType) > 4) return "property";
+                }
+
+                if(!parsePLYType(type, property.type) || !(line >> property.name)) return "property";
+
+                header.elements.back().properties.push_back(property);
+            }
+            else if(keyword == "end_header")
+            {
+                header.body = std::min(last + 1, end);
+                break;
+            }
+            else if(keyword != "comment" && keyword != "obj_info" && !keyword.empty())
+            {
+                return "header";
+            }
+        }
+
+        if(!hasFormat || header.body == nullptr) return "header";
+
+        static const char *const PositionNames[] = { "x", "y", "z" };
+        static const char *const NormalNames[] = { "nx", "ny", "nz" };
+
+        for(size_t e = 0; e < header.elements.size(); ++e)
+        {
+            const PLYElement &element = header.elements[e];
+
+            if(element.name == "vertex" && header.vertexElement < 0)
+            {
+                header.vertexElement = (int)e;
+
+                for(int k = 0; k < 3; ++k)
+                {
+                    header.position[k] = element.find(PositionNames[k]);
+                    header.normal[k] = element.find(NormalNames[k]);
+
+                    if(header.position[k] < 0 || element.properties[header.position[k]].isList) return "vertex element";
+                }
+
+                // normals are only used if all three components are there
+                for(int k = 0; k < 3; ++k)
+                {
+                    if(header.normal[k] < 0 || element.properties[header.normal[k]].isList)
+                    {
+                        header.normal[0] = header.normal[1] = header.normal[2] = -1;
+                        break;
+                    }
+                }
+            }
+            else if(element.name == "face" && header.faceElement < 0)
+            {
+                header.faceElement = (int)e;
+                header.faceIndices = element.find("vertex_indices");
+
+                if(header.faceIndices < 0) header.faceIndices = element.find("vertex_index");
+
+                if(header.faceIndices < 0 || !element.properties[header.faceIndices].isList) return "face element";
+            }
+        }
+
+        if(header.vertexElement < 0 || header.faceElement < 0) return "header";
+
+        return nullptr;
+    }
+
+    /* parses a chunk of lines of an ASCII PLY body, the first of which is line firstLine of the body */
+    void parsePLYTextChunk(const char *c, const char *end, uint64_t firstLine, const PLYHeader &header, TextChunk &chunk)
+    {
+        // the line each element's data starts at
+        std::vector<uint64_t> firstLines(header.elements.size() + 1, 0);
+
+        for(size_t e = 0; e < header.elements.size(); ++e)
+        {
+            firstLines[e + 1] = firstLines[e] + header.elements[e].count;
+        }
+
+        std::vector<double> values;
+        std::vector<int64_t> polygon;
+        std::vector<char> relative;
+        size_t e = 0;
+
+        for(uint64_t line = firstLine; c < end; c = lineEnd(c, end) + 1, ++line)
+        {
+            const char *last = lineEnd(c, end);
+            ++chunk.numLines;
+
+            while(e < header.elements.size() && line >= firstLines[e + 1]) ++e;
+
+            // lines after the last element, usually blank, are ignored
+            if(e == header.elements.size()) continue;
+
+            bool isVertex = (int)e == header.vertexElement;
+            bool isFace = (int)e == header.faceElement;
+
+            if(!isVertex && !isFace) continue;
+
+            const PLYElement &element = header.elements[e];
+            values.clear();
+
+            for(size_t p = 0; p < element.properties.size(); ++p)
+            {
+                const PLYProperty &property = element.properties[p];
+                int64_t count = 1;
+
+                if(property.isList && (!parseInteger(c, last, count) || count < 0 || !atFieldEnd(c, last)))
+                {
+                    chunk.fail(element.name.c_str());
+                    return;
+                }
+
+                if(isFace && (int)p == header.faceIndices)
+                {
+                    polygon.clear();
+
+                    for(int64_t i = 0; i < count; ++i)
+                    {
+                        int64_t index;
+
+                        if(!parseInteger(c, last, index) || !atFieldEnd(c, last))
+                        {
+                            chunk.fail("face");
+                            return;
+                        }
+
+                        polygon.push_back(index);
+                    }
+
+                    values.push_back(0.0);
+                    continue;
+                }
+
+                for(int64_t i = 0; i < count; ++i)
+                {
+                    double value;
+
+                    if(!parseDouble(c, last, value) || !atFieldEnd(c, last))
+                    {
+                        chunk.fail(element.name.c_str());
+                        return;
+                    }
+
+                    if(!property.isList) values.push_back(value);
+                }
+
+                // list values were skipped, so scalars are indexed as if lists weren't there
+                if(property.isList) values.push_back(0.0);
+            }
+
+            if(isVertex)
+            {
+                for(int k = 0; k < 3; ++k)
+                {
+                    chunk.positions.push_back((float)values[header.position[k]]);
+                }
+
+                if(header.normal[0] >= 0)
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        chunk.normals.push_back((float)values[header.normal[k]]);
+                    }
+                }
+            }
+            else
+            {
+                if(polygon.size() < 3)
+                {
+                    chunk.fail("face");
+                    return;
+                }
+
+                relative.assign(polygon.size(), 0);
+                addFan(chunk, polygon, relative);
+            }
+        }
+    }
+
+    MPMesh* importPLYText(const MappedFile &file, const PLYHeader &header, const std::string &path, std::ostream &errors)
+    {
+        int numThreads = threadsFor(file.end() - header.body);
+        std::vector<const char *> bounds = splitLines(header.body, file.end(), numThreads);
+
+        // vertices and faces are found by their line in the body, so each chunk needs its first line's number
+        std::vector<uint64_t> firstLines(numThreads + 1, 0);
+
+        runParallel(numThreads, [&](int t)
+        {
+            firstLines[t + 1] = countLines(bounds[t], bounds[t + 1]);
+        });
+
+        for(int t = 0; t < numThreads; ++t)
+        {
+            firstLines[t + 1] += firstLines[t];
+        }
+
+        uint64_t numRecords = 0;
+
+        for(const PLYElement &element : header.elements)
+        {
+            numRecords += element.count;
+        }
+
+        if(firstLines[numThreads] < numRecords)
+        {
+            errors << "error: missing data in " << path << std::endl;
+            return nullptr;
+        }
+
+        std::vector<TextChunk> chunks(numThreads);
+
+        runParallel(numThreads, [&](int t)
+        {
+            parsePLYTextChunk(bounds[t], bounds[t + 1], firstLines[t], header, chunks[t]);
+        });
+
+        if(!reportChunkErrors(chunks, header.numLines, path, errors)) return nullptr;
+
+        std::vector<float> positions, normals;
+        std::vector<uint32_t> indices;
+
+        if(!joinChunks(chunks, positions, normals, indices))
+        {
+            errors << "error: face refers to a missing vertex in " << path << std::endl;
+            return nullptr;
+        }
+
+        return createMesh(positions, normals, indices, path, errors);
+    }
+
+    MPMesh* importPLYBinary(const MappedFile &file, const PLYHeader &header, const std::string &path, std::ostream &errors)
+    {
+        bool swap = (header.format == PLYHeader::BinaryBigEndian) != hostIsBigEndian();
+
+        std::vector<float> positions, normals;
+        std::vector<uint32_t> indices;
+
+        const char *c = header.body;
+        const char *end = file.end();
+
+        for(size_t e = 0; e < header.elements.size(); ++e)
+        {
+            const PLYElement &element = header.elements[e];
+
+            if(!element.hasLists())
+            {
+                // records have a fixed size, so they can be found without reading the ones before
+                std::vector<size_t> offsets;
+                size_t recordSize = 0;
+
+                for(const PLYProperty &property : element.properties)
+                {
+                    offsets.push_back(recordSize);
+                    recordSize += sizeOf(property.type);
+                }
+
+                if(recordSize > 0 && element.count > (uint64_t)(end - c) / recordSize)
+                {
+                    errors << "error: missing " << element.name << " data in " << path << std::endl;
+                    return nullptr;
+                }
+
+                if((int)e == header.vertexElement)
+                {
+                    size_t numVertices = (size_t)element.count;
+                    bool hasNormals = header.normal[0] >= 0;
+
+                    positions.resize(3 * numVertices);
+                    if(hasNormals) normals.resize(3 * numVertices);
+
+                    int numThreads = threadsFor(numVertices * recordSize);
+
+                    runParallel(numThreads, [&](int t)
+                    {
+                        size_t last = shareBegin(numVertices, t + 1, numThreads);
+
+                        for(size_t i = shareBegin(numVertices, t, numThreads); i < last; ++i)
+                        {
+                            const char *record = c + i * recordSize;
+
+                            for(int k = 0; k < 3; ++k)
+                            {
+                                const PLYProperty &property = element.properties[header.position[k]];
+                                positions[3 * i + k] = (float)readPLYValue(record + offsets[header.position[k]], property.type, swap);
+                            }
+
+                            for(int k = 0; hasNormals && k < 3; ++k)
+                            {
+                                const PLYProperty &property = element.properties[header.normal[k]];
+                                normals[3 * i + k] = (float)readPLYValue(record + offsets[header.normal[k]], property.type, swap);
+                            }
+                        }
+                    });
+                }
+
+                c += element.count * recordSize;
+                continue;
+            }
+
+            if((int)e == header.vertexElement)
+            {
+                errors << "error: vertex lists aren't supported in " << path << std::endl;
+                return nullptr;
+            }
+
+            bool isFace = (int)e == header.faceElement;
+
+            // records vary in size, so they're walked to find where each face's index list starts and
+            // how many triangles it adds, and then the lists are read in parallel
+            std::vector<const char *> lists;
+            std::vector<uint64_t> firstCorners(1, 0);
+
+            for(uint64_t i = 0; i < element.count; ++i)
+            {
+                for(size_t p = 0; p < element.properties.size(); ++p)
+                {
+                    const PLYProperty &property = element.properties[p];
+                    uint64_t count = 1;
+
+                    if(property.isList)
+                    {
+                        if((size_t)(end - c) < sizeOf(property.countType))
+                        {
+                            errors << "error: missing " << element.name << " data in " << path << std::endl;
+                            return nullptr;
+                        }
+
+                        double value = readPLYValue(c, property.countType, swap);
+
+                        // float counts must still be whole numbers that fit in the rest of the file
+                        if(!std::isfinite(value) || value < 0 || value != std::floor(value) || value > (double)(end - c))
+                        {
+                            errors << "error: malformed " << element.name << " in " << path << std::endl;
+                            return nullptr;
+                        }
+
+                        count = (uint64_t)value;
+                        c += sizeOf(property.countType);
+
+                        if(isFace && (int)p == header.faceIndices)
+                        {
+                            if(count < 3)
+                            {
+                                errors << "error: malformed face in " << path << std::endl;
+                                return nullptr;
+                            }
+
+                            lists.push_back(c);
+                            firstCorners.push_back(firstCorners.back() + 3 * (count - 2));
+                        }
+                    }
+
+                    if((uint64_t)(end - c) / sizeOf(property.type) < count)
+                    {
+                        errors << "error: missing " << element.name << " data in " << path << std::endl;
+                        return nullptr;
+                    }
+
+                    c += count * sizeOf(property.type);
+                }
+            }
+
+            if(!isFace) continue;
+
+            if(firstCorners.back() > UINT32_MAX)
+            {
+                errors << "error: too many triangles in " << path << std::endl;
+                return nullptr;
+            }
+
+            const PLYProperty &property = element.properties[header.faceIndices];
+            size_t numFaces = lists.size();
+
+            indices.resize((size_t)firstCorners.back());
+
+            int numThreads = threadsFor(lists.empty() ? 0 : c - lists[0]);
+            std::vector<char> valid(numThreads, 1);
+
+            runParallel(numThreads, [&](int t)
+            {
+                size_t last = shareBegin(numFaces, t + 1, numThreads);
+
+                for(size_t i = shareBegin(numFaces, t, numThreads); i < last; ++i)
+                {
+                    size_t count = (size_t)((firstCorners[i + 1] - firstCorners[i]) / 3 + 2);
+                    size_t size = sizeOf(property.type);
+
+                    double first = readPLYValue(lists[i], property.type, swap);
+                    double previous = readPLYValue(lists[i] + size, property.type, swap);
+                    uint32_t *triangle = &indices[(size_t)firstCorners[i]];
+
+                    for(size_t k = 2; k < count; ++k, triangle += 3)
+                    {
+                        double next = readPLYValue(lists[i] + k * size, property.type, swap);
+
+                        if(first < 0 || previous < 0 || next < 0 || first > UINT32_MAX || previous > UINT32_MAX || next > UINT32_MAX)
+                        {
+                            valid[t] = 0;
+                        }
+
+                        triangle[0] = (uint32_t)first;
+                        triangle[1] = (uint32_t)previous;
+                        triangle[2] = (uint32_t)next;
+
+                        previous = next;
+                    }
+                }
+            });
+
+            if(std::find(valid.begin(), valid.end(), 0) != valid.end())
+            {
+                errors << "error: face refers to a missing vertex in " << path << std::endl;
+                return nullptr;
+            }
+        }
+
+        return createMesh(positions, normals, indices, path, errors);
+    }
+
+    bool hasExtension(const std::string &path, const char *extension)
+    {
+        size_t length = strlen(extension);
+
+        if(path.size() <= length) return false;
+
+        return strcasecmp(path.c_str() + path.size() - length, extension) == 0;
+    }
+}
+
+#pragma mark - public functions
+
+bool isImportableMesh(const std::string &path)
+{
+    return hasExtension(path, ".obj") || hasExtension(path, ".stl") || hasExtension(path, ".ply");
+}
+
+MPMesh* importMesh(const std::string &path, std::ostream &errors)
+{
+    if(hasExtension(path, ".obj")) return importOBJ(path, errors);
+    if(hasExtension(path, ".stl")) return importSTL(path, errors);
+    if(hasExtension(path, ".ply")) return importPLY(path, errors);
+
+    errors << "error: unknown mesh format " << path << std::endl;
+
+    return nullptr;
+}
+
+MPMesh* importOBJ(const std::string &path, std::ostream &errors)
+{
+    MappedFile file(path);
+
+    if(!file.isOpen())
+    {
+        errors << "error: could not read mesh file " << path << std::endl;
+        return nullptr;
+    }
+
+    int numThreads = threadsFor(file.size());
+    std::vector<const char *> bounds = splitLines(file.data(), file.end(), numThreads);
+    std::vector<TextChunk> chunks(numThreads);
+
+    runParallel(numThreads, [&](int t)
+    {
+        parseOBJChunk(bounds[t], bounds[t + 1], chunks[t]);
+    });
+
+    if(!reportChunkErrors(chunks, 0, path, errors)) return nullptr;
+
+    std::vector<float> positions, normals;
+    std::vector<uint32_t> indices;
+
+    if(!joinChunks(chunks, positions, normals, indices))
+    {
+        errors << "error: face refers to a missing vertex in " << path << std::endl;
+        return nullptr;
+    }
+
+    return createMesh(positions, normals, indices, path, errors);
+}
+
+MPMesh* importSTL(const std::string &path, std::ostream &errors)
+{
+    MappedFile file(path);
+
+    if(!file.isOpen())
+    {
+        errors << "error: could not read mesh file " << path << std::endl;
+        return nullptr;
+    }
+
+    // an 80 byte header, the triangle count, then per triangle a normal, three corners and two attribute bytes
+    uint32_t numTriangles = 0;
+
+    if(file.size() >= 84) readBytes(&numTriangles, file.data() + 80, 4, hostIsBigEndian());
+
+    if(file.size() < 84 || (file.size() - 84) / 50 < numTriangles)
+    {
+        if(file.size() >= 5 && memcmp(file.data(), "solid", 5) == 0)
+        {
+            errors << "error: unsupported ASCII STL file " << path << std::endl;
+        }
+        else
+        {
+            errors << "error: malformed STL file " << path << std::endl;
+        }
+
+        return nullptr;
+    }
+
+    size_t numCorners = 3 * (size_t)numTriangles;
+
+    if(numCorners > UINT32_MAX)
+    {
+        errors << "error: too many triangles in " << path << std::endl;
+        return nullptr;
+    }
+
+    const char *triangles = file.data() + 84;
+    bool swap = hostIsBigEndian();
+
+    // positions with -0 folded into 0, so that the two weld
+    std::vector<uint32_t> keys(3 * numCorners);
+    std::vector<uint32_t> hashes(numCorners);
+
+    int numThreads = threadsFor(50 * (uint64_t)numTriangles);
+
+    runParallel(numThreads, [&](int t)
+    {
+        size_t last = shareBegin(numTriangles, t + 1, numThreads);
+
+        for(size_t i = shareBegin(numTriangles, t, numThreads); i < last; ++i)
+        {
+            const char *corner = triangles + 50 * i + 12;
+
+            for(size_t j = 3 * i; j < 3 * i + 3; ++j, corner += 12)
+            {
+                uint32_t hash = 2166136261u;
+
+                for(int k = 0; k < 3; ++k)
+                {
+                    uint32_t bits;
+                    readBytes(&bits, corner + 4 * k, 4, swap);
+
+                    if((bits & 0x7fffffff) == 0) bits = 0;
+
+                    keys[3 * j + k] = bits;
+                    hash = (hash ^ bits) * 16777619u;
+                }
+
+                hashes[j] = hash ^ (hash >> 15);
+            }
+        }
+    });
+
+    // each thread welds the corners whose hash falls in its partition, finding the first corner at each position
+    std::vector<uint32_t> firstCorners(numCorners);
+
+    auto samePosition = [&](size_t a, size_t b)
+    {
+        return keys[3 * a] == keys[3 * b] && keys[3 * a + 1] == keys[3 * b + 1] && keys[3 * a + 2] == keys[3 * b + 2];
+    };
+
+    runParallel(numThreads, [&](int t)
+    {
+        size_t count = 0;
+
+        for(size_t i = 0; i < numCorners; ++i)
+        {
+            if(hashes[i] % numThreads == (uint32_t)t) ++count;
+        }
+
+        size_t capacity = 16;
+        while(capacity < 2 * count) capacity *= 2;
+
+        std::vector<uint32_t> table(capacity, UINT32_MAX);
+        size_t mask = capacity - 1;
+
+        for(size_t i = 0; i < numCorners; ++i)
+        {
+            if(hashes[i] % numThreads != (uint32_t)t) continue;
+
+            for(size_t slot = (hashes[i] / numThreads) & mask; ; slot = (slot + 1) & mask)
+            {
+                if(table[slot] == UINT32_MAX)
+                {
+                    table[slot] = (uint32_t)i;
+                    firstCorners[i] = (uint32_t)i;
+                    break;
+                }
+
+                if(samePosition(table[slot], i))
+                {
+                    firstCorners[i] = table[slot];
+                    break;
+                }
+            }
+        }
+    });
+
+    // vertices are numbered in order of their first corner, whatever the number of threads
+    std::vector<float> positions, normals;
+    std::vector<uint32_t> indices(numCorners);
+    std::vector<uint32_t> &vertices = hashes;
+
+    for(size_t i = 0; i < numCorners; ++i)
+    {
+        if(firstCorners[i] == i)
+        {
+            vertices[i] = (uint32_t)(positions.size() / 3);
+
+            for(int k = 0; k < 3; ++k)
+            {
+                float value;
+                memcpy(&value, &keys[3 * i + k], sizeof(float));
+                positions.push_back(value);
+            }
+        }
+
+        indices[i] = vertices[firstCorners[i]];
+    }
+
+    return createMesh(positions, normals, indices, path, errors);
+}
+
+MPMesh* importPLY(const std::string &path, std::ostream &errors)
+{
+    MappedFile file(path);
+
+    if(!file.isOpen())
+    {
+        errors << "error: could not read mesh file " << path << std::endl;
+        return nullptr;
+    }
+
+    PLYHeader header;
+    const char *error = parsePLYHeader(file.data(), file.end(), header);
+
+    if(error)
+    {
+        errors << "error: malformed " << error << " in line " << header.numLines << " of " << path << std::endl;
+        return nullptr;
+    }
+
+    if(header.format == PLYHeader::ASCII) return importPLYText(file, header, path, errors);
+
+    return importPLYBinary(file, header, path, errors);
+}
+
+}
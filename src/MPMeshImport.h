@@ -0,0 +1,37 @@
+//
+//  MPMeshImport.h
+//
+//  Importers for meshes exported by other tools: Wavefront OBJ, binary STL and PLY (ASCII or
+//  binary in either byte order). Files are memory-mapped and split into chunks that are parsed on
+//  separate threads, and the chunks are combined in file order, so the mesh doesn't depend on the
+//  number of threads. Imports made at the same time share one thread per core. Meshes get the
+//  layout of .mesh files: a position and a normal per vertex (6 floats) and uint32 indices.
+//  Normals come from the file where it gives them per vertex (PLY), and are otherwise the area
+//  weighted normals of the surrounding triangles. Polygons are triangulated as fans. STL stores each triangle's corners separately, so corners at identical
+//  positions are welded into shared vertices.
+
+#ifndef __MPMeshImport__
+#define __MPMeshImport__
+
+#include <iostream>
+#include <string>
+#include "MPMesh.h"
+
+namespace MP
+{
+
+/* returns true if the file has the extension of a format that can be imported (.obj, .stl or
+ * .ply, in any case) */
+bool isImportableMesh(const std::string &path);
+
+/* imports the mesh in the file at path, choosing the format by its extension. returns nullptr,
+ * after writing the reason to errors, if the file can't be read or is malformed. */
+MPMesh* importMesh(const std::string &path, std::ostream &errors = std::cout);
+
+MPMesh* importOBJ(const std::string &path, std::ostream &errors = std::cout);
+MPMesh* importSTL(const std::string &path, std::ostream &errors = std::cout);
+MPMesh* importPLY(const std::string &path, std::ostream &errors = std::cout);
+
+}
+
+#endif
@@ -11,11 +11,11 @@ namespace MP
 {
 #pragma mark - public methods
 
-Model::Model() : mesh(nullptr), motion(nullptr)
+Model::Model() : mesh(nullptr), motion(nullptr), transformEpoch(1)
 {
 }
 
-Model::Model(MPMesh *mesh) : motion(nullptr)
+Model::Model(MPMesh *mesh) : motion(nullptr), transformEpoch(1)
 {
     this->mesh = nullptr;
     this->setMesh(mesh);
@@ -65,9 +65,10 @@ Motion* Model::getMotion() const
 void Model::setTransform(const Transform3D &transform)
 {
     this->transform = transform;
+    ++this->transformEpoch;
 }
 
-Transform3D& Model::getTransform()
+const Transform3D& Model::getTransform() const
 {
     return this->transform;
 }
@@ -75,6 +76,7 @@ Transform3D& Model::getTransform()
 void Model::setPosition(const MPVec3 &position)
 {
     this->transform.setPosition(position);
+    ++this->transformEpoch;
 }
 
 MPVec3 Model::getPosition() const
@@ -85,6 +87,7 @@ MPVec3 Model::getPosition() const
 void Model::setScale(const MPVec3 &scale)
 {
     this->transform.setScale(scale);
+    ++this->transformEpoch;
 }
 
 MPVec3 Model::getScale() const
@@ -95,6 +98,7 @@ MPVec3 Model::getScale() const
 void Model::setRotation(const MPQuaternion &rotation)
 {
     this->transform.setRotation(rotation);
+    ++this->transformEpoch;
 }
 
 MPQuaternion Model::getRotation() const
@@ -107,6 +111,11 @@ MPMat4 Model::getModelMatrix()
     return transform.getMatrix();
 }
 
+unsigned long Model::getTransformEpoch() const
+{
+    return this->transformEpoch;
+}
+
 bool Model::collidesWithModel(Model &model)
 {
     return this->wouldCollideWithModel(this->transform, model);
@@ -117,39 +126,7 @@ bool Model::wouldCollideWithModel(Transform3D &transform, Model &model)
     MPMat4 modelMatrix = transform.getMatrix();
     MPMat4 otherModelMatrix = model.getModelMatrix();
     
-    MPSphere boundingSphere = MPMeshGetBoundingSphere(this->mesh, &modelMatrix);
-    MPSphere otherBoundingSphere = MPMeshGetBoundingSphere(model.getMesh(), &otherModelMatrix);
-    
-    // bounding spheres don't intersect, so neither can the models
-    if (!MPSphereIntersectsSphere(boundingSphere, otherBoundingSphere))
-    {
-        return false;
-    }
-    
-    size_t numTriangles = MPMeshGetTriangleCount(this->mesh);
-    size_t numTrianglesOther = MPMeshGetTriangleCount(model.mesh);
-    
-    // triangles for during iteration
-    MPTriangle tri1, tri2;
-    
-    for (int i = 0; i < numTriangles; ++i)
-    {
-        for (int j = 0; j < numTrianglesOther; ++j)
-        {
-            MPMeshGetTriangle(this->mesh, i, tri1.p);
-            MPTriangleApplyTransform(&tri1, modelMatrix);
-            
-            MPMeshGetTriangle(model.mesh, j, tri2.p);
-            MPTriangleApplyTransform(&tri2, otherModelMatrix);
-            
-            if (MPTrianglesIntersect(tri1, tri2))
-            {
-                return true;
-            }
-        }
-    }
-    
-    return false;
+    return MPMeshesIntersect(this->mesh, modelMatrix, model.getMesh(), otherModelMatrix);
 }
     
 void Model::setActionSet(const Action6D::ActionSet &actions)
@@ -30,7 +30,7 @@ public:
     Motion* getMotion() const;
     
     void setTransform(const Transform3D &transform);
-    Transform3D& getTransform();
+    const Transform3D& getTransform() const;
     
     void setPosition(const MPVec3 &position);
     MPVec3 getPosition() const;
@@ -43,6 +43,11 @@ public:
     
     MPMat4 getModelMatrix();
     
+    /* changes whenever the transform is set, so that anything derived from it can be cached and
+     * refreshed only once the model has moved. never 0, so a cache can start out with an epoch of
+     * 0 to mark itself as empty. */
+    unsigned long getTransformEpoch() const;
+    
     /* returns true if the current state causes a collision with the given model */
     bool collidesWithModel(Model &model);
     
@@ -58,6 +63,7 @@ protected:
     Motion *motion;
     
     Transform3D transform;
+    unsigned long transformEpoch;
     
     Action6D::ActionSet actionSet;
 };
@@ -0,0 +1,354 @@
+//
+//  MPMultiAgentController.cpp
+//
+
+#include "MPMultiAgentController.h"
+#include "MPTimer.h"
+#include <algorithm>
+#include <thread>
+
+// fewer agents than this per thread aren't worth handing to a worker
+#define MP_MIN_AGENTS_PER_THREAD 64
+
+namespace MP
+{
+
+MultiAgentController::MultiAgentController(const std::vector<Model *> &obstacles, float agentRadius, float voxelSize)
+: agentRadius_(agentRadius), voxelSize_(voxelSize), gradStep_(1.0f), attractiveMultiplier_(1.0f), repulsiveMultiplier_(1.0f),
+  agentRepulsiveMultiplier_(1.0f), numThreads_(0), workGeneration_(0), workChunkSize_(0), workPending_(0), stopping_(false),
+  lastStepTime_(0.0), totalStepTime_(0.0), numSteps_(0)
+{
+    for(auto model : obstacles)
+    {
+        Obstacle obstacle;
+        obstacle.model = model;
+        obstacle.scale = MPVec3Zero;
+        obstacle.epoch = 0;
+        
+        obstacles_.push_back(obstacle);
+    }
+    
+    this->updateObstacles();
+}
+
+MultiAgentController::~MultiAgentController()
+{
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        stopping_ = true;
+    }
+    
+    workReady_.notify_all();
+    
+    for(auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+int MultiAgentController::addAgent(const MPVec3 &position, const MPVec3 &goal)
+{
+    x_.push_back(position.x);
+    y_.push_back(position.y);
+    z_.push_back(position.z);
+    
+    goalX_.push_back(goal.x);
+    goalY_.push_back(goal.y);
+    goalZ_.push_back(goal.z);
+    
+    gradX_.push_back(0.0f);
+    gradY_.push_back(0.0f);
+    gradZ_.push_back(0.0f);
+    
+    return (int)x_.size() - 1;
+}
+
+void MultiAgentController::setPosition(int agent, const MPVec3 &position)
+{
+    x_[agent] = position.x;
+    y_[agent] = position.y;
+    z_[agent] = position.z;
+}
+
+void MultiAgentController::setGoal(int agent, const MPVec3 &goal)
+{
+    goalX_[agent] = goal.x;
+    goalY_[agent] = goal.y;
+    goalZ_[agent] = goal.z;
+}
+
+void MultiAgentController::step()
+{
+    Timer timer;
+    timer.start();
+    
+    int n = this->getNumAgents();
+    
+    if(n == 0)
+    {
+        return;
+    }
+    
+    // agents repel each other from where they all were at the start of the step
+    positions_.resize(n);
+    
+    for(int i = 0; i < n; ++i)
+    {
+        positions_[i] = MPVec3Make(x_[i], y_[i], z_[i]);
+    }
+    
+    this->updateObstacles();
+    
+    float P = voxelSize_ + 0.25f;
+    
+    if(agentRepulsiveMultiplier_ != 0.0f)
+    {
+        agentGrid_.build(positions_, 2.0f * agentRadius_ + P);
+    }
+    
+    int numThreads = numThreads_ > 0 ? numThreads_ : std::max(1, (int)std::thread::hardware_concurrency());
+    numThreads = std::max(1, std::min(numThreads, n / MP_MIN_AGENTS_PER_THREAD));
+    
+    int agentsPerThread = (n + numThreads - 1) / numThreads;
+    
+    if(numThreads == 1)
+    {
+        this->computeGradients(0, n);
+    }
+    else
+    {
+        this->computeGradientsInChunks(agentsPerThread, numThreads);
+    }
+    
+    // move every agent down its gradient
+    int i = 0;
+    
+#if MP_SIMD_SSE
+    __m128 step = _mm_set1_ps(gradStep_);
+    
+    for(; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&x_[i], _mm_sub_ps(_mm_loadu_ps(&x_[i]), _mm_mul_ps(_mm_loadu_ps(&gradX_[i]), step)));
+        _mm_storeu_ps(&y_[i], _mm_sub_ps(_mm_loadu_ps(&y_[i]), _mm_mul_ps(_mm_loadu_ps(&gradY_[i]), step)));
+        _mm_storeu_ps(&z_[i], _mm_sub_ps(_mm_loadu_ps(&z_[i]), _mm_mul_ps(_mm_loadu_ps(&gradZ_[i]), step)));
+    }
+#endif
+    
+    for(; i < n; ++i)
+    {
+        x_[i] -= gradX_[i] * gradStep_;
+        y_[i] -= gradY_[i] * gradStep_;
+        z_[i] -= gradZ_[i] * gradStep_;
+    }
+    
+    lastStepTime_ = GET_ELAPSED_MICRO(timer) / 1000.0;
+    totalStepTime_ += lastStepTime_;
+    ++numSteps_;
+}
+
+void MultiAgentController::updateObstacles()
+{
+    // the same cutoff as PotentialFieldController
+    float P = voxelSize_ + 0.25f;
+    
+    for(Obstacle &obstacle : obstacles_)
+    {
+        unsigned long epoch = obstacle.model->getTransformEpoch();
+        
+        if(epoch == obstacle.epoch) continue;
+        
+        obstacle.epoch = epoch;
+        
+        MPVec3 scale = obstacle.model->getScale();
+        
+        if(!MPVec3EqualToVec3(scale, obstacle.scale))
+        {
+            int n;
+            MPVec3 *voxArray = MPMeshGetVoxels(obstacle.model->getMesh(), scale, voxelSize_, &n);
+            
+            std::vector<MPVec3> voxels(voxArray, voxArray + n);
+            free(voxArray);
+            
+            obstacle.field.build(voxels, agentRadius_, P, voxelSize_ / MP_REPULSIVE_FIELD_SUBDIVISIONS);
+            obstacle.scale = scale;
+        }
+        
+        MPQuaternion rotation = obstacle.model->getRotation();
+        MPVec3 position = obstacle.model->getPosition();
+        
+        // the voxels are already scaled, so the obstacle's frame only differs by rotation and translation
+        obstacle.toWorld = MPMat4MakeRotation(rotation);
+        obstacle.toLocal = MPMat4MakeRotation(MPQuaternionInvert(rotation));
+        
+        MPVec3 offset = MPMat4TransformVec3(obstacle.toLocal, position);
+        obstacle.toLocal.m[12] = -offset.x;
+        obstacle.toLocal.m[13] = -offset.y;
+        obstacle.toLocal.m[14] = -offset.z;
+    }
+}
+
+void MultiAgentController::computeGradientsInChunks(int chunkSize, int numChunks)
+{
+    // workers are kept between steps, and any beyond those needed get empty chunks
+    while((int)workers_.size() < numChunks - 1)
+    {
+        workers_.push_back(std::thread(&MultiAgentController::workerLoop, this, (int)workers_.size() + 1, workGeneration_));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        
+        workChunkSize_ = chunkSize;
+        workPending_ = (int)workers_.size();
+        ++workGeneration_;
+    }
+    
+    workReady_.notify_all();
+    
+    this->computeGradients(0, std::min(this->getNumAgents(), chunkSize));
+    
+    std::unique_lock<std::mutex> lock(workMutex_);
+    workDone_.wait(lock, [&] { return workPending_ == 0; });
+}
+
+void MultiAgentController::workerLoop(int chunk, unsigned long generation)
+{
+    while(true)
+    {
+        int first, last;
+        
+        {
+            std::unique_lock<std::mutex> lock(workMutex_);
+            workReady_.wait(lock, [&] { return stopping_ || workGeneration_ != generation; });
+            
+            if(stopping_) return;
+            
+            generation = workGeneration_;
+            
+            first = chunk * workChunkSize_;
+            last = std::min(this->getNumAgents(), first + workChunkSize_);
+        }
+        
+        if(first < last)
+        {
+            this->computeGradients(first, last);
+        }
+        
+        std::lock_guard<std::mutex> lock(workMutex_);
+        
+        if(--workPending_ == 0)
+        {
+            workDone_.notify_one();
+        }
+    }
+}
+
+void MultiAgentController::computeGradients(int begin, int end)
+{
+    int count = end - begin;
+    
+    const float *x = &x_[begin], *y = &y_[begin], *z = &z_[begin];
+    const float *goalX = &goalX_[begin], *goalY = &goalY_[begin], *goalZ = &goalZ_[begin];
+    float *gradX = &gradX_[begin], *gradY = &gradY_[begin], *gradZ = &gradZ_[begin];
+    
+    // attractive term, the same as PotentialFieldController::attractivePotentialGrad: conic beyond
+    // the threshold and quadratic within it, i.e. (p - goal) * multiplier * min(1, threshold / distance)
+    const float threshold = 1.0f;
+    
+    int i = 0;
+    
+#if MP_SIMD_SSE
+    __m128 attractive4 = _mm_set1_ps(attractiveMultiplier_);
+    __m128 threshold4 = _mm_set1_ps(threshold);
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(goalX + i));
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(goalY + i));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), _mm_loadu_ps(goalZ + i));
+        
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        
+        // at the goal threshold / distance is infinite, and min picks 1
+        __m128 scale = _mm_mul_ps(attractive4, _mm_min_ps(one, _mm_div_ps(threshold4, distance)));
+        
+        _mm_storeu_ps(gradX + i, _mm_mul_ps(dx, scale));
+        _mm_storeu_ps(gradY + i, _mm_mul_ps(dy, scale));
+        _mm_storeu_ps(gradZ + i, _mm_mul_ps(dz, scale));
+    }
+#endif
+    
+    for(; i < count; ++i)
+    {
+        float dx = x[i] - goalX[i], dy = y[i] - goalY[i], dz = z[i] - goalZ[i];
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+        
+        float scale = attractiveMultiplier_ * (distance <= threshold ? 1.0f : threshold / distance);
+        
+        gradX[i] = dx * scale;
+        gradY[i] = dy * scale;
+        gradZ[i] = dz * scale;
+    }
+    
+    // obstacle terms: move the agents into each obstacle's frame together, look up the field, and
+    // rotate the gradients back out together
+    std::vector<float> localX(count), localY(count), localZ(count);
+    std::vector<float> fieldX(count), fieldY(count), fieldZ(count);
+    
+    for(const Obstacle &obstacle : obstacles_)
+    {
+        MPMat4TransformPoints(obstacle.toLocal, x, y, z, localX.data(), localY.data(), localZ.data(), count);
+        
+        for(i = 0; i < count; ++i)
+        {
+            MPVec3 g = obstacle.field.gradient(MPVec3Make(localX[i], localY[i], localZ[i]));
+            
+            fieldX[i] = g.x * repulsiveMultiplier_;
+            fieldY[i] = g.y * repulsiveMultiplier_;
+            fieldZ[i] = g.z * repulsiveMultiplier_;
+        }
+        
+        MPMat4TransformPoints(obstacle.toWorld, fieldX.data(), fieldY.data(), fieldZ.data(), fieldX.data(), fieldY.data(), fieldZ.data(), count);
+        
+        for(i = 0; i < count; ++i)
+        {
+            gradX[i] += fieldX[i];
+            gradY[i] += fieldY[i];
+            gradZ[i] += fieldZ[i];
+        }
+    }
+    
+    if(agentRepulsiveMultiplier_ == 0.0f) return;
+    
+    // agents repel each other like obstacle voxels do, from their surfaces rather than their centers
+    float P = voxelSize_ + 0.25f;
+    float reach = 2.0f * agentRadius_ + P;
+    float multiplier = repulsiveMultiplier_ * agentRepulsiveMultiplier_;
+    
+    // overlapping agents would otherwise push each other arbitrarily far in one step
+    float minDistance = 0.1f * P;
+    
+    for(i = 0; i < count; ++i)
+    {
+        int agent = begin + i;
+        const MPVec3 &p = positions_[agent];
+        
+        MPVec3 g = MPVec3Zero;
+        
+        agentGrid_.forEachNear(p, reach, [&](const MPVec3 &other, size_t index)
+        {
+            if((int)index == agent) return;
+            
+            float distance = fmaxf(MPVec3EuclideanDistance(p, other) - 2.0f * agentRadius_, minDistance);
+            
+            g = MPVec3Add(g, MPVec3MultiplyScalar(MPVec3Subtract(p, other), (1.0f / P - 1.0f / distance) / distance));
+        });
+        
+        gradX[i] += g.x * multiplier;
+        gradY[i] += g.y * multiplier;
+        gradZ[i] += g.z * multiplier;
+    }
+}
+
+}
@@ -0,0 +1,136 @@
+//
+//  MPMultiAgentController.h
+//
+//  Steps a fleet of identical agents down the same potential as PotentialFieldController, but
+//  all at once: agent state is kept in separate coordinate arrays so the attractive term and
+//  the transforms into each obstacle's frame run several agents at a time, the obstacle fields
+//  are built once for the whole fleet, and agents also repel each other. Large fleets are split
+//  between worker threads that are started once and wait for each step.
+
+#ifndef __MPMultiAgentController__
+#define __MPMultiAgentController__
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "MPModel.h"
+#include "MPRepulsiveField.h"
+#include "MPPointGrid.h"
+
+namespace MP
+{
+
+class MultiAgentController
+{
+public:
+    /* agentRadius plays the role of the active object's radius for every agent */
+    MultiAgentController(const std::vector<Model *> &obstacles, float agentRadius, float voxelSize);
+    
+    ~MultiAgentController();
+    
+    /* returns the index of the new agent */
+    int addAgent(const MPVec3 &position, const MPVec3 &goal);
+    
+    int getNumAgents() const { return (int)x_.size(); }
+    
+    MPVec3 getPosition(int agent) const { return MPVec3Make(x_[agent], y_[agent], z_[agent]); }
+    
+    void setPosition(int agent, const MPVec3 &position);
+    
+    MPVec3 getGoal(int agent) const { return MPVec3Make(goalX_[agent], goalY_[agent], goalZ_[agent]); }
+    
+    void setGoal(int agent, const MPVec3 &goal);
+    
+    void setGradStep(float gradStep) { gradStep_ = gradStep; }
+    
+    void setAttractiveMultiplier(float multiplier) { attractiveMultiplier_ = multiplier; }
+    
+    void setRepulsiveMultiplier(float multiplier) { repulsiveMultiplier_ = multiplier; }
+    
+    /* scales the repulsion between agents, on top of the repulsive multiplier. defaults to 1.0, 0 disables it. */
+    void setAgentRepulsiveMultiplier(float multiplier) { agentRepulsiveMultiplier_ = multiplier; }
+    
+    /* 0 (the default) uses one thread per core */
+    void setNumThreads(int numThreads) { numThreads_ = numThreads; }
+    
+    /* performs a single step of gradient descent for every agent */
+    void step();
+    
+    /* wall clock time of the last step, and the mean over all steps, in milliseconds */
+    double getLastStepTime() const { return lastStepTime_; }
+    
+    double getMeanStepTime() const { return numSteps_ > 0 ? totalStepTime_ / numSteps_ : 0.0; }
+    
+    size_t getNumSteps() const { return numSteps_; }
+    
+private:
+    struct Obstacle
+    {
+        Model *model;
+        RepulsiveField field;
+        
+        /* the scale the field was built for, and the transforms between the obstacle's frame
+         * and the world as of the transform epoch they were taken at */
+        MPVec3 scale;
+        unsigned long epoch;
+        MPMat4 toLocal;
+        MPMat4 toWorld;
+    };
+    
+    /* refreshes the transforms of obstacles that moved since the last step, and rebuilds the
+     * fields of those that were also rescaled */
+    void updateObstacles();
+    
+    /* computes the gradient of the potential for agents [begin, end) into gradX_ etc. */
+    void computeGradients(int begin, int end);
+    
+    /* computes the gradients of every agent, split into chunks of chunkSize. the calling thread
+     * takes the first chunk and workers the rest, starting more workers if there are too few. */
+    void computeGradientsInChunks(int chunkSize, int numChunks);
+    
+    /* waits for a step's chunk and computes its gradients, until the controller is destroyed */
+    void workerLoop(int chunk, unsigned long generation);
+    
+    MultiAgentController(const MultiAgentController &) = delete;
+    MultiAgentController& operator=(const MultiAgentController &) = delete;
+    
+    float agentRadius_;
+    float voxelSize_;
+    
+    /* all default to 1.0 */
+    float gradStep_;
+    float attractiveMultiplier_;
+    float repulsiveMultiplier_;
+    float agentRepulsiveMultiplier_;
+    
+    int numThreads_;
+    
+    std::vector<Obstacle> obstacles_;
+    
+    std::vector<float> x_, y_, z_;
+    std::vector<float> goalX_, goalY_, goalZ_;
+    std::vector<float> gradX_, gradY_, gradZ_;
+    
+    /* agent positions at the start of the current step */
+    std::vector<MPVec3> positions_;
+    PointGrid agentGrid_;
+    
+    /* workers compute chunk index + 1 of each step. the fields below the mutex are guarded by it. */
+    std::vector<std::thread> workers_;
+    std::mutex workMutex_;
+    std::condition_variable workReady_;
+    std::condition_variable workDone_;
+    unsigned long workGeneration_;
+    int workChunkSize_;
+    int workPending_;
+    bool stopping_;
+    
+    double lastStepTime_;
+    double totalStepTime_;
+    size_t numSteps_;
+};
+
+}
+
+#endif
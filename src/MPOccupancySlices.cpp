@@ -0,0 +1,169 @@
+//
+//  MPOccupancySlices.cpp
+//
+
+#include "MPOccupancySlices.h"
+#include <algorithm>
+
+namespace MP
+{
+
+OccupancySlices::OccupancySlices(size_t memoryLimit)
+: numRotations_(1), scale_(MPVec3Make(1.0f, 1.0f, 1.0f)), memoryLimit_(memoryLimit), memoryUsage_(0)
+{
+    min_[0] = min_[1] = min_[2] = 0;
+    dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+OccupancySlices::~OccupancySlices()
+{
+    clear();
+}
+
+void OccupancySlices::setGrid(const int min[3], const int max[3], int numRotations)
+{
+    clear();
+
+    for(int a = 0; a < 3; ++a)
+    {
+        min_[a] = min[a];
+        dims_[a] = std::max(0, max[a] - min[a] + 1);
+    }
+
+    numRotations_ = std::max(1, numRotations);
+}
+
+void OccupancySlices::setMemoryLimit(size_t bytes)
+{
+    memoryLimit_ = bytes;
+    evict(0);
+}
+
+int OccupancySlices::lookup(const Transform3D &state, const OccupiedFn &occupied)
+{
+    MPVec3 p = state.getPosition();
+
+    int i = (int)p.x - min_[0];
+    int j = (int)p.y - min_[1];
+    int k = (int)p.z - min_[2];
+
+    if(i < 0 || i >= dims_[0] || j < 0 || j >= dims_[1] || k < 0 || k >= dims_[2])
+        return -1;
+
+    MPVec3 scale = state.getScale();
+    
+    if(!MPVec3EqualToVec3(scale, scale_))
+    {
+        clear();
+        scale_ = scale;
+    }
+    
+    int index = orientationIndex(state.getRotation());
+
+    auto it = slices_.find(index);
+    if(it == slices_.end())
+    {
+        const int b = MP_SLICE_BLOCK_SIZE;
+        
+        Slice slice;
+        slice.grid = MPBitGridMake(dims_[0], dims_[1], dims_[2]);
+        slice.filled = MPBitGridMake((dims_[0] + b - 1) / b, (dims_[1] + b - 1) / b, (dims_[2] + b - 1) / b);
+
+        evict(byteSize(slice));
+
+        lru_.push_front(index);
+        slice.lru = lru_.begin();
+
+        it = slices_.insert(std::make_pair(index, slice)).first;
+        memoryUsage_ += byteSize(slice);
+    }
+    else if(it->second.lru != lru_.begin())
+    {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+    }
+
+    Slice &slice = it->second;
+    
+    int bi = i / MP_SLICE_BLOCK_SIZE, bj = j / MP_SLICE_BLOCK_SIZE, bk = k / MP_SLICE_BLOCK_SIZE;
+    
+    if(!MPBitGridGet(&slice.filled, bi, bj, bk))
+    {
+        fillBlock(slice.grid, i, j, k, state.getRotation(), scale, occupied);
+        MPBitGridSet(&slice.filled, bi, bj, bk);
+    }
+
+    return MPBitGridGet(&slice.grid, i, j, k);
+}
+
+void OccupancySlices::clear()
+{
+    for(auto &kv : slices_)
+    {
+        MPBitGridFree(&kv.second.grid);
+        MPBitGridFree(&kv.second.filled);
+    }
+
+    slices_.clear();
+    lru_.clear();
+    memoryUsage_ = 0;
+}
+
+#pragma mark - private methods
+
+int OccupancySlices::orientationIndex(const MPQuaternion &q) const
+{
+    // planner orientations are stored as (pitch, yaw, roll) indices in (x, y, z)
+    return ((int)q.x * numRotations_ + (int)q.y) * numRotations_ + (int)q.z;
+}
+
+void OccupancySlices::fillBlock(MPBitGrid &grid, int i, int j, int k, const MPQuaternion &q, const MPVec3 &scale, const OccupiedFn &occupied) const
+{
+    // a planner only looks at the states near its search, so a whole slice would mostly be wasted
+    int first[3] = { i, j, k };
+    int last[3];
+    
+    for(int a = 0; a < 3; ++a)
+    {
+        first[a] -= first[a] % MP_SLICE_BLOCK_SIZE;
+        last[a] = std::min(first[a] + MP_SLICE_BLOCK_SIZE, dims_[a]);
+    }
+    
+    Transform3D state(MPVec3Zero, scale, q);
+    
+    for(int ci = first[0]; ci < last[0]; ++ci)
+    {
+        for(int cj = first[1]; cj < last[1]; ++cj)
+        {
+            for(int ck = first[2]; ck < last[2]; ++ck)
+            {
+                state.setPosition(MPVec3Make(ci + min_[0], cj + min_[1], ck + min_[2]));
+                
+                if(occupied(state))
+                    MPBitGridSet(&grid, ci, cj, ck);
+            }
+        }
+    }
+}
+
+size_t OccupancySlices::byteSize(const Slice &slice)
+{
+    return MPBitGridByteSize(&slice.grid) + MPBitGridByteSize(&slice.filled);
+}
+
+void OccupancySlices::evict(size_t bytesNeeded)
+{
+    // always keep room for at least the slice being added
+    while(!lru_.empty() && memoryUsage_ + bytesNeeded > memoryLimit_)
+    {
+        auto it = slices_.find(lru_.back());
+
+        memoryUsage_ -= byteSize(it->second);
+        MPBitGridFree(&it->second.grid);
+        MPBitGridFree(&it->second.filled);
+
+        slices_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,91 @@
+//
+//  MPOccupancySlices.h
+//
+//  Since the planner only uses a discrete set of orientations, fixing the orientation of the
+//  active object leaves a translation-only configuration space. This class lazily computes
+//  that space as a bitmap (one bit per planner cell, set if occupied) for each orientation,
+//  a small block of cells at a time as states in it are first looked up, and keeps the most
+//  recently used slices up to a memory limit.
+
+#ifndef __MPOccupancySlices__
+#define __MPOccupancySlices__
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include "MPBitGrid.h"
+#include "MPTransform3D.h"
+
+#define DEFAULT_SLICE_MEMORY_LIMIT (64 * 1024 * 1024)
+
+// slices are filled in cubes of this many cells a side
+#define MP_SLICE_BLOCK_SIZE 4
+
+namespace MP
+{
+
+class OccupancySlices
+{
+public:
+    /* returns true if the given planner state is in collision (or out of bounds) */
+    typedef std::function<bool(const Transform3D &)> OccupiedFn;
+
+    OccupancySlices(size_t memoryLimit = DEFAULT_SLICE_MEMORY_LIMIT);
+    ~OccupancySlices();
+
+    /* sets the range of planner cells (inclusive) covered by each slice. clears all slices. */
+    void setGrid(const int min[3], const int max[3], int numRotations);
+
+    void setMemoryLimit(size_t bytes);
+    size_t getMemoryLimit() const { return memoryLimit_; }
+
+    size_t getMemoryUsage() const { return memoryUsage_; }
+
+    int getNumSlices() const { return (int)slices_.size(); }
+
+    /* returns 1 if the planner state is occupied, 0 if it is free, or -1 if its position
+     * lies outside the grid. computes the block of the slice for the state's orientation that
+     * holds it if necessary.
+     * slices are only valid for one scale of the object, so a change of scale clears them. */
+    int lookup(const Transform3D &state, const OccupiedFn &occupied);
+
+    void clear();
+
+private:
+    struct Slice
+    {
+        MPBitGrid grid;
+        
+        /* one bit per block of the grid, set once the block is filled */
+        MPBitGrid filled;
+        
+        std::list<int>::iterator lru;
+    };
+
+    int orientationIndex(const MPQuaternion &q) const;
+
+    /* fills the cells of the block containing cell (i, j, k) */
+    void fillBlock(MPBitGrid &grid, int i, int j, int k, const MPQuaternion &q, const MPVec3 &scale, const OccupiedFn &occupied) const;
+    
+    static size_t byteSize(const Slice &slice);
+
+    void evict(size_t bytesNeeded);
+
+    int min_[3];
+    int dims_[3];
+    int numRotations_;
+    
+    MPVec3 scale_;
+
+    size_t memoryLimit_;
+    size_t memoryUsage_;
+
+    std::unordered_map<int, Slice> slices_;
+
+    /* orientation indices, most recently used first */
+    std::list<int> lru_;
+};
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+//
+//  MPOrientationTable.cpp
+//
+
+#include "MPOrientationTable.h"
+
+namespace MP
+{
+
+OrientationTable::OrientationTable()
+: numRotations_(0), scale_(MPVec3Make(1.0f, 1.0f, 1.0f)), hasExtremePoints_(false)
+{
+}
+
+void OrientationTable::build(double rotationStepSize, int numRotations, const MPMesh *mesh, const MPVec3 &scale)
+{
+    this->clear();
+    
+    if(numRotations < 1 || (long long)numRotations * numRotations * numRotations > MP_ORIENTATION_TABLE_MAX_SIZE)
+    {
+        return;
+    }
+    
+    numRotations_ = numRotations;
+    orientations_.resize(numRotations * numRotations * numRotations);
+    
+    for(int pitch = 0; pitch < numRotations; ++pitch)
+    {
+        for(int yaw = 0; yaw < numRotations; ++yaw)
+        {
+            for(int roll = 0; roll < numRotations; ++roll)
+            {
+                Orientation &o = orientations_[(pitch * numRotations + yaw) * numRotations + roll];
+                
+                // NOTE: the angles are rounded exactly as in Environment3D::plannerToWorld
+                float p = pitch, y = yaw, r = roll;
+                o.rotation = MPRPYToQuaternion(r * rotationStepSize, p * rotationStepSize, y * rotationStepSize);
+                o.matrix = MPMat4MakeRotation(o.rotation);
+            }
+        }
+    }
+    
+    this->setMesh(mesh, scale);
+}
+
+void OrientationTable::setMesh(const MPMesh *mesh, const MPVec3 &scale)
+{
+    scale_ = scale;
+    hasExtremePoints_ = (mesh != nullptr);
+    
+    MPVec3 scaled[6];
+    
+    for(int i = 0; i < 6; ++i)
+    {
+        scaled[i] = MPVec3Zero;
+        
+        if(mesh != nullptr)
+        {
+            MPVec3 e = MPMeshGetExtremePoints(mesh)[i];
+            scaled[i] = MPVec3Make(e.x * scale.x, e.y * scale.y, e.z * scale.z);
+        }
+    }
+    
+    for(auto &o : orientations_)
+    {
+        MPMat4TransformVec3Array(o.matrix, scaled, o.extremePoints, 6);
+    }
+}
+
+void OrientationTable::clear()
+{
+    orientations_.clear();
+    numRotations_ = 0;
+    hasExtremePoints_ = false;
+}
+
+}
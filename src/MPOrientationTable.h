@@ -0,0 +1,80 @@
+//
+//  MPOrientationTable.h
+//
+//  The planner only uses numRotations^3 discrete orientations, stored as (pitch, yaw, roll)
+//  indices in the x, y and z components of a quaternion. This table holds the world rotation
+//  of every one of them, along with its matrix and the rotated extreme points of the active
+//  object, so that the search never has to go through trigonometry to use an orientation.
+
+#ifndef __MPOrientationTable__
+#define __MPOrientationTable__
+
+#include <vector>
+#include "MPMesh.h"
+
+/* tables larger than this (a rotation step of about 8 degrees) aren't built */
+#define MP_ORIENTATION_TABLE_MAX_SIZE (1 << 16)
+
+namespace MP
+{
+
+class OrientationTable
+{
+public:
+    struct Orientation
+    {
+        MPQuaternion rotation;
+        MPMat4 matrix;
+        
+        /* the extreme points of the mesh, scaled and then rotated */
+        MPVec3 extremePoints[6];
+    };
+    
+    OrientationTable();
+    
+    /* computes every orientation reachable with the given rotation step. the mesh may be null,
+     * in which case the extreme points are left at the origin. */
+    void build(double rotationStepSize, int numRotations, const MPMesh *mesh, const MPVec3 &scale);
+    
+    /* recomputes only the extreme points, for a new mesh or scale */
+    void setMesh(const MPMesh *mesh, const MPVec3 &scale);
+    
+    void clear();
+    
+    bool empty() const { return orientations_.empty(); }
+    
+    int size() const { return (int)orientations_.size(); }
+    
+    /* the scale the extreme points were computed for */
+    MPVec3 getScale() const { return scale_; }
+    
+    bool hasExtremePoints() const { return hasExtremePoints_; }
+    
+    /* returns the orientation for the given planner rotation, or null if it is out of range */
+    const Orientation* find(const MPQuaternion &plannerRotation) const
+    {
+        int pitch = (int)plannerRotation.x;
+        int yaw = (int)plannerRotation.y;
+        int roll = (int)plannerRotation.z;
+        
+        if(pitch < 0 || pitch >= numRotations_ || yaw < 0 || yaw >= numRotations_ || roll < 0 || roll >= numRotations_ ||
+           orientations_.empty())
+        {
+            return nullptr;
+        }
+        
+        return &orientations_[(pitch * numRotations_ + yaw) * numRotations_ + roll];
+    }
+    
+private:
+    std::vector<Orientation> orientations_;
+    
+    int numRotations_;
+    
+    MPVec3 scale_;
+    bool hasExtremePoints_;
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+//
+//  MPPointGrid.cpp
+//
+
+#include "MPPointGrid.h"
+
+namespace MP
+{
+
+PointGrid::PointGrid()
+: cellSize_(1.0f), bucketMask_(0)
+{
+}
+
+void PointGrid::build(const std::vector<MPVec3> &points, float cellSize)
+{
+    clear();
+    
+    if(points.empty() || cellSize <= 0.0f) return;
+    
+    cellSize_ = cellSize;
+    
+    // at least twice as many buckets as points keeps collisions rare
+    size_t numBuckets = 1;
+    while(numBuckets < 2 * points.size()) numBuckets <<= 1;
+    
+    bucketMask_ = numBuckets - 1;
+    
+    // counting sort of the points by bucket
+    std::vector<size_t> buckets(points.size());
+    bucketStart_.assign(numBuckets + 1, 0);
+    
+    for(size_t n = 0; n < points.size(); ++n)
+    {
+        const MPVec3 &p = points[n];
+        
+        buckets[n] = bucket(cellCoordinate(p.x), cellCoordinate(p.y), cellCoordinate(p.z));
+        ++bucketStart_[buckets[n] + 1];
+    }
+    
+    for(size_t b = 0; b < numBuckets; ++b)
+    {
+        bucketStart_[b + 1] += bucketStart_[b];
+    }
+    
+    std::vector<size_t> next(bucketStart_.begin(), bucketStart_.end() - 1);
+    points_.resize(points.size());
+    indices_.resize(points.size());
+    
+    for(size_t n = 0; n < points.size(); ++n)
+    {
+        size_t sorted = next[buckets[n]]++;
+        
+        points_[sorted] = points[n];
+        indices_[sorted] = n;
+    }
+}
+
+void PointGrid::clear()
+{
+    bucketStart_.clear();
+    points_.clear();
+    indices_.clear();
+    bucketMask_ = 0;
+}
+
+}
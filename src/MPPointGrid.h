@@ -0,0 +1,120 @@
+//
+//  MPPointGrid.h
+//
+//  A hashed uniform grid over a fixed set of points, for finding the points within a radius
+//  of a query without visiting all of them. Points are sorted by bucket, so the points of a
+//  bucket are contiguous and a query only touches the buckets of the cells it overlaps.
+
+#ifndef __MPPointGrid__
+#define __MPPointGrid__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "MPMath.h"
+
+namespace MP
+{
+
+class PointGrid
+{
+public:
+    PointGrid();
+    
+    /* indexes the points in cells of the given size. queries are fastest when their radius is
+     * about the cell size. */
+    void build(const std::vector<MPVec3> &points, float cellSize);
+    
+    void clear();
+    
+    bool isBuilt() const { return !bucketStart_.empty(); }
+    
+    size_t size() const { return points_.size(); }
+    
+    float getCellSize() const { return cellSize_; }
+    
+    /* calls fn(point, index) for every point within radius of p, where index is the point's position
+     * in the vector the grid was built from. returns the number of points that had to be visited to
+     * find them (those in the buckets of the overlapped cells). */
+    template<typename Fn>
+    size_t forEachNear(const MPVec3 &p, float radius, Fn fn) const;
+    
+private:
+    int cellCoordinate(float x) const { return (int)std::floor(x / cellSize_); }
+    
+    size_t bucket(int i, int j, int k) const
+    {
+        return (((unsigned)i * 73856093u) ^ ((unsigned)j * 19349663u) ^ ((unsigned)k * 83492791u)) & bucketMask_;
+    }
+    
+    float cellSize_;
+    size_t bucketMask_;
+    
+    /* the points of bucket b are points_[bucketStart_[b]] to points_[bucketStart_[b + 1] - 1] */
+    std::vector<size_t> bucketStart_;
+    std::vector<MPVec3> points_;
+    std::vector<size_t> indices_;
+};
+
+template<typename Fn>
+size_t PointGrid::forEachNear(const MPVec3 &p, float radius, Fn fn) const
+{
+    if(points_.empty()) return 0;
+    
+    int lo[3], hi[3];
+    for(int a = 0; a < 3; ++a)
+    {
+        lo[a] = cellCoordinate(p.v[a] - radius);
+        hi[a] = cellCoordinate(p.v[a] + radius);
+    }
+    
+    size_t count = 0;
+    float radiusSquared = radius * radius;
+    
+    // a radius much larger than the cells would touch most buckets anyway
+    if((long long)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1) > 27)
+    {
+        for(size_t n = 0; n < points_.size(); ++n)
+        {
+            MPVec3 d = MPVec3Subtract(points_[n], p);
+            
+            if(MPVec3DotProduct(d, d) <= radiusSquared) fn(points_[n], indices_[n]);
+        }
+        
+        return points_.size();
+    }
+    
+    // distinct cells can share a bucket, which must only be visited once
+    size_t visitedBuckets[27];
+    int numVisited = 0;
+    
+    for(int i = lo[0]; i <= hi[0]; ++i)
+    {
+        for(int j = lo[1]; j <= hi[1]; ++j)
+        {
+            for(int k = lo[2]; k <= hi[2]; ++k)
+            {
+                size_t b = bucket(i, j, k);
+                
+                if(std::find(visitedBuckets, visitedBuckets + numVisited, b) != visitedBuckets + numVisited) continue;
+                
+                visitedBuckets[numVisited++] = b;
+                
+                for(size_t n = bucketStart_[b]; n < bucketStart_[b + 1]; ++n)
+                {
+                    MPVec3 d = MPVec3Subtract(points_[n], p);
+                    
+                    if(MPVec3DotProduct(d, d) <= radiusSquared) fn(points_[n], indices_[n]);
+                }
+                
+                count += bucketStart_[b + 1] - bucketStart_[b];
+            }
+        }
+    }
+    
+    return count;
+}
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+//
+//  MPPoseBatch.h
+//
+//  A set of poses stored as a structure of arrays, so that batched validity checks can
+//  sweep each component across all poses at once.
+
+#ifndef __MPPoseBatch__
+#define __MPPoseBatch__
+
+#include <vector>
+#include <cstdint>
+#include "MPTransform3D.h"
+
+namespace MP
+{
+
+class PoseBatch
+{
+public:
+    /* bit i of word i / 64 is set if pose i passed */
+    typedef std::vector<uint64_t> Mask;
+
+    size_t size() const { return x.size(); }
+
+    bool empty() const { return x.empty(); }
+
+    void reserve(size_t n)
+    {
+        for(auto c : components()) c->reserve(n);
+    }
+
+    void clear()
+    {
+        for(auto c : components()) c->clear();
+    }
+
+    void push_back(const Transform3D &T)
+    {
+        MPVec3 p = T.getPosition();
+        MPVec3 s = T.getScale();
+        MPQuaternion q = T.getRotation();
+
+        x.push_back(p.x); y.push_back(p.y); z.push_back(p.z);
+        sx.push_back(s.x); sy.push_back(s.y); sz.push_back(s.z);
+        qx.push_back(q.x); qy.push_back(q.y); qz.push_back(q.z); qw.push_back(q.w);
+    }
+
+    Transform3D get(size_t i) const
+    {
+        return Transform3D(MPVec3Make(x[i], y[i], z[i]), MPVec3Make(sx[i], sy[i], sz[i]), MPQuaternionMake(qx[i], qy[i], qz[i], qw[i]));
+    }
+
+    static bool maskGet(const Mask &mask, size_t i) { return (mask[i / 64] >> (i % 64)) & 1; }
+
+    static void maskSet(Mask &mask, size_t i) { mask[i / 64] |= (uint64_t)1 << (i % 64); }
+
+    /* position */
+    std::vector<float> x, y, z;
+
+    /* scale */
+    std::vector<float> sx, sy, sz;
+
+    /* rotation */
+    std::vector<float> qx, qy, qz, qw;
+
+private:
+    std::vector<std::vector<float> *> components()
+    {
+        return {&x, &y, &z, &sx, &sy, &sz, &qx, &qy, &qz, &qw};
+    }
+};
+
+}
+
+#endif
@@ -7,44 +7,79 @@
 #include "MPPotentialFieldController.h"
 #include "MPUtils.h"
 
+// the smallest the object's radius is taken to be while following a path, before giving up and replanning
+#define MP_MIN_RADIUS_SCALE (1.0f / 16.0f)
+
 namespace MP
 {
 PotentialFieldController::PotentialFieldController(const std::vector<Model *> &obstacles, Model *activeObject, float voxelSize)
-: activeObject_(activeObject), voxelSize_(voxelSize), gradStep_(1.0f), attractiveMultiplier_(1.0f), repulsiveMultiplier_(1.0f)
-{    
+: activeObject_(activeObject), voxelSize_(voxelSize), gradStep_(1.0f), attractiveMultiplier_(1.0f), repulsiveMultiplier_(1.0f),
+  useRepulsiveField_(true), voxelsVisited_(0), totalVoxelsVisited_(0), numSteps_(0),
+  planner_(nullptr), waypointTolerance_(voxelSize), stallSteps_(30), stallProgress_(0.1f * voxelSize),
+  nextWaypoint_(0), needsPlan_(false), bestDistance_(Inf), stepsWithoutProgress_(0), radiusScale_(1.0f), numReplans_(0)
+{
+    MPSphere activeSphere = MPSphereTransformTRS(MPMeshGetBoundingSphere(activeObject->getMesh(), NULL),
+                                                 activeObject->getPosition(), activeObject->getRotation(), activeObject->getScale());
+    
     for(auto obstacle : obstacles)
     {
-        // TODO: make voxel size a parameter somewhere
-        int n;
-        MPVec3 *voxArray = MPMeshGetVoxels(obstacle->getMesh(), obstacle->getScale(), voxelSize, &n);
-        
-        std::vector<MPVec3> voxels;
+        RepulsiveObstacle &repulsive = obstacles_[obstacle];
+        repulsive.scale = MPVec3Zero;
+        repulsive.epoch = 0;
         
-        for (int i = 0; i < n; ++i)
-        {
-            voxels.push_back(voxArray[i]);
-        }
-        
-        obstacles_.insert(std::make_pair(obstacle, voxels));
-        
-        free(voxArray);
+        this->updateObstaclePose(obstacle, repulsive);
+        this->updateRepulsiveField(obstacle, repulsive, 0.5f * activeSphere.radius);
     }
 }
 
 PotentialFieldController::PotentialFieldController()
+: useRepulsiveField_(true), voxelsVisited_(0), totalVoxelsVisited_(0), numSteps_(0),
+  planner_(nullptr), waypointTolerance_(0.0f), stallSteps_(30), stallProgress_(0.0f),
+  nextWaypoint_(0), needsPlan_(false), bestDistance_(Inf), stepsWithoutProgress_(0), radiusScale_(1.0f), numReplans_(0)
 {
 }
 
 void PotentialFieldController::setGoal(const Transform3D &goal)
 {
     goal_ = goal;
+    
+    needsPlan_ = true;
+}
+
+void PotentialFieldController::setPlanner(Planner<Transform3D> *planner)
+{
+    planner_ = planner;
+    
+    waypoints_.clear();
+    needsPlan_ = true;
+    radiusScale_ = 1.0f;
+}
+
+void PotentialFieldController::resetCounters()
+{
+    voxelsVisited_ = 0;
+    totalVoxelsVisited_ = 0;
+    numSteps_ = 0;
 }
 
 void PotentialFieldController::move() const
 {
+    voxelsVisited_ = 0;
+    ++numSteps_;
+    
     // Perform a single step of gradient descent
     MPVec3 currentPosition = activeObject_->getPosition();
-    MPVec3 gradient = potentialGrad(currentPosition);
+    
+    MPVec3 gradient = MPVec3Zero;
+    
+    if(planner_ != nullptr)
+    {
+        this->updateWaypoints(currentPosition);
+    }
+    
+    // obstacles push in every direction, even along a planned path, so the object still avoids
+    // anything that moves into its way
+    gradient = potentialGrad(currentPosition);
     
     // TODO: Check for convergence (i.e. when gradient of potential function is close to zero
     // or, || gradient || < epsilon for some epsilon)
@@ -57,70 +92,202 @@ MPVec3 PotentialFieldController::potentialGrad(const MPVec3 &p) const
 {
     // By superposition and linearity, the gradient of the potential at p is simply the
     // sum of the individual contributions from all the "particles"
-    MPVec3 potentialGrad = attractivePotentialGrad(p);
+    return MPVec3Add(attractivePotentialGrad(p), obstaclePotentialGrad(p));
+}
+
+MPVec3 PotentialFieldController::obstaclePotentialGrad(const MPVec3 &p) const
+{
+    MPVec3 potentialGrad = MPVec3Zero;
     
-    const MPMat4 activeT = this->activeObject_->getTransform().getMatrix();
-    MPSphere activeSphere = MPMeshGetBoundingSphere(this->activeObject_->getMesh(), &activeT);
+    MPSphere activeSphere = MPSphereTransformTRS(MPMeshGetBoundingSphere(this->activeObject_->getMesh(), NULL),
+                                                 this->activeObject_->getPosition(), this->activeObject_->getRotation(), this->activeObject_->getScale());
+    
+    // TODO: what should these radii be?
+    float r = 0.5f * activeSphere.radius * this->radiusScale_;
+    float P = this->voxelSize_ + 0.25f;
     
     for(auto it = this->obstacles_.begin(); it != this->obstacles_.end(); ++it)
     {
         Model *obstacle = it->first;
-        std::vector<MPVec3> voxels = it->second;
-        
-        const MPMat4 matrix = obstacle->getTransform().getMatrix();
-        MPSphere boundingSphere = MPMeshGetBoundingSphere(obstacle->getMesh(), &matrix);
+        RepulsiveObstacle &repulsive = it->second;
         
-        MPVec3 trans = obstacle->getPosition();
+        this->updateObstaclePose(obstacle, repulsive);
         
-        MPMat4 tr = MPMat4MakeRotation(obstacle->getRotation());
-
-        // shortcut to apply translation
-        tr.m[12] = trans.x;
-        tr.m[13] = trans.y;
-        tr.m[14] = trans.z;
-        
-        if (MPSphereIntersectsSphere(boundingSphere, activeSphere))
+        if (MPSphereIntersectsSphere(repulsive.boundingSphere, activeSphere))
         {
-            for (auto vox : voxels)
+            this->updateRepulsiveField(obstacle, repulsive, r);
+            
+            // the voxels are already scaled, so only rotation and translation take p to the obstacle's frame
+            MPVec3 local = MPQuaternionRotateVec3(repulsive.inverseRotation, MPVec3Subtract(p, repulsive.position));
+            
+            MPVec3 repulsiveGrad = MPVec3Zero;
+            
+            if(this->useRepulsiveField_)
             {
-                MPVec3ApplyTransform(&vox, tr);
-                
-                // TODO: what should these radii be?
-                MPVec3 repulsiveGrad = repulsivePotentialGrad(vox, p, 0.5f * activeSphere.radius, this->voxelSize_ + 0.25f);
+                repulsiveGrad = MPVec3MultiplyScalar(repulsive.field.gradient(local), this->repulsiveMultiplier_);
+            }
+            else
+            {
+                // only voxels within r + P of p have any effect
+                size_t visited = repulsive.voxelGrid.forEachNear(local, r + P, [&](const MPVec3 &vox, size_t)
+                {
+                    repulsiveGrad = MPVec3Add(repulsiveGrad, this->repulsivePotentialGrad(vox, local, r, P));
+                });
                 
-                potentialGrad.x += repulsiveGrad.x;
-                potentialGrad.y += repulsiveGrad.y;
-                potentialGrad.z += repulsiveGrad.z;
+                voxelsVisited_ += visited;
+                totalVoxelsVisited_ += visited;
             }
+            
+            repulsiveGrad = MPQuaternionRotateVec3(repulsive.rotation, repulsiveGrad);
+            
+            potentialGrad.x += repulsiveGrad.x;
+            potentialGrad.y += repulsiveGrad.y;
+            potentialGrad.z += repulsiveGrad.z;
         }
     }
     
     return potentialGrad;
 }
 
+void PotentialFieldController::updateObstaclePose(Model *obstacle, RepulsiveObstacle &repulsive) const
+{
+    unsigned long epoch = obstacle->getTransformEpoch();
+    
+    if(epoch == repulsive.epoch) return;
+    
+    repulsive.epoch = epoch;
+    repulsive.position = obstacle->getPosition();
+    repulsive.rotation = obstacle->getRotation();
+    repulsive.inverseRotation = MPQuaternionInvert(repulsive.rotation);
+    repulsive.boundingSphere = MPSphereTransformTRS(MPMeshGetBoundingSphere(obstacle->getMesh(), NULL),
+                                                    repulsive.position, repulsive.rotation, obstacle->getScale());
+}
+
+void PotentialFieldController::updateRepulsiveField(Model *obstacle, RepulsiveObstacle &repulsive, float r) const
+{
+    MPVec3 scale = obstacle->getScale();
+    
+    // the repulsive effect reaches a little beyond the voxels
+    float P = this->voxelSize_ + 0.25f;
+    
+    if(!MPVec3EqualToVec3(scale, repulsive.scale))
+    {
+        // TODO: make voxel size a parameter somewhere
+        int n;
+        MPVec3 *voxArray = MPMeshGetVoxels(obstacle->getMesh(), scale, this->voxelSize_, &n);
+        
+        repulsive.voxels.assign(voxArray, voxArray + n);
+        repulsive.scale = scale;
+        repulsive.field.clear();
+        
+        free(voxArray);
+    }
+    
+    if(!repulsive.voxelGrid.isBuilt() || repulsive.voxelGrid.getCellSize() != r + P)
+    {
+        repulsive.voxelGrid.build(repulsive.voxels, r + P);
+    }
+    
+    if(this->useRepulsiveField_ && (!repulsive.field.isBuilt() || repulsive.field.getRadius() != r || repulsive.field.getCutoff() != P))
+    {
+        repulsive.field.build(repulsive.voxels, r, P, this->voxelSize_ / MP_REPULSIVE_FIELD_SUBDIVISIONS);
+    }
+}
+
 MPVec3 PotentialFieldController::attractivePotentialGrad(const MPVec3 &p) const
 {
     // TODO: Move this (arbitrarily-defined) constant somewhere better
     const float threshold = 1.0f;
     
-    float distance = MPVec3EuclideanDistance(p, goal_.getPosition());
+    MPVec3 goal = this->target();
+    
+    float distance = MPVec3EuclideanDistance(p, goal);
     
     MPVec3 potentialGrad = MPVec3Zero;
     
     if(distance <= threshold)
     {
-        potentialGrad = MPVec3Subtract(p, goal_.getPosition());
+        potentialGrad = MPVec3Subtract(p, goal);
         potentialGrad = MPVec3MultiplyScalar(potentialGrad, this->attractiveMultiplier_);
     }
     else
     {
-        potentialGrad = MPVec3Subtract(p, goal_.getPosition());
+        potentialGrad = MPVec3Subtract(p, goal);
         potentialGrad = MPVec3MultiplyScalar(potentialGrad, (threshold * this->attractiveMultiplier_) / (distance));
     }
     
     return potentialGrad;
 }
 
+MPVec3 PotentialFieldController::target() const
+{
+    if(planner_ != nullptr && nextWaypoint_ < waypoints_.size())
+    {
+        return waypoints_[nextWaypoint_].getPosition();
+    }
+    
+    return goal_.getPosition();
+}
+
+void PotentialFieldController::updateWaypoints(const MPVec3 &p) const
+{
+    if(!needsPlan_)
+    {
+        // without a path (the last plan failed) progress is measured toward the goal, so a stall
+        // still leads to another attempt
+        float distance = MPVec3EuclideanDistance(p, this->target());
+        
+        if(distance <= waypointTolerance_)
+        {
+            // the last waypoint is the goal, which stays the target once reached
+            if(nextWaypoint_ + 1 < waypoints_.size()) ++nextWaypoint_;
+            
+            bestDistance_ = Inf;
+            stepsWithoutProgress_ = 0;
+            return;
+        }
+        
+        if(distance < bestDistance_ - stallProgress_)
+        {
+            bestDistance_ = distance;
+            stepsWithoutProgress_ = 0;
+            return;
+        }
+        
+        if(++stepsWithoutProgress_ < stallSteps_) return;
+        
+        // the path is known to be clear, but the field's model of the object is more conservative
+        // than the planner's collision checks and can hold it back in narrow passages. so the
+        // object's radius in the field is shrunk until the path is followed, and a new path is
+        // only planned once that doesn't help.
+        if(nextWaypoint_ < waypoints_.size() && radiusScale_ > MP_MIN_RADIUS_SCALE)
+        {
+            radiusScale_ *= 0.5f;
+            stepsWithoutProgress_ = 0;
+            return;
+        }
+        
+        // stuck in a local minimum of the field, so find a new way from here
+        ++numReplans_;
+    }
+    
+    needsPlan_ = false;
+    
+    waypoints_.clear();
+    nextWaypoint_ = 0;
+    bestDistance_ = Inf;
+    stepsWithoutProgress_ = 0;
+    radiusScale_ = 1.0f;
+    
+    Transform3D start = activeObject_->getTransform();
+    
+    // without a path the object is pulled straight at the goal until it stalls again
+    if(!planner_->plan(start, goal_, waypoints_))
+    {
+        waypoints_.clear();
+    }
+}
+
 MPVec3 PotentialFieldController::repulsivePotentialGrad(const MPVec3 &pObs, const MPVec3 &p, float r, float P) const
 {
     float distance = MPVec3EuclideanDistance(pObs, p) - r;
@@ -137,4 +304,4 @@ MPVec3 PotentialFieldController::repulsivePotentialGrad(const MPVec3 &pObs, cons
     // Compute the gradient of the repulsive potential function
     return MPVec3MultiplyScalar(distanceGrad, multiplier);
 }
-}
\ No newline at end of file
+}
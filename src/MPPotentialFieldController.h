@@ -10,6 +10,9 @@
 #include <iostream>
 #include <map>
 #include "MPModel.h"
+#include "MPPlanner.h"
+#include "MPRepulsiveField.h"
+#include "MPPointGrid.h"
 
 namespace MP
 {
@@ -29,19 +32,89 @@ public:
     
     void setRepulsiveMultiplier(float multiplier) { repulsiveMultiplier_ = multiplier; }
     
+    /* when enabled (the default), the repulsive gradient is looked up in precomputed fields.
+     * otherwise it is summed exactly over the obstacle voxels within the cutoff. */
+    void setUseRepulsiveField(bool use) { useRepulsiveField_ = use; }
+    
+    bool usesRepulsiveField() const { return useRepulsiveField_; }
+    
+    /* with a planner (not owned), the controller follows the planner's path to the goal, using the
+     * potential field only to track the next waypoint and avoid obstacles on the way. when progress
+     * to a waypoint stalls, the object's radius in the field is shrunk for the rest of the path. a
+     * new path is only planned when the goal changes or that doesn't help, including when no path
+     * was found and the object is pulled straight at the goal. pass null to always pull straight at
+     * the goal. */
+    void setPlanner(Planner<Transform3D> *planner);
+    
+    /* a waypoint is reached once the object is within this distance of it. defaults to the voxel size. */
+    void setWaypointTolerance(float tolerance) { waypointTolerance_ = tolerance; }
+    
+    /* progress has stalled when the distance to the target (the next waypoint, or the goal) hasn't
+     * shrunk by at least minProgress within the given number of steps. default to 30 steps and a
+     * tenth of the voxel size. */
+    void setStallDetection(int steps, float minProgress) { stallSteps_ = steps; stallProgress_ = minProgress; }
+    
+    const std::vector<Transform3D>& getWaypoints() const { return waypoints_; }
+    
+    size_t getNumReplans() const { return numReplans_; }
+    
     void move() const;
     
+    /* the number of obstacle voxels visited by the last move(), and by all moves since the
+     * counters were reset. lookups in the repulsive fields don't visit any voxels. */
+    size_t getVoxelsVisited() const { return voxelsVisited_; }
+    
+    size_t getTotalVoxelsVisited() const { return totalVoxelsVisited_; }
+    
+    size_t getNumSteps() const { return numSteps_; }
+    
+    void resetCounters();
+    
 private:
+    /* an obstacle's voxels and the repulsive field they make, in the obstacle's frame */
+    struct RepulsiveObstacle
+    {
+        std::vector<MPVec3> voxels;
+        MPVec3 scale;
+        
+        /* the obstacle's pose and world bounding sphere, as of the transform epoch they were taken at */
+        unsigned long epoch;
+        MPVec3 position;
+        MPQuaternion rotation;
+        MPQuaternion inverseRotation;
+        MPSphere boundingSphere;
+        
+        /* the voxels, indexed for finding those within the cutoff of a point */
+        PointGrid voxelGrid;
+        RepulsiveField field;
+    };
+    
     /* Potential functions inspired by http://www.cs.cmu.edu/~motionplanning/lecture/Chap4-Potential-Field_howie.pdf */
     MPVec3 potentialGrad(const MPVec3 &p) const;
     
     MPVec3 attractivePotentialGrad(const MPVec3 &p) const;
     
+    /* the sum of the repulsive contributions of all nearby obstacles */
+    MPVec3 obstaclePotentialGrad(const MPVec3 &p) const;
+    
+    /* the position the object is pulled toward: the next waypoint, or the goal */
+    MPVec3 target() const;
+    
+    /* plans a path if there is none, advances past reached waypoints, and replans when stalled */
+    void updateWaypoints(const MPVec3 &p) const;
+    
     /* pObs is the position of the obstacle
      * p is the position of the moving object
      * P is the cutoff beyond which there is no repuslive effect */
     MPVec3 repulsivePotentialGrad(const MPVec3 &pObs, const MPVec3 &p, float r, float P) const;
     
+    /* refreshes the obstacle's cached pose if it has moved since the last step */
+    void updateObstaclePose(Model *obstacle, RepulsiveObstacle &repulsive) const;
+    
+    /* revoxelizes the obstacle if its scale changed, and rebuilds its voxel grid and field (if used)
+     * if anything they depend on changed. r is the radius of the moving object. */
+    void updateRepulsiveField(Model *obstacle, RepulsiveObstacle &repulsive, float r) const;
+    
     float voxelSize_;
     
     /* all default to 1.0 */
@@ -49,10 +122,35 @@ private:
     float attractiveMultiplier_;
     float repulsiveMultiplier_;
     
-    std::map<Model *, std::vector<MPVec3>> obstacles_;
+    bool useRepulsiveField_;
+    
+    /* fields are built up front, and only rebuilt when a scale changes */
+    mutable std::map<Model *, RepulsiveObstacle> obstacles_;
+    
+    mutable size_t voxelsVisited_;
+    mutable size_t totalVoxelsVisited_;
+    mutable size_t numSteps_;
     
     Model *activeObject_;
     Transform3D goal_;
+    
+    Planner<Transform3D> *planner_;
+    float waypointTolerance_;
+    int stallSteps_;
+    float stallProgress_;
+    
+    mutable std::vector<Transform3D> waypoints_;
+    mutable size_t nextWaypoint_;
+    mutable bool needsPlan_;
+    
+    /* the closest the object has come to the target, and the steps since it got closer */
+    mutable float bestDistance_;
+    mutable int stepsWithoutProgress_;
+    
+    /* scales the object's radius in the repulsive fields. halved each time the object stalls short
+     * of a waypoint, and reset with each new path. */
+    mutable float radiusScale_;
+    mutable size_t numReplans_;
 };
     
 }
@@ -0,0 +1,523 @@
+//
+//  MPPredicates.c
+//
+
+#include <float.h>
+#include <math.h>
+#include "MPPredicates.h"
+
+#pragma mark - private definitions
+
+// error bounds of the double precision determinants (Shewchuk, with epsilon = 2^-53)
+#define MP_EPSILON (DBL_EPSILON * 0.5)
+#define MP_ORIENT3D_BOUND ((7.0 + 56.0 * MP_EPSILON) * MP_EPSILON)
+#define MP_ORIENT2D_BOUND ((3.0 + 16.0 * MP_EPSILON) * MP_EPSILON)
+
+// an exact 3x3 determinant of 2 term differences needs at most 192 terms
+#define MP_EXPANSION_MAX 192
+
+int _MPTwoDiff(double a, double b, double *h);
+
+int _MPGrowExpansion(int elen, double *e, double b);
+
+int _MPScaleExpansion(int elen, const double *e, double b, double *h);
+
+int _MPExpansionSum(int elen, double *e, int flen, const double *f);
+
+int _MPExpansionProduct(int elen, const double *e, int flen, const double *f, double *h);
+
+int _MPExpansionSign(int elen, const double *e);
+
+int _MPOrient3DExact(MPVec3 a, MPVec3 b, MPVec3 c, MPVec3 d);
+
+int _MPOrient2DExact(MPVec3 a, MPVec3 b, MPVec3 c, int dropAxis);
+
+int _MPTrianglesIntersect3D(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int dp2, int dq2, int dr2, const MPTrianglePlane *plane1, MPTriangle t2);
+
+int _MPCheckMinMax(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2);
+
+int _MPCoplanarTrianglesIntersect(const MPTrianglePlane *plane1, MPTriangle t2);
+
+int _MPCCWTrianglesIntersect2D(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int axis);
+
+int _MPIntersectionTestVertex(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int axis);
+
+int _MPIntersectionTestEdge(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 r2, int axis);
+
+#pragma mark - public functions
+
+int MPOrient3D(MPVec3 a, MPVec3 b, MPVec3 c, MPVec3 d)
+{
+    double ux = (double)b.x - a.x, uy = (double)b.y - a.y, uz = (double)b.z - a.z;
+    double vx = (double)c.x - a.x, vy = (double)c.y - a.y, vz = (double)c.z - a.z;
+    double wx = (double)d.x - a.x, wy = (double)d.y - a.y, wz = (double)d.z - a.z;
+
+    double uyvz = uy * vz, uzvy = uz * vy;
+    double uzvx = uz * vx, uxvz = ux * vz;
+    double uxvy = ux * vy, uyvx = uy * vx;
+
+    double det = wx * (uyvz - uzvy) + wy * (uzvx - uxvz) + wz * (uxvy - uyvx);
+    double permanent = fabs(wx) * (fabs(uyvz) + fabs(uzvy)) + fabs(wy) * (fabs(uzvx) + fabs(uxvz)) + fabs(wz) * (fabs(uxvy) + fabs(uyvx));
+    double bound = MP_ORIENT3D_BOUND * permanent;
+
+    if (det > bound) return 1;
+    if (-det > bound) return -1;
+
+    return _MPOrient3DExact(a, b, c, d);
+}
+
+int MPOrient2D(MPVec3 a, MPVec3 b, MPVec3 c, int dropAxis)
+{
+    int i = (dropAxis + 1) % 3;
+    int j = (dropAxis + 2) % 3;
+
+    double left = ((double)a.v[i] - c.v[i]) * ((double)b.v[j] - c.v[j]);
+    double right = ((double)a.v[j] - c.v[j]) * ((double)b.v[i] - c.v[i]);
+
+    double det = left - right;
+    double bound = MP_ORIENT2D_BOUND * (fabs(left) + fabs(right));
+
+    if (det > bound) return 1;
+    if (-det > bound) return -1;
+
+    return _MPOrient2DExact(a, b, c, dropAxis);
+}
+
+MPTrianglePlane MPTrianglePlaneMake(MPTriangle t)
+{
+    MPTrianglePlane plane;
+    plane.triangle = t;
+
+    double ux = (double)t.v2.x - t.v1.x, uy = (double)t.v2.y - t.v1.y, uz = (double)t.v2.z - t.v1.z;
+    double vx = (double)t.v3.x - t.v1.x, vy = (double)t.v3.y - t.v1.y, vz = (double)t.v3.z - t.v1.z;
+
+    double uyvz = uy * vz, uzvy = uz * vy;
+    double uzvx = uz * vx, uxvz = ux * vz;
+    double uxvy = ux * vy, uyvx = uy * vx;
+
+    plane.normal[0] = uyvz - uzvy;
+    plane.normal[1] = uzvx - uxvz;
+    plane.normal[2] = uxvy - uyvx;
+
+    plane.bound[0] = MP_ORIENT3D_BOUND * (fabs(uyvz) + fabs(uzvy));
+    plane.bound[1] = MP_ORIENT3D_BOUND * (fabs(uzvx) + fabs(uxvz));
+    plane.bound[2] = MP_ORIENT3D_BOUND * (fabs(uxvy) + fabs(uyvx));
+
+    return plane;
+}
+
+int MPTrianglePlaneSide(const MPTrianglePlane *plane, MPVec3 p)
+{
+    const MPVec3 o = plane->triangle.v1;
+
+    double wx = (double)p.x - o.x, wy = (double)p.y - o.y, wz = (double)p.z - o.z;
+
+    double det = wx * plane->normal[0] + wy * plane->normal[1] + wz * plane->normal[2];
+    double bound = fabs(wx) * plane->bound[0] + fabs(wy) * plane->bound[1] + fabs(wz) * plane->bound[2];
+
+    if (det > bound) return 1;
+    if (-det > bound) return -1;
+
+    return _MPOrient3DExact(plane->triangle.v1, plane->triangle.v2, plane->triangle.v3, p);
+}
+
+int MPTrianglesIntersect(MPTriangle t1, MPTriangle t2)
+{
+    MPTrianglePlane plane1 = MPTrianglePlaneMake(t1);
+
+    return MPTrianglesIntersectWithPlane(&plane1, t2);
+}
+
+int MPTrianglesIntersectWithPlane(const MPTrianglePlane *plane1, MPTriangle t2)
+{
+    // t2 against the plane of t1
+    int dp2 = MPTrianglePlaneSide(plane1, t2.v1);
+    int dq2 = MPTrianglePlaneSide(plane1, t2.v2);
+    int dr2 = MPTrianglePlaneSide(plane1, t2.v3);
+
+    if (dp2 * dq2 > 0 && dp2 * dr2 > 0) return 0;
+
+    // t1 against the plane of t2
+    MPTrianglePlane plane2 = MPTrianglePlaneMake(t2);
+
+    MPVec3 p1 = plane1->triangle.v1, q1 = plane1->triangle.v2, r1 = plane1->triangle.v3;
+    MPVec3 p2 = t2.v1, q2 = t2.v2, r2 = t2.v3;
+
+    int dp1 = MPTrianglePlaneSide(&plane2, p1);
+    int dq1 = MPTrianglePlaneSide(&plane2, q1);
+    int dr1 = MPTrianglePlaneSide(&plane2, r1);
+
+    if (dp1 * dq1 > 0 && dp1 * dr1 > 0) return 0;
+
+    // rotate t1 so that p1 is alone on its side of the plane of t2, and swap q2 and r2
+    // so that p1 is above it
+    if (dp1 > 0)
+    {
+        if (dq1 > 0)      return _MPTrianglesIntersect3D(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+        else if (dr1 > 0) return _MPTrianglesIntersect3D(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+        else              return _MPTrianglesIntersect3D(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+    }
+    else if (dp1 < 0)
+    {
+        if (dq1 < 0)      return _MPTrianglesIntersect3D(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+        else if (dr1 < 0) return _MPTrianglesIntersect3D(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+        else              return _MPTrianglesIntersect3D(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+    }
+    else
+    {
+        if (dq1 < 0)
+        {
+            if (dr1 >= 0) return _MPTrianglesIntersect3D(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+            else          return _MPTrianglesIntersect3D(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+        }
+        else if (dq1 > 0)
+        {
+            if (dr1 > 0)  return _MPTrianglesIntersect3D(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+            else          return _MPTrianglesIntersect3D(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+        }
+        else
+        {
+            if (dr1 > 0)      return _MPTrianglesIntersect3D(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2, plane1, t2);
+            else if (dr1 < 0) return _MPTrianglesIntersect3D(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2, plane1, t2);
+            else              return _MPCoplanarTrianglesIntersect(plane1, t2);
+        }
+    }
+}
+
+#pragma mark - private functions
+
+// h = a - b, exactly. returns the number of nonzero terms.
+int _MPTwoDiff(double a, double b, double *h)
+{
+    double x = a - b;
+    double bvirt = a - x;
+    double avirt = x + bvirt;
+    double y = (a - avirt) + (bvirt - b);
+
+    int n = 0;
+    if (y != 0.0) h[n++] = y;
+    if (x != 0.0) h[n++] = x;
+
+    return n;
+}
+
+// e += b in place (e needs room for one more term). terms are kept in increasing magnitude.
+int _MPGrowExpansion(int elen, double *e, double b)
+{
+    double q = b;
+    int n = 0;
+
+    int i;
+    for (i = 0; i < elen; ++i)
+    {
+        double enow = e[i];
+        double sum = q + enow;
+        double bvirt = sum - q;
+        double avirt = sum - bvirt;
+        double h = (q - avirt) + (enow - bvirt);
+
+        q = sum;
+
+        if (h != 0.0) e[n++] = h;
+    }
+
+    if (q != 0.0 || n == 0) e[n++] = q;
+
+    return n;
+}
+
+// h = e * b, with at most 2 * elen terms
+int _MPScaleExpansion(int elen, const double *e, double b, double *h)
+{
+    int n = 0;
+
+    double q = 0.0;
+
+    int i;
+    for (i = 0; i < elen; ++i)
+    {
+        double product = e[i] * b;
+        double productTail = fma(e[i], b, -product);
+
+        // q + product + productTail, carrying the largest part on
+        double sum = q + productTail;
+        double bvirt = sum - q;
+        double avirt = sum - bvirt;
+        double h1 = (q - avirt) + (productTail - bvirt);
+
+        if (h1 != 0.0) h[n++] = h1;
+
+        double total = product + sum;
+        bvirt = total - product;
+        double h2 = sum - bvirt;
+
+        if (h2 != 0.0) h[n++] = h2;
+
+        q = total;
+    }
+
+    if (q != 0.0 || n == 0) h[n++] = q;
+
+    return n;
+}
+
+// e += f in place (e needs room for flen more terms)
+int _MPExpansionSum(int elen, double *e, int flen, const double *f)
+{
+    int i;
+    for (i = 0; i < flen; ++i)
+    {
+        elen = _MPGrowExpansion(elen, e, f[i]);
+    }
+
+    return elen;
+}
+
+// h = e * f, with at most 2 * elen * flen terms
+int _MPExpansionProduct(int elen, const double *e, int flen, const double *f, double *h)
+{
+    double scaled[MP_EXPANSION_MAX];
+
+    int n = 0;
+
+    int i;
+    for (i = 0; i < flen; ++i)
+    {
+        int slen = _MPScaleExpansion(elen, e, f[i], scaled);
+        n = _MPExpansionSum(n, h, slen, scaled);
+    }
+
+    return n;
+}
+
+int _MPExpansionSign(int elen, const double *e)
+{
+    // the largest term comes last and determines the sign
+    if (elen == 0) return 0;
+
+    return (e[elen - 1] > 0.0) - (e[elen - 1] < 0.0);
+}
+
+int _MPOrient3DExact(MPVec3 a, MPVec3 b, MPVec3 c, MPVec3 d)
+{
+    double u[3][2], v[3][2], w[3][2];
+    int ulen[3], vlen[3], wlen[3];
+
+    int k;
+    for (k = 0; k < 3; ++k)
+    {
+        ulen[k] = _MPTwoDiff(b.v[k], a.v[k], u[k]);
+        vlen[k] = _MPTwoDiff(c.v[k], a.v[k], v[k]);
+        wlen[k] = _MPTwoDiff(d.v[k], a.v[k], w[k]);
+    }
+
+    double det[MP_EXPANSION_MAX];
+    int detlen = 0;
+
+    // det = sum over k of w[k] * (u[i] v[j] - u[j] v[i])
+    for (k = 0; k < 3; ++k)
+    {
+        int i = (k + 1) % 3;
+        int j = (k + 2) % 3;
+
+        double left[8], right[8], minor[16], term[64];
+
+        int llen = _MPExpansionProduct(ulen[i], u[i], vlen[j], v[j], left);
+        int rlen = _MPExpansionProduct(ulen[j], u[j], vlen[i], v[i], right);
+
+        int r;
+        for (r = 0; r < rlen; ++r) right[r] = -right[r];
+
+        int mlen = 0;
+        mlen = _MPExpansionSum(mlen, minor, llen, left);
+        mlen = _MPExpansionSum(mlen, minor, rlen, right);
+
+        int tlen = _MPExpansionProduct(mlen, minor, wlen[k], w[k], term);
+
+        detlen = _MPExpansionSum(detlen, det, tlen, term);
+    }
+
+    return _MPExpansionSign(detlen, det);
+}
+
+int _MPOrient2DExact(MPVec3 a, MPVec3 b, MPVec3 c, int dropAxis)
+{
+    int i = (dropAxis + 1) % 3;
+    int j = (dropAxis + 2) % 3;
+
+    double acx[2], bcy[2], acy[2], bcx[2];
+
+    int acxlen = _MPTwoDiff(a.v[i], c.v[i], acx);
+    int bcylen = _MPTwoDiff(b.v[j], c.v[j], bcy);
+    int acylen = _MPTwoDiff(a.v[j], c.v[j], acy);
+    int bcxlen = _MPTwoDiff(b.v[i], c.v[i], bcx);
+
+    double left[8], right[8], det[16];
+
+    int llen = _MPExpansionProduct(acxlen, acx, bcylen, bcy, left);
+    int rlen = _MPExpansionProduct(acylen, acy, bcxlen, bcx, right);
+
+    int r;
+    for (r = 0; r < rlen; ++r) right[r] = -right[r];
+
+    int detlen = 0;
+    detlen = _MPExpansionSum(detlen, det, llen, left);
+    detlen = _MPExpansionSum(detlen, det, rlen, right);
+
+    return _MPExpansionSign(detlen, det);
+}
+
+// p1 is alone on the positive side of the plane of t2 (or on it, with q1 and r1 below)
+int _MPTrianglesIntersect3D(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int dp2, int dq2, int dr2, const MPTrianglePlane *plane1, MPTriangle t2)
+{
+    if (dp2 > 0)
+    {
+        if (dq2 > 0)      return _MPCheckMinMax(p1, r1, q1, r2, p2, q2);
+        else if (dr2 > 0) return _MPCheckMinMax(p1, r1, q1, q2, r2, p2);
+        else              return _MPCheckMinMax(p1, q1, r1, p2, q2, r2);
+    }
+    else if (dp2 < 0)
+    {
+        if (dq2 < 0)      return _MPCheckMinMax(p1, q1, r1, r2, p2, q2);
+        else if (dr2 < 0) return _MPCheckMinMax(p1, q1, r1, q2, r2, p2);
+        else              return _MPCheckMinMax(p1, r1, q1, p2, q2, r2);
+    }
+    else
+    {
+        if (dq2 < 0)
+        {
+            if (dr2 >= 0) return _MPCheckMinMax(p1, r1, q1, q2, r2, p2);
+            else          return _MPCheckMinMax(p1, q1, r1, p2, q2, r2);
+        }
+        else if (dq2 > 0)
+        {
+            if (dr2 > 0)  return _MPCheckMinMax(p1, r1, q1, p2, q2, r2);
+            else          return _MPCheckMinMax(p1, q1, r1, q2, r2, p2);
+        }
+        else
+        {
+            if (dr2 > 0)      return _MPCheckMinMax(p1, q1, r1, r2, p2, q2);
+            else if (dr2 < 0) return _MPCheckMinMax(p1, r1, q1, r2, p2, q2);
+            else              return _MPCoplanarTrianglesIntersect(plane1, t2);
+        }
+    }
+}
+
+// both triangles cross the line where their planes meet; they intersect if their intervals
+// on it overlap, which comes down to two orientation tests
+int _MPCheckMinMax(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2)
+{
+    if (MPOrient3D(q1, p2, p1, q2) > 0) return 0;
+    if (MPOrient3D(p1, p2, r1, r2) > 0) return 0;
+
+    return 1;
+}
+
+int _MPCoplanarTrianglesIntersect(const MPTrianglePlane *plane1, MPTriangle t2)
+{
+    // drop the axis the plane faces most, which keeps the projection from degenerating
+    double nx = fabs(plane1->normal[0]);
+    double ny = fabs(plane1->normal[1]);
+    double nz = fabs(plane1->normal[2]);
+
+    int axis = 2;
+
+    if (nx > nz && nx >= ny)      axis = 0;
+    else if (ny > nz && ny >= nx) axis = 1;
+
+    MPVec3 p1 = plane1->triangle.v1, q1 = plane1->triangle.v2, r1 = plane1->triangle.v3;
+    MPVec3 p2 = t2.v1, q2 = t2.v2, r2 = t2.v3;
+
+    // the 2D test needs both triangles counterclockwise
+    if (MPOrient2D(p1, q1, r1, axis) < 0)
+    {
+        MPVec3 swap = q1; q1 = r1; r1 = swap;
+    }
+
+    if (MPOrient2D(p2, q2, r2, axis) < 0)
+    {
+        MPVec3 swap = q2; q2 = r2; r2 = swap;
+    }
+
+    return _MPCCWTrianglesIntersect2D(p1, q1, r1, p2, q2, r2, axis);
+}
+
+// locates p1 among the regions cut out by the edge lines of t2
+int _MPCCWTrianglesIntersect2D(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int axis)
+{
+    if (MPOrient2D(p2, q2, p1, axis) >= 0)
+    {
+        if (MPOrient2D(q2, r2, p1, axis) >= 0)
+        {
+            if (MPOrient2D(r2, p2, p1, axis) >= 0) return 1;
+
+            return _MPIntersectionTestEdge(p1, q1, r1, p2, r2, axis);
+        }
+
+        if (MPOrient2D(r2, p2, p1, axis) >= 0) return _MPIntersectionTestEdge(p1, q1, r1, r2, q2, axis);
+
+        return _MPIntersectionTestVertex(p1, q1, r1, p2, q2, r2, axis);
+    }
+
+    if (MPOrient2D(q2, r2, p1, axis) >= 0)
+    {
+        if (MPOrient2D(r2, p2, p1, axis) >= 0) return _MPIntersectionTestEdge(p1, q1, r1, q2, p2, axis);
+
+        return _MPIntersectionTestVertex(p1, q1, r1, q2, r2, p2, axis);
+    }
+
+    return _MPIntersectionTestVertex(p1, q1, r1, r2, p2, q2, axis);
+}
+
+// p1 is in the region facing the vertex p2 of t2
+int _MPIntersectionTestVertex(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 q2, MPVec3 r2, int axis)
+{
+    if (MPOrient2D(r2, p2, q1, axis) >= 0)
+    {
+        if (MPOrient2D(r2, q2, q1, axis) <= 0)
+        {
+            if (MPOrient2D(p1, p2, q1, axis) > 0)
+            {
+                return MPOrient2D(p1, q2, q1, axis) <= 0;
+            }
+
+            return MPOrient2D(p1, p2, r1, axis) >= 0 && MPOrient2D(q1, r1, p2, axis) >= 0;
+        }
+
+        return MPOrient2D(p1, q2, q1, axis) <= 0 && MPOrient2D(r2, q2, r1, axis) <= 0 && MPOrient2D(q1, r1, q2, axis) >= 0;
+    }
+
+    if (MPOrient2D(r2, p2, r1, axis) >= 0)
+    {
+        if (MPOrient2D(q1, r1, r2, axis) >= 0)
+        {
+            return MPOrient2D(p1, p2, r1, axis) >= 0;
+        }
+
+        return MPOrient2D(q1, r1, q2, axis) >= 0 && MPOrient2D(r2, r1, q2, axis) >= 0;
+    }
+
+    return 0;
+}
+
+// p1 is in the region facing the edge of t2 that starts at p2. the edge's other end isn't
+// needed, only the remaining vertex r2.
+int _MPIntersectionTestEdge(MPVec3 p1, MPVec3 q1, MPVec3 r1, MPVec3 p2, MPVec3 r2, int axis)
+{
+    if (MPOrient2D(r2, p2, q1, axis) >= 0)
+    {
+        if (MPOrient2D(p1, p2, q1, axis) >= 0)
+        {
+            return MPOrient2D(p1, q1, r2, axis) >= 0;
+        }
+
+        return MPOrient2D(q1, r1, p2, axis) >= 0 && MPOrient2D(r1, p1, p2, axis) >= 0;
+    }
+
+    if (MPOrient2D(r2, p2, r1, axis) >= 0 && MPOrient2D(p1, p2, r1, axis) >= 0)
+    {
+        return MPOrient2D(p1, r1, r2, axis) >= 0 || MPOrient2D(q1, r1, r2, axis) >= 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+//
+//  MPPredicates.h
+//
+//  Robust orientation predicates and the triangle intersection test built on them. Each
+//  predicate is evaluated in double precision first, and only falls back to exact expansion
+//  arithmetic (Shewchuk, Adaptive Precision Floating-Point Arithmetic and Fast Robust
+//  Geometric Predicates) when the result is within the rounding error bound of zero.
+
+#ifndef _MPPredicates_h
+#define _MPPredicates_h
+
+#include "MPMath.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* the plane of a triangle, with what the filtered orientation test against it needs */
+typedef struct _MPTrianglePlane
+{
+    MPTriangle triangle;
+
+    double normal[3];   // (v2 - v1) x (v3 - v1)
+    double bound[3];    // absolute values of the terms of each normal component
+} MPTrianglePlane;
+
+/* returns 1 if d lies on the side of the plane through a, b, c that (b - a) x (c - a) points
+   to, -1 if on the other side and 0 if the four points are coplanar. the result is exact. */
+int MPOrient3D(MPVec3 a, MPVec3 b, MPVec3 c, MPVec3 d);
+
+/* returns 1 if a, b, c (given in the axis plane that excludes dropAxis) are counterclockwise,
+   -1 if they are clockwise and 0 if they are collinear. the result is exact. */
+int MPOrient2D(MPVec3 a, MPVec3 b, MPVec3 c, int dropAxis);
+
+MPTrianglePlane MPTrianglePlaneMake(MPTriangle t);
+
+/* same as MPOrient3D(t.v1, t.v2, t.v3, p) for the plane's triangle t */
+int MPTrianglePlaneSide(const MPTrianglePlane *plane, MPVec3 p);
+
+/* returns 1 if the triangles share at least one point, including when they only touch.
+   (Guigue and Devillers, Fast and Robust Triangle-Triangle Overlap Test Using Orientation
+   Predicates) */
+int MPTrianglesIntersect(MPTriangle t1, MPTriangle t2);
+
+/* same as MPTrianglesIntersect, with the plane of t1 already known */
+int MPTrianglesIntersectWithPlane(const MPTrianglePlane *plane1, MPTriangle t2);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
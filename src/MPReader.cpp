@@ -6,38 +6,48 @@
 //
 
 #include "MPReader.h"
+#include "MPMeshFile.h"
+#include "MPEnvironmentSnapshot.h"
+#include "MPMeshCache.h"
+#include "MPMeshImport.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <sstream>
+#include <thread>
 
 namespace MP
 {
     
-static const std::regex MeshValue("Vertex|Index|Texture");
-static const std::regex ModelValue("Mesh|Position|Rotation|Scale|Motion");
-static const std::regex MotionValue("Path|Repeat|Loop|Duration");
-static const std::regex EnvironmentValue("Dynamic|Step|RotationStep|Origin|Size|ActiveObject|Obstacles");
-    
-static const std::regex FloatLit("^\\-?[\\d]*\\.?[\\d]*$");
-static const std::regex IntLit("^\\-?[\\d]+");
-static const std::regex Identifier("^\\w+[\\w\\d]*$");
+static const char *const MeshValue[] = { "Vertex", "Index", "Texture", nullptr };
+static const char *const ModelValue[] = { "Mesh", "Position", "Rotation", "Scale", "Motion", nullptr };
+static const char *const MotionValue[] = { "Path", "Repeat", "Loop", "Duration", nullptr };
+static const char *const EnvironmentValue[] = { "Dynamic", "Step", "RotationStep", "Origin", "Size", "ActiveObject", "Obstacles", nullptr };
 
 #pragma mark - public methods
     
 Environment3D* Reader::generateEnvironment3D() const
 {
+    if (isEnvironmentSnapshot(this->file_))
+    {
+        // snapshots are mapped, and their meshes used in place
+        return openEnvironmentSnapshot(this->file_, *this->errors_);
+    }
+    
     Tokenizer tokens(this->file_);
     
-    std::string token;
+    Token token;
     std::map<std::string, MPMesh *> importedMeshes;
     
+    // import all referenced meshes
+    // NOTE: retains meshes
+    if (!this->importMeshes_(tokens, token, importedMeshes))
+    {
+        return nullptr;
+    }
+    
     try
     {
-        // import all referenced meshes
-        while ((token = tokens.getNext()) == "import")
-        {
-            // NOTE: retains meshes
-            this->importMeshes_(tokens, importedMeshes);
-        }
-        
         if (token != "new")
         {
             tokens.throw_token_error(token);
@@ -57,7 +67,7 @@ Environment3D* Reader::generateEnvironment3D() const
     }
     catch (std::runtime_error e)
     {
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -67,18 +77,18 @@ Model* Reader::generateModel() const
 {
     Tokenizer tokens(this->file_);
     
-    std::string token;
+    Token token;
     std::map<std::string, MPMesh *> importedMeshes;
     
+    // import all referenced meshes
+    // NOTE: retains meshes
+    if (!this->importMeshes_(tokens, token, importedMeshes))
+    {
+        return nullptr;
+    }
+    
     try
     {
-        // import all referenced meshes
-        while ((token = tokens.getNext()) == "import")
-        {
-            // NOTE: retains meshes
-            this->importMeshes_(tokens, importedMeshes);
-        }
-        
         if (token != "new")
         {
             tokens.throw_token_error(token);
@@ -98,7 +108,7 @@ Model* Reader::generateModel() const
     }
     catch (std::runtime_error e)
     {
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -106,6 +116,25 @@ Model* Reader::generateModel() const
 
 MPMesh* Reader::generateMesh() const
 {
+    if (MPMeshFileIsBinary(this->file_.c_str()))
+    {
+        // binary meshes are mapped and used in place
+        MPMesh *mesh = MPMeshOpenBinary(this->file_.c_str());
+        
+        if (mesh == nullptr)
+        {
+            *this->errors_ << "error: malformed binary mesh file " << this->file_ << std::endl;
+        }
+        
+        return mesh;
+    }
+    
+    if (isImportableMesh(this->file_))
+    {
+        // meshes exported by other tools are converted as they are loaded
+        return importMesh(this->file_, *this->errors_);
+    }
+    
     Tokenizer tokens(this->file_);
     
     try
@@ -117,7 +146,7 @@ MPMesh* Reader::generateMesh() const
     }
     catch (std::runtime_error e)
     {
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -128,7 +157,7 @@ MPMesh* Reader::generateMesh() const
 Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<std::string, MPMesh *> &meshes) const
 {
     Environment3D *environment = new Environment3D();
-    std::string token;
+    Token token;
     
     try
     {
@@ -143,7 +172,7 @@ Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<
             {
                 tokens.match("{");
                 
-                environment->setDynamic(atoi(tokens.match(IntLit).c_str()));
+                environment->setDynamic(tokens.match(IntLit).toInt());
                 
                 tokens.match("}");
             }
@@ -151,7 +180,7 @@ Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<
             {
                 tokens.match("{");
                 
-                environment->setStepSize(atof(tokens.match(FloatLit).c_str()));
+                environment->setStepSize(tokens.match(FloatLit).toDouble());
                 
                 tokens.match("}");
             }
@@ -159,7 +188,7 @@ Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<
             {
                 tokens.match("{");
                 
-                environment->setRotationStepSize(RADIANS(atof(tokens.match(FloatLit).c_str())));
+                environment->setRotationStepSize(RADIANS(tokens.match(FloatLit).toDouble()));
                 
                 tokens.match("}");
             }
@@ -204,7 +233,7 @@ Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<
     catch (std::runtime_error e)
     {
         delete environment;
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -214,7 +243,7 @@ Environment3D* Reader::generateEnvironment3D_(Tokenizer &tokens, const std::map<
     
 Model* Reader::generateModel_(Tokenizer &tokens, const std::map<std::string, MPMesh *> &meshes) const
 {
-    std::string token;
+    Token token;
     Model *model = new Model();
     
     try
@@ -272,7 +301,7 @@ Model* Reader::generateModel_(Tokenizer &tokens, const std::map<std::string, MPM
                 }
                 else
                 {
-                    std::map<std::string, MPMesh *>::const_iterator kv = meshes.find(token);
+                    std::map<std::string, MPMesh *>::const_iterator kv = meshes.find(token.str());
                     
                     if (kv != meshes.end())
                     {
@@ -295,7 +324,7 @@ Model* Reader::generateModel_(Tokenizer &tokens, const std::map<std::string, MPM
     catch (std::runtime_error e)
     {
         delete model;
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -305,7 +334,7 @@ Model* Reader::generateModel_(Tokenizer &tokens, const std::map<std::string, MPM
 
 MPMesh* Reader::generateMesh_(Tokenizer &tokens) const
 {
-    std::string token;
+    Token token;
     
     void *vertexData, *indexData;
     vertexData = indexData = nullptr;
@@ -328,9 +357,9 @@ MPMesh* Reader::generateMesh_(Tokenizer &tokens) const
                 tokens.match("=");
                 tokens.match("{");
                 
-                std::string name = tokens.getNext();
+                std::string name = tokens.getNext().str();
                 
-                texName = (char *)malloc(name.size());
+                texName = (char *)malloc(name.size() + 1);
                 strcpy(texName, name.c_str());
                 
                 tokens.match("}");
@@ -355,7 +384,7 @@ MPMesh* Reader::generateMesh_(Tokenizer &tokens) const
         free(vertexData);
         free(indexData);
         
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -363,6 +392,9 @@ MPMesh* Reader::generateMesh_(Tokenizer &tokens) const
     MPMesh *mesh = MPMeshCreate((const MPVec3 *)vertexData, stride, numVertices, (const void *)indexData, indexSize, numIndices);
     mesh->texName = texName;
     
+    // the mesh owns the data that was loaded for it
+    MPMeshSetDataDeallocator(mesh, MPMeshFreeData, NULL);
+    
     return mesh;
 }
     
@@ -370,7 +402,7 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
 {
     Motion *motion = new Motion();
     
-    std::string token;
+    Token token;
     
     try
     {
@@ -385,7 +417,7 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
                 tokens.match("=");
                 tokens.match("{");
                 
-                motion->setRepeats(atoi(tokens.match(IntLit).c_str()));
+                motion->setRepeats(tokens.match(IntLit).toInt());
                 
                 tokens.match("}");
             }
@@ -394,7 +426,7 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
                 tokens.match("=");
                 tokens.match("{");
                 
-                motion->setLoops(atoi(tokens.match(IntLit).c_str()));
+                motion->setLoops(tokens.match(IntLit).toInt());
                 
                 tokens.match("}");
             }
@@ -403,7 +435,7 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
                 tokens.match("=");
                 tokens.match("{");
                 
-                motion->setDuration(atoi(tokens.match(FloatLit).c_str()));
+                motion->setDuration(tokens.match(FloatLit).toInt());
                 
                 tokens.match("}");
             }
@@ -422,7 +454,7 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
     {
         delete motion;
         
-        std::cout << e.what() << std::endl;
+        *this->errors_ << e.what() << std::endl;
         
         return nullptr;
     }
@@ -430,30 +462,144 @@ Motion* Reader::generateMotion_(Tokenizer &tokens) const
     return motion;
 }
     
-void Reader::importMeshes_(Tokenizer &tokens, std::map<std::string, MPMesh *> &meshes) const
+bool Reader::importMeshes_(Tokenizer &tokens, Token &token, std::map<std::string, MPMesh *> &meshes) const
 {
-    std::string importFile = tokens.getNext();
-    tokens.match("as");
-    std::string alias = tokens.match(Identifier);
+    std::vector<std::pair<std::string, std::string> > imports;
     
-    if (importFile[0] != '/')
+    try
     {
-        // import should be a relative path
-        size_t slash = this->file_.find_last_of("/\\");
-        importFile = this->file_.substr(0, slash) + "/" + importFile;
+        // find every import before loading any of them, so they can be loaded together
+        while ((token = tokens.getNext()) == "import")
+        {
+            std::string importFile = tokens.getNext().str();
+            tokens.match("as");
+            std::string alias = tokens.match(Identifier).str();
+            
+            if (importFile[0] != '/')
+            {
+                // import should be a relative path
+                size_t slash = this->file_.find_last_of("/\\");
+                importFile = this->file_.substr(0, slash) + "/" + importFile;
+            }
+            
+            imports.push_back(std::make_pair(importFile, alias));
+        }
+    }
+    catch (std::runtime_error e)
+    {
+        // the imports before the malformed statement are still loaded, so that their errors are
+        // reported ahead of its own, just as if each import had been loaded as soon as it was read
+        this->loadImports_(imports, meshes);
+        
+        for (std::map<std::string, MPMesh *>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+        {
+            MPMeshRelease(it->second);
+        }
+        
+        meshes.clear();
+        
+        *this->errors_ << e.what() << std::endl;
+        
+        return false;
+    }
+    
+    return this->loadImports_(imports, meshes);
+}
+    
+bool Reader::loadImports_(const std::vector<std::pair<std::string, std::string> > &imports, std::map<std::string, MPMesh *> &meshes) const
+{
+    // each distinct file is only loaded once
+    std::vector<std::string> files;
+    std::vector<size_t> fileIndices;
+    
+    for (size_t i = 0; i < imports.size(); ++i)
+    {
+        size_t n = std::find(files.begin(), files.end(), imports[i].first) - files.begin();
+        
+        if (n == files.size())
+        {
+            files.push_back(imports[i].first);
+        }
+        
+        fileIndices.push_back(n);
+    }
+    
+    std::vector<MPMesh *> loaded(files.size(), nullptr);
+    std::vector<std::ostringstream> errors(files.size());
+    
+    std::atomic<size_t> next(0);
+    
+    // files differ widely in size, so workers take the next file as they finish one
+    auto load = [&]()
+    {
+        for (size_t n = next++; n < files.size(); n = next++)
+        {
+            // imported meshes are shared with every other reader that imports the same file
+            loaded[n] = MeshCache::shared().acquire(files[n], errors[n]);
+        }
+    };
+    
+    int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    numThreads = (int)std::min<size_t>(numThreads, files.size());
+    
+    std::vector<std::thread> workers;
+    
+    for (int t = 1; t < numThreads; ++t)
+    {
+        workers.push_back(std::thread(load));
+    }
+    
+    load();
+    
+    for (auto &worker : workers)
+    {
+        worker.join();
     }
     
-    Reader meshReader(importFile);
+    // report errors and add meshes in import order, so the results don't depend on which file loaded first
+    std::vector<bool> added(files.size(), false);
+    bool succeeded = true;
     
-    MPMesh *mesh = meshReader.generateMesh();
-    MPMeshRetain(mesh);
+    for (size_t i = 0; i < imports.size(); ++i)
+    {
+        size_t n = fileIndices[i];
+        
+        *this->errors_ << errors[n].str();
+        
+        if (loaded[n] == nullptr)
+        {
+            *this->errors_ << "error: could not import " << files[n] << std::endl;
+            succeeded = false;
+        }
+        
+        if (added[n])
+        {
+            // a later import of the same file, which would have found the mesh in the cache
+            MPMeshRetain(loaded[n]);
+        }
+        
+        added[n] = true;
+        
+        meshes.insert(std::make_pair(imports[i].second, loaded[n]));
+    }
+    
+    if (!succeeded)
+    {
+        // nothing can be built without every mesh, so the ones that did load are released
+        for (std::map<std::string, MPMesh *>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+        {
+            MPMeshRelease(it->second);
+        }
+        
+        meshes.clear();
+    }
     
-    meshes.insert(std::make_pair(alias, mesh));
+    return succeeded;
 }
     
 MPVec3 Reader::loadVector3_(Tokenizer &tokens) const
 {
-    std::string token;
+    Token token;
     
     tokens.match("{");
 
@@ -463,12 +609,12 @@ MPVec3 Reader::loadVector3_(Tokenizer &tokens) const
     
     for (int i = 0; (token = tokens.getNext()) != "}" && i < 3; ++i)
     {
-        if (!std::regex_match(token.begin(), token.end(), FloatLit))
+        if (!token.is(FloatLit))
         {
             tokens.throw_token_error(token);
         }
         
-        vec.v[i] = atof(token.c_str());
+        vec.v[i] = token.toDouble();
     }
     
     tokens.setTokenDelimiter(' ');
@@ -478,10 +624,10 @@ MPVec3 Reader::loadVector3_(Tokenizer &tokens) const
     
 void Reader::loadVertices(Tokenizer &tokens, void **vertexData, size_t &stride, size_t &count) const
 {
-    std::string token;
+    Token token;
     
-    count = atol(tokens.match(IntLit).c_str());
-    size_t elementsPerVertex = atol(tokens.match(IntLit).c_str());
+    count = tokens.match(IntLit).toLong();
+    size_t elementsPerVertex = tokens.match(IntLit).toLong();
     
     // currently enforcing that vertex elements be float types
     stride = elementsPerVertex * sizeof(float);
@@ -497,12 +643,12 @@ void Reader::loadVertices(Tokenizer &tokens, void **vertexData, size_t &stride,
     
     for (int i = 0; (token = tokens.getNext()) != "}" && i < count * elementsPerVertex; ++i)
     {
-        if (!std::regex_match(token.begin(), token.end(), FloatLit))
+        if (!token.is(FloatLit))
         {
             tokens.throw_token_error(token);
         }
         
-        values[i] = atof(token.c_str());
+        values[i] = token.toDouble();
     }
     
     // set delimiter back to default
@@ -511,9 +657,9 @@ void Reader::loadVertices(Tokenizer &tokens, void **vertexData, size_t &stride,
 
 void Reader::loadIndices(Tokenizer &tokens, void **indexData, size_t &size, size_t &count) const
 {
-    std::string token;
+    Token token;
     
-    count = atol(tokens.match(IntLit).c_str());
+    count = tokens.match(IntLit).toLong();
     
     // currently enforcing that indices be unsigned ints
     size = sizeof(unsigned int);
@@ -529,12 +675,12 @@ void Reader::loadIndices(Tokenizer &tokens, void **indexData, size_t &size, size
     
     for (int i = 0; (token = tokens.getNext()) != "}" && i < count; ++i)
     {
-        if (!std::regex_match(token.begin(), token.end(), IntLit))
+        if (!token.is(IntLit))
         {
             tokens.throw_token_error(token);
         }
         
-        values[i] = (unsigned int)atoi(token.c_str());
+        values[i] = (unsigned int)token.toInt();
     }
     
     // set delimiter back to default
@@ -543,7 +689,7 @@ void Reader::loadIndices(Tokenizer &tokens, void **indexData, size_t &size, size
     
 void Reader::loadPath(Tokenizer &tokens, std::vector<MPVec3> &path) const
 {
-    std::string token;
+    Token token;
     
     tokens.match("=");
     tokens.match("{");
@@ -553,19 +699,18 @@ void Reader::loadPath(Tokenizer &tokens, std::vector<MPVec3> &path) const
     
     for (int i = 0; (token = tokens.getNext()) != "}"; ++i)
     {
-        if (!std::regex_match(token.begin(), token.end(), FloatLit))
+        if (!token.is(FloatLit))
         {
             tokens.throw_token_error(token);
         }
         
         MPVec3 vec;
-        vec.v[0] = atof(token.c_str());
+        vec.v[0] = token.toDouble();
         
         // load yz coordinates
         for (int j = 0; j < 2; ++j)
         {
-            token = tokens.match(FloatLit);
-            vec.v[j+1] = atof(token.c_str());
+            vec.v[j+1] = tokens.match(FloatLit).toDouble();
         }
         
         path.push_back(vec);
@@ -11,6 +11,7 @@
 
 #include "MPEnvironment3D.h"
 #include "MPTokenizer.h"
+#include <iostream>
 #include <map>
 #include <vector>
 
@@ -20,7 +21,8 @@ namespace MP
 class Reader
 {
 public:
-    Reader(std::string filePath) : file_(filePath) {}
+    /* errors found while reading the file, or any file it imports, are written to errors */
+    Reader(std::string filePath, std::ostream &errors = std::cout) : file_(filePath), errors_(&errors) {}
     
     Environment3D* generateEnvironment3D() const;
     Model* generateModel() const;
@@ -28,13 +30,21 @@ public:
 
 private:
     std::string file_;
+    std::ostream *errors_;
     
     Environment3D* generateEnvironment3D_(Tokenizer &tokens, const std::map<std::string, MPMesh *> &meshes) const;
     Model* generateModel_(Tokenizer &tokens, const std::map<std::string, MPMesh *> &meshes) const;
     MPMesh* generateMesh_(Tokenizer &tokens) const;
     Motion* generateMotion_(Tokenizer &tokens) const;
     
-    void importMeshes_(Tokenizer &tokens, std::map<std::string, MPMesh *> &meshes) const;
+    /* reads every import statement at the start of the file, leaving token at the one after
+     * them, then loads the imported meshes concurrently and adds them to meshes (retained).
+     * returns false if a statement is malformed, in which case nothing is added. */
+    bool importMeshes_(Tokenizer &tokens, Token &token, std::map<std::string, MPMesh *> &meshes) const;
+    
+    /* loads each (file, alias) import, reporting errors and adding meshes in the order of the imports.
+     * returns false, with nothing added, if any of them couldn't be loaded. */
+    bool loadImports_(const std::vector<std::pair<std::string, std::string> > &imports, std::map<std::string, MPMesh *> &meshes) const;
     
     MPVec3 loadVector3_(Tokenizer &tokens) const;
     
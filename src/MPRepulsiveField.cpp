@@ -0,0 +1,136 @@
+//
+//  MPRepulsiveField.cpp
+//
+
+#include "MPRepulsiveField.h"
+#include <algorithm>
+#include <cmath>
+
+namespace MP
+{
+
+RepulsiveField::RepulsiveField()
+: bounds_(MPAABoxMake(MPVec3Zero, MPVec3Zero)), resolution_(0.0f), radius_(0.0f), cutoff_(0.0f)
+{
+    dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+void RepulsiveField::build(const std::vector<MPVec3> &points, float radius, float cutoff, float resolution)
+{
+    clear();
+    
+    radius_ = radius;
+    cutoff_ = cutoff;
+    
+    if(resolution <= 0.0f || points.empty()) return;
+    
+    // beyond this distance from every point the gradient is zero
+    float reach = radius + cutoff;
+    
+    MPVec3 min = MPVec3Make(Inf, Inf, Inf);
+    MPVec3 max = MPVec3Make(-Inf, -Inf, -Inf);
+    
+    for(const MPVec3 &p : points)
+    {
+        for(int a = 0; a < 3; ++a)
+        {
+            min.v[a] = fminf(min.v[a], p.v[a] - reach);
+            max.v[a] = fmaxf(max.v[a], p.v[a] + reach);
+        }
+    }
+    
+    bounds_ = MPAABoxMake(min, max);
+    resolution_ = resolution;
+    
+    for(int a = 0; a < 3; ++a)
+    {
+        dims_[a] = std::max(2, (int)std::ceil((max.v[a] - min.v[a]) / resolution) + 1);
+        bounds_.max.v[a] = min.v[a] + (dims_[a] - 1) * resolution;
+    }
+    
+    samples_.assign((size_t)dims_[0] * dims_[1] * dims_[2], MPVec3Zero);
+    
+    // splat each point onto the samples within its reach, rather than summing every point at every sample
+    int span = (int)std::ceil(reach / resolution);
+    
+    float minDistance = 0.5f * std::min(resolution, cutoff);
+    
+    for(const MPVec3 &p : points)
+    {
+        int c[3];
+        for(int a = 0; a < 3; ++a)
+        {
+            c[a] = (int)std::floor((p.v[a] - bounds_.min.v[a]) / resolution);
+        }
+        
+        for(int i = std::max(0, c[0] - span); i <= std::min(dims_[0] - 1, c[0] + span + 1); ++i)
+        {
+            for(int j = std::max(0, c[1] - span); j <= std::min(dims_[1] - 1, c[1] + span + 1); ++j)
+            {
+                for(int k = std::max(0, c[2] - span); k <= std::min(dims_[2] - 1, c[2] + span + 1); ++k)
+                {
+                    MPVec3 q = MPVec3Make(bounds_.min.x + i * resolution,
+                                          bounds_.min.y + j * resolution,
+                                          bounds_.min.z + k * resolution);
+                    
+                    float distance = MPVec3EuclideanDistance(p, q) - radius;
+                    
+                    if(distance > cutoff) continue;
+                    
+                    // the potential blows up at the repelled object's radius, which would swamp the
+                    // interpolation across whole cells, so distances are clamped to half a sample
+                    distance = fmaxf(distance, minDistance);
+                    
+                    MPVec3 g = MPVec3MultiplyScalar(MPVec3Subtract(q, p), (1.0f / cutoff - 1.0f / distance) / distance);
+                    
+                    MPVec3 &s = samples_[(i * dims_[1] + j) * dims_[2] + k];
+                    s = MPVec3Add(s, g);
+                }
+            }
+        }
+    }
+}
+
+void RepulsiveField::clear()
+{
+    samples_.clear();
+    dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+MPVec3 RepulsiveField::gradient(const MPVec3 &p) const
+{
+    if(samples_.empty() || !MPAABoxContainsPoint(bounds_, p)) return MPVec3Zero;
+    
+    int c[3];
+    float t[3];
+    
+    for(int a = 0; a < 3; ++a)
+    {
+        float x = (p.v[a] - bounds_.min.v[a]) / resolution_;
+        c[a] = std::min(dims_[a] - 2, std::max(0, (int)x));
+        t[a] = std::min(1.0f, std::max(0.0f, x - c[a]));
+    }
+    
+    MPVec3 g = MPVec3Zero;
+    
+    for(int a = 0; a < 2; ++a)
+    {
+        float wa = a ? t[0] : 1.0f - t[0];
+        
+        for(int b = 0; b < 2; ++b)
+        {
+            float wb = wa * (b ? t[1] : 1.0f - t[1]);
+            
+            for(int d = 0; d < 2; ++d)
+            {
+                float w = wb * (d ? t[2] : 1.0f - t[2]);
+                
+                g = MPVec3Add(g, MPVec3MultiplyScalar(sample(c[0] + a, c[1] + b, c[2] + d), w));
+            }
+        }
+    }
+    
+    return g;
+}
+
+}
@@ -0,0 +1,56 @@
+//
+//  MPRepulsiveField.h
+//
+//  The gradient of the repulsive potential of a set of point particles (e.g. the voxels of an
+//  obstacle), summed and sampled on a regular grid in the particles' own frame. Since the
+//  potential only depends on distances, the field stays valid as the particles move rigidly.
+
+#ifndef __MPRepulsiveField__
+#define __MPRepulsiveField__
+
+#include <vector>
+#include "MPMath.h"
+
+// samples of a field per obstacle voxel along each axis
+#define MP_REPULSIVE_FIELD_SUBDIVISIONS 2
+
+namespace MP
+{
+
+class RepulsiveField
+{
+public:
+    RepulsiveField();
+    
+    /* samples the summed gradient of the points' potentials with the given spacing. each point
+     * repels an object of the given radius once it comes within cutoff of the point.
+     * (potential inspired by http://www.cs.cmu.edu/~motionplanning/lecture/Chap4-Potential-Field_howie.pdf) */
+    void build(const std::vector<MPVec3> &points, float radius, float cutoff, float resolution);
+    
+    void clear();
+    
+    bool isBuilt() const { return !samples_.empty(); }
+    
+    float getRadius() const { return radius_; }
+    
+    float getCutoff() const { return cutoff_; }
+    
+    /* trilinearly interpolated gradient at p (in the points' frame), zero outside the field */
+    MPVec3 gradient(const MPVec3 &p) const;
+    
+private:
+    const MPVec3& sample(int i, int j, int k) const { return samples_[(i * dims_[1] + j) * dims_[2] + k]; }
+    
+    MPAABox bounds_;
+    float resolution_;
+    
+    float radius_;
+    float cutoff_;
+    
+    int dims_[3];
+    std::vector<MPVec3> samples_;
+};
+
+}
+
+#endif
@@ -6,73 +6,247 @@
 //
 
 #include "MPTokenizer.h"
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// longer numbers are copied to the heap to be terminated
+#define MP_MAX_NUMBER_LENGTH 64
 
 namespace MP
 {
 
+namespace
+{
+    bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    bool isWordCharacter(char c)
+    {
+        return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    // tokens aren't terminated in the file, so numbers are parsed from a terminated copy
+    template <typename T>
+    T parseNumber(const Token &token, T (*parse)(const char *))
+    {
+        if (token.length() >= MP_MAX_NUMBER_LENGTH)
+        {
+            return parse(token.str().c_str());
+        }
+
+        char buffer[MP_MAX_NUMBER_LENGTH];
+        memcpy(buffer, token.data(), token.length());
+        buffer[token.length()] = '\0';
+
+        return parse(buffer);
+    }
+}
+
+#pragma mark - token
+
+bool Token::is(TokenClass lexicalClass) const
+{
+    const char *c = begin_, *end = begin_ + length_;
+
+    switch (lexicalClass)
+    {
+        case FloatLit:
+            if (c < end && *c == '-') ++c;
+            while (c < end && isDigit(*c)) ++c;
+            if (c < end && *c == '.') ++c;
+            while (c < end && isDigit(*c)) ++c;
+
+            return c == end;
+
+        case IntLit:
+            if (c < end && *c == '-') ++c;
+            if (c == end) return false;
+            while (c < end && isDigit(*c)) ++c;
+
+            return c == end;
+
+        case Identifier:
+            if (c == end) return false;
+            while (c < end && isWordCharacter(*c)) ++c;
+
+            return c == end;
+    }
+
+    return false;
+}
+
+double Token::toDouble() const
+{
+    return parseNumber(*this, atof);
+}
+
+int Token::toInt() const
+{
+    return parseNumber(*this, atoi);
+}
+
+long Token::toLong() const
+{
+    return parseNumber(*this, atol);
+}
+
 #pragma mark - public methods
-    
-void Tokenizer::setTokenDelimiter(const char delimiter)
+
+Tokenizer::Tokenizer(std::string file)
+: base_(nullptr), size_(0), tokenDelimiter_(' '), lineNum_(0)
 {
-    this->tokenDelimiter_ = delimiter;
+    int fd = open(file.c_str(), O_RDONLY);
+
+    if (fd >= 0)
+    {
+        struct stat info;
+
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (base != MAP_FAILED)
+            {
+                base_ = (const char *)base;
+                size_ = (size_t)info.st_size;
+            }
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    position_ = lineEnd_ = nextLine_ = base_;
 }
-    
-std::string Tokenizer::getNext()
+
+Tokenizer::~Tokenizer()
 {
-    std::string token = EmptyToken;
-    
-    while (std::getline(this->lineStream_, token, this->tokenDelimiter_))
+    if (base_)
     {
-        if (token.length() == 0) continue; // ignore white space
-        if (std::regex_match(token.begin(), token.end(), Comment)) break; // skip comments
-        
-        token = std::regex_replace(token, Whitespace, "");
-        
-        return token;
+        munmap((void *)base_, size_);
     }
-    
-    std::string line;
-    if (std::getline(this->fileStream_, line))
+}
+
+void Tokenizer::setTokenDelimiter(const char delimiter)
+{
+    this->tokenDelimiter_ = delimiter;
+}
+
+Token Tokenizer::getNext()
+{
+    while (true)
     {
-        line = std::regex_replace(line, Whitespace, " ");
-        
-        this->lineStream_.str(line);
-        this->lineStream_.clear();
-        this->lineNum_++;
-        
-        token = this->getNext();
+        while (this->position_ < this->lineEnd_ && isWhitespace(*this->position_)) ++this->position_;
+
+        if (this->position_ == this->lineEnd_)
+        {
+            if (!this->nextLine()) return Token();
+
+            continue;
+        }
+
+        const char *begin = this->position_, *end;
+
+        if (isWhitespace(this->tokenDelimiter_))
+        {
+            end = begin;
+            while (end < this->lineEnd_ && !isWhitespace(*end)) ++end;
+
+            this->position_ = end;
+        }
+        else
+        {
+            end = (const char *)memchr(begin, this->tokenDelimiter_, this->lineEnd_ - begin);
+            if (!end) end = this->lineEnd_;
+
+            this->position_ = (end == this->lineEnd_) ? end : end + 1;
+
+            while (end > begin && isWhitespace(end[-1])) --end;
+        }
+
+        if (end == begin) continue; // ignore empty tokens
+
+        if (end - begin >= 2 && begin[0] == '/' && begin[1] == '/')
+        {
+            // skip comments
+            this->position_ = this->lineEnd_;
+            continue;
+        }
+
+        return Token(begin, end - begin);
     }
-    
-    return token;
 }
 
-std::string Tokenizer::match(const std::string &expected)
+Token Tokenizer::match(const char *expected)
 {
-    std::string next = this->getNext();
-    
+    Token next = this->getNext();
+
     if (next != expected)
     {
         this->throw_token_error(next);
     }
-    
+
+    return next;
+}
+
+Token Tokenizer::match(const char *const *expected)
+{
+    Token next = this->getNext();
+
+    for (; *expected; ++expected)
+    {
+        if (next == *expected) return next;
+    }
+
+    this->throw_token_error(next);
+
     return next;
 }
 
-std::string Tokenizer::match(const std::regex &expected)
+Token Tokenizer::match(TokenClass expected)
 {
-    std::string next = this->getNext();
-    
-    if (!std::regex_match(next.begin(), next.end(), expected))
+    Token next = this->getNext();
+
+    if (!next.is(expected))
     {
         this->throw_token_error(next);
     }
-    
+
     return next;
 }
-    
-void Tokenizer::throw_token_error(const std::string &token)
+
+void Tokenizer::throw_token_error(const Token &token)
 {
-    throw std::runtime_error("unexpected token '" + token + "' in line " + std::to_string(this->lineNum_) + ".");
+    throw std::runtime_error("unexpected token '" + token.str() + "' in line " + std::to_string(this->lineNum_) + ".");
 }
 
-}
\ No newline at end of file
+#pragma mark - private methods
+
+bool Tokenizer::nextLine()
+{
+    const char *end = this->base_ + this->size_;
+
+    if (this->nextLine_ == end) return false;
+
+    this->position_ = this->nextLine_;
+
+    const char *lineBreak = (const char *)memchr(this->position_, '\n', end - this->position_);
+
+    this->lineEnd_ = lineBreak ? lineBreak : end;
+    this->nextLine_ = lineBreak ? lineBreak + 1 : end;
+    this->lineNum_++;
+
+    return true;
+}
+
+}
@@ -9,44 +9,103 @@
 #ifndef __MPTokenizer__
 #define __MPTokenizer__
 
-#include <fstream>
-#include <sstream>
-#include <regex>
+#include <cstring>
+#include <string>
 #include <stdexcept>
 
 namespace MP
 {
 
-/* token constants */
-static const std::string EmptyToken = "";
-static const std::regex Whitespace("[ \t\n]+");
-static const std::regex Comment("^//");
+/* lexical classes a token can be matched against */
+enum TokenClass
+{
+    FloatLit,       // -?[0-9]*.?[0-9]* (which includes the empty token)
+    IntLit,         // -?[0-9]+
+    Identifier      // [A-Za-z0-9_]+
+};
+
+/* a run of characters in the tokenizer's file. tokens point into the file's mapping, so they
+ * are only valid as long as the tokenizer that returned them. */
+class Token
+{
+public:
+    Token() : begin_(nullptr), length_(0) {}
+    Token(const char *begin, size_t length) : begin_(begin), length_(length) {}
+
+    const char* data() const { return begin_; }
+    size_t length() const { return length_; }
+    bool empty() const { return length_ == 0; }
+
+    std::string str() const { return std::string(begin_, length_); }
 
-// helper class for reading tokens from a file one by one
+    bool operator==(const char *s) const { return strlen(s) == length_ && (length_ == 0 || memcmp(begin_, s, length_) == 0); }
+    bool operator!=(const char *s) const { return !(*this == s); }
+
+    bool is(TokenClass lexicalClass) const;
+
+    /* the value of a numeric token, as atof/atoi/atol would give it */
+    double toDouble() const;
+    int toInt() const;
+    long toLong() const;
+
+private:
+    const char *begin_;
+    size_t length_;
+};
+
+// helper class for reading tokens from a file one by one.
+//
+// the grammar differs from the regex tokenizer this replaced in three ways:
+//  - any token starting with "//" begins a comment. before, only a bare "//" did, and "//text"
+//    was returned as a token.
+//  - carriage returns are whitespace, so files with CRLF line breaks read the same. before,
+//    only spaces, tabs and line breaks were.
+//  - only the whitespace around a delimited token is trimmed, so "1 2" between commas is one
+//    token "1 2" (which isn't a number). before, whitespace inside it was removed too, giving "12".
 class Tokenizer
 {
 public:
-    Tokenizer(std::string file) : fileStream_(file), tokenDelimiter_(' ') {}
-    ~Tokenizer() {}
-    
+    /* the file is mapped into memory, and tokens are read from it in place. a file that can't be
+     * read has no tokens. */
+    Tokenizer(std::string file);
+    ~Tokenizer();
+
     void setTokenDelimiter(const char delimiter);
-    
-    std::string getNext();
-    
-    std::string match(const std::string &expected);
-    std::string match(const std::regex &expected);
-    
-    void throw_token_error(const std::string &token);
-    
+
+    /* returns the next token, or an empty token at the end of the file. tokens are separated by
+     * the delimiter (and, with any delimiter, by line breaks), and have surrounding whitespace
+     * trimmed. an empty token is skipped, as is the rest of a line after a token starting with "//". */
+    Token getNext();
+
+    Token match(const char *expected);
+
+    /* matches any one of a nullptr-terminated list of tokens */
+    Token match(const char *const *expected);
+
+    Token match(TokenClass expected);
+
+    void throw_token_error(const Token &token);
+
 private:
-    std::ifstream fileStream_;
-    std::istringstream lineStream_;
-    
+    /* moves on to the next line of the file, returning false if there isn't one */
+    bool nextLine();
+
+    const char *base_;
+    size_t size_;
+
+    /* the unread part of the current line, and the start of the next one */
+    const char *position_;
+    const char *lineEnd_;
+    const char *nextLine_;
+
     char tokenDelimiter_;
-    
+
     int lineNum_;
+
+    Tokenizer(const Tokenizer &) = delete;
+    Tokenizer& operator=(const Tokenizer &) = delete;
 };
-    
+
 }
 
 #endif
@@ -6,9 +6,13 @@
 //
 
 #include "MPTransform3D.h"
+#include <type_traits>
 
 namespace MP
 {
+
+static_assert(std::is_trivially_copyable<Transform3D>::value, "transforms are copied as plain data");
+
 #pragma mark - public methods
     
 Transform3D::Transform3D()
@@ -21,24 +25,10 @@ Transform3D::Transform3D(const MPVec3 &pos, const MPVec3 &scale, const MPQuatern
     this->init(pos, scale, rotation);
 }
 
-Transform3D::Transform3D(const Transform3D &other)
-{
-    this->position = other.getPosition();
-    this->rotation = other.getRotation();
-    this->scale = other.getScale();
-    
-    this->matrixCache = nullptr;
-}
-
-Transform3D::~Transform3D()
-{
-    this->invalidateMatrixCache();
-}
-
 void Transform3D::setPosition(const MPVec3 &position)
 {
     this->position = position;
-    this->invalidateMatrixCache();
+    this->updateMatrix();
 }
 
 MPVec3 Transform3D::getPosition() const
@@ -49,7 +39,7 @@ MPVec3 Transform3D::getPosition() const
 void Transform3D::setScale(const MPVec3 &scale)
 {
     this->scale = scale;
-    this->invalidateMatrixCache();
+    this->updateMatrix();
 }
 
 MPVec3 Transform3D::getScale() const
@@ -60,7 +50,7 @@ MPVec3 Transform3D::getScale() const
 void Transform3D::setRotation(const MPQuaternion &rotation)
 {
     this->rotation = rotation;
-    this->invalidateMatrixCache();
+    this->updateMatrix();
 }
 
 MPQuaternion Transform3D::getRotation() const
@@ -68,33 +58,17 @@ MPQuaternion Transform3D::getRotation() const
     return this->rotation;
 }
 
-MPMat4 Transform3D::getMatrix()
+MPMat4 Transform3D::getMatrix() const
 {
-    if (this->matrixCache == nullptr)
-    {
-        MPMat4 s = MPMat4MakeScale(MPVec3Make(this->scale.x, this->scale.y, this->scale.z));
-        MPMat4 r = MPMat4MakeRotation(this->rotation);
-        
-        MPMat4 mat = MPMat4Multiply(r, s);
-        
-        // shortcut to apply a translation transformation
-        mat.m[12] += this->position.x;
-        mat.m[13] += this->position.y;
-        mat.m[14] += this->position.z;
-        
-        this->matrixCache = new MPMat4;
-        *(this->matrixCache) = mat;
-    }
-    
-    return *(this->matrixCache);
+    return this->matrix;
 }
     
-void Transform3D::transformVec3(MPVec3 &vec)
+void Transform3D::transformVec3(MPVec3 &vec) const
 {
     vec = MPMat4TransformVec3(this->getMatrix(), vec);
 }
 
-MPVec3 Transform3D::transformVec3(const MPVec3 &vec)
+MPVec3 Transform3D::transformVec3(const MPVec3 &vec) const
 {
     MPVec3 tVec = vec;
     
@@ -107,19 +81,25 @@ MPVec3 Transform3D::transformVec3(const MPVec3 &vec)
 
 void Transform3D::init(const MPVec3 &pos, const MPVec3 &scale, const MPQuaternion &rotation)
 {
-    this->matrixCache = nullptr;
-    
     this->position = pos;
     this->scale = scale;
     this->rotation = rotation;
+    
+    this->updateMatrix();
 }
 
-void Transform3D::invalidateMatrixCache()
+void Transform3D::updateMatrix()
 {
-    if (this->matrixCache != nullptr)
-    {
-        delete this->matrixCache;
-        this->matrixCache = nullptr;
-    }
+    MPMat4 s = MPMat4MakeScale(MPVec3Make(this->scale.x, this->scale.y, this->scale.z));
+    MPMat4 r = MPMat4MakeRotation(this->rotation);
+    
+    MPMat4 mat = MPMat4Multiply(r, s);
+    
+    // shortcut to apply a translation transformation
+    mat.m[12] += this->position.x;
+    mat.m[13] += this->position.y;
+    mat.m[14] += this->position.z;
+    
+    this->matrix = mat;
 }
 }
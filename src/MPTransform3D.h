@@ -4,7 +4,9 @@
 //  Created by John Visentin on 4/3/14.
 //  Copyright (c) 2014 John Visentin. All rights reserved.
 //
-//  Defines a TRS transform of an object in 3D space
+//  Defines a TRS transform of an object in 3D space. The matrix is stored inline and updated by
+//  the setters, so transforms are trivially copyable, and const methods only read, which makes
+//  it safe to share a transform between threads while no one changes it.
 
 #ifndef __MPTransform3D__
 #define __MPTransform3D__
@@ -18,8 +20,6 @@ class Transform3D
 public:
     Transform3D();
     Transform3D(const MPVec3 &pos, const MPVec3 &scale, const MPQuaternion &rotation);
-    Transform3D(const Transform3D &other);
-    ~Transform3D();
     
     void setPosition(const MPVec3 &position);
     MPVec3 getPosition() const;
@@ -31,20 +31,21 @@ public:
     MPQuaternion getRotation() const;
     
     /* returns the TRS matrix using the position, rotation, and scale properties */
-    MPMat4 getMatrix();
+    MPMat4 getMatrix() const;
     
-    void transformVec3(MPVec3 &vec);
-    MPVec3 transformVec3(const MPVec3 &vec);
+    void transformVec3(MPVec3 &vec) const;
+    MPVec3 transformVec3(const MPVec3 &vec) const;
     
 protected:
-    MPMat4 *matrixCache;
-    
     MPVec3 position;
     MPVec3 scale;
     MPQuaternion rotation;
     
+    // derived from the properties above whenever one of them is set
+    MPMat4 matrix;
+    
     void init(const MPVec3 &pos, const MPVec3 &scale, const MPQuaternion &rotation);
-    void invalidateMatrixCache();
+    void updateMatrix();
 };
 }
 
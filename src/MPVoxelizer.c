@@ -0,0 +1,239 @@
+//
+//  MPVoxelizer.c
+//
+
+#include <pthread.h>
+#include <unistd.h>
+#include "MPVoxelizer.h"
+
+#pragma mark - private definitions
+
+// voxels are grown by this fraction of their size, so that surfaces lying exactly on a voxel
+// boundary mark the voxels on both sides regardless of rounding
+#define MP_VOXEL_TOLERANCE 1e-4f
+
+typedef struct _MPVoxelizerSlab
+{
+    const MPTriangle *triangles;
+    size_t numTriangles;
+
+    MPVec3 origin;
+    float voxelSize;
+
+    MPBitGrid *grid;
+
+    // range of i owned by this slab
+    int first, last;
+} MPVoxelizerSlab;
+
+void* _MPVoxelizeSlab(void *arg);
+
+void _MPVoxelizerFillSolid(MPBitGrid *grid);
+
+#pragma mark - public functions
+
+void MPVoxelGridDimensions(MPAABox bounds, float voxelSize, int dims[3])
+{
+    int a;
+    for (a = 0; a < 3; ++a)
+    {
+        int n = (int)ceilf((bounds.max.v[a] - bounds.min.v[a]) / voxelSize);
+        dims[a] = n > 0 ? n : 1;
+    }
+}
+
+MPBitGrid MPVoxelizeMesh(const MPMesh *mesh, MPMat4 transform, MPAABox bounds, float voxelSize, int solid)
+{
+    int dims[3];
+    MPVoxelGridDimensions(bounds, voxelSize, dims);
+
+    MPBitGrid grid = MPBitGridMake(dims[0], dims[1], dims[2]);
+
+    size_t numTriangles = MPMeshGetTriangleCount(mesh);
+    MPTriangle *triangles = malloc((numTriangles > 0 ? numTriangles : 1) * sizeof(MPTriangle));
+
+    MPMeshGetTransformedTriangles(mesh, transform, triangles);
+
+    long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    int numThreads = (int)(numCPUs > 0 ? numCPUs : 1);
+
+    if (numThreads > dims[0]) numThreads = dims[0];
+
+    MPVoxelizerSlab slabs[numThreads];
+    pthread_t threads[numThreads];
+    int started[numThreads];
+
+    int slabSize = (dims[0] + numThreads - 1) / numThreads;
+
+    int i;
+    for (i = 0; i < numThreads; ++i)
+    {
+        slabs[i].triangles = triangles;
+        slabs[i].numTriangles = numTriangles;
+        slabs[i].origin = bounds.min;
+        slabs[i].voxelSize = voxelSize;
+        slabs[i].grid = &grid;
+        slabs[i].first = i * slabSize;
+        slabs[i].last = (i + 1) * slabSize < dims[0] ? (i + 1) * slabSize : dims[0];
+
+        // the calling thread takes the first slab
+        started[i] = (i > 0 && pthread_create(&threads[i], NULL, _MPVoxelizeSlab, &slabs[i]) == 0);
+
+        if (i > 0 && !started[i])
+        {
+            // fall back to doing the work here
+            _MPVoxelizeSlab(&slabs[i]);
+        }
+    }
+
+    _MPVoxelizeSlab(&slabs[0]);
+
+    for (i = 1; i < numThreads; ++i)
+    {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    free(triangles);
+
+    if (solid)
+    {
+        _MPVoxelizerFillSolid(&grid);
+    }
+
+    return grid;
+}
+
+#pragma mark - private functions
+
+void* _MPVoxelizeSlab(void *arg)
+{
+    MPVoxelizerSlab *slab = (MPVoxelizerSlab *)arg;
+    MPBitGrid *grid = slab->grid;
+
+    float h = slab->voxelSize;
+    float tolerance = MP_VOXEL_TOLERANCE * h;
+    
+    MPVec3 halfSize = MPVec3Make(0.5f * h + tolerance, 0.5f * h + tolerance, 0.5f * h + tolerance);
+
+    size_t t;
+    for (t = 0; t < slab->numTriangles; ++t)
+    {
+        MPTriangle tri = slab->triangles[t];
+
+        // range of voxels overlapping the triangle's bounding box, clipped to the slab
+        int lo[3], hi[3];
+
+        int a;
+        for (a = 0; a < 3; ++a)
+        {
+            float min = fminf(fminf(tri.v1.v[a], tri.v2.v[a]), tri.v3.v[a]);
+            float max = fmaxf(fmaxf(tri.v1.v[a], tri.v2.v[a]), tri.v3.v[a]);
+
+            lo[a] = (int)floorf((min - tolerance - slab->origin.v[a]) / h);
+            hi[a] = (int)floorf((max + tolerance - slab->origin.v[a]) / h);
+
+            if (lo[a] < 0) lo[a] = 0;
+            if (hi[a] > grid->dims[a] - 1) hi[a] = grid->dims[a] - 1;
+        }
+
+        if (lo[0] < slab->first) lo[0] = slab->first;
+        if (hi[0] > slab->last - 1) hi[0] = slab->last - 1;
+
+        int i, j, k;
+        for (i = lo[0]; i <= hi[0]; ++i)
+        {
+            for (j = lo[1]; j <= hi[1]; ++j)
+            {
+                for (k = lo[2]; k <= hi[2]; ++k)
+                {
+                    size_t index = MPBitGridIndex(grid, i, j, k);
+
+                    // another triangle already marked it
+                    if ((__atomic_load_n(&grid->words[index >> 6], __ATOMIC_RELAXED) >> (index & 63)) & 1) continue;
+
+                    if (MPTriangleIntersectsAABox(tri, MPVoxelCenter(slab->origin, h, i, j, k), halfSize))
+                    {
+                        // neighbouring slabs can share a word at their boundary
+                        MPBitGridSetIndexAtomic(grid, index);
+                    }
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// voxels that can't be reached from the boundary of the grid without crossing the surface are inside
+void _MPVoxelizerFillSolid(MPBitGrid *grid)
+{
+    MPBitGrid outside = MPBitGridMake(grid->dims[0], grid->dims[1], grid->dims[2]);
+
+    size_t stackSize = 1024;
+    size_t top = 0;
+    size_t *stack = malloc(stackSize * sizeof(size_t));
+
+    const int offsets[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+    size_t numCells = MPBitGridNumCells(grid);
+    size_t n;
+
+    for (n = 0; n < numCells; ++n)
+    {
+        int i, j, k;
+        MPBitGridCell(grid, n, &i, &j, &k);
+
+        int onBoundary = (i == 0 || j == 0 || k == 0 || i == grid->dims[0] - 1 || j == grid->dims[1] - 1 || k == grid->dims[2] - 1);
+
+        if (!onBoundary || MPBitGridGetIndex(grid, n) || MPBitGridGetIndex(&outside, n)) continue;
+
+        MPBitGridSetIndex(&outside, n);
+        stack[top++] = n;
+
+        while (top > 0)
+        {
+            size_t current = stack[--top];
+            MPBitGridCell(grid, current, &i, &j, &k);
+
+            int d;
+            for (d = 0; d < 6; ++d)
+            {
+                int ni = i + offsets[d][0], nj = j + offsets[d][1], nk = k + offsets[d][2];
+
+                if (!MPBitGridContains(grid, ni, nj, nk)) continue;
+
+                size_t next = MPBitGridIndex(grid, ni, nj, nk);
+
+                if (MPBitGridGetIndex(grid, next) || MPBitGridGetIndex(&outside, next)) continue;
+
+                MPBitGridSetIndex(&outside, next);
+
+                if (top >= stackSize)
+                {
+                    // double stack if necessary
+                    stack = realloc(stack, 2 * stackSize * sizeof(size_t));
+                    stackSize *= 2;
+                }
+
+                stack[top++] = next;
+            }
+        }
+    }
+
+    free(stack);
+
+    // everything not outside is either on or inside the surface
+    size_t w;
+    for (w = 0; w < grid->numWords; ++w)
+    {
+        grid->words[w] = ~outside.words[w];
+    }
+
+    // clear the padding bits past the last cell
+    if (numCells % 64)
+    {
+        grid->words[grid->numWords - 1] &= ((uint64_t)1 << (numCells % 64)) - 1;
+    }
+
+    MPBitGridFree(&outside);
+}
@@ -0,0 +1,37 @@
+//
+//  MPVoxelizer.h
+//
+//  Converts a mesh into a bit-packed grid of voxels. Each triangle is only tested against the
+//  voxels in its bounding box, with an exact triangle/box overlap test, so the surface voxels are
+//  exactly those touched by the mesh. Slabs of the grid are voxelized in parallel.
+
+#ifndef _MPVoxelizer_h
+#define _MPVoxelizer_h
+
+#include "MPMesh.h"
+#include "MPBitGrid.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* returns the number of voxels of the given size along each axis needed to cover bounds. */
+void MPVoxelGridDimensions(MPAABox bounds, float voxelSize, int dims[3]);
+
+/* returns the center of voxel (i, j, k) of a grid whose minimum corner is at origin. */
+static inline MPVec3 MPVoxelCenter(MPVec3 origin, float voxelSize, int i, int j, int k)
+{
+    return MPVec3Make(origin.x + (i + 0.5f) * voxelSize, origin.y + (j + 0.5f) * voxelSize, origin.z + (k + 0.5f) * voxelSize);
+}
+
+/* voxelizes the mesh, moved by transform, into a grid of cubes of the given size covering bounds
+   (the grid's minimum corner is bounds.min). a bit is set for every voxel the surface touches.
+   if solid is nonzero, voxels enclosed by the surface are set as well.
+    @note the grid must be freed with MPBitGridFree. */
+MPBitGrid MPVoxelizeMesh(const MPMesh *mesh, MPMat4 transform, MPAABox bounds, float voxelSize, int solid);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -11,11 +11,18 @@ using namespace MP;
 
 int main(int argc, char** argv)
 {
+    // the directory holding the meshes and environments, src/geometry when run from the repository
+    std::string geometry = (argc > 1 ? argv[1] : "src/geometry");
+    if(geometry.back() != '/') geometry += '/';
+    
     Benchmarker benchmarker;
     
-    benchmarker.loadEnvironment("/Users/eratner/Documents/Bowdoin/Spring 2014/Computational Geometry/compgeo/src/geometry/simple.env");
+    benchmarker.loadEnvironment(geometry + "simple.env");
+    
+    benchmarker.benchmark(20, Action6D::generate3DActions(benchmarker.getEnvStepSize()));
     
-    benchmarker.benchmark3D(20);
+    benchmarker.benchmarkLoading(20, {geometry + "cube.mesh", geometry + "pyramid.mesh", geometry + "falcon.mesh",
+                                      geometry + "simple.env", geometry + "maze.env", geometry + "podracer.env"});
     
 //    MPAABox boundingBox = MPAABoxMake(MPVec3Make(1.0f, 1.0f, 1.0f),
 //                                      MPVec3Make(2.0f, 2.0f, 2.0f));
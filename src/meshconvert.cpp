@@ -0,0 +1,86 @@
+//
+//  meshconvert.cpp
+//
+//  Converts a text mesh into the binary format, or a text environment into a snapshot, so that
+//  it can be memory-mapped on load. A distance field resolution given for an environment enables
+//  its distance field, which is then built and saved in the snapshot.
+//  Usage: MeshConvert input.mesh output.mpmesh (or an .obj, .stl or .ply mesh as input)
+//         MeshConvert input.env output.mpenv [distance field resolution]
+//
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include "MPReader.h"
+#include "MPMeshFile.h"
+#include "MPEnvironmentSnapshot.h"
+using namespace MP;
+
+int convertEnvironment(const char *input, const char *output, double distanceFieldResolution)
+{
+    Reader reader(input);
+    Environment3D *environment = reader.generateEnvironment3D();
+
+    if (environment == nullptr)
+    {
+        std::cout << "error: could not read environment " << input << std::endl;
+
+        return 1;
+    }
+
+    if (distanceFieldResolution > 0.0)
+    {
+        environment->setDistanceFieldResolution(distanceFieldResolution);
+    }
+
+    bool ok = writeEnvironmentSnapshot(*environment, output);
+
+    if (!ok)
+    {
+        std::cout << "error: could not write environment snapshot " << output << std::endl;
+    }
+
+    delete environment;
+
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    std::string input = argc > 1 ? argv[1] : "";
+    bool isEnvironment = input.size() > 4 && input.compare(input.size() - 4, 4, ".env") == 0;
+
+    if (argc != 3 && !(isEnvironment && argc == 4))
+    {
+        std::cout << "usage: " << argv[0] << " input.mesh output.mpmesh" << std::endl;
+        std::cout << "       " << argv[0] << " input.env output.mpenv [distance field resolution]" << std::endl;
+
+        return 1;
+    }
+
+    if (isEnvironment)
+    {
+        return convertEnvironment(argv[1], argv[2], argc == 4 ? atof(argv[3]) : 0.0);
+    }
+
+    Reader reader(argv[1]);
+    MPMesh *mesh = reader.generateMesh();
+
+    if (mesh == nullptr)
+    {
+        std::cout << "error: could not read mesh " << argv[1] << std::endl;
+
+        return 1;
+    }
+
+    int status = MPMeshWriteBinary(mesh, argv[2]);
+
+    if (status != 0)
+    {
+        std::cout << "error: could not write mesh " << argv[2] << std::endl;
+    }
+
+    MPMeshFree(mesh);
+
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+//
+//  MPMeshCacheTests.cpp
+//
+//  Checks that the mesh cache reports files it can't open or parse, and shares meshes loaded
+//  from files with the same contents.
+
+#include "MPTest.h"
+#include "MPMeshCache.h"
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+using namespace MP;
+
+MP_TEST(meshCacheMissingFileIsReported)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::string path = dir + "/missing.mesh";
+    std::ostringstream errors;
+    
+    MeshCache cache;
+    MP_CHECK(cache.acquire(path, errors) == nullptr);
+    MP_CHECK(errors.str().find("error: cannot open " + path) != std::string::npos);
+    MP_CHECK(cache.size() == 0);
+    
+    rmdir(dir.c_str());
+}
+
+MP_TEST(meshCacheMalformedFileIsReported)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::string path = dir + "/malformed.mesh";
+    const char text[] = "new Mesh\n{\n\tset Vertex 24 8 =\n\t{\n\t\t1 2\n";
+    MP_CHECK(testWriteFile(path, text, sizeof(text) - 1));
+    std::ostringstream errors;
+    
+    MeshCache cache;
+    MP_CHECK(cache.acquire(path, errors) == nullptr);
+    MP_CHECK(!errors.str().empty());
+    MP_CHECK(cache.size() == 0);
+    
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
+
+MP_TEST(meshCacheSharesIdenticalFiles)
+{
+    std::ifstream source("src/geometry/block.mesh", std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    MP_CHECK(!text.empty());
+    
+    std::string dir = testCreateTemporaryDirectory();
+    std::string first = dir + "/first.mesh", second = dir + "/second.mesh";
+    MP_CHECK(testWriteFile(first, text.data(), text.size()));
+    MP_CHECK(testWriteFile(second, text.data(), text.size()));
+    std::ostringstream errors;
+    
+    MeshCache cache;
+    MPMesh *mesh1 = cache.acquire(first, errors);
+    MPMesh *mesh2 = cache.acquire(second, errors);
+    MP_CHECK(mesh1 != nullptr);
+    MP_CHECK(mesh1 == mesh2);
+    MP_CHECK(cache.size() == 1);
+    MP_CHECK(errors.str().empty());
+    
+    MPMeshRelease(mesh1);
+    MPMeshRelease(mesh2);
+    unlink(first.c_str());
+    unlink(second.c_str());
+    rmdir(dir.c_str());
+}
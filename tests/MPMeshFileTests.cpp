@@ -0,0 +1,149 @@
+//
+//  MPMeshFileTests.cpp
+//
+//  Checks that binary mesh files round trip, and that missing, truncated and corrupted files
+//  are rejected rather than used.
+
+#include "MPTest.h"
+#include "MPMeshFile.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+/* writes a cube in the binary format to path, returning the file's contents */
+static std::vector<char> writeCube(const std::string &path)
+{
+    MPMesh *cube = MPMeshCreateCube();
+    int error = MPMeshWriteBinary(cube, path.c_str());
+    MPMeshFree(cube);
+    
+    if (error)
+        return std::vector<char>();
+    
+    std::ifstream file(path.c_str(), std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/* creates a mesh from a 16 byte aligned copy of the first size bytes of an image */
+static MPMesh* createWithCopy(const std::vector<char> &image, size_t size)
+{
+    void *data = NULL;
+    if (posix_memalign(&data, 16, size ? size : 16))
+        return NULL;
+    
+    memcpy(data, image.data(), size);
+    MPMesh *mesh = MPMeshCreateWithBinaryData(data, size);
+    
+    // the mesh uses the data in place, so it can only be released by the caller when it was rejected
+    if (!mesh)
+        free(data);
+    else
+        MPMeshSetDataDeallocator(mesh, [](MPMesh *, void *context) { free(context); }, data);
+    
+    return mesh;
+}
+
+MP_TEST(meshFileRoundTrips)
+{
+    std::string dir = MP::testCreateTemporaryDirectory();
+    std::string path = dir + "/cube.bmesh";
+    std::vector<char> image = writeCube(path);
+    MP_CHECK(!image.empty());
+    MP_CHECK(MPMeshFileIsBinary(path.c_str()));
+    
+    MPMesh *mesh = MPMeshOpenBinary(path.c_str());
+    MPMesh *cube = MPMeshCreateCube();
+    MP_CHECK(mesh != NULL);
+    
+    if (mesh)
+    {
+        MP_CHECK(MPMeshGetTriangleCount(mesh) == MPMeshGetTriangleCount(cube));
+        MP_CHECK(MPMeshesIntersect(mesh, MPMat4Identity, cube, MPMat4MakeTranslation(MPVec3Make(0.9f, 0.0f, 0.0f))));
+        MP_CHECK(!MPMeshesIntersect(mesh, MPMat4Identity, cube, MPMat4MakeTranslation(MPVec3Make(1.1f, 0.0f, 0.0f))));
+    }
+    
+    MPMeshFree(mesh);
+    MPMeshFree(cube);
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
+
+MP_TEST(meshFileMissingIsRejected)
+{
+    std::string dir = MP::testCreateTemporaryDirectory();
+    std::string path = dir + "/missing.bmesh";
+    
+    MP_CHECK(!MPMeshFileIsBinary(path.c_str()));
+    MP_CHECK(MPMeshOpenBinary(path.c_str()) == NULL);
+    MP_CHECK(MPMeshOpenBinary(dir.c_str()) == NULL);
+    
+    rmdir(dir.c_str());
+}
+
+MP_TEST(meshFileTruncatedIsRejected)
+{
+    std::string dir = MP::testCreateTemporaryDirectory();
+    std::string path = dir + "/cube.bmesh";
+    std::vector<char> image = writeCube(path);
+    MP_CHECK(!image.empty());
+    
+    for (size_t size = 0; size < image.size(); size++)
+    {
+        MPMesh *mesh = createWithCopy(image, size);
+        MP_CHECK(mesh == NULL);
+        MPMeshFree(mesh);
+    }
+    
+    // and likewise when the truncated image is mapped from a file
+    size_t sizes[] = {0, sizeof(MPMeshFileHeader) - 1, sizeof(MPMeshFileHeader), image.size()/2, image.size() - 1};
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    {
+        MP_CHECK(MP::testWriteFile(path, image.data(), sizes[i]));
+        MPMesh *mesh = MPMeshOpenBinary(path.c_str());
+        MP_CHECK(mesh == NULL);
+        MPMeshFree(mesh);
+    }
+    
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
+
+MP_TEST(meshFileCorruptedIsRejected)
+{
+    std::string dir = MP::testCreateTemporaryDirectory();
+    std::string path = dir + "/cube.bmesh";
+    std::vector<char> image = writeCube(path);
+    MP_CHECK(image.size() >= sizeof(MPMeshFileHeader));
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+    
+    if (image.size() < sizeof(MPMeshFileHeader))
+        return;
+    
+    MPMeshFileHeader header;
+    memcpy(&header, image.data(), sizeof(header));
+    
+    MPMeshFileHeader corrupted[8];
+    for (int i = 0; i < 8; i++)
+        corrupted[i] = header;
+    
+    corrupted[0].magic = ~header.magic;
+    corrupted[1].version = header.version + 1;
+    corrupted[2].vertexStride = 1;
+    corrupted[3].numVertices = UINT64_MAX/2;
+    corrupted[4].numIndices = header.numIndices + 1;
+    corrupted[5].indexOffset = image.size();
+    corrupted[6].vertexOffset = header.vertexOffset + 1;
+    corrupted[7].precomputedOffset = image.size() - 8;
+    
+    for (int i = 0; i < 8; i++)
+    {
+        std::vector<char> copy = image;
+        memcpy(copy.data(), &corrupted[i], sizeof(corrupted[i]));
+        MPMesh *mesh = createWithCopy(copy, copy.size());
+        MP_CHECK(mesh == NULL);
+        MPMeshFree(mesh);
+    }
+}
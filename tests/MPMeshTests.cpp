@@ -0,0 +1,62 @@
+//
+//  MPMeshTests.cpp
+//
+//  Checks MPMeshesIntersect on unit cubes placed inside, across and outside one another.
+
+#include "MPTest.h"
+#include "MPMesh.h"
+
+static MPMat4 placement(float x, float y, float z, float scale)
+{
+    return MPMat4Multiply(MPMat4MakeTranslation(MPVec3Make(x, y, z)), MPMat4MakeScale(MPVec3Make(scale, scale, scale)));
+}
+
+MP_TEST(meshInsideMeshIntersects)
+{
+    MPMesh *cube = MPMeshCreateCube();
+    MPMat4 outer = placement(0.0f, 0.0f, 0.0f, 3.0f);
+    
+    // the outer cube spans [-1.5, 1.5], so every small cube here lies strictly inside it
+    for (int i = 0; i <= 14; i++)
+    {
+        float offset = 0.1f*i;
+        MPMat4 inner = placement(offset, 0.3f*offset, -0.2f*offset, 0.1f);
+        
+        MP_CHECK(MPMeshesIntersect(cube, outer, cube, inner));
+        MP_CHECK(MPMeshesIntersect(cube, inner, cube, outer));
+    }
+    
+    MPMeshFree(cube);
+}
+
+MP_TEST(meshAcrossSurfaceIntersects)
+{
+    MPMesh *cube = MPMeshCreateCube();
+    MPMat4 outer = placement(0.0f, 0.0f, 0.0f, 3.0f);
+    MPMat4 crossing = placement(1.5f, 0.0f, 0.0f, 0.1f);
+    
+    MP_CHECK(MPMeshesIntersect(cube, outer, cube, crossing));
+    MP_CHECK(MPMeshesIntersect(cube, crossing, cube, outer));
+    
+    MPMeshFree(cube);
+}
+
+MP_TEST(meshOutsideMeshDoesNotIntersect)
+{
+    MPMesh *cube = MPMeshCreateCube();
+    MPMat4 outer = placement(0.0f, 0.0f, 0.0f, 3.0f);
+    MPMat4 outside[] = {
+        placement(1.7f, 0.0f, 0.0f, 0.1f),
+        placement(0.0f, -1.7f, 0.0f, 0.1f),
+        placement(1.6f, 1.6f, 1.6f, 0.1f),
+        placement(5.0f, 5.0f, 5.0f, 3.0f)
+    };
+    
+    for (size_t i = 0; i < sizeof(outside)/sizeof(outside[0]); i++)
+    {
+        MP_CHECK(!MPMeshesIntersect(cube, outer, cube, outside[i]));
+        MP_CHECK(!MPMeshesIntersect(cube, outside[i], cube, outer));
+    }
+    
+    MPMeshFree(cube);
+}
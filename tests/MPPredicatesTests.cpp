@@ -0,0 +1,252 @@
+//
+//  MPPredicatesTests.cpp
+//
+//  Checks the robust predicates against brute-force references computed in exact integer
+//  arithmetic. Points have integer coordinates small enough to be exact floats, and many of
+//  the cases are chosen to be coplanar, collinear or touching, where rounding would matter.
+
+#include "MPTest.h"
+#include "MPPredicates.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+
+typedef __int128 Exact;
+
+struct Point
+{
+    int64_t v[3];
+};
+
+static int sign(Exact x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static MPVec3 toVec3(const Point &p)
+{
+    return MPVec3Make((float)p.v[0], (float)p.v[1], (float)p.v[2]);
+}
+
+static MPTriangle toTriangle(const Point *t)
+{
+    MPTriangle triangle;
+    triangle.v1 = toVec3(t[0]);
+    triangle.v2 = toVec3(t[1]);
+    triangle.v3 = toVec3(t[2]);
+    return triangle;
+}
+
+static void normal(const Point &a, const Point &b, const Point &c, Exact n[3])
+{
+    Exact u[3], v[3];
+    for (int k = 0; k < 3; k++)
+    {
+        u[k] = b.v[k] - a.v[k];
+        v[k] = c.v[k] - a.v[k];
+    }
+    
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+static int orient3D(const Point &a, const Point &b, const Point &c, const Point &d)
+{
+    Exact n[3];
+    normal(a, b, c, n);
+    return sign(n[0]*(d.v[0] - a.v[0]) + n[1]*(d.v[1] - a.v[1]) + n[2]*(d.v[2] - a.v[2]));
+}
+
+static int orient2D(const Point &a, const Point &b, const Point &c, int dropAxis)
+{
+    int i = (dropAxis + 1) % 3, j = (dropAxis + 2) % 3;
+    return sign((Exact)(b.v[i] - a.v[i])*(c.v[j] - a.v[j]) - (Exact)(b.v[j] - a.v[j])*(c.v[i] - a.v[i]));
+}
+
+/* whether p, known to be on the line through a and b, lies between them */
+static bool onSegment(const Point &a, const Point &b, const Point &p)
+{
+    for (int k = 0; k < 3; k++)
+        if (p.v[k] < std::min(a.v[k], b.v[k]) || p.v[k] > std::max(a.v[k], b.v[k]))
+            return false;
+    return true;
+}
+
+/* whether the closed segments ab and cd, in a plane projected along dropAxis, share a point */
+static bool segmentsIntersect2D(const Point &a, const Point &b, const Point &c, const Point &d, int dropAxis)
+{
+    int d1 = orient2D(a, b, c, dropAxis), d2 = orient2D(a, b, d, dropAxis);
+    int d3 = orient2D(c, d, a, dropAxis), d4 = orient2D(c, d, b, dropAxis);
+    
+    if (d1*d2 < 0 && d3*d4 < 0)
+        return true;
+    
+    return (d1 == 0 && onSegment(a, b, c)) || (d2 == 0 && onSegment(a, b, d)) ||
+           (d3 == 0 && onSegment(c, d, a)) || (d4 == 0 && onSegment(c, d, b));
+}
+
+/* whether p lies in the closed triangle t, in a plane projected along dropAxis */
+static bool pointInTriangle2D(const Point &p, const Point *t, int dropAxis)
+{
+    int s1 = orient2D(t[0], t[1], p, dropAxis);
+    int s2 = orient2D(t[1], t[2], p, dropAxis);
+    int s3 = orient2D(t[2], t[0], p, dropAxis);
+    
+    return !((s1 > 0 || s2 > 0 || s3 > 0) && (s1 < 0 || s2 < 0 || s3 < 0));
+}
+
+/* whether the closed segment ab shares a point with the closed, non-degenerate triangle t */
+static bool segmentIntersectsTriangle(const Point &a, const Point &b, const Point *t)
+{
+    int sa = orient3D(t[0], t[1], t[2], a), sb = orient3D(t[0], t[1], t[2], b);
+    
+    if (sa*sb > 0)
+        return false;
+    
+    if (sa == 0 && sb == 0)
+    {
+        // coplanar, so test in the axis plane the triangle is largest in
+        Exact n[3];
+        normal(t[0], t[1], t[2], n);
+        for (int k = 0; k < 3; k++)
+            n[k] = n[k] < 0 ? -n[k] : n[k];
+        int dropAxis = n[0] >= n[1] && n[0] >= n[2] ? 0 : (n[1] >= n[2] ? 1 : 2);
+        
+        return pointInTriangle2D(a, t, dropAxis) || pointInTriangle2D(b, t, dropAxis) ||
+               segmentsIntersect2D(a, b, t[0], t[1], dropAxis) ||
+               segmentsIntersect2D(a, b, t[1], t[2], dropAxis) ||
+               segmentsIntersect2D(a, b, t[2], t[0], dropAxis);
+    }
+    
+    // the segment crosses the plane, so it meets the triangle if the line through it does
+    int s1 = orient3D(a, b, t[0], t[1]);
+    int s2 = orient3D(a, b, t[1], t[2]);
+    int s3 = orient3D(a, b, t[2], t[0]);
+    
+    return !((s1 > 0 || s2 > 0 || s3 > 0) && (s1 < 0 || s2 < 0 || s3 < 0));
+}
+
+/* two triangles share a point exactly when an edge of one of them meets the other */
+static bool trianglesIntersect(const Point *t1, const Point *t2)
+{
+    for (int e = 0; e < 3; e++)
+    {
+        if (segmentIntersectsTriangle(t1[e], t1[(e + 1) % 3], t2) ||
+            segmentIntersectsTriangle(t2[e], t2[(e + 1) % 3], t1))
+            return true;
+    }
+    
+    return false;
+}
+
+static bool degenerate(const Point *t)
+{
+    Exact n[3];
+    normal(t[0], t[1], t[2], n);
+    return n[0] == 0 && n[1] == 0 && n[2] == 0;
+}
+
+MP_TEST(orient3DMatchesExactReference)
+{
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int64_t> coordinate(-(1 << 20), 1 << 20);
+    std::uniform_int_distribution<int64_t> step(-2, 2), nudge(-1, 1);
+    int mismatches = 0;
+    
+    for (int i = 0; i < 200000; i++)
+    {
+        Point a, b, c, d;
+        for (int k = 0; k < 3; k++)
+        {
+            a.v[k] = coordinate(random);
+            b.v[k] = coordinate(random);
+            c.v[k] = coordinate(random);
+        }
+        
+        // d is on or within a unit step of the plane, where the double precision filter fails
+        int64_t u = step(random), v = step(random);
+        for (int k = 0; k < 3; k++)
+            d.v[k] = a.v[k] + u*(b.v[k] - a.v[k]) + v*(c.v[k] - a.v[k]) + (i % 2 ? nudge(random) : 0);
+        
+        int expected = orient3D(a, b, c, d);
+        Point t[3] = {a, b, c};
+        MPTrianglePlane plane = MPTrianglePlaneMake(toTriangle(t));
+        
+        mismatches += MPOrient3D(toVec3(a), toVec3(b), toVec3(c), toVec3(d)) != expected;
+        mismatches += MPTrianglePlaneSide(&plane, toVec3(d)) != expected;
+    }
+    
+    MP_CHECK(mismatches == 0);
+}
+
+MP_TEST(orient2DMatchesExactReference)
+{
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int64_t> coordinate(-(1 << 22), 1 << 22);
+    std::uniform_int_distribution<int64_t> step(-3, 3);
+    int mismatches = 0;
+    
+    for (int i = 0; i < 200000; i++)
+    {
+        Point a, b, c;
+        int64_t u = step(random);
+        for (int k = 0; k < 3; k++)
+        {
+            a.v[k] = coordinate(random);
+            b.v[k] = a.v[k] + coordinate(random)/8;
+            c.v[k] = i % 2 ? a.v[k] + u*(b.v[k] - a.v[k]) : coordinate(random);
+        }
+        
+        for (int dropAxis = 0; dropAxis < 3; dropAxis++)
+            mismatches += MPOrient2D(toVec3(a), toVec3(b), toVec3(c), dropAxis) != orient2D(a, b, c, dropAxis);
+    }
+    
+    MP_CHECK(mismatches == 0);
+}
+
+MP_TEST(trianglesIntersectMatchesBruteForce)
+{
+    std::mt19937 random(3);
+    int mismatches = 0, tested = 0, intersecting = 0;
+    
+    // small grids make shared vertices, touching edges and coplanar overlaps common. the last
+    // two modes put both triangles in the same axis plane.
+    for (int mode = 0; mode < 4; mode++)
+    {
+        int range = mode == 0 ? 4 : 8;
+        
+        for (int i = 0; i < 50000; i++)
+        {
+            Point t1[3], t2[3];
+            for (int v = 0; v < 3; v++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    t1[v].v[k] = random() % range;
+                    t2[v].v[k] = random() % range;
+                }
+                
+                if (mode >= 2)
+                    t1[v].v[mode - 2] = t2[v].v[mode - 2] = 3;
+            }
+            
+            if (degenerate(t1) || degenerate(t2))
+                continue;
+            
+            bool expected = trianglesIntersect(t1, t2);
+            MPTrianglePlane plane1 = MPTrianglePlaneMake(toTriangle(t1));
+            
+            mismatches += MPTrianglesIntersect(toTriangle(t1), toTriangle(t2)) != expected;
+            mismatches += MPTrianglesIntersectWithPlane(&plane1, toTriangle(t2)) != expected;
+            tested++;
+            intersecting += expected;
+        }
+    }
+    
+    MP_CHECK(mismatches == 0);
+    
+    // make sure both outcomes were actually exercised
+    MP_CHECK(intersecting > tested/10);
+    MP_CHECK(intersecting < tested - tested/10);
+}
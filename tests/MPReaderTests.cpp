@@ -0,0 +1,105 @@
+//
+//  MPReaderTests.cpp
+//
+//  Checks that environments whose files or imports are missing or malformed are reported and
+//  rejected, rather than built from the meshes that did load.
+
+#include "MPTest.h"
+#include "MPReader.h"
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+using namespace MP;
+
+static std::string geometryPath(const std::string &name)
+{
+    char cwd[4096];
+    return std::string(getcwd(cwd, sizeof(cwd)) ? cwd : ".") + "/src/geometry/" + name;
+}
+
+/* the body of the simple environment, which uses meshes imported as Cube and Pyramid */
+static std::string simpleEnvironmentBody()
+{
+    std::ifstream file(geometryPath("simple.env").c_str());
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t start = text.find("new Environment");
+    return start == std::string::npos ? "" : text.substr(start);
+}
+
+/* writes an environment with the given imports to dir, and reads it */
+static Environment3D* readEnvironment(const std::string &dir, const std::string &imports, std::ostream &errors)
+{
+    std::string body = simpleEnvironmentBody();
+    MP_CHECK(!body.empty());
+    
+    std::string text = imports + "\n" + body;
+    std::string path = dir + "/test.env";
+    MP_CHECK(testWriteFile(path, text.data(), text.size()));
+    
+    Environment3D *env = Reader(path, errors).generateEnvironment3D();
+    unlink(path.c_str());
+    return env;
+}
+
+MP_TEST(readerLoadsEnvironment)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::ostringstream errors;
+    
+    Environment3D *env = readEnvironment(dir, "import " + geometryPath("block.mesh") + " as Cube\n"
+                                              "import " + geometryPath("pyramid.mesh") + " as Pyramid\n", errors);
+    MP_CHECK(env != nullptr);
+    MP_CHECK(errors.str().empty());
+    
+    delete env;
+    rmdir(dir.c_str());
+}
+
+MP_TEST(readerMissingImportIsReported)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::ostringstream errors;
+    
+    // the block is imported twice, so the loaded meshes released on failure include a shared one
+    Environment3D *env = readEnvironment(dir, "import " + geometryPath("block.mesh") + " as Cube\n"
+                                              "import " + geometryPath("block.mesh") + " as Block\n"
+                                              "import missing.mesh as Pyramid\n", errors);
+    MP_CHECK(env == nullptr);
+    MP_CHECK(errors.str().find("error: cannot open " + dir + "/missing.mesh") != std::string::npos);
+    MP_CHECK(errors.str().find("error: could not import " + dir + "/missing.mesh") != std::string::npos);
+    
+    delete env;
+    rmdir(dir.c_str());
+}
+
+MP_TEST(readerMalformedImportIsReported)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::string meshPath = dir + "/malformed.mesh";
+    const char text[] = "new Mesh\n{\n\tset Vertex 24 8 =\n";
+    MP_CHECK(testWriteFile(meshPath, text, sizeof(text) - 1));
+    std::ostringstream errors;
+    
+    Environment3D *env = readEnvironment(dir, "import " + geometryPath("block.mesh") + " as Cube\n"
+                                              "import malformed.mesh as Pyramid\n", errors);
+    MP_CHECK(env == nullptr);
+    MP_CHECK(errors.str().find("error: could not import " + meshPath) != std::string::npos);
+    
+    delete env;
+    unlink(meshPath.c_str());
+    rmdir(dir.c_str());
+}
+
+MP_TEST(readerMissingFileIsReported)
+{
+    std::string dir = testCreateTemporaryDirectory();
+    std::ostringstream errors;
+    
+    MP_CHECK(Reader(dir + "/missing.env", errors).generateEnvironment3D() == nullptr);
+    MP_CHECK(Reader(dir + "/missing.mesh", errors).generateMesh() == nullptr);
+    MP_CHECK(!errors.str().empty());
+    
+    rmdir(dir.c_str());
+}
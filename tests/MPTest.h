@@ -0,0 +1,52 @@
+//
+//  MPTest.h
+//
+//  A minimal test harness for the planner's library code. Tests register themselves when
+//  their translation unit is loaded and are run in order by MPTestMain.cpp; a failed check
+//  reports its file and line and fails the test, but the remaining checks still run.
+
+#ifndef __MPTest__
+#define __MPTest__
+
+#include <string>
+#include <vector>
+
+namespace MP
+{
+    typedef void (*TestFunction)();
+    
+    struct TestCase
+    {
+        const char *name;
+        TestFunction function;
+    };
+    
+    /* the tests registered so far, in the order their registrations ran */
+    std::vector<TestCase>& registeredTests();
+    
+    struct TestRegistration
+    {
+        TestRegistration(const char *name, TestFunction function)
+        {
+            registeredTests().push_back({name, function});
+        }
+    };
+    
+    /* records a failure of the running test if the condition is false */
+    void testCheck(bool condition, const char *expression, const char *file, int line);
+    
+    /* returns the path of a new empty directory for a test's files, or the empty string */
+    std::string testCreateTemporaryDirectory();
+    
+    /* writes the given bytes to path, returning false on failure */
+    bool testWriteFile(const std::string &path, const void *data, size_t size);
+}
+
+#define MP_TEST(name) \
+    static void name(); \
+    static MP::TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define MP_CHECK(condition) MP::testCheck((condition), #condition, __FILE__, __LINE__)
+
+#endif /* defined(__MPTest__) */
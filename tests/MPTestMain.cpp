@@ -0,0 +1,64 @@
+//
+//  MPTestMain.cpp
+//
+//  Runs every registered test and exits with a non-zero status if any of them failed.
+
+#include "MPTest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace MP
+{
+    static int failedChecks = 0;
+    
+    std::vector<TestCase>& registeredTests()
+    {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+    
+    void testCheck(bool condition, const char *expression, const char *file, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+            failedChecks++;
+        }
+    }
+    
+    std::string testCreateTemporaryDirectory()
+    {
+        char path[] = "/tmp/MotionPlannerTests.XXXXXX";
+        if (!mkdtemp(path))
+            return "";
+        return path;
+    }
+    
+    bool testWriteFile(const std::string &path, const void *data, size_t size)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        bool written = fwrite(data, 1, size, file) == size;
+        return fclose(file) == 0 && written;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int failedTests = 0;
+    std::vector<MP::TestCase> &tests = MP::registeredTests();
+    
+    for (size_t i = 0; i < tests.size(); i++)
+    {
+        int failedBefore = MP::failedChecks;
+        tests[i].function();
+        bool passed = MP::failedChecks == failedBefore;
+        printf("%s %s\n", passed ? "pass" : "FAIL", tests[i].name);
+        failedTests += !passed;
+    }
+    
+    printf("%d of %d tests passed\n", (int)tests.size() - failedTests, (int)tests.size());
+    return failedTests ? EXIT_FAILURE : EXIT_SUCCESS;
+}